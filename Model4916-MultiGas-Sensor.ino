@@ -108,8 +108,15 @@ cDownload gDownload;
 // the individual commmands are put in this table
 static const cCommandStream::cEntry sMyExtraCommmands[] =
         {
+        { "bench", cmdBench },
+        { "csvbench", cmdCsvBench },
         { "dir", cmdDir },
+        { "dump", cmdDump },
+        { "export", cmdExport },
         { "log", cmdLog },
+        { "sdstats", cmdSdStats },
+        { "stats", cmdStats },
+        { "stream", cmdStream },
         { "tree", cmdDir },
         // other commands go here....
         };
@@ -138,6 +145,7 @@ void setup()
 
     setup_flash();
     setup_download();
+    setup_sdFirmwareUpdate();
     setup_measurement();
     setup_radio();
     setup_commands();
@@ -287,10 +295,33 @@ void setup_download()
     gDownload.begin(gFlash, gBootloaderApi);
     }
 
+static void receiveMessage(
+    void *pContext,
+    uint8_t port,
+    const uint8_t *pMessage,
+    size_t nMessage
+    )
+    {
+    gMeasurementLoop.processDownlink(port, pMessage, nMessage);
+    }
+
+// program any firmware update left on the SD card, before anything else
+// gets going; a successful update takes effect on the reset.
+void setup_sdFirmwareUpdate()
+    {
+    if (gMeasurementLoop.handleSdFirmwareUpdate())
+        {
+        gCatena.SafePrintf("Firmware updated from SD card, rebooting\n");
+        Serial.flush();
+        NVIC_SystemReset();
+        }
+    }
+
 void setup_radio()
     {
     gLoRaWAN.begin(&gCatena);
     gCatena.registerObject(&gLoRaWAN);
+    gLoRaWAN.SetReceiveBufferBufferCb(receiveMessage);
     LMIC_setClockError(5 * MAX_CLOCK_ERROR / 100);
     }
 
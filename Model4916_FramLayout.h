@@ -0,0 +1,54 @@
+/*
+
+Module: Model4916_FramLayout.h
+
+Function:
+    Where the application keeps its own data in FRAM.
+
+Copyright:
+    See accompanying LICENSE file for copyright and license information.
+
+Author:
+    Dhinesh Kumar Pitchai, MCCI Corporation   November 2022
+
+*/
+
+#ifndef _Model4916_FramLayout_h_
+# define _Model4916_FramLayout_h_
+
+#pragma once
+
+#include <Catena_Fram.h>
+#include <cstddef>
+
+namespace McciModel4916 {
+namespace FramLayout {
+
+using Offset = McciCatena::cFramStorage::Offset;
+
+// cFramStorage grows up from offset 0; the application owns the upper
+// half of the 32 KiB FRAM, and carves it up here so regions never
+// overlap.
+constexpr Offset kAppBase           = 0x4000;
+constexpr Offset kAppEnd            = 0x8000;
+
+// 1 KiB reserved for small application records.
+constexpr Offset kAppRecords        = kAppBase;
+constexpr size_t kAppRecordsSize    = 0x0400;
+
+// settings changed by downlink.
+constexpr Offset kAppConfig         = kAppRecords;
+constexpr size_t kAppConfigSize     = 0x0080;
+
+// size and CRC of the fallback image last taken from the SD card.
+constexpr Offset kFwImages          = kAppConfig + kAppConfigSize;
+constexpr size_t kFwImagesSize      = 0x0040;
+
+// the rest holds the store-and-forward uplink queue.
+constexpr Offset kUplinkQueue       = kAppRecords + kAppRecordsSize;
+constexpr size_t kUplinkQueueSize   = kAppEnd - kUplinkQueue;
+
+} // namespace FramLayout
+} // namespace McciModel4916
+
+#endif /* _Model4916_FramLayout_h_ */
@@ -0,0 +1,312 @@
+/*
+
+Module: Model4916_SdLogFormat.h
+
+Function:
+    Layout of the binary SD card log; shared with the host tools.
+
+Copyright:
+    See accompanying LICENSE file for copyright and license information.
+
+Author:
+    Dhinesh Kumar Pitchai, MCCI Corporation   November 2022
+
+*/
+
+#ifndef _Model4916_SdLogFormat_h_
+# define _Model4916_SdLogFormat_h_
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+namespace McciModel4916 {
+namespace SdLogFormat {
+
+// Logs are rotated daily, and when a file is full. A file's 8.3 name is
+// YYMMDDnn, from the UTC date of its first record and a part number nn;
+// if the time isn't known, it's Bbbbbbnn, from the boot count. Binary
+// logs are .REC, CSV logs .CSV. Each has a sparse index beside it (.RCI
+// and .CSI) of IndexEntry_t, one every few records, for seeking by time.
+//
+// A binary log file is one 512-byte header sector, followed by record
+// sectors. Each record sector holds kRecordsPerSector records and is
+// padded with zeros to the end, so no record straddles a sector. The
+// file grows ahead of the records in zero-filled steps of 16 sectors
+// (cMeasurementLoop::kSdLogAllocSectors), and each step updates the FAT
+// and the directory entry; records are written in place, in sequence,
+// so writing them changes neither. All fields are little-endian, floats
+// are IEEE single precision. See extra/catena-sd-binary-log-format.md.
+
+constexpr size_t kSectorSize        = 512;
+constexpr std::uint16_t kSchemaVersion = 2;
+
+// largest raw uplink we keep; matches cMeasurementFormat::kTxBufferSize.
+constexpr size_t kMaxRaw            = 46;
+
+struct FileHeader_t
+    {
+    // kFileMagic
+    std::uint8_t                magic[8];
+    std::uint16_t               schemaVersion;
+    std::uint16_t               headerSize;
+    std::uint16_t               recordSize;
+    std::uint8_t                recordsPerSector;
+    // format byte of the raw uplinks in the records (0x27)
+    std::uint8_t                messageFormat;
+    // DevEUI, most significant byte first; all zero if not provisioned
+    std::uint8_t                devEUI[8];
+    // boot count when the file was created
+    std::uint32_t               bootCount;
+    // creation time, seconds since the Unix epoch; 0 if unknown
+    std::uint32_t               createTime;
+    // records the file was allocated for (schema 2)
+    std::uint32_t               recordCapacity;
+    std::uint8_t                reserved[24];
+    // crc32_ieee() over the bytes above
+    std::uint32_t               crc;
+    };
+
+struct Record_t
+    {
+    // record number within the file, from 0
+    std::uint32_t               sequence;
+    // capture time, seconds since the Unix epoch; 0 if unknown
+    std::uint32_t               time;
+    // cMeasurementFormat::Flags of the valid fields
+    std::uint16_t               flags;
+    // LoRaWAN port of the raw uplink
+    std::uint8_t                port;
+    // number of valid bytes in raw[]
+    std::uint8_t                nRaw;
+    std::uint32_t               bootCount;
+    float                       vBat;
+    float                       vBus;
+    float                       tempC;
+    float                       humidity;
+    float                       latitude;
+    float                       longitude;
+    float                       co2ppm;
+    // particle counts PC0.1 .. PC10, then mass PM0.1 .. PM10
+    std::uint32_t               count[7];
+    float                       mass[7];
+    // CO, NO2, O3, SO2 (ppm)
+    float                       gases[4];
+    std::uint8_t                raw[kMaxRaw];
+    std::uint16_t               reserved;
+    // crc32_ieee() over the bytes above
+    std::uint32_t               crc;
+    };
+
+constexpr std::uint8_t kFileMagic[8] = { 'M', '4', '9', '1', '6', 'L', 'O', 'G' };
+constexpr size_t kRecordSize        = sizeof(Record_t);
+constexpr unsigned kRecordsPerSector = kSectorSize / kRecordSize;
+constexpr size_t kRecordPad         = kSectorSize - kRecordsPerSector * kRecordSize;
+
+static_assert(sizeof(FileHeader_t) == 64, "FileHeader_t layout changed");
+static_assert(sizeof(Record_t) == 168, "Record_t layout changed");
+static_assert(offsetof(Record_t, crc) == kRecordSize - 4, "crc must be last");
+
+struct IndexEntry_t
+    {
+    // capture time of the record, seconds since the Unix epoch
+    std::uint32_t               time;
+    // file offset of the record
+    std::uint32_t               offset;
+    };
+
+static_assert(sizeof(IndexEntry_t) == 8, "IndexEntry_t layout changed");
+
+// a file's part number is 0 .. kMaxParts-1
+constexpr unsigned kMaxParts        = 100;
+
+// file offset of record i
+constexpr std::uint32_t recordOffset(std::uint32_t i)
+    {
+    return kSectorSize * (1 + i / kRecordsPerSector) + kRecordSize * (i % kRecordsPerSector);
+    }
+
+// number of records that fit in a file of nSectors sectors
+constexpr std::uint32_t recordCapacity(std::uint32_t nSectors)
+    {
+    return nSectors <= 1 ? 0 : (nSectors - 1) * kRecordsPerSector;
+    }
+
+/****************************************************************************\
+|
+|   Sensor traces
+|
+\****************************************************************************/
+
+// If fSdTrace is set in the operating flags, the raw inputs of each
+// measurement are also appended to Data/YYMMDD00.TRC (named as the logs
+// are, always part 00): a TraceHeader_t, then a TraceRecord_t per
+// measurement. Nothing is padded or preallocated. extra/hostsim replays
+// a trace through the measurement code; see
+// extra/catena-sd-trace-format.md.
+
+constexpr std::uint16_t kTraceSchemaVersion = 1;
+
+struct TraceHeader_t
+    {
+    // kTraceMagic
+    std::uint8_t                magic[8];
+    std::uint16_t               schemaVersion;
+    std::uint16_t               headerSize;
+    std::uint16_t               recordSize;
+    std::uint16_t               reserved0;
+    // DevEUI, most significant byte first; all zero if not provisioned
+    std::uint8_t                devEUI[8];
+    // boot count when the file was created
+    std::uint32_t               bootCount;
+    // creation time, seconds since the Unix epoch; 0 if unknown
+    std::uint32_t               createTime;
+    std::uint8_t                reserved[28];
+    // crc32_ieee() over the bytes above
+    std::uint32_t               crc;
+    };
+
+// TraceRecord_t::valid: the inputs that were read.
+enum TraceValid : std::uint16_t
+    {
+    kTraceBoot      = 1 << 0,
+    kTraceSht3x     = 1 << 1,
+    // a new SCD30 reading since the previous record
+    kTraceScd30     = 1 << 2,
+    kTraceIps7100   = 1 << 3,
+    kTraceGas       = 1 << 4,
+    kTraceGps       = 1 << 5,
+    };
+
+struct TraceRecord_t
+    {
+    // capture time, seconds since the Unix epoch; 0 if unknown
+    std::uint32_t               time;
+    // millis() when the measurement started
+    std::uint32_t               ms;
+    std::uint32_t               bootCount;
+    // TraceValid bits
+    std::uint16_t               valid;
+    // cMeasurementLoop::SensorMask at the time
+    std::uint8_t                sensorMask;
+    std::uint8_t                reserved0;
+    float                       vBat;
+    // SHT3x, as the driver returned them
+    float                       shtTempC;
+    float                       shtHumidity;
+    // the last SCD30 reading, and millis() when it was read
+    float                       scdCO2ppm;
+    float                       scdTempC;
+    float                       scdHumidity;
+    std::uint32_t               scdMs;
+    // IPS-7100 counts PC0.1 .. PC10, then mass PM0.1 .. PM10
+    std::uint32_t               ipsCount[7];
+    float                       ipsMass[7];
+    // ADS131M04 volts, in channel order: CO, NO2, O3, SO2
+    float                       adcVolts[4];
+    // GNSS position, and its time (seconds since the Unix epoch)
+    float                       latitude;
+    float                       longitude;
+    std::uint32_t               gpsTime;
+    // the calibration the volts were converted with
+    float                       vGasZero;
+    float                       calibrationFactor[4];
+    // crc32_ieee() over the bytes above
+    std::uint32_t               crc;
+    };
+
+constexpr std::uint8_t kTraceMagic[8] = { 'M', '4', '9', '1', '6', 'T', 'R', 'C' };
+
+static_assert(sizeof(TraceHeader_t) == 64, "TraceHeader_t layout changed");
+static_assert(sizeof(TraceRecord_t) == 152, "TraceRecord_t layout changed");
+static_assert(offsetof(TraceRecord_t, crc) == sizeof(TraceRecord_t) - 4, "crc must be last");
+
+/****************************************************************************\
+|
+|   File names
+|
+\****************************************************************************/
+
+// proleptic Gregorian date of a count of days since 1970-01-01.
+static inline void
+civilFromDays(
+    std::int32_t z,
+    unsigned &year,
+    unsigned &month,
+    unsigned &day
+    )
+    {
+    z += 719468;
+    std::int32_t const era = (z >= 0 ? z : z - 146096) / 146097;
+    unsigned const doe = unsigned(z - era * 146097);
+    unsigned const yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    unsigned const doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    unsigned const mp = (5 * doy + 2) / 153;
+
+    day = doy - (153 * mp + 2) / 5 + 1;
+    month = mp < 10 ? mp + 3 : mp - 9;
+    year = unsigned(yoe + era * 400) + (month <= 2);
+    }
+
+// count of days since 1970-01-01 of a proleptic Gregorian date.
+static inline std::int32_t
+daysFromCivil(
+    unsigned year,
+    unsigned month,
+    unsigned day
+    )
+    {
+    std::int32_t const y = std::int32_t(year) - (month <= 2);
+    std::int32_t const era = (y >= 0 ? y : y - 399) / 400;
+    unsigned const yoe = unsigned(y - era * 400);
+    unsigned const doy = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+    unsigned const doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+
+    return era * 146097 + std::int32_t(doe) - 719468;
+    }
+
+// the files a record goes to are named for this key: the day number
+// (since the Unix epoch) if the time is known, otherwise the boot count
+// with kBootKey set.
+constexpr std::uint32_t kBootKey    = 0x80000000u;
+
+constexpr std::uint32_t fileKey(std::uint32_t time, std::uint32_t bootCount)
+    {
+    return time != 0 ? time / 86400 : kBootKey | (bootCount % 100000);
+    }
+
+// "Data/YYMMDDnn.ext" or "Data/Bbbbbbnn.ext"
+static inline void
+fileName(
+    char *pBuffer,
+    size_t nBuffer,
+    std::uint32_t key,
+    unsigned part,
+    const char *pExt
+    )
+    {
+    if (key & kBootKey)
+        {
+        std::snprintf(
+            pBuffer, nBuffer, "Data/B%05lu%02u.%s",
+            (unsigned long)(key & ~kBootKey) % 100000, part % kMaxParts, pExt
+            );
+        }
+    else
+        {
+        unsigned year, month, day;
+
+        civilFromDays(std::int32_t(key), year, month, day);
+        std::snprintf(
+            pBuffer, nBuffer, "Data/%02u%02u%02u%02u.%s",
+            year % 100, month, day, part % kMaxParts, pExt
+            );
+        }
+    }
+
+} // namespace SdLogFormat
+} // namespace McciModel4916
+
+#endif /* _Model4916_SdLogFormat_h_ */
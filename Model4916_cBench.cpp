@@ -0,0 +1,178 @@
+/*
+
+Module: Model4916_cBench.cpp
+
+Function:
+    Time small kernels, and report the results as CSV.
+
+Copyright:
+    See accompanying LICENSE file for copyright and license information.
+
+Author:
+    Dhinesh Kumar Pitchai, MCCI Corporation   November 2022
+
+*/
+
+#include "Model4916_cBench.h"
+
+#include <mcciadk_baselib.h>
+
+#include <cstring>
+
+using namespace McciModel4916;
+
+/****************************************************************************\
+|
+|   Variables
+|
+\****************************************************************************/
+
+volatile std::uint32_t cBench::s_sink;
+
+/****************************************************************************\
+|
+|   Code
+|
+\****************************************************************************/
+
+void
+cBench::sink(float v)
+    {
+    std::uint32_t bits;
+
+    static_assert(sizeof(bits) == sizeof(v), "float isn't 32 bits");
+    std::memcpy(&bits, &v, sizeof(bits));
+    sink(bits);
+    }
+
+void
+cBench::begin()
+    {
+    char buf[96];
+
+    McciAdkLib_Snprintf(
+        buf, sizeof(buf), 0,
+        "# bench clock_hz=%lu clock=%s ms_per_kernel=%lu\n",
+        (unsigned long) this->m_clock.hz,
+        this->m_clock.fCycles ? "cycles" : "time",
+        (unsigned long) this->m_msPerKernel
+        );
+    this->m_out.write(buf);
+    this->m_out.write("kernel,ops,ns_per_op,cycles_per_op,allocs_per_op\n");
+    }
+
+std::uint64_t
+cBench::timeBatch(
+    Kernel_t *pKernel,
+    void *pContext,
+    std::uint32_t nOps
+    )
+    {
+    std::uint64_t const tStart = this->m_clock.pRead();
+    pKernel(pContext, nOps);
+    return this->m_clock.pRead() - tStart;
+    }
+
+/*
+
+Name:   cBench::run()
+
+Function:
+    Time a kernel, and print its row.
+
+Definition:
+    bool cBench::run(
+            const char *pName,
+            cBench::Kernel_t *pKernel,
+            void *pContext
+            );
+
+Description:
+    The batch size starts at one op and doubles until a batch takes
+    about a sixth of the time allowed for the kernel (or kMaxOps is
+    reached). kSamples batches of that size are timed, and the fastest
+    is reported: anything that slows a batch down (an interrupt, a
+    context switch on the host) only ever adds time.
+
+Returns:
+    false if the kernel was filtered out; true if it ran.
+
+*/
+
+bool
+cBench::run(
+    const char *pName,
+    Kernel_t *pKernel,
+    void *pContext
+    )
+    {
+    if (this->m_pFilter != nullptr &&
+        std::strncmp(pName, this->m_pFilter, std::strlen(this->m_pFilter)) != 0)
+        return false;
+
+    std::uint64_t targetTicks = std::uint64_t(this->m_clock.hz) * this->m_msPerKernel / 1000 / (2 * kSamples);
+    if (targetTicks == 0)
+        targetTicks = 1;
+
+    std::uint32_t nOps = 1;
+    while (nOps < kMaxOps && this->timeBatch(pKernel, pContext, nOps) < targetTicks)
+        nOps *= 2;
+
+    auto const pCounter = this->m_pAllocationCounter;
+    std::uint32_t const nAllocStart = pCounter != nullptr ? pCounter() : 0;
+    std::uint64_t best = ~std::uint64_t(0);
+
+    for (unsigned i = 0; i < kSamples; ++i)
+        {
+        auto const ticks = this->timeBatch(pKernel, pContext, nOps);
+        if (ticks < best)
+            best = ticks;
+        }
+
+    ++this->m_nRun;
+
+    // ns/op to a tenth, from picoseconds: exact for clocks that divide
+    // 1 THz, as the device's and the host's do.
+    std::uint64_t const psPerTick = 1000000000000ull / this->m_clock.hz;
+    std::uint64_t const psPerOp = best * psPerTick / nOps;
+    char buf[128];
+    char cycles[24] = "";
+    char allocs[24] = "";
+
+    if (this->m_clock.fCycles)
+        {
+        std::uint64_t const cycles10 = best * 10 / nOps;
+
+        McciAdkLib_Snprintf(
+            cycles, sizeof(cycles), 0,
+            "%lu.%lu",
+            (unsigned long) (cycles10 / 10),
+            (unsigned long) (cycles10 % 10)
+            );
+        }
+
+    if (pCounter != nullptr)
+        {
+        std::uint64_t const allocs100 = std::uint64_t(pCounter() - nAllocStart) * 100 / (std::uint64_t(nOps) * kSamples);
+
+        McciAdkLib_Snprintf(
+            allocs, sizeof(allocs), 0,
+            "%lu.%02lu",
+            (unsigned long) (allocs100 / 100),
+            (unsigned long) (allocs100 % 100)
+            );
+        }
+
+    McciAdkLib_Snprintf(
+        buf, sizeof(buf), 0,
+        "%s,%lu,%lu.%lu,%s,%s\n",
+        pName,
+        (unsigned long) nOps,
+        (unsigned long) (psPerOp / 1000),
+        (unsigned long) (psPerOp % 1000 / 100),
+        cycles,
+        allocs
+        );
+    this->m_out.write(buf);
+    return true;
+    }
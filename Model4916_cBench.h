@@ -0,0 +1,127 @@
+/*
+
+Module: Model4916_cBench.h
+
+Function:
+    cBench: time small kernels, and report the results as CSV.
+
+Copyright:
+    See accompanying LICENSE file for copyright and license information.
+
+Author:
+    Dhinesh Kumar Pitchai, MCCI Corporation   November 2022
+
+*/
+
+#ifndef _Model4916_cBench_h_
+# define _Model4916_cBench_h_
+
+#pragma once
+
+#include <Arduino.h>
+
+#include <cstddef>
+#include <cstdint>
+
+namespace McciModel4916 {
+
+/****************************************************************************\
+|
+|   Microbenchmarks
+|
+\****************************************************************************/
+
+// A kernel does its operation a given number of times. cBench doubles
+// the count until a batch takes long enough to time well, then times a
+// few batches and reports the fastest, as a CSV row:
+//
+//      kernel,ops,ns_per_op,cycles_per_op,allocs_per_op
+//
+// cycles_per_op is empty unless the clock counts CPU cycles, and
+// allocs_per_op unless the platform can count allocations. Lines
+// starting with '#' describe the run. Saved runs can be compared with
+// extra/benchcmp.py.
+//
+// The clock comes from the caller: SysTick on the device (see the
+// "bench" command), the host's steady clock in extra/hostsim/hostbench.
+class cBench
+    {
+public:
+    // run the operation nOps times. Anything computed should go to
+    // sink(), so the compiler can't drop it.
+    typedef void Kernel_t(void *pContext, std::uint32_t nOps);
+
+    // a free-running counter, and its rate in Hz. fCycles is set if it
+    // counts CPU cycles.
+    struct Clock_t
+        {
+        std::uint64_t (*pRead)(void);
+        std::uint32_t hz;
+        bool fCycles;
+        };
+
+    // allocations so far.
+    typedef std::uint32_t AllocationCounter_t(void);
+
+    // batches timed for each kernel.
+    static constexpr unsigned kSamples = 3;
+    // the most ops in a batch.
+    static constexpr std::uint32_t kMaxOps = 1u << 24;
+
+    cBench(Print &out, const Clock_t &clock, std::uint32_t msPerKernel)
+        : m_out(out)
+        , m_clock(clock)
+        , m_msPerKernel(msPerKernel)
+        {}
+
+    // neither copyable nor movable
+    cBench(const cBench&) = delete;
+    cBench& operator=(const cBench&) = delete;
+    cBench(const cBench&&) = delete;
+    cBench& operator=(const cBench&&) = delete;
+
+    // run only the kernels whose names start with pPrefix.
+    void setFilter(const char *pPrefix)
+        {
+        this->m_pFilter = pPrefix;
+        }
+    void setAllocationCounter(AllocationCounter_t *pCounter)
+        {
+        this->m_pAllocationCounter = pCounter;
+        }
+
+    // print the header.
+    void begin();
+
+    // time a kernel and print its row. Returns false if it was skipped.
+    bool run(const char *pName, Kernel_t *pKernel, void *pContext);
+
+    // the number of kernels run.
+    unsigned getCount() const
+        {
+        return this->m_nRun;
+        }
+
+    static void sink(std::uint32_t v)
+        {
+        s_sink += v;
+        }
+    static void sink(float v);
+
+private:
+    static volatile std::uint32_t   s_sink;
+
+    // time one batch, in clock ticks.
+    std::uint64_t timeBatch(Kernel_t *pKernel, void *pContext, std::uint32_t nOps);
+
+    Print                           &m_out;
+    Clock_t                         m_clock;
+    std::uint32_t                   m_msPerKernel;
+    const char                      *m_pFilter = nullptr;
+    AllocationCounter_t             *m_pAllocationCounter = nullptr;
+    unsigned                        m_nRun = 0;
+    };
+
+} // namespace McciModel4916
+
+#endif /* _Model4916_cBench_h_ */
@@ -0,0 +1,292 @@
+/*
+
+Module: Model4916_cCsvRow.cpp
+
+Function:
+    Formats a CSV row into a line buffer.
+
+Copyright:
+    See accompanying LICENSE file for copyright and license information.
+
+Author:
+    Dhinesh Kumar Pitchai, MCCI Corporation   November 2022
+
+*/
+
+#include "Model4916_cCsvRow.h"
+
+#include <cmath>
+#include <cstring>
+
+using namespace McciModel4916;
+
+/****************************************************************************\
+|
+|   Read-only data
+|
+\****************************************************************************/
+
+namespace {
+
+const char kHexDigits[] = "0123456789abcdef";
+
+// "00" to "99", so each division by 100 yields two digits.
+const char kDigitPairs[] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+// the largest magnitude Print::print(float) prints; beyond it, "ovf".
+constexpr float kMaxFloat = 4294967040.0f;
+
+} // namespace
+
+/****************************************************************************\
+|
+|   Code
+|
+\****************************************************************************/
+
+void
+cCsvRow::setPrecision(
+    unsigned digits
+    )
+    {
+    if (digits > kMaxDigits)
+        digits = kMaxDigits;
+
+    this->m_digits = digits;
+    this->m_scale = 1;
+    while (digits-- > 0)
+        this->m_scale *= 10;
+    }
+
+char *
+cCsvRow::reserve(
+    size_t n
+    )
+    {
+    if (this->m_nBuffer - this->m_n < n)
+        {
+        this->m_fOverflow = true;
+        return nullptr;
+        }
+
+    char * const p = this->m_pBuffer + this->m_n;
+    this->m_n += n;
+    return p;
+    }
+
+void
+cCsvRow::putBytes(
+    const char *p,
+    size_t n
+    )
+    {
+    char * const pOut = this->reserve(n);
+
+    if (pOut != nullptr)
+        std::memcpy(pOut, p, n);
+    }
+
+void
+cCsvRow::putString(
+    const char *s
+    )
+    {
+    this->putBytes(s, std::strlen(s));
+    }
+
+void
+cCsvRow::putUnsigned(
+    std::uint32_t v
+    )
+    {
+    char digits[10];
+    char *p = digits + sizeof(digits);
+
+    while (v >= 100)
+        {
+        unsigned const r = v % 100;
+
+        v /= 100;
+        p -= 2;
+        p[0] = kDigitPairs[2 * r];
+        p[1] = kDigitPairs[2 * r + 1];
+        }
+
+    if (v >= 10)
+        {
+        p -= 2;
+        p[0] = kDigitPairs[2 * v];
+        p[1] = kDigitPairs[2 * v + 1];
+        }
+    else
+        *--p = char('0' + v);
+
+    this->putBytes(p, digits + sizeof(digits) - p);
+    }
+
+/*
+
+Name:	cCsvRow::putFloat()
+
+Function:
+    Append a float with getPrecision() digits after the point.
+
+Definition:
+    void cCsvRow::putFloat(
+        float v
+        );
+
+Description:
+    The float is m * 2^e, with m < 2^24. Its value times 10^digits,
+    rounded half up, is computed exactly in 64 bits: for e >= 0 it's
+    just a shift and multiply; otherwise m * 10^digits (< 2^44) is
+    shifted right by -e, with half the last bit added first. The
+    integer and fraction digits are then printed from that.
+
+    This matches Print::print(float) except when the value is exactly
+    half way (e.g. 2.125 to two digits); Print's double arithmetic
+    rounds those either way, so they're handed to putFloatTie(), which
+    does the same arithmetic.
+
+Returns:
+    No explicit result.
+
+*/
+
+void
+cCsvRow::putFloat(
+    float v
+    )
+    {
+    if (std::isnan(v))
+        {
+        this->putBytes("nan", 3);
+        return;
+        }
+    if (std::isinf(v))
+        {
+        this->putBytes("inf", 3);
+        return;
+        }
+    if (v > kMaxFloat || v < -kMaxFloat)
+        {
+        this->putBytes("ovf", 3);
+        return;
+        }
+
+    std::uint32_t bits;
+    std::memcpy(&bits, &v, sizeof(bits));
+
+    unsigned const exponent = (bits >> 23) & 0xFF;
+    std::uint32_t m = bits & 0x7FFFFF;
+    int e;
+
+    // Print writes a sign for anything below zero, even if the digits
+    // are all zero; but not for -0.0.
+    if (v < 0.0f)
+        this->putChar('-');
+
+    if (exponent == 0)
+        e = -149;
+    else
+        {
+        m |= 0x800000;
+        e = int(exponent) - 150;
+        }
+
+    std::uint64_t scaled;
+    if (e >= 0)
+        scaled = (std::uint64_t(m) << e) * this->m_scale;
+    else if (e > -64)
+        {
+        unsigned const shift = unsigned(-e);
+        std::uint64_t const product = std::uint64_t(m) * this->m_scale;
+        std::uint64_t const half = std::uint64_t(1) << (shift - 1);
+
+        // exactly half way: Print's result depends on how its double
+        // arithmetic rounds, so do the same.
+        if ((product & (2 * half - 1)) == half)
+            {
+            this->putFloatTie(v < 0.0f ? -v : v);
+            return;
+            }
+
+        scaled = (product + half) >> shift;
+        }
+    else
+        scaled = 0;
+
+    this->putUnsigned(std::uint32_t(scaled / this->m_scale));
+
+    if (this->m_digits == 0)
+        return;
+
+    char * const p = this->reserve(this->m_digits + 1);
+    if (p == nullptr)
+        return;
+
+    std::uint32_t frac = std::uint32_t(scaled % this->m_scale);
+    p[0] = '.';
+    for (unsigned i = this->m_digits; i > 0; --i)
+        {
+        p[i] = char('0' + frac % 10);
+        frac /= 10;
+        }
+    }
+
+// the digits of Print::printFloat(), for the rare values it's exactly
+// half way between two outputs; v is positive.
+void
+cCsvRow::putFloatTie(
+    double v
+    )
+    {
+    double rounding = 0.5;
+    for (unsigned i = 0; i < this->m_digits; ++i)
+        rounding /= 10.0;
+
+    v += rounding;
+
+    std::uint32_t const intPart = std::uint32_t(v);
+    double remainder = v - double(intPart);
+
+    this->putUnsigned(intPart);
+    if (this->m_digits == 0)
+        return;
+
+    this->putChar('.');
+    for (unsigned i = 0; i < this->m_digits; ++i)
+        {
+        remainder *= 10.0;
+        unsigned const digit = unsigned(remainder);
+        this->putChar(char('0' + digit));
+        remainder -= digit;
+        }
+    }
+
+void
+cCsvRow::putHex(
+    const std::uint8_t *p,
+    size_t n
+    )
+    {
+    char * const pOut = this->reserve(2 * n);
+    if (pOut == nullptr)
+        return;
+
+    for (size_t i = 0; i < n; ++i)
+        {
+        pOut[2 * i] = kHexDigits[p[i] >> 4];
+        pOut[2 * i + 1] = kHexDigits[p[i] & 0xF];
+        }
+    }
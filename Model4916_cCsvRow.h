@@ -0,0 +1,116 @@
+/*
+
+Module: Model4916_cCsvRow.h
+
+Function:
+    cCsvRow: formats a CSV row into a line buffer.
+
+Copyright:
+    See accompanying LICENSE file for copyright and license information.
+
+Author:
+    Dhinesh Kumar Pitchai, MCCI Corporation   November 2022
+
+Notes:
+    This file doesn't depend on Arduino, so host tools can use it.
+
+*/
+
+#ifndef _Model4916_cCsvRow_h_
+# define _Model4916_cCsvRow_h_
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace McciModel4916 {
+
+/****************************************************************************\
+|
+|   CSV row formatter
+|
+\****************************************************************************/
+
+// Fields are appended to a caller-supplied buffer, so a whole row can be
+// written with one call. Numbers are converted with integer arithmetic:
+// floats are split into mantissa and exponent and scaled to a fixed-point
+// integer, which on a CPU without an FPU is much faster than
+// Print::print(float)'s double arithmetic.
+//
+// Floats read exactly as Print::print(float, digits) would print them:
+// rounded half up, no exponent, and "nan", "inf" or "ovf" where Print
+// prints those.
+//
+// If the buffer fills, further output is dropped and isOverflow() is
+// true.
+class cCsvRow
+    {
+public:
+    static constexpr unsigned kDefaultDigits = 2;
+    static constexpr unsigned kMaxDigits = 6;
+
+    cCsvRow(char *pBuffer, size_t nBuffer, unsigned digits = kDefaultDigits)
+        : m_pBuffer(pBuffer)
+        , m_nBuffer(nBuffer)
+        {
+        this->setPrecision(digits);
+        }
+
+    // digits after the point for putFloat(); at most kMaxDigits.
+    void setPrecision(unsigned digits);
+    unsigned getPrecision() const
+        {
+        return this->m_digits;
+        }
+
+    void clear()
+        {
+        this->m_n = 0;
+        this->m_fOverflow = false;
+        }
+
+    void putChar(char c)
+        {
+        if (this->m_n < this->m_nBuffer)
+            this->m_pBuffer[this->m_n++] = c;
+        else
+            this->m_fOverflow = true;
+        }
+
+    void putString(const char *s);
+    void putBytes(const char *p, size_t n);
+    void putUnsigned(std::uint32_t v);
+    void putFloat(float v);
+    // lower-case hex, two digits per byte, no separators.
+    void putHex(const std::uint8_t *p, size_t n);
+
+    const char *getBase() const
+        {
+        return this->m_pBuffer;
+        }
+    size_t getn() const
+        {
+        return this->m_n;
+        }
+    bool isOverflow() const
+        {
+        return this->m_fOverflow;
+        }
+
+private:
+    // room for n more characters, or nullptr (and overflow) if not.
+    char *reserve(size_t n);
+    void putFloatTie(double v);
+
+    char                            *m_pBuffer;
+    size_t                          m_nBuffer;
+    size_t                          m_n = 0;
+    unsigned                        m_digits = kDefaultDigits;
+    std::uint32_t                   m_scale = 100;
+    bool                            m_fOverflow = false;
+    };
+
+} // namespace McciModel4916
+
+#endif /* _Model4916_cCsvRow_h_ */
@@ -0,0 +1,235 @@
+/*
+
+Module: Model4916_cDeltaPatch.cpp
+
+Function:
+    Rebuilds a firmware image from the old image and a delta patch.
+
+Copyright:
+    See accompanying LICENSE file for copyright and license information.
+
+Author:
+    Dhinesh Kumar Pitchai, MCCI Corporation   November 2022
+
+*/
+
+#include "Model4916_cDeltaPatch.h"
+
+#include "Model4916_crc.h"
+
+#include <cstring>
+
+using namespace McciModel4916;
+
+/****************************************************************************\
+|
+|   Reading the patch
+|
+\****************************************************************************/
+
+bool
+cDeltaPatch::getByte(
+    std::uint8_t &b
+    )
+    {
+    if (this->m_iIn == this->m_nIn)
+        {
+        this->m_iIn = 0;
+        this->m_nIn = this->m_pRead(this->m_pUserData, this->m_in, sizeof(this->m_in));
+        if (this->m_nIn == 0)
+            return this->fail(Error::kRead);
+        }
+
+    b = this->m_in[this->m_iIn++];
+    ++this->m_nPatch;
+    return true;
+    }
+
+bool
+cDeltaPatch::getBytes(
+    std::uint8_t *p,
+    size_t n
+    )
+    {
+    while (n > 0)
+        {
+        if (this->m_iIn == this->m_nIn)
+            {
+            std::uint8_t b;
+
+            if (! this->getByte(b))
+                return false;
+            *p++ = b;
+            --n;
+            continue;
+            }
+
+        size_t nCopy = this->m_nIn - this->m_iIn;
+        if (nCopy > n)
+            nCopy = n;
+
+        std::memcpy(p, this->m_in + this->m_iIn, nCopy);
+        this->m_iIn += nCopy;
+        this->m_nPatch += nCopy;
+        p += nCopy;
+        n -= nCopy;
+        }
+
+    return true;
+    }
+
+bool
+cDeltaPatch::getVarint(
+    std::uint32_t &v
+    )
+    {
+    v = 0;
+    for (unsigned shift = 0; shift < 35; shift += 7)
+        {
+        std::uint8_t b;
+
+        if (! this->getByte(b))
+            return false;
+
+        v |= std::uint32_t(b & 0x7F) << shift;
+        if ((b & 0x80) == 0)
+            return true;
+        }
+
+    return this->fail(Error::kCorrupt);
+    }
+
+/****************************************************************************\
+|
+|   Applying the patch
+|
+\****************************************************************************/
+
+bool
+cDeltaPatch::begin(
+    ReadFn *pRead,
+    void *pUserData,
+    const std::uint8_t *pOld,
+    size_t nOldMax
+    )
+    {
+    using namespace DeltaPatchFormat;
+    auto &h = this->m_header;
+
+    this->m_pRead = pRead;
+    this->m_pUserData = pUserData;
+    this->m_pOld = pOld;
+    this->m_op = kOpEnd;
+    this->m_nRemaining = 0;
+    this->m_oldPos = 0;
+    this->m_nNew = 0;
+    this->m_newCrc = 0;
+    this->m_nPatch = 0;
+    this->m_error = Error::kNone;
+    this->m_fComplete = false;
+    this->m_nIn = this->m_iIn = 0;
+
+    if (! this->getBytes((std::uint8_t *)&h, sizeof(h)))
+        return false;
+
+    if (std::memcmp(h.magic, kMagic, sizeof(h.magic)) != 0 ||
+        h.crc != crc32_ieee(&h, offsetof(Header_t, crc)))
+        return this->fail(Error::kHeader);
+
+    if (h.oldSize > nOldMax ||
+        crc32_ieee(pOld, h.oldSize) != h.oldCrc)
+        return this->fail(Error::kWrongImage);
+
+    return true;
+    }
+
+// start the next operation.
+bool
+cDeltaPatch::nextOp()
+    {
+    using namespace DeltaPatchFormat;
+    std::uint8_t op;
+    std::uint32_t length;
+
+    if (! this->getByte(op))
+        return false;
+
+    if (op == kOpEnd)
+        {
+        if (this->m_nNew != this->m_header.newSize ||
+            this->m_newCrc != this->m_header.newCrc)
+            return this->fail(Error::kMismatch);
+
+        this->m_fComplete = true;
+        return false;
+        }
+
+    if (op != kOpCopy && op != kOpLiteral)
+        return this->fail(Error::kCorrupt);
+
+    if (! this->getVarint(length))
+        return false;
+
+    if (length == 0 || length > this->m_header.newSize - this->m_nNew)
+        return this->fail(Error::kCorrupt);
+
+    if (op == kOpCopy)
+        {
+        std::uint32_t zigzag;
+
+        if (! this->getVarint(zigzag))
+            return false;
+
+        std::int32_t const delta = std::int32_t(zigzag >> 1) ^ -std::int32_t(zigzag & 1);
+        std::uint32_t const pos = this->m_oldPos + std::uint32_t(delta);
+
+        // unsigned compare also catches positions before the start.
+        if (pos > this->m_header.oldSize || length > this->m_header.oldSize - pos)
+            return this->fail(Error::kCorrupt);
+
+        this->m_oldPos = pos;
+        }
+
+    this->m_op = op;
+    this->m_nRemaining = length;
+    return true;
+    }
+
+size_t
+cDeltaPatch::read(
+    std::uint8_t *pBuffer,
+    size_t nBuffer
+    )
+    {
+    using namespace DeltaPatchFormat;
+    size_t nOut = 0;
+
+    while (nOut < nBuffer && ! this->m_fComplete && this->m_error == Error::kNone)
+        {
+        if (this->m_nRemaining == 0)
+            {
+            if (! this->nextOp())
+                break;
+            continue;
+            }
+
+        size_t n = nBuffer - nOut;
+        if (n > this->m_nRemaining)
+            n = this->m_nRemaining;
+
+        if (this->m_op == kOpCopy)
+            {
+            std::memcpy(pBuffer + nOut, this->m_pOld + this->m_oldPos, n);
+            this->m_oldPos += n;
+            }
+        else if (! this->getBytes(pBuffer + nOut, n))
+            break;
+
+        this->m_newCrc = crc32_ieee(pBuffer + nOut, n, this->m_newCrc);
+        this->m_nNew += n;
+        this->m_nRemaining -= n;
+        nOut += n;
+        }
+
+    return nOut;
+    }
@@ -0,0 +1,174 @@
+/*
+
+Module: Model4916_cDeltaPatch.h
+
+Function:
+    cDeltaPatch: rebuilds a firmware image from the old image and a patch.
+
+Copyright:
+    See accompanying LICENSE file for copyright and license information.
+
+Author:
+    Dhinesh Kumar Pitchai, MCCI Corporation   November 2022
+
+Notes:
+    This file doesn't depend on Arduino; extra/mkpatch.cpp uses it to
+    check the patches it writes.
+
+*/
+
+#ifndef _Model4916_cDeltaPatch_h_
+# define _Model4916_cDeltaPatch_h_
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace McciModel4916 {
+
+/****************************************************************************\
+|
+|   Delta patch format
+|
+\****************************************************************************/
+
+// A patch is a 32-byte header followed by a stream of operations. Each
+// operation is a code byte and LEB128 unsigned arguments:
+//
+//  kOpCopy {length} {delta}    copy length bytes of the old image. The
+//                              source is delta (zigzag-encoded, signed)
+//                              from where the previous copy ended, so
+//                              code that has only moved costs a few
+//                              bytes.
+//  kOpLiteral {length} {bytes} the next length bytes of the new image.
+//  kOpEnd                      the new image is complete.
+//
+// The header names the old image by size and CRC-32, so a patch is only
+// ever applied to the image it was made from, and the new image by size
+// and CRC-32, so the result can be checked before it's programmed.
+namespace DeltaPatchFormat {
+
+constexpr char kMagic[8] = { 'M', '4', '9', '1', '6', 'P', 'A', 'T' };
+
+enum Op : std::uint8_t
+    {
+    kOpEnd      = 0x00,
+    kOpCopy     = 0x01,
+    kOpLiteral  = 0x02,
+    };
+
+struct Header_t
+    {
+    char                            magic[8];
+    std::uint32_t                   oldSize;
+    std::uint32_t                   oldCrc;
+    std::uint32_t                   newSize;
+    std::uint32_t                   newCrc;
+    std::uint32_t                   reserved;
+    // CRC-32 of the bytes above
+    std::uint32_t                   crc;
+    };
+
+static_assert(sizeof(Header_t) == 32, "DeltaPatchFormat::Header_t must be 32 bytes");
+
+} // namespace DeltaPatchFormat
+
+/****************************************************************************\
+|
+|   The patch applier
+|
+\****************************************************************************/
+
+// The new image is produced a buffer at a time by read(), so it can feed
+// cDownload's ReadBytes callback directly. The old image must be
+// readable as memory (on the device, it's the running image in the
+// MCU's flash); the patch is pulled through a callback, so it can come
+// from a file or any other store.
+class cDeltaPatch
+    {
+public:
+    // read up to n bytes of patch; return the number read, 0 at the end.
+    typedef size_t (ReadFn)(void *pUserData, std::uint8_t *pBuffer, size_t nBuffer);
+
+    enum class Error : std::uint8_t
+        {
+        kNone,
+        kRead,          // the patch ended early
+        kHeader,        // not a patch
+        kWrongImage,    // made for another old image
+        kCorrupt,       // bad operation, or out of range
+        kMismatch,      // the result isn't the image named in the header
+        };
+
+    cDeltaPatch() {}
+
+    // neither copyable nor movable
+    cDeltaPatch(const cDeltaPatch&) = delete;
+    cDeltaPatch& operator=(const cDeltaPatch&) = delete;
+    cDeltaPatch(const cDeltaPatch&&) = delete;
+    cDeltaPatch& operator=(const cDeltaPatch&&) = delete;
+
+    // read and check the header. pOld points to the old image, of which
+    // at most nOldMax bytes may be read; its CRC is checked too.
+    bool begin(ReadFn *pRead, void *pUserData, const std::uint8_t *pOld, size_t nOldMax);
+
+    // produce up to nBuffer bytes of the new image; returns the number
+    // produced, short only at the end or on error.
+    size_t read(std::uint8_t *pBuffer, size_t nBuffer);
+
+    // true once the whole image has been produced and matches its CRC.
+    bool isComplete() const
+        {
+        return this->m_fComplete;
+        }
+    Error getError() const
+        {
+        return this->m_error;
+        }
+    const DeltaPatchFormat::Header_t &getHeader() const
+        {
+        return this->m_header;
+        }
+    std::uint32_t getPatchBytes() const
+        {
+        return this->m_nPatch;
+        }
+
+private:
+    bool fail(Error error)
+        {
+        if (this->m_error == Error::kNone)
+            this->m_error = error;
+        return false;
+        }
+    bool getByte(std::uint8_t &b);
+    bool getBytes(std::uint8_t *p, size_t n);
+    bool getVarint(std::uint32_t &v);
+    bool nextOp();
+
+    ReadFn                          *m_pRead = nullptr;
+    void                            *m_pUserData = nullptr;
+    const std::uint8_t              *m_pOld = nullptr;
+    DeltaPatchFormat::Header_t      m_header {};
+    // the operation in progress, and the bytes it has left
+    std::uint8_t                    m_op = DeltaPatchFormat::kOpEnd;
+    std::uint32_t                   m_nRemaining = 0;
+    // where the next copy starts in the old image, before its delta
+    std::uint32_t                   m_oldPos = 0;
+    // bytes of new image produced, and their CRC
+    std::uint32_t                   m_nNew = 0;
+    std::uint32_t                   m_newCrc = 0;
+    // bytes of patch consumed
+    std::uint32_t                   m_nPatch = 0;
+    Error                           m_error = Error::kNone;
+    bool                            m_fComplete = false;
+    // patch input, read ahead
+    std::uint8_t                    m_in[128];
+    size_t                          m_nIn = 0;
+    size_t                          m_iIn = 0;
+    };
+
+} // namespace McciModel4916
+
+#endif /* _Model4916_cDeltaPatch_h_ */
@@ -0,0 +1,196 @@
+/*
+
+Module: Model4916_cLogCategory.cpp
+
+Function:
+    Log categories, with levels and rate limits.
+
+Copyright:
+    See accompanying LICENSE file for copyright and license information.
+
+Author:
+    Dhinesh Kumar Pitchai, MCCI Corporation   November 2022
+
+*/
+
+#include "Model4916_cLogCategory.h"
+
+#include <Catena_Log.h>
+
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+
+using namespace McciModel4916;
+using namespace McciCatena;
+
+/****************************************************************************\
+|
+|   globals
+|
+\****************************************************************************/
+
+// name, default level, messages per second, burst. The default levels
+// show about what was shown before there were categories.
+cLogCategory gLogFsm("fsm", cLogCategory::kTrace, 5, 10);
+cLogCategory gLogSensors("sensors", cLogCategory::kInfo, 10, 20);
+cLogCategory gLogRadio("radio", cLogCategory::kTrace, 5, 10);
+cLogCategory gLogSd("sd", cLogCategory::kInfo, 5, 10);
+cLogCategory gLogFwUpdate("fw-update", cLogCategory::kWarning, 5, 20);
+cLogCategory gLogPower("power", cLogCategory::kInfo, 5, 10);
+
+/****************************************************************************\
+|
+|   Read-only data
+|
+\****************************************************************************/
+
+namespace {
+
+cLogCategory * const kCategoryTable[cLogCategory::kCategories] =
+    {
+    &gLogFsm, &gLogSensors, &gLogRadio, &gLogSd, &gLogFwUpdate, &gLogPower,
+    };
+
+const char * const kLevelNames[cLogCategory::kLevels] =
+    {
+    "off", "error", "warning", "info", "trace",
+    };
+
+} // namespace
+
+/****************************************************************************\
+|
+|   Code
+|
+\****************************************************************************/
+
+void
+cLogCategory::printf(
+    Level level,
+    const char *pFmt,
+    ...
+    )
+    {
+    if (! this->isEnabled(level))
+        return;
+
+    if (! this->take())
+        {
+        ++this->m_nSuppressed;
+        return;
+        }
+
+    if (this->m_nReported != this->m_nSuppressed)
+        {
+        gLog.printf(
+            gLog.kAlways,
+            "%s: %lu messages suppressed\n",
+            this->m_pName,
+            (unsigned long) (this->m_nSuppressed - this->m_nReported)
+            );
+        this->m_nReported = this->m_nSuppressed;
+        }
+
+    char buffer[192];
+    std::va_list ap;
+
+    va_start(ap, pFmt);
+    std::vsnprintf(buffer, sizeof(buffer), pFmt, ap);
+    va_end(ap);
+
+    gLog.printf(gLog.kAlways, "%s", buffer);
+    }
+
+bool
+cLogCategory::take()
+    {
+    if (this->m_ratePerSec == 0)
+        return true;
+
+    // a rate in tokens per second is a rate in milli-tokens per ms.
+    std::uint32_t const now = millis();
+    std::uint32_t const limit = std::uint32_t(this->m_burst) * 1000;
+    std::uint32_t const elapsed = now - this->m_lastMs;
+
+    this->m_lastMs = now;
+    if (elapsed >= limit / this->m_ratePerSec)
+        this->m_milliTokens = limit;
+    else
+        {
+        this->m_milliTokens += elapsed * this->m_ratePerSec;
+        if (this->m_milliTokens > limit)
+            this->m_milliTokens = limit;
+        }
+
+    if (this->m_milliTokens < 1000)
+        return false;
+
+    this->m_milliTokens -= 1000;
+    return true;
+    }
+
+void
+cLogCategory::setRate(
+    std::uint16_t ratePerSec,
+    std::uint16_t burst
+    )
+    {
+    this->m_ratePerSec = ratePerSec;
+    this->m_burst = burst == 0 ? 1 : burst;
+    this->m_milliTokens = std::uint32_t(this->m_burst) * 1000;
+    this->m_lastMs = millis();
+    }
+
+const char *
+cLogCategory::getLevelName(
+    Level level
+    )
+    {
+    if (unsigned(level) >= kLevels)
+        return "?";
+
+    return kLevelNames[unsigned(level)];
+    }
+
+// a level by name, or by number.
+bool
+cLogCategory::parseLevel(
+    const char *pName,
+    Level &level
+    )
+    {
+    for (unsigned i = 0; i < kLevels; ++i)
+        {
+        if (std::strcmp(pName, kLevelNames[i]) == 0 ||
+            (pName[0] == char('0' + i) && pName[1] == '\0'))
+            {
+            level = Level(i);
+            return true;
+            }
+        }
+
+    return false;
+    }
+
+cLogCategory *
+cLogCategory::getCategory(
+    unsigned i
+    )
+    {
+    return i < kCategories ? kCategoryTable[i] : nullptr;
+    }
+
+cLogCategory *
+cLogCategory::find(
+    const char *pName
+    )
+    {
+    for (auto p : kCategoryTable)
+        {
+        if (std::strcmp(p->m_pName, pName) == 0)
+            return p;
+        }
+
+    return nullptr;
+    }
@@ -0,0 +1,137 @@
+/*
+
+Module: Model4916_cLogCategory.h
+
+Function:
+    cLogCategory: log messages by subsystem, with levels and rate limits.
+
+Copyright:
+    See accompanying LICENSE file for copyright and license information.
+
+Author:
+    Dhinesh Kumar Pitchai, MCCI Corporation   November 2022
+
+*/
+
+#ifndef _Model4916_cLogCategory_h_
+# define _Model4916_cLogCategory_h_
+
+#pragma once
+
+#include <Arduino.h>
+#include <cstddef>
+#include <cstdint>
+
+namespace McciModel4916 {
+
+/****************************************************************************\
+|
+|   Log categories
+|
+\****************************************************************************/
+
+// Each subsystem logs through its own category, which has its own level
+// (set by the "log" command), so one subsystem can be traced without
+// turning on all the others. Each category also has a token bucket:
+// a message takes a token, tokens come back at a fixed rate up to a
+// burst limit, and messages that find the bucket empty are counted and
+// dropped rather than printed. That keeps tracing from distorting the
+// timing it's meant to show. The next message printed reports how many
+// were dropped.
+class cLogCategory
+    {
+public:
+    enum Level : std::uint8_t
+        {
+        kOff,
+        kError,
+        kWarning,
+        kInfo,
+        kTrace,
+        kLevels         // number of levels
+        };
+
+    cLogCategory(const char *pName, Level level, std::uint16_t ratePerSec, std::uint16_t burst)
+        : m_pName(pName)
+        , m_level(level)
+        , m_ratePerSec(ratePerSec)
+        , m_burst(burst)
+        , m_milliTokens(std::uint32_t(burst) * 1000)
+        {}
+
+    // neither copyable nor movable
+    cLogCategory(const cLogCategory&) = delete;
+    cLogCategory& operator=(const cLogCategory&) = delete;
+    cLogCategory(const cLogCategory&&) = delete;
+    cLogCategory& operator=(const cLogCategory&&) = delete;
+
+    // cheap enough to guard work done only for a message.
+    bool isEnabled(Level level) const
+        {
+        return level != kOff && level <= this->m_level;
+        }
+
+    void printf(Level level, const char *pFmt, ...) __attribute__((__format__(__printf__, 3, 4)));
+
+    const char *getName() const
+        {
+        return this->m_pName;
+        }
+    Level getLevel() const
+        {
+        return this->m_level;
+        }
+    void setLevel(Level level)
+        {
+        this->m_level = level;
+        }
+    std::uint16_t getRatePerSec() const
+        {
+        return this->m_ratePerSec;
+        }
+    std::uint16_t getBurst() const
+        {
+        return this->m_burst;
+        }
+    // a rate of zero turns the limit off.
+    void setRate(std::uint16_t ratePerSec, std::uint16_t burst);
+    // messages dropped by the rate limit since boot.
+    std::uint32_t getSuppressed() const
+        {
+        return this->m_nSuppressed;
+        }
+
+    static const char *getLevelName(Level level);
+    static bool parseLevel(const char *pName, Level &level);
+
+    // the categories, for the "log" command.
+    static constexpr unsigned kCategories = 6;
+    static cLogCategory *getCategory(unsigned i);
+    static cLogCategory *find(const char *pName);
+
+private:
+    // take a token; false if there's none.
+    bool take();
+
+    const char                      *m_pName;
+    Level                           m_level;
+    std::uint16_t                   m_ratePerSec;
+    std::uint16_t                   m_burst;
+    // tokens in the bucket, in thousandths, and when it was last filled
+    std::uint32_t                   m_milliTokens;
+    std::uint32_t                   m_lastMs = 0;
+    std::uint32_t                   m_nSuppressed = 0;
+    // m_nSuppressed when last reported
+    std::uint32_t                   m_nReported = 0;
+    };
+
+} // namespace McciModel4916
+
+extern McciModel4916::cLogCategory gLogFsm;
+extern McciModel4916::cLogCategory gLogSensors;
+extern McciModel4916::cLogCategory gLogRadio;
+extern McciModel4916::cLogCategory gLogSd;
+extern McciModel4916::cLogCategory gLogFwUpdate;
+extern McciModel4916::cLogCategory gLogPower;
+
+#endif /* _Model4916_cLogCategory_h_ */
@@ -15,6 +15,9 @@ Author:
 
 #include "Model4916_cMeasurementLoop.h"
 
+#include "Model4916_cLogCategory.h"
+#include "Model4916_cStats.h"
+
 #include <arduino_lmic.h>
 #include <Model4916-MultiGas-Sensor.h>
 #include <stdint.h>
@@ -24,6 +27,30 @@ using namespace McciCatena;
 
 extern cMeasurementLoop gMeasurementLoop;
 
+/****************************************************************************\
+|
+|   Statistics (see the "stats" command)
+|
+\****************************************************************************/
+
+namespace {
+
+cStatsCounter sCycles("loop.cycles");
+cStatsCounter sPolls("loop.polls");
+cStatsCounter sDeepSleeps("loop.deepsleeps");
+cStatsCounter sTxOk("tx.ok");
+cStatsCounter sTxFail("tx.fail");
+// sensor transactions that failed on the I2C bus
+cStatsCounter sI2cErrors("i2c.errors");
+// time to read each sensor, in microseconds
+cStatsGauge sReadScd30("read.scd30.us");
+cStatsGauge sReadSht3x("read.sht3x.us");
+cStatsGauge sReadIps7100("read.ips7100.us");
+cStatsGauge sReadAds131m04("read.ads131m04.us");
+cStatsGauge sReadGps("read.gps.us");
+
+} // namespace
+
 /* instantiate SPI */
 /*SPIClass gSPI2(
 		Catena::PIN_SPI2_MOSI,
@@ -46,6 +73,12 @@ void cMeasurementLoop::begin()
 
         gCatena.registerObject(this);
 
+        // pick up settings changed by downlink, and start with their
+        // fast cycle.
+        this->loadConfig();
+        this->m_txCycleSec = this->m_config.txCycleSec_Fast;
+        this->m_txCycleCount = this->m_config.txCycleCount_Fast;
+
         this->m_UplinkTimer.begin(this->m_txCycleSec * 1000);
         }
 
@@ -120,6 +153,21 @@ void cMeasurementLoop::begin()
         gCatena.SafePrintf("No SAM-M8Q GPS found: check wiring\n");
         }
 
+    // recover any uplinks stored before the last reset.
+    if (this->m_UplinkQueue.begin(gCatena.getFram()))
+        {
+        if (this->m_UplinkQueue.getCount() != 0)
+            gCatena.SafePrintf(
+                "Uplink backlog: %u stored, %u dropped\n",
+                this->m_UplinkQueue.getCount(),
+                unsigned(this->m_UplinkQueue.getDropped())
+                );
+        }
+    else
+        {
+        gCatena.SafePrintf("No FRAM: failed uplinks will not be stored\n");
+        }
+
     // start (or restart) the FSM.
     if (! this->m_running)
         {
@@ -155,9 +203,9 @@ cMeasurementLoop::fsmDispatch(
     {
     State newState = State::stNoChange;
 
-    if (fEntry && this->isTraceEnabled(this->DebugFlags::kTrace))
+    if (fEntry)
         {
-        gCatena.SafePrintf("cMeasurementLoop::fsmDispatch: enter %s\n",
+        gLogFsm.printf(gLogFsm.kTrace, "cMeasurementLoop::fsmDispatch: enter %s\n",
                 this->getStateName(currentState)
                 );
         }
@@ -166,7 +214,7 @@ cMeasurementLoop::fsmDispatch(
         {
     case State::stInitial:
         newState = State::stInactive;
-        this->resetMeasurements();
+        this->acquireCollectSlot();
         break;
 
     case State::stInactive:
@@ -183,6 +231,8 @@ cMeasurementLoop::fsmDispatch(
             this->m_UplinkTimer.retrigger();
             newState = State::stWarmup;
             }
+        else if (this->m_rqStream)
+            newState = State::stStreaming;
         break;
 
     case State::stSleeping:
@@ -198,8 +248,21 @@ cMeasurementLoop::fsmDispatch(
             this->m_active = false;
             newState = State::stInactive;
             }
+        else if (this->m_rqStream && ! this->m_txpending)
+            newState = State::stStreaming;
         else if (this->m_UplinkTimer.isready())
             newState = State::stMeasure;
+        else if (this->m_txpending)
+            {
+            // the previous uplink is still in flight; stay awake for it.
+            }
+        else if (this->startAckTransmission() ||
+                 this->startSdStatsTransmission() ||
+                 this->startBacklogTransmission())
+            {
+            // an acknowledgement, report or backlog frame is in flight;
+            // stay awake for it.
+            }
         else if (this->m_UplinkTimer.getRemaining() > 1500)
             {
             this->m_fSleepScd30 = true;
@@ -222,7 +285,9 @@ cMeasurementLoop::fsmDispatch(
     case State::stMeasure:
 			if (fEntry)
             {
+            ++sCycles;
             this->updateSynchronousMeasurements();
+            this->checkThresholds(*this->m_pData);
             }
 
             newState = State::stTransmit;
@@ -231,27 +296,60 @@ cMeasurementLoop::fsmDispatch(
     case State::stTransmit:
         if (fEntry)
             {
-            TxBuffer_t b;
-            this->fillTxBuffer(b, this->m_data);
-
-            this->m_FileTxBuffer.begin();
-            for (auto i = 0; i < b.getn(); ++i)
-                this->m_FileTxBuffer.put(b.getbase()[i]);
-
-            this->resetMeasurements();
-            this->startTransmission(b);
+            // encode in place; the payload never leaves the slot.
+            this->fillTxBuffer(this->m_pCollectSlot->buffer, this->m_pCollectSlot->data);
             }
-        if (! gLoRaWAN.IsProvisioned())
+
+        // only one uplink can be in flight, so if the radio still holds
+        // the previous slot, wait here until sendBufferDone() frees it.
+        if (! this->m_txpending)
             {
-            newState = State::stFinal;
+            auto const pSlot = this->m_pCollectSlot;
+
+            // hand the slot to the SD logger and the radio...
+            this->m_TxPool.claim(pSlot, TxBufferPool_t::kOwnerSd);
+            this->m_TxPool.claim(pSlot, TxBufferPool_t::kOwnerRadio);
+            this->m_TxPool.release(pSlot, TxBufferPool_t::kOwnerCollect);
+
+            if (this->writeSdCard(pSlot->buffer, pSlot->data) &&
+                (gCatena.GetOperatingFlags() &
+                    static_cast<uint32_t>(OPERATING_FLAGS::fSdTrace)))
+                this->sdWriteTrace();
+            this->m_TxPool.release(pSlot, TxBufferPool_t::kOwnerSd);
+
+            this->startTransmission(pSlot);
+
+            // ...and collect the next measurement in the other one while
+            // the uplink is pending.
+            this->acquireCollectSlot();
+
+            if (! gLoRaWAN.IsProvisioned())
+                {
+                newState = State::stFinal;
+                }
+            else
+                {
+                newState = State::stSleeping;
+
+                // calculate the new sleep interval.
+                this->updateTxCycleTime();
+                }
             }
-        if (this->txComplete())
-            {
-            newState = State::stSleeping;
+        break;
+
+    // uplinks wait while the calibration bench takes samples; a
+    // measurement that comes due is taken when we get back.
+    case State::stStreaming:
+        if (fEntry)
+            this->streamBegin();
 
-            // calculate the new sleep interval.
-            this->updateTxCycleTime();
+        if (this->m_rqStreamStop)
+            {
+            this->streamEnd();
+            newState = this->m_active ? State::stSleeping : State::stInactive;
             }
+        else if (std::int32_t(millis() - this->m_streamNextMs) >= 0)
+            this->streamSample();
         break;
 
     case State::stFinal:
@@ -272,8 +370,26 @@ cMeasurementLoop::fsmDispatch(
 
 void cMeasurementLoop::resetMeasurements()
     {
-    memset((void *) &this->m_data, 0, sizeof(this->m_data));
-    this->m_data.flags = Flags(0);
+    memset((void *) this->m_pData, 0, sizeof(*this->m_pData));
+    this->m_pData->flags = Flags(0);
+    }
+
+bool cMeasurementLoop::acquireCollectSlot()
+    {
+    auto const pSlot = this->m_TxPool.acquire(TxBufferPool_t::kOwnerCollect);
+
+    if (pSlot == nullptr)
+        {
+        // every slot is still held downstream; keep collecting into the
+        // current one rather than overwrite a payload in flight.
+        gLog.printf(gLog.kBug, "acquireCollectSlot: no free uplink slot\n");
+        return false;
+        }
+
+    this->m_pCollectSlot = pSlot;
+    this->m_pData = &pSlot->data;
+    this->resetMeasurements();
+    return true;
     }
 
 void cMeasurementLoop::updateScd30Measurements()
@@ -283,10 +399,13 @@ void cMeasurementLoop::updateScd30Measurements()
         bool fError;
         if (this->m_Scd.queryReady(fError))
             {
+            std::uint32_t const tStart = micros();
             this->m_measurement_valid = this->m_Scd.readMeasurement();
-            if ((! this->m_measurement_valid) && gLog.isEnabled(gLog.kError))
+            sReadScd30.set(micros() - tStart);
+            if (! this->m_measurement_valid)
                 {
-                gLog.printf(gLog.kError, "SCD30 measurement failed: error %s(%u)\n",
+                ++sI2cErrors;
+                gLogSensors.printf(gLogSensors.kError, "SCD30 measurement failed: error %s(%u)\n",
                         this->m_Scd.getLastErrorName(),
                         unsigned(this->m_Scd.getLastError())
                         );
@@ -294,13 +413,13 @@ void cMeasurementLoop::updateScd30Measurements()
             }
         else if (fError)
             {
-            if (gLog.isEnabled(gLog.DebugFlags::kError))
-                gLog.printf(
-                    gLog.kAlways,
-                    "SCD30 queryReady failed: status %s(%u)\n",
-                    this->m_Scd.getLastErrorName(),
-                    unsigned(this->m_Scd.getLastError())
-                    );
+            ++sI2cErrors;
+            gLogSensors.printf(
+                gLogSensors.kError,
+                "SCD30 queryReady failed: status %s(%u)\n",
+                this->m_Scd.getLastErrorName(),
+                unsigned(this->m_Scd.getLastError())
+                );
             }
         }
 
@@ -309,7 +428,7 @@ void cMeasurementLoop::updateScd30Measurements()
         auto const m = this->m_Scd.getMeasurement();
         // temperature is 2 bytes from -163.840 to +163.835 degrees C
         // pressure is 4 bytes, first signed units, then scale.
-        if (gLog.isEnabled(gLog.kInfo))
+        if (gLogSensors.isEnabled(gLogSensors.kInfo))
             {
             this->ts = ' ';
             this->t100 = std::int32_t(m.Temperature * 100.0f + 0.5f);
@@ -329,92 +448,303 @@ void cMeasurementLoop::updateScd30Measurements()
             this->co2frac = this->co2_100 - (this->co2int * 100);
             }
 
-        this->m_data.co2ppm.CO2ppm = m.CO2ppm;
+        this->m_pData->co2ppm.CO2ppm = m.CO2ppm;
+
+        this->m_trace.scdCO2ppm = m.CO2ppm;
+        this->m_trace.scdTempC = m.Temperature;
+        this->m_trace.scdHumidity = m.RelativeHumidity;
+        this->m_trace.scdMs = millis();
+        this->m_trace.valid |= SdLogFormat::kTraceScd30;
         }
     }
 
 void cMeasurementLoop::updateSynchronousMeasurements()
     {
-    this->m_data.Vbat = gCatena.ReadVbat();
-    this->m_data.flags |= Flags::Vbat;
-
-    if (gCatena.getBootCount(this->m_data.BootCount))
+    // the raw inputs are kept for the SD trace (see sdWriteTrace()); the
+    // SCD30 was read on its own schedule, before now.
+    auto &trace = this->m_trace;
+
+    trace.valid &= SdLogFormat::kTraceScd30;
+    trace.ms = millis();
+    trace.sensorMask = this->m_config.sensorMask;
+    trace.vGasZero = this->m_vGasZero;
+    trace.calibrationFactor[kGasCO] = this->m_calibrationFactorCO;
+    trace.calibrationFactor[kGasNO2] = this->m_calibrationFactorNO2;
+    trace.calibrationFactor[kGasO3] = this->m_calibrationFactorO3;
+    trace.calibrationFactor[kGasSO2] = this->m_calibrationFactorSO2;
+
+    this->m_pData->Vbat = gCatena.ReadVbat();
+    this->m_pData->flags |= Flags::Vbat;
+    trace.vBat = this->m_pData->Vbat;
+
+    if (gCatena.getBootCount(this->m_pData->BootCount))
         {
-        this->m_data.flags |= Flags::Boot;
+        this->m_pData->flags |= Flags::Boot;
+        trace.bootCount = this->m_pData->BootCount;
+        trace.valid |= SdLogFormat::kTraceBoot;
         }
 
-    if (this->m_fSht3x)
+    std::uint32_t tStart;
+
+    if (this->m_fSht3x && this->isSensorEnabled(kSensorSht3x))
         {
         cSHT3x::Measurements m;
-        this->m_Sht.getTemperatureHumidity(m);
-        this->m_data.env.TempC = m.Temperature;
-        this->m_data.env.Humidity = m.Humidity;
-        this->m_data.flags |= Flags::TH;
+
+        tStart = micros();
+        if (this->m_Sht.getTemperatureHumidity(m))
+            {
+            this->m_pData->env.TempC = m.Temperature;
+            this->m_pData->env.Humidity = m.Humidity;
+            this->m_pData->flags |= Flags::TH;
+            trace.shtTempC = m.Temperature;
+            trace.shtHumidity = m.Humidity;
+            trace.valid |= SdLogFormat::kTraceSht3x;
+            }
+        else
+            ++sI2cErrors;
+        sReadSht3x.set(micros() - tStart);
         }
 
-    if (this->m_data.co2ppm.CO2ppm != 0.0f)
+    if (this->m_pData->co2ppm.CO2ppm != 0.0f && this->isSensorEnabled(kSensorScd30))
         {
-        this->m_data.flags |= Flags::CO2;
+        this->m_pData->flags |= Flags::CO2;
         }
 
-    if (this->m_fIps7100)
+    if (this->m_fIps7100 && this->isSensorEnabled(kSensorIps7100))
         {
+        tStart = micros();
         m_Ips.updateData();
-
-        this->m_data.particle.Count[0] = m_Ips.getPC01Data();
-        this->m_data.particle.Count[1] = m_Ips.getPC03Data();
-        this->m_data.particle.Count[2] = m_Ips.getPC05Data();
-        this->m_data.particle.Count[3] = m_Ips.getPC10Data();
-        this->m_data.particle.Count[4] = m_Ips.getPC25Data();
-        this->m_data.particle.Count[5] = m_Ips.getPC50Data();
-        this->m_data.particle.Count[6] = m_Ips.getPC100Data();
-
-        this->m_data.particle.Mass[0] = m_Ips.getPM01Data();
-        this->m_data.particle.Mass[1] = m_Ips.getPM03Data();
-        this->m_data.particle.Mass[2] = m_Ips.getPM05Data();
-        this->m_data.particle.Mass[3] = m_Ips.getPM10Data();
-        this->m_data.particle.Mass[4] = m_Ips.getPM25Data();
-        this->m_data.particle.Mass[5] = m_Ips.getPM50Data();
-        this->m_data.particle.Mass[6] = m_Ips.getPM100Data();
-
-        this->m_data.flags |= Flags::PM;
+        sReadIps7100.set(micros() - tStart);
+
+        this->m_pData->particle.Count[0] = m_Ips.getPC01Data();
+        this->m_pData->particle.Count[1] = m_Ips.getPC03Data();
+        this->m_pData->particle.Count[2] = m_Ips.getPC05Data();
+        this->m_pData->particle.Count[3] = m_Ips.getPC10Data();
+        this->m_pData->particle.Count[4] = m_Ips.getPC25Data();
+        this->m_pData->particle.Count[5] = m_Ips.getPC50Data();
+        this->m_pData->particle.Count[6] = m_Ips.getPC100Data();
+
+        this->m_pData->particle.Mass[0] = m_Ips.getPM01Data();
+        this->m_pData->particle.Mass[1] = m_Ips.getPM03Data();
+        this->m_pData->particle.Mass[2] = m_Ips.getPM05Data();
+        this->m_pData->particle.Mass[3] = m_Ips.getPM10Data();
+        this->m_pData->particle.Mass[4] = m_Ips.getPM25Data();
+        this->m_pData->particle.Mass[5] = m_Ips.getPM50Data();
+        this->m_pData->particle.Mass[6] = m_Ips.getPM100Data();
+
+        this->m_pData->flags |= Flags::PM;
+        static_assert(sizeof(trace.ipsCount) == sizeof(this->m_pData->particle.Count), "IPS count size");
+        static_assert(sizeof(trace.ipsMass) == sizeof(this->m_pData->particle.Mass), "IPS mass size");
+        std::memcpy(trace.ipsCount, this->m_pData->particle.Count, sizeof(trace.ipsCount));
+        std::memcpy(trace.ipsMass, this->m_pData->particle.Mass, sizeof(trace.ipsMass));
+        trace.valid |= SdLogFormat::kTraceIps7100;
         }
 
-    if (this->m_fAds131m04)
+    if (this->m_fAds131m04 && this->isSensorEnabled(kSensorGas))
         {
         std::uint8_t channel0 = 0;
         std::uint8_t channel1 = 1;
         std::uint8_t channel2 = 2;
         std::uint8_t channel3 = 3;
 
+        tStart = micros();
         auto voltage = this->m_Ads.readVoltage(channel0);
+        trace.adcVolts[kGasCO] = voltage;
         auto concentration = this->getCOConcentration(voltage);
-        this->m_data.gases.CO = concentration;
-        this->m_data.flags |= Flags::CO;
+        this->m_pData->gases.CO = concentration;
+        this->m_pData->flags |= Flags::CO;
 
         voltage = m_Ads.readVoltage(channel1);
+        trace.adcVolts[kGasNO2] = voltage;
         concentration = this->getNO2Concentration(voltage);
-        this->m_data.gases.NO2 = concentration;
-        this->m_data.flags |= Flags::NO2;
+        this->m_pData->gases.NO2 = concentration;
+        this->m_pData->flags |= Flags::NO2;
 
         voltage = m_Ads.readVoltage(channel2);
+        trace.adcVolts[kGasO3] = voltage;
         concentration = this->getO3Concentration(voltage);
-        this->m_data.gases.O3 = concentration;
-        this->m_data.flags |= Flags::O3;
+        this->m_pData->gases.O3 = concentration;
+        this->m_pData->flags |= Flags::O3;
 
         voltage = m_Ads.readVoltage(channel3);
+        trace.adcVolts[kGasSO2] = voltage;
         concentration = this->getSO2Concentration(voltage);
-        this->m_data.gases.SO2 = concentration;
-        this->m_data.flags |= Flags::SO2;
+        this->m_pData->gases.SO2 = concentration;
+        this->m_pData->flags |= Flags::SO2;
+        sReadAds131m04.set(micros() - tStart);
+        trace.valid |= SdLogFormat::kTraceGas;
         }
 
-    if (this->m_GpsSamM8q)
+    // GNSS is powered down between occasional fixes; when it's up, its
+    // time also sets the clock if the network hasn't.
+    if (this->m_GpsSamM8q && this->isSensorEnabled(kSensorGps) && this->isGpsFixDue())
         {
-        this->m_data.position.Latitude = m_Gps.getLatitude();
-        this->m_data.position.Longitude = m_Gps.getLongitude();
-        this->m_data.position.UnixTime = m_Gps.getUnixEpoch();
-        this->m_data.flags |= Flags::GPS;
+        tStart = micros();
+        this->m_pData->position.Latitude = m_Gps.getLatitude();
+        this->m_pData->position.Longitude = m_Gps.getLongitude();
+        this->m_pData->flags |= Flags::GPS;
+
+        auto const gpsTime = m_Gps.getUnixEpoch();
+        sReadGps.set(micros() - tStart);
+        trace.latitude = this->m_pData->position.Latitude;
+        trace.longitude = this->m_pData->position.Longitude;
+        trace.gpsTime = gpsTime;
+        trace.valid |= SdLogFormat::kTraceGps;
+        if (! this->m_fTimeFromNetwork && gpsTime != 0)
+            this->setTime(gpsTime, 0);
+
+        this->gpsSleepUntilNextFix();
         }
+
+    // every measurement is stamped from the clock.
+    this->updateTimeReference();
+    this->m_pData->position.UnixTime = this->getUnixTime();
+    trace.time = this->m_pData->position.UnixTime;
+    }
+
+/****************************************************************************\
+|
+|   Time keeping
+|
+\****************************************************************************/
+
+std::uint32_t cMeasurementLoop::getUnixTime() const
+    {
+    if (! this->m_fTimeValid)
+        return 0;
+
+    return std::uint32_t(this->getUnixTimeMs() / 1000);
+    }
+
+std::int64_t cMeasurementLoop::getUnixTimeMs() const
+    {
+    std::int64_t elapsedMs = std::uint32_t(millis() - this->m_timeRefMillis);
+
+    // correct for the measured rate error of our clock.
+    elapsedMs -= elapsedMs * this->m_timeDriftPpm / 1000000;
+    return std::int64_t(this->m_timeRefUnix) * 1000 + elapsedMs;
+    }
+
+// the clock read unixTime msAgo milliseconds ago.
+void cMeasurementLoop::setTime(std::uint32_t unixTime, std::uint32_t msAgo)
+    {
+    this->m_timeRefUnix = unixTime;
+    this->m_timeRefMillis = millis() - msAgo;
+    this->m_fTimeValid = true;
+    }
+
+// millis() wraps every 49.7 days, so now and then move the reference up
+// to now, folding in the time since.
+void cMeasurementLoop::updateTimeReference()
+    {
+    auto const now = millis();
+
+    if (! this->m_fTimeValid ||
+        std::uint32_t(now - this->m_timeRefMillis) < kTimeRefMaxAgeMs)
+        return;
+
+    std::int64_t elapsedMs = std::uint32_t(now - this->m_timeRefMillis);
+
+    elapsedMs -= elapsedMs * this->m_timeDriftPpm / 1000000;
+    elapsedMs += std::int64_t(this->m_timeRefUnix) * 1000;
+
+    this->m_timeRefUnix = std::uint32_t(elapsedMs / 1000);
+    this->m_timeRefMillis = now - std::uint32_t(elapsedMs % 1000);
+    }
+
+// ask for DeviceTimeReq to ride on the next uplink, if the clock is
+// unset or due for a resync.
+void cMeasurementLoop::requestNetworkTime()
+    {
+    if (this->m_fTimeRequested)
+        return;
+
+    if (this->m_fTimeFromNetwork &&
+        this->getUnixTime() - this->m_timeSyncUnix < kTimeResyncMs / 1000)
+        return;
+
+    this->m_fTimeRequested = true;
+    LMIC_requestNetworkTime(
+        [](void *pUserData, int flagSuccess)
+            {
+            auto const pThis = (cMeasurementLoop *)pUserData;
+            pThis->networkTimeDone(flagSuccess);
+            },
+        (void *)this
+        );
+    }
+
+void cMeasurementLoop::networkTimeDone(int flagSuccess)
+    {
+    // seconds from the GPS epoch (1980-01-06) to the Unix epoch, and the
+    // GPS-UTC leap second offset.
+    constexpr std::uint32_t kGpsToUnixSecs = 315964800;
+    constexpr std::uint32_t kGpsLeapSecs = 18;
+    lmic_time_reference_t ref;
+
+    this->m_fTimeRequested = false;
+
+    if (! flagSuccess || ! LMIC_getNetworkTimeReference(&ref))
+        {
+        gLogRadio.printf(gLogRadio.kTrace, "network time: no answer\n");
+        return;
+        }
+
+    // the answer came down after the uplink in flight.
+    this->setLinkProven();
+
+    // ref.tNetwork was the time at ref.tLocal.
+    std::uint32_t const unixTime = ref.tNetwork + kGpsToUnixSecs - kGpsLeapSecs;
+    std::uint32_t const msAgo = osticks2ms(os_getTime() - ref.tLocal);
+
+    if (this->m_fTimeFromNetwork)
+        {
+        // learn our rate error from how far we drifted since last time;
+        // ignore anything implausible for a crystal.
+        std::int64_t const nowMs = this->getUnixTimeMs();
+        std::int64_t const elapsedMs = nowMs - std::int64_t(this->m_timeSyncUnix) * 1000;
+        std::int64_t const errorMs =
+            nowMs - (std::int64_t(unixTime) * 1000 + msAgo);
+
+        if (elapsedMs > 60 * 60 * 1000)
+            {
+            auto const drift = this->m_timeDriftPpm + std::int32_t(errorMs * 1000000 / elapsedMs);
+
+            if (-kMaxDriftPpm < drift && drift < kMaxDriftPpm)
+                this->m_timeDriftPpm = drift;
+            }
+        }
+
+    this->setTime(unixTime, msAgo);
+    this->m_timeSyncUnix = unixTime;
+    this->m_fTimeFromNetwork = true;
+
+    gLogRadio.printf(
+        gLogRadio.kInfo,
+        "network time: %u (drift %d ppm)\n",
+        unsigned(unixTime),
+        int(this->m_timeDriftPpm)
+        );
+    }
+
+bool cMeasurementLoop::isGpsFixDue() const
+    {
+    // until we have a clock, GNSS stays on for the time.
+    if (! this->m_fGpsAsleep || ! this->m_fTimeValid)
+        return true;
+
+    return std::int32_t(millis() - this->m_gpsNextFixMillis) >= 0;
+    }
+
+// power GNSS down; it wakes itself in time for the next fix.
+void cMeasurementLoop::gpsSleepUntilNextFix()
+    {
+    // keep it running until some clock is set.
+    if (! this->m_fTimeValid)
+        return;
+
+    this->m_gpsNextFixMillis = millis() + kGpsFixIntervalMs;
+    this->m_fGpsAsleep = this->m_Gps.powerOff(kGpsFixIntervalMs - kGpsWarmupMs);
     }
 
 /****************************************************************************\
@@ -424,7 +754,7 @@ void cMeasurementLoop::updateSynchronousMeasurements()
 \****************************************************************************/
 
 void cMeasurementLoop::startTransmission(
-    cMeasurementLoop::TxBuffer_t &b
+    cMeasurementLoop::TxSlot_t *pSlot
     )
     {
     auto const savedLed = gLed.Set(McciCatena::LedPattern::Off);
@@ -435,40 +765,280 @@ void cMeasurementLoop::startTransmission(
         [](void *pClientData, bool fSuccess)
             {
             auto const pThis = (cMeasurementLoop *)pClientData;
-            pThis->m_txpending = false;
-            pThis->m_txcomplete = true;
-            pThis->m_txerr = ! fSuccess;
-            pThis->m_fsm.eval();
+            pThis->sendBufferDone(fSuccess);
             };
 
+    // the operating flag forces every uplink to be confirmed; otherwise
+    // the policy picks, from how the link has been doing.
     bool fConfirmed = false;
     if (gCatena.GetOperatingFlags() &
         static_cast<uint32_t>(gCatena.OPERATING_FLAGS::fConfirmedUplink))
         {
-        gCatena.SafePrintf("requesting confirmed tx\n");
+        gLogRadio.printf(gLogRadio.kInfo, "requesting confirmed tx\n");
+        fConfirmed = true;
+        }
+    else if (this->m_UplinkPolicy.shouldConfirm())
+        {
+        gLogRadio.printf(
+            gLogRadio.kTrace,
+            "requesting confirmed tx (link %s, every %u)\n",
+            cUplinkPolicy::getHealthName(this->m_UplinkPolicy.getHealth()),
+            this->m_UplinkPolicy.getInterval()
+            );
         fConfirmed = true;
         }
+    this->m_fTxConfirmed = fConfirmed;
 
+    // piggyback a DeviceTimeReq if the clock needs it.
+    this->requestNetworkTime();
+
+    this->m_pRadioSlot = pSlot;
+    this->m_txKind = UplinkKind::kLive;
+    this->m_nBacklogFrames = 0;
     this->m_txpending = true;
     this->m_txcomplete = this->m_txerr = false;
 
-    if (! gLoRaWAN.SendBuffer(b.getbase(), b.getn(), sendBufferDoneCb, (void *)this, fConfirmed))
+    auto &b = pSlot->buffer;
+    if (! gLoRaWAN.SendBuffer(
+                b.getbase(), b.getn(),
+                sendBufferDoneCb, (void *)this,
+                fConfirmed, MeasurementFormat::kMessagePort
+                ))
         {
         // uplink wasn't launched.
-        this->m_txcomplete = true;
-        this->m_txerr = true;
-        this->m_fsm.eval();
+        this->sendBufferDone(false);
         }
     }
 
 void cMeasurementLoop::sendBufferDone(bool fSuccess)
     {
+    // an unconfirmed uplink reports success once it's transmitted, heard
+    // or not; only an ack or a downlink shows the network is listening.
+    bool const fProven = fSuccess && (this->m_fTxConfirmed || this->m_fTxProven);
+
+    if (fProven)
+        this->setLinkProven();
+    else if (this->m_fTxConfirmed)
+        {
+        // the unconfirmed uplinks since the last proof were probably
+        // lost too; they become ordinary backlog.
+        this->m_fLinkUp = false;
+        this->m_nUnproven = 0;
+        }
+
+    if (fSuccess)
+        ++sTxOk;
+    else
+        ++sTxFail;
+
+    if (this->m_txKind == UplinkKind::kLive)
+        {
+        // the ack (if any) was the last thing received.
+        this->m_UplinkPolicy.recordResult(
+            this->m_fTxConfirmed,
+            fSuccess,
+            std::int16_t(LMIC.rssi) - RSSI_OFF,
+            LMIC.snr
+            );
+
+        // keep what we couldn't send, so it isn't lost for good; and
+        // what may not have been heard, until the link is proven.
+        if (! fProven)
+            {
+            auto &b = this->m_pRadioSlot->buffer;
+
+            this->m_UplinkQueue.push(
+                MeasurementFormat::kMessagePort,
+                this->m_pRadioSlot->data.position.UnixTime,
+                b.getbase(), b.getn()
+                );
+
+            if (fSuccess)
+                ++this->m_nUnproven;
+            // a full ring drops the oldest, which may be unproven too.
+            if (this->m_nUnproven > this->m_UplinkQueue.getCount())
+                this->m_nUnproven = this->m_UplinkQueue.getCount();
+            }
+
+        // the radio is done with the payload; give the slot back.
+        this->m_TxPool.release(this->m_pRadioSlot, TxBufferPool_t::kOwnerRadio);
+        this->m_pRadioSlot = nullptr;
+        }
+    else if (this->m_txKind == UplinkKind::kBacklog)
+        {
+        // the network acknowledged the records; forget them.
+        if (fSuccess)
+            this->m_UplinkQueue.pop(this->m_nBacklogRecords);
+        this->m_nBacklogRecords = 0;
+        }
+    else if (this->m_txKind == UplinkKind::kAck)
+        {
+        // if it didn't go, try again after the next uplink.
+        if (fSuccess)
+            this->m_fAckPending = false;
+        }
+    else if (this->m_txKind == UplinkKind::kSdStats)
+        {
+        if (fSuccess)
+            this->m_fSdStatsPending = false;
+        }
+
+    this->m_txKind = UplinkKind::kNone;
+    this->m_fTxProven = false;
     this->m_txpending = false;
     this->m_txcomplete = true;
     this->m_txerr = ! fSuccess;
     this->m_fsm.eval();
     }
 
+/****************************************************************************\
+|
+|   Drain the uplink backlog
+|
+\****************************************************************************/
+
+// An acknowledgement or a downlink shows the network hears us: the
+// unconfirmed live uplinks kept since the last proof got through, so
+// they're dropped. After a reset they can't be told apart, and are
+// sent again as backlog.
+void cMeasurementLoop::setLinkProven()
+    {
+    this->m_fLinkUp = true;
+
+    // a downlink during an uplink proves that one too.
+    if (this->m_txpending)
+        this->m_fTxProven = true;
+
+    if (this->m_nUnproven != 0)
+        {
+        gLogRadio.printf(gLogRadio.kTrace, "backlog: link proven, dropping %u unconfirmed\n", this->m_nUnproven);
+        this->m_UplinkQueue.dropNewest(this->m_nUnproven);
+        this->m_nUnproven = 0;
+        }
+    }
+
+// Send one frame of stored records if the link is known to be working,
+// the per-cycle budget set by the uplink policy isn't used up, and the
+// next measurement isn't imminent. Returns true if an uplink was launched.
+bool cMeasurementLoop::startBacklogTransmission()
+    {
+    if (! this->m_fLinkUp ||
+        this->m_UplinkQueue.getCount() <= this->m_nUnproven ||
+        this->m_nBacklogFrames >= this->m_UplinkPolicy.getRetryBudget(kBacklogFramesPerCycle) ||
+        this->m_UplinkTimer.getRemaining() < kBacklogGuardMs ||
+        ! gLoRaWAN.IsProvisioned())
+        return false;
+
+    unsigned nRecords;
+    size_t const nBuffer = this->fillBacklogBuffer(this->getMaxUplinkBytes(), nRecords);
+
+    if (nRecords == 0)
+        {
+        // records at the head were corrupt and have been discarded, or
+        // the data rate is too low to carry even one.
+        return false;
+        }
+
+    auto sendBufferDoneCb =
+        [](void *pClientData, bool fSuccess)
+            {
+            auto const pThis = (cMeasurementLoop *)pClientData;
+            pThis->sendBufferDone(fSuccess);
+            };
+
+    gLogRadio.printf(
+        gLogRadio.kTrace,
+        "backlog: sending %u of %u records (%u bytes)\n",
+        nRecords, this->m_UplinkQueue.getCount(), unsigned(nBuffer)
+        );
+
+    this->m_txKind = UplinkKind::kBacklog;
+    this->m_fTxConfirmed = true;
+    this->m_nBacklogRecords = nRecords;
+    ++this->m_nBacklogFrames;
+    this->m_txpending = true;
+    this->m_txcomplete = this->m_txerr = false;
+
+    // confirmed: an unconfirmed uplink always reports success, and the
+    // records are popped when it does, so one lost over the air would be
+    // gone for good.
+    if (! gLoRaWAN.SendBuffer(
+                this->m_BacklogBuffer, nBuffer,
+                sendBufferDoneCb, (void *)this,
+                true, MeasurementFormat::kBacklogPort
+                ))
+        {
+        this->sendBufferDone(false);
+        return false;
+        }
+
+    return true;
+    }
+
+// Pack as many stored records as fit in nMax bytes:
+//
+//  byte 0:     kBacklogFormat
+//  byte 1:     number of records
+//  then, per record: uint32 capture time, uint8 length, message bytes.
+size_t cMeasurementLoop::fillBacklogBuffer(size_t nMax, unsigned &nRecords)
+    {
+    std::uint8_t * const pBuffer = this->m_BacklogBuffer;
+    size_t n = 2;
+    cUplinkQueue::Record_t record;
+
+    nRecords = 0;
+    if (nMax > sizeof(this->m_BacklogBuffer))
+        nMax = sizeof(this->m_BacklogBuffer);
+
+    // a torn record at the head would block the queue forever.
+    while (this->m_UplinkQueue.getCount() > this->m_nUnproven &&
+           ! this->m_UplinkQueue.peek(0, record))
+        this->m_UplinkQueue.pop(1);
+
+    // the unproven records at the tail wait for the link to be proven.
+    unsigned const nReady = this->m_UplinkQueue.getCount() - this->m_nUnproven;
+
+    for (unsigned i = 0; i < nReady; ++i)
+        {
+        if (! this->m_UplinkQueue.peek(i, record))
+            break;
+
+        if (n + 5 + record.nPayload > nMax || nRecords == 255)
+            break;
+
+        pBuffer[n++] = std::uint8_t(record.time >> 24);
+        pBuffer[n++] = std::uint8_t(record.time >> 16);
+        pBuffer[n++] = std::uint8_t(record.time >> 8);
+        pBuffer[n++] = std::uint8_t(record.time);
+        pBuffer[n++] = record.nPayload;
+        memcpy(pBuffer + n, record.payload, record.nPayload);
+        n += record.nPayload;
+        ++nRecords;
+        }
+
+    pBuffer[0] = MeasurementFormat::kBacklogFormat;
+    pBuffer[1] = std::uint8_t(nRecords);
+    return n;
+    }
+
+// the largest application payload at the current data rate.
+size_t cMeasurementLoop::getMaxUplinkBytes() const
+    {
+#if defined(CFG_us915)
+    static const std::uint8_t kMaxPayload[] = { 11, 53, 125, 242, 242 };
+#elif defined(CFG_au915)
+    static const std::uint8_t kMaxPayload[] = { 51, 51, 51, 115, 242, 242, 242 };
+#else
+    static const std::uint8_t kMaxPayload[] = { 51, 51, 51, 115, 222, 222, 222, 222 };
+#endif
+    auto const dr = LMIC.datarate;
+
+    if (dr < sizeof(kMaxPayload))
+        return kMaxPayload[dr];
+    else
+        return kMaxPayload[0];
+    }
+
 /****************************************************************************\
 |
 |   The Polling function --
@@ -479,13 +1049,15 @@ void cMeasurementLoop::poll()
     {
     bool fEvent;
 
+    ++sPolls;
+
     // no need to evaluate unless something happens.
     fEvent = false;
 
     // if we're not active, and no request, nothing to do.
     if (! this->m_active)
         {
-        if (! this->m_rqActive)
+        if (! this->m_rqActive && ! this->m_fStreaming)
             return;
 
         // we're asked to go active. We'll want to eval.
@@ -493,7 +1065,7 @@ void cMeasurementLoop::poll()
         }
 
     auto const msToNext = this->m_Scd.getMsToNextMeasurement();
-    if (msToNext < 20)
+    if (msToNext < 20 && this->isSensorEnabled(kSensorScd30))
         updateScd30Measurements();
 
 	   if (this->m_fTimerActive)
@@ -512,11 +1084,15 @@ void cMeasurementLoop::poll()
         fEvent = true;
         }
 
+    // samples are timed by the FSM.
+    if (this->m_fStreaming)
+        fEvent = true;
+
     if (fEvent)
         this->m_fsm.eval();
 
-    this->m_data.Vbus = gCatena.ReadVbus();
-    setVbus(this->m_data.Vbus);
+    this->m_pData->Vbus = gCatena.ReadVbus();
+    setVbus(this->m_pData->Vbus);
     }
 
 /****************************************************************************\
@@ -538,7 +1114,7 @@ void cMeasurementLoop::updateTxCycleTime()
     else if (txCycleCount == 1)
             {
             // it's now one (otherwise we couldn't be here.)
-            gCatena.SafePrintf("resetting tx cycle to default: %u\n", this->m_txCycleSec_Permanent);
+            gLogRadio.printf(gLogRadio.kInfo, "resetting tx cycle to default: %u\n", this->m_txCycleSec_Permanent);
 
             this->setTxCycleTime(this->m_txCycleSec_Permanent, 0);
             }
@@ -647,7 +1223,7 @@ void cMeasurementLoop::doSleepAlert(bool fDeepSleep)
             }
         }
     else
-        gCatena.SafePrintf("using light sleep\n");
+        gLogPower.printf(gLogPower.kInfo, "using light sleep\n");
     }
 
 void cMeasurementLoop::doDeepSleep()
@@ -660,6 +1236,7 @@ void cMeasurementLoop::doDeepSleep()
         return;
 
     /* ok... now it's time for a deep sleep */
+    ++sDeepSleeps;
     gLed.Set(McciCatena::LedPattern::Off);
     this->deepSleepPrepare();
 
@@ -675,6 +1252,9 @@ void cMeasurementLoop::doDeepSleep()
 
 void cMeasurementLoop::deepSleepPrepare(void)
     {
+    // SD power goes away: write out what the logger is holding.
+    this->sdSleep();
+
     if (this->m_fSleepScd30)
         {
         // stop the SCD30; we leave it running.
@@ -714,13 +1294,12 @@ void cMeasurementLoop::deepSleepRecovery(void)
         // if it didn't start, log a message.
         if (! this->m_fScd30)
             {
-            if (gLog.isEnabled(gLog.DebugFlags::kError))
-                gLog.printf(
-                        gLog.kAlways,
-                        "SCD30 begin() failed after sleep: status %s(%u)\n",
-                        this->m_Scd.getLastErrorName(),
-                        unsigned(this->m_Scd.getLastError())
-                        );
+            gLogSensors.printf(
+                gLogSensors.kError,
+                "SCD30 begin() failed after sleep: status %s(%u)\n",
+                this->m_Scd.getLastErrorName(),
+                unsigned(this->m_Scd.getLastError())
+                );
             }
         }
     }
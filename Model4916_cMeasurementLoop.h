@@ -38,6 +38,14 @@ Author:
 #include <MCCI_Catena_IPS-7100.h>
 #include <MCCI_Catena_ADS131M04.h>
 #include <MCCI_Catena_SAM-M8Q.h>
+#include <SD.h>
+#include "Model4916_SdLogFormat.h"
+#include "Model4916_cBench.h"
+#include "Model4916_cSdLogger.h"
+#include "Model4916_cSdStats.h"
+#include "Model4916_cTxBufferPool.h"
+#include "Model4916_cUplinkPolicy.h"
+#include "Model4916_cUplinkQueue.h"
 
 #include <cstdint>
 
@@ -71,6 +79,23 @@ public:
     // message format
     static constexpr uint8_t kMessageFormat = 0x27;
 
+    // backlog frames: several stored port-1 messages in one uplink
+    static constexpr uint8_t kBacklogFormat = 0x30;
+
+    // acknowledgement of a downlink command (port 2)
+    static constexpr uint8_t kAckFormat = 0x31;
+
+    // SD card statistics, sent on request (port 2)
+    static constexpr uint8_t kSdStatsFormat = 0x32;
+
+    // LoRaWAN ports
+    static constexpr uint8_t kMessagePort = 1;
+    static constexpr uint8_t kCommandPort = 2;
+    static constexpr uint8_t kBacklogPort = 3;
+
+    // largest frame we ever build (US915 DR4)
+    static constexpr size_t kMaxUplinkBytes = 242;
+
     enum class Flags : uint16_t
             {
             Vbat = 1 << 0,      // vBat
@@ -112,8 +137,8 @@ public:
         // measure particle with IPS-7100
         struct Particle
             {
-            float                   Mass[6];
-            std::uint32_t           Count[6];
+            float                   Mass[7];
+            std::uint32_t           Count[7];
             };
 
         // measures spec sensor data
@@ -168,7 +193,23 @@ public:
 	using Measurement = MeasurementFormat::Measurement;
 	using Flags = MeasurementFormat::Flags;
 	static constexpr std::uint8_t kMessageFormat = MeasurementFormat::kMessageFormat;
+    // at most this many backlog frames are drained per measurement
+    // cycle; cUplinkPolicy lowers this when the link is poor.
+    static constexpr unsigned kBacklogFramesPerCycle = 2;
+    // don't start a backlog frame this close to the next measurement
+    static constexpr std::uint32_t kBacklogGuardMs = 10 * 1000;
     static constexpr std::uint8_t kSdCardCSpin = D11;
+    // staged SD records are written out (whole sectors) this often
+    static constexpr unsigned kSdFlushRecords = 8;
+    // below this battery voltage, every record is written at once
+    static constexpr float kSdLowBatteryVolts = 3.4f;
+    // log files are rotated at this size (in 512-byte sectors)
+    static constexpr std::uint32_t kSdLogFileSectors = 2048;
+    // binary logs are allocated this many sectors at a time, ahead of
+    // the records
+    static constexpr std::uint32_t kSdLogAllocSectors = 16;
+    // an index entry is written every this many records
+    static constexpr unsigned kSdIndexInterval = 16;
 
     enum OPERATING_FLAGS : uint32_t
         {
@@ -178,16 +219,54 @@ public:
         fDisableDeepSleep = 1 << 17,
         fQuickLightSleep = 1 << 18,
         fDeepSleepTest = 1 << 19,
+        fSdBinaryLog = 1 << 20,     // log binary records, not CSV
+        fSdTrace = 1 << 21,         // also log raw sensor inputs (.TRC)
+        };
+
+    // sensors that can be switched off remotely
+    enum SensorMask : std::uint8_t
+        {
+        kSensorSht3x    = 1 << 0,
+        kSensorScd30    = 1 << 1,
+        kSensorIps7100  = 1 << 2,
+        kSensorGas      = 1 << 3,   // ADS131M04 and the gas cells
+        kSensorGps      = 1 << 4,
+        kSensorAll      = 0x1F,
         };
 
-    enum DebugFlags : std::uint32_t
+    // the gas channels, in ADC channel order
+    enum GasChannel : std::uint8_t
         {
-        kError      = 1 << 0,
-        kWarning    = 1 << 1,
-        kTrace      = 1 << 2,
-        kInfo       = 1 << 3,
+        kGasCO = 0,
+        kGasNO2,
+        kGasO3,
+        kGasSO2,
+        kGasChannels,
         };
 
+    // network time is requested again after this long
+    static constexpr std::uint32_t kTimeResyncMs = 24 * 60 * 60 * 1000;
+    // the clock reference is moved up once it's this old
+    static constexpr std::uint32_t kTimeRefMaxAgeMs = 7 * 24 * 60 * 60 * 1000;
+    // rate corrections beyond this are rejected
+    static constexpr std::int32_t kMaxDriftPpm = 500;
+    // GNSS is woken for a position fix this often
+    static constexpr std::uint32_t kGpsFixIntervalMs = 6 * 60 * 60 * 1000;
+    // ... and this long before the fix is needed
+    static constexpr std::uint32_t kGpsWarmupMs = 2 * 60 * 1000;
+
+    // default uplink cadence
+    static constexpr std::uint32_t kDefaultTxCycleSec_Permanent = 6 * 60;
+    static constexpr std::uint32_t kDefaultTxCycleSec_Fast = 30;
+    static constexpr std::uint32_t kDefaultTxCycleCount_Fast = 10;
+
+    // default calibration of the gas cells
+    static constexpr float kDefaultVGasZero = 1.65f;
+    static constexpr float kDefaultCalibrationFactorCO = (1 / 0.000427f);
+    static constexpr float kDefaultCalibrationFactorNO2 = (1 / -0.01535423f);
+    static constexpr float kDefaultCalibrationFactorO3 = (1 / -0.01497998f);
+    static constexpr float kDefaultCalibrationFactorSO2 = (1 / 0.00286f);
+
     // constructor
     cMeasurementLoop(
             McciCatenaSht3x::cSHT3x& sht3x,
@@ -197,10 +276,9 @@ public:
         : m_Sht(sht3x)
         , m_Scd(scd30)
         , m_Ips(ips7100)
-        , m_txCycleSec_Permanent(6 * 60) // default uplink interval
-        , m_txCycleSec(30)                    // initial uplink interval
-        , m_txCycleCount(10)                   // initial count of fast uplinks
-        , m_DebugFlags(DebugFlags(kError | kTrace))
+        , m_txCycleSec_Permanent(kDefaultTxCycleSec_Permanent) // default uplink interval
+        , m_txCycleSec(kDefaultTxCycleSec_Fast)                // initial uplink interval
+        , m_txCycleCount(kDefaultTxCycleCount_Fast)            // initial count of fast uplinks
         {};
 
     // neither copyable nor movable
@@ -218,6 +296,7 @@ public:
         stWarmup,       // transition from inactive to measure, get some data.
         stMeasure,      // take measurents
         stTransmit,     // transmit data
+        stStreaming,    // uplinks suspended; sampling to the console
         stFinal,        // this name must be present, it's the terminal state.
         };
 
@@ -232,6 +311,7 @@ public:
             case State::stWarmup:   return "stWarmup";
             case State::stMeasure:  return "stMeasure";
             case State::stTransmit: return "stTransmit";
+            case State::stStreaming: return "stStreaming";
             case State::stFinal:    return "stFinal";
             default:                return "<<unknown>>";
             }
@@ -241,6 +321,17 @@ public:
     using TxBuffer_t = McciCatena::AbstractTxBuffer_t<MeasurementFormat::kTxBufferSize>;
     using TxBufferBase_t = McciCatena::AbstractTxBufferBase_t;
 
+    // an uplink slot: a measurement, and the payload encoded from it.
+    struct TxSlot_t
+        {
+        Measurement                 data;
+        TxBuffer_t                  buffer;
+        };
+
+    // two slots: one collecting while the other is still being sent.
+    static constexpr unsigned kTxSlots = 2;
+    using TxBufferPool_t = cTxBufferPool<TxSlot_t, kTxSlots>;
+
     // initialize measurement FSM.
     void begin();
     void end();
@@ -380,10 +471,24 @@ public:
     // request that the measurement loop be active/inactive
     void requestActive(bool fEnable);
 
-    // return true if a given debug mask is enabled.
-    bool isTraceEnabled(DebugFlags mask) const
+    // handle a downlink; commands arrive on MeasurementFormat::kCommandPort.
+    void processDownlink(std::uint8_t port, const std::uint8_t *pMessage, size_t nMessage);
+
+    const cUplinkPolicy &getUplinkPolicy() const
+        {
+        return this->m_UplinkPolicy;
+        }
+
+    bool isSensorEnabled(SensorMask mask) const
         {
-        return this->m_DebugFlags & mask;
+        return (this->m_config.sensorMask & mask) != 0;
+        }
+
+    // the time (seconds since the Unix epoch), or 0 if not yet known.
+    std::uint32_t getUnixTime() const;
+    bool isTimeValid() const
+        {
+        return this->m_fTimeValid;
         }
 
     // register an additional SPI for sleep/resume
@@ -393,10 +498,64 @@ public:
         this->m_pSPI2 = pSpi;
         }
 
-    /// bring up the SD card, if possible.
+    /// bring up the SD card, if possible; no-op if it's already up.
     bool checkSdCard();
-    /// tear down the SD card.
+    /// done with the SD card; it stays up if the logger is using it.
     void sdFinish();
+    /// write out any log records still held in RAM.
+    bool flushSdLog();
+    bool isSdCardUp() const
+        {
+        return this->m_fSdCardUp;
+        }
+    /// counts mounts; files open before a change are no longer valid.
+    std::uint32_t getSdMountCount() const
+        {
+        return this->m_nSdMounts;
+        }
+    /// log bytes dropped because the card couldn't take them.
+    std::uint32_t getSdLost() const
+        {
+        return this->m_SdLogger.getLost();
+        }
+    /// program a firmware update from the SD card; true if the system
+    /// should be reset to install it.
+    bool handleSdFirmwareUpdate();
+
+    /// sensors that can be streamed, and the fastest rate
+    static constexpr std::uint8_t kStreamChannels = kSensorGas | kSensorSht3x | kSensorScd30;
+    static constexpr std::uint8_t kStreamMaxRateHz = 10;
+    /// suspend uplinks and stream samples of channels (SensorMask bits)
+    /// to the console; see extra/catena-stream-format.md.
+    bool startStreaming(std::uint8_t rateHz, std::uint8_t channels, bool fBinary);
+    /// end streaming and go back to normal operation.
+    void stopStreaming();
+    bool isStreaming() const
+        {
+        return this->m_fStreaming;
+        }
+    std::uint32_t getStreamSamples() const
+        {
+        return this->m_streamSamples;
+        }
+    std::uint32_t getStreamDropped() const
+        {
+        return this->m_streamDropped;
+        }
+
+    /// the columns of the CSV log
+    static const char kSdCsvHeader[];
+    /// room for the longest CSV row (about 480 bytes) and its newline
+    static constexpr size_t kSdCsvMaxRow = 512;
+    /// print a log record as a CSV row
+    static void printSdRecordCsv(Print &out, const std::uint8_t *pDevEUI, const SdLogFormat::Record_t &record);
+
+    /// time the encoding, conversion and formatting kernels
+    void runBench(cBench &bench);
+    /// prepare the port 1 uplink for a measurement
+    void fillTxBuffer(TxBuffer_t &b, Measurement const & mData);
+    /// the largest application payload at the current data rate
+    size_t getMaxUplinkBytes() const;
 private:
     // sleep handling
     void sleep();
@@ -412,9 +571,12 @@ private:
     void resetMeasurements();
 
     // telemetry handling.
-    void fillTxBuffer(TxBuffer_t &b, Measurement const & mData);
-    void startTransmission(TxBuffer_t &b);
+    void startTransmission(TxSlot_t *pSlot);
+    bool startBacklogTransmission();
+    void setLinkProven();
+    size_t fillBacklogBuffer(size_t nMax, unsigned &nRecords);
     void sendBufferDone(bool fSuccess);
+    bool acquireCollectSlot();
 
     bool txComplete()
         {
@@ -422,15 +584,52 @@ private:
         }
     void updateTxCycleTime();
 
+    // time keeping
+    std::int64_t getUnixTimeMs() const;
+    void updateTimeReference();
+    void requestNetworkTime();
+    void networkTimeDone(int flagSuccess);
+    void setTime(std::uint32_t unixTime, std::uint32_t msAgo);
+    bool isGpsFixDue() const;
+    void gpsSleepUntilNextFix();
+
+    // remote configuration
+    void loadConfig();
+    bool saveConfig();
+    void setDefaultConfig();
+    void applyConfig();
+    std::uint8_t parseCommands(const std::uint8_t *pMessage, size_t nMessage, bool fApply);
+    void checkThresholds(Measurement const &mData);
+    bool startAckTransmission();
+    bool startSdStatsTransmission();
+    size_t fillSdStatsBuffer();
+
+    // streaming to the console
+    void streamBegin();
+    void streamSample();
+    void streamEnd();
+
     // SD card handling
     bool initSdCard();
 
     bool writeSdCard(TxBuffer_t &b, Measurement const &mData);
-    bool handleSdFirmwareUpdate();
+    bool sdSelectLogFile(Measurement const &mData, bool fBinary);
+    bool sdWriteTrace();
+    bool sdOpenCsvLog(const char *pName);
+    bool sdOpenBinaryLog(const char *pName, Measurement const &mData);
+    bool sdCheckRecord(File &f, std::uint32_t i);
+    bool sdExtendBinaryLog();
+    bool sdWriteIndex(std::uint32_t time, std::uint32_t offset);
+    void fillSdRecord(SdLogFormat::Record_t &record, TxBuffer_t &b, Measurement const &mData);
+    void writeSdRecordBinary(SdLogFormat::Record_t &record);
     bool handleSdFirmwareUpdateCardUp();
-    bool updateFromSd(const char *sFile, McciCatena::cDownload::DownloadRq_t rq);
+    bool sdVerifyImage(const char *sImage, std::uint32_t &size, std::uint32_t &crc);
+    bool sdVerifyPatch(const char *sPatch, std::uint32_t &size, std::uint32_t &crc);
+    bool updateFromSd(const char *sFile, McciCatena::cDownload::DownloadRq_t rq, std::uint32_t size, std::uint32_t crc, bool fPatch = false);
     void sdPowerUp(bool fOn);
     void sdPrep();
+    void sdTeardown();
+    void sdSleep();
 
     // timeout handling
 
@@ -474,18 +673,15 @@ private:
 
     // ADS131M04 - ADC for different spec sensor
     McciCatenaAds131m04::cADS131M04 m_Ads;
-    float                           m_vGasZero = 1.65;
-    float                           m_calibrationFactorCO = (1 / 0.000427);
-    float                           m_calibrationFactorNO2 = (1 / -0.01535423);
-    float                           m_calibrationFactorO3 = (1 / -0.01497998);
-    float                           m_calibrationFactorSO2 = (1 / 0.00286);
+    float                           m_vGasZero = kDefaultVGasZero;
+    float                           m_calibrationFactorCO = kDefaultCalibrationFactorCO;
+    float                           m_calibrationFactorNO2 = kDefaultCalibrationFactorNO2;
+    float                           m_calibrationFactorO3 = kDefaultCalibrationFactorO3;
+    float                           m_calibrationFactorSO2 = kDefaultCalibrationFactorSO2;
 
     // SAM-M8Q - GPS for position and time
     SAM_M8Q                         m_Gps;
 
-    // debug flags
-    DebugFlags                      m_DebugFlags;
-
     // true if object is registered for polling.
     bool                            m_registered : 1;
     // true if object is running.
@@ -547,10 +743,131 @@ private:
     std::uint32_t                   m_timer_start;
     std::uint32_t                   m_timer_delay;
 
-    // the current measurement
-    Measurement                     m_data;
+    // uplink slots, and the ones held by collection and by the radio
+    TxBufferPool_t                  m_TxPool;
+    TxSlot_t                        *m_pCollectSlot;
+    TxSlot_t                        *m_pRadioSlot;
 
-    TxBuffer_t                      m_FileTxBuffer;
+    // the current measurement; always points into m_pCollectSlot.
+    Measurement                     *m_pData;
+
+    // what the uplink in flight is carrying
+    enum class UplinkKind : std::uint8_t
+        {
+        kNone,
+        kLive,          // the current measurement, from m_pRadioSlot
+        kBacklog,       // stored records, from m_BacklogBuffer
+        kAck,           // command acknowledgement, from m_AckBuffer
+        kSdStats,       // SD card statistics, from m_SdStatsBuffer
+        };
+    UplinkKind                      m_txKind;
+
+    // uplinks that couldn't be sent, kept in FRAM until they can
+    cUplinkQueue                    m_UplinkQueue;
+    std::uint8_t                    m_BacklogBuffer[MeasurementFormat::kMaxUplinkBytes];
+    // records packed into the backlog frame in flight
+    unsigned                        m_nBacklogRecords;
+    // backlog frames sent since the last live uplink
+    unsigned                        m_nBacklogFrames;
+    // unconfirmed live uplinks at the tail of m_UplinkQueue, kept until
+    // the link is proven; they aren't sent as backlog.
+    unsigned                        m_nUnproven;
+    // set true by an acknowledgement or a downlink; cleared when a
+    // confirmed uplink isn't acknowledged.
+    bool                            m_fLinkUp : 1;
+    // set true if the uplink in flight is confirmed.
+    bool                            m_fTxConfirmed : 1;
+    // set true if a downlink arrived for the uplink in flight.
+    bool                            m_fTxProven : 1;
+
+    // which uplinks to confirm, from the recent link history
+    cUplinkPolicy                   m_UplinkPolicy;
+
+    // the clock: millis() keeps running through deep sleep, so we
+    // keep the Unix time at a reference millis(), plus a rate
+    // correction learned from successive network time answers.
+    std::uint32_t                   m_timeRefUnix;
+    std::uint32_t                   m_timeRefMillis;
+    std::int32_t                    m_timeDriftPpm;
+    // the Unix time of the last network time answer
+    std::uint32_t                   m_timeSyncUnix;
+    // millis() when the next GNSS fix is due
+    std::uint32_t                   m_gpsNextFixMillis;
+    // set true once the clock has been set
+    bool                            m_fTimeValid : 1;
+    // set true once the clock has been set from the network
+    bool                            m_fTimeFromNetwork : 1;
+    // set true while a DeviceTimeReq is outstanding
+    bool                            m_fTimeRequested : 1;
+    // set true while GNSS is powered down
+    bool                            m_fGpsAsleep : 1;
+
+    // settings that can be changed by downlink; kept in FRAM.
+    struct AppConfig_t
+        {
+        std::uint32_t               magic;
+        std::uint16_t               size;
+        // sequence number of the last command message applied
+        std::uint8_t                lastSeq;
+        // SensorMask bits of the sensors to read
+        std::uint8_t                sensorMask;
+        std::uint32_t               txCycleSec_Permanent;
+        std::uint32_t               txCycleSec_Fast;
+        std::uint32_t               txCycleCount_Fast;
+        float                       vGasZero;
+        float                       calibrationFactor[kGasChannels];
+        // switch to the fast cycle above these (ppm); zero disables
+        float                       threshold[kGasChannels];
+        std::uint16_t               reserved;
+        std::uint16_t               crc;
+        };
+    static constexpr std::uint32_t kConfigMagic = 0x31304341;  // "AC01"
+
+    AppConfig_t                     m_config;
+    // acknowledgement for the next uplink on kCommandPort
+    std::uint8_t                    m_AckBuffer[5];
+    bool                            m_fAckPending : 1;
+    // SD card statistics, requested by downlink
+    std::uint8_t                    m_SdStatsBuffer[4 + 7 * cSdStats::kPhases];
+    bool                            m_fSdStatsPending : 1;
+
+    // streaming: requested, running (from request to exit), stopping
+    bool                            m_rqStream : 1;
+    bool                            m_fStreaming : 1;
+    bool                            m_rqStreamStop : 1;
+    bool                            m_fStreamBinary : 1;
+    std::uint8_t                    m_streamChannels;
+    std::uint32_t                   m_streamPeriodMs;
+    // millis() when the next sample is due, and its sequence number
+    std::uint32_t                   m_streamNextMs;
+    std::uint32_t                   m_streamSeq;
+    std::uint32_t                   m_streamSamples;
+    std::uint32_t                   m_streamDropped;
+
+    // SD records are staged here and written a sector at a time
+    cSdLogger                       m_SdLogger;
+    // set true while the SD card is initialized
+    bool                            m_fSdCardUp : 1;
+    // incremented each time the card is mounted
+    std::uint32_t                   m_nSdMounts;
+    // set true once the Data directory is known to exist
+    bool                            m_fSdDataDir : 1;
+    // records in the current binary log file
+    std::uint32_t                   m_nSdRecords;
+    // bytes allocated so far in the current binary log file
+    std::uint32_t                   m_nSdAllocated;
+    // the current log file: SdLogFormat::fileKey(), part and format
+    std::uint32_t                   m_nSdFileKey;
+    unsigned                        m_nSdPart;
+    bool                            m_fSdFileBinary : 1;
+    // set true once m_nSdPart has been looked up for m_nSdFileKey
+    bool                            m_fSdFileKnown : 1;
+    // records until the next index entry
+    unsigned                        m_nSdIndexCountdown;
+
+    // raw inputs of the current measurement, for fSdTrace; the SCD30
+    // fields are kept from reading to reading.
+    SdLogFormat::TraceRecord_t      m_trace;
     };
 
 //
@@ -558,12 +875,12 @@ private:
 //
 static constexpr cMeasurementLoop::Flags operator| (const cMeasurementLoop::Flags lhs, const cMeasurementLoop::Flags rhs)
         {
-        return cMeasurementLoop::Flags(uint8_t(lhs) | uint8_t(rhs));
+        return cMeasurementLoop::Flags(uint16_t(lhs) | uint16_t(rhs));
         };
 
 static constexpr cMeasurementLoop::Flags operator& (const cMeasurementLoop::Flags lhs, const cMeasurementLoop::Flags rhs)
         {
-        return cMeasurementLoop::Flags(uint8_t(lhs) & uint8_t(rhs));
+        return cMeasurementLoop::Flags(uint16_t(lhs) & uint16_t(rhs));
         };
 
 static cMeasurementLoop::Flags operator|= (cMeasurementLoop::Flags &lhs, const cMeasurementLoop::Flags &rhs)
@@ -16,6 +16,10 @@ Author:
 #include "Model4916_cMeasurementLoop.h"
 
 #include "Model4916-MultiGas-Sensor.h"
+#include "Model4916_FramLayout.h"
+#include "Model4916_cDeltaPatch.h"
+#include "Model4916_cLogCategory.h"
+#include "Model4916_crc.h"
 
 #include <Catena_Download.h>
 
@@ -25,6 +29,8 @@ Author:
 
 #include <SD.h>
 #include <mcciadk_baselib.h>
+#include <cstdlib>
+#include <cstring>
 
 using namespace McciModel4916;
 using namespace McciCatena;
@@ -37,6 +43,97 @@ using namespace McciCatena;
 
 SDClass gSD;
 
+/****************************************************************************\
+|
+|   Firmware image records
+|
+\****************************************************************************/
+
+namespace {
+
+// the fallback image last programmed from the SD card, kept in FRAM so
+// a card left in with the same image isn't programmed again. (An update
+// is compared with the running image instead; the fallback only runs if
+// an update fails, so there's nothing running to compare it with.)
+struct FwFallback_t
+    {
+    std::uint32_t                   magic;
+    std::uint32_t                   size;
+    std::uint32_t                   crc32;
+    std::uint16_t                   reserved;
+    std::uint16_t                   crc;
+    };
+constexpr std::uint32_t kFwFallbackMagic = 0x31304246;  // "FB01"
+
+static_assert(sizeof(FwFallback_t) <= FramLayout::kFwImagesSize, "FwFallback_t too large");
+
+bool loadFwFallback(FwFallback_t &fallback)
+    {
+    auto const pFram = gCatena.getFram();
+
+    if (pFram != nullptr &&
+        pFram->read(FramLayout::kFwImages, (std::uint8_t *)&fallback, sizeof(fallback)) &&
+        fallback.magic == kFwFallbackMagic &&
+        fallback.crc == crc16_ccitt(&fallback, offsetof(FwFallback_t, crc)))
+        return true;
+
+    std::memset(&fallback, 0, sizeof(fallback));
+    fallback.magic = kFwFallbackMagic;
+    return false;
+    }
+
+bool saveFwFallback(FwFallback_t &fallback)
+    {
+    auto const pFram = gCatena.getFram();
+
+    fallback.crc = crc16_ccitt(&fallback, offsetof(FwFallback_t, crc));
+    return pFram != nullptr &&
+           pFram->write(FramLayout::kFwImages, (const std::uint8_t *)&fallback, sizeof(fallback));
+    }
+
+// the running image, as the old image for patches. The bootloader
+// points VTOR at the application's vector table, which starts the image;
+// nMax is what's left of the MCU flash from there.
+const std::uint8_t *getRunningImage(size_t &nMax)
+    {
+    std::uint32_t const base = SCB->VTOR;
+
+    nMax = base <= FLASH_END ? FLASH_END + 1 - base : 0;
+    return (const std::uint8_t *)std::uintptr_t(base);
+    }
+
+// true if the running image starts with size bytes of this CRC-32.
+bool isRunningImage(std::uint32_t size, std::uint32_t crc)
+    {
+    size_t nMax;
+    auto const pImage = getRunningImage(nMax);
+
+    return size <= nMax && crc32_ieee(pImage, size) == crc;
+    }
+
+// cDeltaPatch::ReadFn for a patch in a file.
+size_t readPatchFile(void *pUserData, std::uint8_t *pBuffer, size_t nBuffer)
+    {
+    int const nRead = static_cast<File *>(pUserData)->read(pBuffer, nBuffer);
+
+    return nRead > 0 ? nRead : 0;
+    }
+
+const char *getPatchError(cDeltaPatch::Error error)
+    {
+    switch (error)
+        {
+    case cDeltaPatch::Error::kRead:         return "truncated";
+    case cDeltaPatch::Error::kHeader:       return "not a patch";
+    case cDeltaPatch::Error::kWrongImage:   return "made for a different image";
+    case cDeltaPatch::Error::kCorrupt:      return "corrupt";
+    case cDeltaPatch::Error::kMismatch:     return "result doesn't match";
+    default:                                return "incomplete";
+        }
+    }
+
+} // namespace
+
 /****************************************************************************\
 |
 |   Some utilities
@@ -65,14 +162,30 @@ void cMeasurementLoop::sdPrep()
     }
 
 void cMeasurementLoop::sdFinish()
+    {
+    // while the logger has a file open, the card stays up; it's
+    // torn down by sdSleep() before deep sleep.
+    if (this->m_fSdCardUp && this->m_SdLogger.getFile()[0] != '\0')
+        return;
+
+    this->sdTeardown();
+    }
+
+void cMeasurementLoop::sdTeardown()
     {
     // gSD.end() calls card.forceIdle() which will
     // (try to) put the card in the idle state.
-    if (! gSD.end())
+    std::uint32_t const tStart = micros();
+    bool const fIdle = gSD.end();
+    gSdStats.done(cSdStats::Phase::kEnd, tStart, fIdle);
+    if (! fIdle)
         {
-        gCatena.SafePrintf("gSD.end() timed out\n");
+        gLogSd.printf(gLogSd.kWarning, "gSD.end() timed out\n");
         }
 
+    this->m_fSdCardUp = false;
+    this->m_fSdDataDir = false;
+
     // turn off CS to avoid locking Vsdcard on.
     this->m_pSPI2->end();
     this->m_fSpi2Active = false;
@@ -87,6 +200,21 @@ void cMeasurementLoop::sdFinish()
     this->sdPowerUp(false);
     }
 
+// write out everything staged and release the card; called before
+// power to the card goes away.
+void cMeasurementLoop::sdSleep()
+    {
+    if (! this->m_fSdCardUp)
+        return;
+
+    // the card may be changed while we sleep: check the file again
+    // when we wake.
+    if (! this->m_SdLogger.close())
+        gLogSd.printf(gLogSd.kError, "can't write SD log\n");
+
+    this->sdTeardown();
+    }
+
 /*
 
 Name:   McciCatena4430::cMeasurementLoop::fillTxBuffer()
@@ -118,236 +246,19 @@ cMeasurementLoop::initSdCard(
 bool
 cMeasurementLoop::checkSdCard()
     {
-    sdPrep();
-    if (! gSD.begin(gSPI2, SPI_HALF_SPEED, kSdCardCSpin))
-        return false;
-    else
+    if (this->m_fSdCardUp)
         return true;
-    }
-
-static const char kHeader[] =
-    "Timestamp,DevEUI,Raw,Uplink Port,Vbat,Vsystem,BootCount,Latitude,Longitude,"
-    "T,RH,CO2,TVOC,IAQ,PC0.1,PC0.3,PC0.5,PC1.0,PC2.5,PC5.0,PC10,"
-    "PM0.1,PM0.3,PM0.5,PM1.0,PM2.5,PM5.0,PM10,CO,NO2,O3,SO2"
-    "\n";
-
-bool
-cMeasurementLoop::writeSdCard(
-    cMeasurementLoop::TxBuffer_t &b,
-    cMeasurementLoop::Measurement const & mData
-    )
-    {
-    bool fResult;
-    File dataFile;
 
-    fResult = this->checkSdCard();
-    if (! fResult)
-        gCatena.SafePrintf("** SD card not detected!\n");
-
-    if (fResult)
-        {
-        // make a directory
-        fResult = gSD.mkdir("Data");
-        if (! fResult)
-            gCatena.SafePrintf("mkdir failed\n");
-        }
-
-    if (fResult)
-        {
-        char fName[32];
-        bool fNew;
-
-        McciAdkLib_Snprintf(fName, sizeof(fName), 0, "Data/DeviceStart%u.dat", mData.BootCount);
-
-        fNew = !gSD.exists(fName);
-        if (fNew)
-            {
-            //gCatena.SafePrintf("%s not found, will create & write header\n", fName);
-            }
-
-        File dataFile = gSD.open(fName, FILE_WRITE);
-        if (dataFile)
-            {
-            if (fNew)
-                {
-                //gCatena.SafePrintf("write header\n");
-                for (auto i : kHeader)
-                    {
-                    if (i == '\n')
-                        {
-                        dataFile.println();
-                        }
-                    else if (i == '\0')
-                        {
-                        break;
-                        }
-                    else
-                        {
-                        dataFile.print(i);
-                        }
-                    }
-                }
-
-            char buf[32];
-
-            if ((mData.flags & Flags::GPS) != Flags(0))
-                {
-                dataFile.print(mData.position.UnixTime);
-                }
-            dataFile.print(',');
-
-            //gCatena.SafePrintf("write DevEUI");
-            do  {
-                CatenaBase::EUI64_buffer_t devEUI;
-
-            	auto const pFram = gCatena.getFram();
-
-                // use devEUI.
-                if (pFram != nullptr &&
-                    pFram->getField(cFramStorage::StandardKeys::kDevEUI, devEUI))
-                    {
-                    dataFile.print('"');
-
-                    /* write the devEUI */
-                    for (auto i = 0; i < sizeof(devEUI.b); ++i)
-                        {
-                        // the devEUI is stored in little-endian order.
-                        McciAdkLib_Snprintf(
-                            buf, sizeof(buf), 0,
-                            "%02x", devEUI.b[sizeof(devEUI.b) - i - 1]
-                            );
-                        dataFile.print(buf);
-                        }
-
-                    dataFile.print('"');
-                    }
-                } while (0);
-
-            dataFile.print(',');
-
-            //gCatena.SafePrintf("write raw hex\n");
-            dataFile.print('"');
-            for (unsigned i = 0; i < b.getn(); ++i)
-                {
-                McciAdkLib_Snprintf(
-                    buf, sizeof(buf), 0,
-                    "%02x",
-                    b.getbase()[i]
-                    );
-                dataFile.print(buf);
-                }
-
-            dataFile.print("\",");
-
-            //gCatena.SafePrintf("write Vbat\n");
-            if ((mData.flags & Flags::Vbat) != Flags(0))
-               dataFile.print(mData.Vbat);
-
-            dataFile.print(',');
-
-            if ((mData.flags & Flags::Boot) != Flags(0))
-                dataFile.print(mData.BootCount);
-
-            dataFile.print(',');
-
-            if ((mData.flags & Flags::TH) != Flags(0))
-                {
-                dataFile.print(mData.env.TempC);
-                dataFile.print(',');
-
-                dataFile.print(mData.env.Humidity);
-                dataFile.print(',');
-                }
-            else
-                {
-                dataFile.print(",,");
-                }
-
-            if ((mData.flags & Flags::GPS) != Flags(0))
-                {
-                dataFile.print(mData.position.Latitude);
-                dataFile.print(',');
-
-                dataFile.print(mData.position.Longitude);
-                dataFile.print(',');
-                }
-            else
-                {
-                dataFile.print(",,");
-                }
-
-            if ((mData.flags & Flags::PM) != Flags(0))
-                {
-                for (uint8_t i = 0; i < 7; i++) {
-                    dataFile.print(mData.particle.Count[i]);
-                    dataFile.print(',');
-                    }
-                for (uint8_t i = 0; i < 7; i++) {
-                    dataFile.print(mData.particle.Mass[i]);
-                    dataFile.print(',');
-                    }
-                }
-            else
-                {
-                dataFile.print(",,,,,,,,,,,,,,");
-                }
-            
-            if ((mData.flags & Flags::CO2) != Flags(0))
-                {
-                dataFile.print(this->co2int);
-                dataFile.print('.');
-                dataFile.print(this->co2frac);
-                }
-            dataFile.print(',');
-            
-            if ((mData.flags & Flags::CO) != Flags(0))
-                {
-                dataFile.print(mData.gases.CO);
-                }
-            dataFile.print(',');
-            
-            if ((mData.flags & Flags::NO2) != Flags(0))
-                {
-                dataFile.print(mData.gases.NO2);
-                }
-            dataFile.print(',');
-            
-            if ((mData.flags & Flags::O3) != Flags(0))
-                {
-                dataFile.print(mData.gases.O3);
-                }
-            dataFile.print(',');
-            
-            if ((mData.flags & Flags::SO2) != Flags(0))
-                {
-                dataFile.print(mData.gases.SO2);
-                }
-            dataFile.print(',');
-            
-            if ((mData.flags & Flags::TVOC) != Flags(0))
-                {
-                
-                }
-            dataFile.print(',');
-            
-            if ((mData.flags & Flags::IAQ) != Flags(0))
-                {
-                
-                }
-            dataFile.print(',');
-
-            dataFile.println();
-            dataFile.close();
-            }
-        else
-            {
-            gCatena.SafePrintf("can't open: %s\n", fName);
-            }
-        }
+    sdPrep();
 
-    sdFinish();
-    return fResult;
+    std::uint32_t const tStart = micros();
+    this->m_fSdCardUp = gSD.begin(gSPI2, SPI_HALF_SPEED, kSdCardCSpin);
+    gSdStats.done(cSdStats::Phase::kMount, tStart, this->m_fSdCardUp);
+    if (this->m_fSdCardUp)
+        ++this->m_nSdMounts;
+    return this->m_fSdCardUp;
     }
+
 
 /*
 
@@ -374,11 +285,17 @@ Description:
     is simply the inner method, to be called as a wrapper once power is
     up on the card.
 
+    "update.pat", a delta patch to the running image, is tried first; if
+    it's missing or made for another image, "update.bin" is used. An
+    update that would produce the running image is skipped, as is a
+    "fallback.bin" that was already programmed from the card.
+
 Returns:
     True if an update was done and the system should be rebooted.
 
 Notes:
-    
+    setup() calls this once at boot, before the measurement loop starts,
+    and resets if it returns true.
 
 */
 
@@ -389,8 +306,12 @@ cMeasurementLoop::handleSdFirmwareUpdate(
     void
     )
     {
+    // the card is on SPI2 too, so without it there's nothing to read.
     if (this->m_pSPI2 == nullptr)
+        {
         gLog.printf(gLog.kBug, "SPI2 not registered, can't program flash\n");
+        return false;
+        }
 
     bool fResult = this->checkSdCard();
     if (fResult)
@@ -410,36 +331,314 @@ cMeasurementLoop::handleSdFirmwareUpdateCardUp(
     void
     )
     {
-    static const char * const sUpdate[] = { "update.bin", "fallback.bin" };
+    // a patch is tried before a whole image for the same slot.
+    static const struct
+        {
+        const char *s;
+        cDownload::DownloadRq_t rq;
+        std::uint8_t iSlot;
+        bool fPatch;
+        } sUpdate[] =
+        {
+        { "update.pat", cDownload::DownloadRq_t::GetUpdate, 0, true },
+        { "update.bin", cDownload::DownloadRq_t::GetUpdate, 0, false },
+        { "fallback.bin", cDownload::DownloadRq_t::GetFallback, 1, false },
+        };
+    FwFallback_t fallback;
+
+    loadFwFallback(fallback);
 
-    for (auto s : sUpdate)
+    for (auto const &u : sUpdate)
         {
+        auto const s = u.s;
+        auto const iSlot = u.iSlot;
+        std::uint32_t size, crc;
+
         if (! gSD.exists(s))
             {
-            if (gLog.isEnabled(gLog.kTrace))
-                gLog.printf(gLog.kAlways, "%s: not found: %s\n", FUNCTION, s);
+            gLogFwUpdate.printf(gLogFwUpdate.kTrace, "%s: not found: %s\n", FUNCTION, s);
+            continue;
+            }
+
+        // nothing is erased until the whole file checks out.
+        if (! (u.fPatch ? this->sdVerifyPatch(s, size, crc)
+                        : this->sdVerifyImage(s, size, crc)))
+            continue;
+
+        bool const fSame = iSlot == 0 ? isRunningImage(size, crc)
+                                      : fallback.size == size && fallback.crc32 == crc;
+        if (fSame)
+            {
+            gLogFwUpdate.printf(gLogFwUpdate.kInfo, "%s: already programmed, skipped\n", s);
             continue;
             }
 
-        auto result = this->updateFromSd(
-                            s,
-                            s[0] == 'u' ? cDownload::DownloadRq_t::GetUpdate
-                                        : cDownload::DownloadRq_t::GetFallback
-                            );
-        if (gLog.isEnabled(gLog.kTrace))
-            gLog.printf(gLog.kTrace, "%s: applied update from %s: %s\n", FUNCTION, s, result ? "true": "false");
+        auto result = this->updateFromSd(s, u.rq, size, crc, u.fPatch);
+        if (result && iSlot != 0)
+            {
+            fallback.size = size;
+            fallback.crc32 = crc;
+            saveFwFallback(fallback);
+            }
+
+        gLogFwUpdate.printf(gLogFwUpdate.kTrace, "%s: applied update from %s: %s\n", FUNCTION, s, result ? "true": "false");
         return result;
         }
 
     return false;
     }
 
+#undef FUNCTION
+
+/*
+
+Name:	cMeasurementLoop::sdVerifyImage()
+
+Function:
+    Check a firmware image on the SD card before it's programmed.
+
+Definition:
+    bool cMeasurementLoop::sdVerifyImage(
+        const char *sImage,
+        std::uint32_t &size,
+        std::uint32_t &crc
+        );
+
+Description:
+    The whole file is read once, computing its CRC-32 (as used by zip),
+    without touching the SPI flash. The manifest beside the image (the
+    same name, with extension ".man") must hold the size and CRC of the
+    image as two numbers, decimal and hex, e.g. "245760 89abcdef";
+    extra/mkfwman.py writes one. An image without a manifest, or that
+    doesn't match it, is rejected: a card can be pulled while the image
+    is copied to it, and a truncated image reads back without an error.
+
+Returns:
+    true if the image can be programmed; size and crc are set to the
+    size and CRC-32 of the file.
+
+*/
+
+#define FUNCTION "cMeasurementLoop::sdVerifyImage"
+
+bool
+cMeasurementLoop::sdVerifyImage(
+    const char *sImage,
+    std::uint32_t &size,
+    std::uint32_t &crc
+    )
+    {
+    std::uint8_t buffer[512];
+    char sManifest[16];
+
+    File f = gSD.open(sImage, FILE_READ);
+    if (! f)
+        {
+        gLogFwUpdate.printf(gLogFwUpdate.kError, "%s: can't open %s\n", FUNCTION, sImage);
+        return false;
+        }
+
+    std::uint32_t const tStart = millis();
+    size = 0;
+    crc = 0;
+    for (;;)
+        {
+        int const nRead = f.read(buffer, sizeof(buffer));
+        if (nRead <= 0)
+            break;
+
+        crc = crc32_ieee(buffer, nRead, crc);
+        size += nRead;
+        gCatena.poll();
+        }
+
+    bool const fComplete = size == f.size();
+    f.close();
+
+    if (! fComplete)
+        {
+        gLogFwUpdate.printf(gLogFwUpdate.kError, "%s: read error at %lu\n", sImage, (unsigned long) size);
+        return false;
+        }
+
+    gLogFwUpdate.printf(
+        gLogFwUpdate.kInfo,
+        "%s: %lu bytes, crc %08lx (%lu ms)\n",
+        sImage,
+        (unsigned long) size,
+        (unsigned long) crc,
+        (unsigned long) (millis() - tStart)
+        );
+
+    // the manifest is the image name with ".man" for ".bin".
+    std::strncpy(sManifest, sImage, sizeof(sManifest) - 1);
+    sManifest[sizeof(sManifest) - 1] = '\0';
+    char * const pDot = std::strrchr(sManifest, '.');
+    if (pDot == nullptr || size_t(pDot - sManifest) + 4 >= sizeof(sManifest))
+        return false;
+    std::strcpy(pDot, ".man");
+
+    f = gSD.open(sManifest, FILE_READ);
+    if (! f)
+        {
+        gLogFwUpdate.printf(gLogFwUpdate.kError, "%s: no %s; not programmed\n", sImage, sManifest);
+        return false;
+        }
+
+    char text[40];
+    int const nText = f.read(text, sizeof(text) - 1);
+    f.close();
+    text[nText > 0 ? nText : 0] = '\0';
+
+    char *p;
+    std::uint32_t const wantSize = std::strtoul(text, &p, 10);
+    std::uint32_t const wantCrc = std::strtoul(p, nullptr, 16);
+
+    if (wantSize != size || wantCrc != crc)
+        {
+        gLogFwUpdate.printf(
+            gLogFwUpdate.kError,
+            "%s: doesn't match %s (%lu bytes, crc %08lx); not programmed\n",
+            sImage,
+            sManifest,
+            (unsigned long) wantSize,
+            (unsigned long) wantCrc
+            );
+        return false;
+        }
+
+    return true;
+    }
+
+#undef FUNCTION
+
+/*
+
+Name:	cMeasurementLoop::sdVerifyPatch()
+
+Function:
+    Check a delta patch on the SD card before it's programmed.
+
+Definition:
+    bool cMeasurementLoop::sdVerifyPatch(
+        const char *sPatch,
+        std::uint32_t &size,
+        std::uint32_t &crc
+        );
+
+Description:
+    A patch (see Model4916_cDeltaPatch.h; extra/mkpatch.cpp makes them)
+    rebuilds a new image from the running image. Its header names both
+    images by size and CRC-32. The patch is applied once here, without
+    touching the SPI flash, to check that it was made for the running
+    image and that it rebuilds the new one exactly.
+
+Returns:
+    true if the patch can be programmed; size and crc are set to the
+    size and CRC-32 of the new image.
+
+*/
+
+#define FUNCTION "cMeasurementLoop::sdVerifyPatch"
+
+bool
+cMeasurementLoop::sdVerifyPatch(
+    const char *sPatch,
+    std::uint32_t &size,
+    std::uint32_t &crc
+    )
+    {
+    std::uint8_t buffer[256];
+    cDeltaPatch patch;
+    size_t nOldMax;
+    auto const pOld = getRunningImage(nOldMax);
+
+    File f = gSD.open(sPatch, FILE_READ);
+    if (! f)
+        {
+        gLogFwUpdate.printf(gLogFwUpdate.kError, "%s: can't open %s\n", FUNCTION, sPatch);
+        return false;
+        }
+
+    std::uint32_t const tStart = millis();
+    if (patch.begin(readPatchFile, &f, pOld, nOldMax))
+        {
+        while (patch.read(buffer, sizeof(buffer)) != 0)
+            gCatena.poll();
+        }
+
+    std::uint32_t const patchSize = f.size();
+    f.close();
+
+    auto const &h = patch.getHeader();
+    if (! patch.isComplete())
+        {
+        gLogFwUpdate.printf(gLogFwUpdate.kError, "%s: %s; not programmed\n", sPatch, getPatchError(patch.getError()));
+        return false;
+        }
+
+    gLogFwUpdate.printf(
+        gLogFwUpdate.kInfo,
+        "%s: %lu bytes make %lu bytes, crc %08lx (%lu ms)\n",
+        sPatch,
+        (unsigned long) patchSize,
+        (unsigned long) h.newSize,
+        (unsigned long) h.newCrc,
+        (unsigned long) (millis() - tStart)
+        );
+
+    size = h.newSize;
+    crc = h.newCrc;
+    return true;
+    }
+
+#undef FUNCTION
+
+/*
+
+Name:	cMeasurementLoop::updateFromSd()
+
+Function:
+    Program a firmware image or patch from the SD card into the SPI flash.
+
+Definition:
+    bool cMeasurementLoop::updateFromSd(
+        const char *sUpdate,
+        cDownload::DownloadRq_t rq,
+        std::uint32_t size,
+        std::uint32_t crc,
+        bool fPatch = false
+        );
+
+Description:
+    The file is streamed to the downloader. size and crc are the size
+    and CRC-32 of the image that sdVerifyImage() or sdVerifyPatch()
+    accepted; the card may have changed since, so the bytes programmed
+    are checked against them again. The file is removed once it has
+    been read, unless they don't match.
+
+Returns:
+    true if the image was programmed and the caller should reboot.
+
+*/
+
+#define FUNCTION "cMeasurementLoop::updateFromSd"
+
 bool
 cMeasurementLoop::updateFromSd(
     const char *sUpdate,
-    cDownload::DownloadRq_t rq
+    cDownload::DownloadRq_t rq,
+    std::uint32_t size,
+    std::uint32_t crc,
+    bool fPatch
     )
     {
+    // the file is read this much at a time: whole sectors, so the SD
+    // library can read them straight into the buffer.
+    static constexpr size_t kReadAheadBytes = 2 * 512;
+    // progress is shown in steps of this many percent.
+    static constexpr unsigned kProgressStep = 10;
+
     // launch a programming cycle. We'll stall the measurement FSM here while
     // doing the operation, but poll the other FSMs.
     struct context_t
@@ -449,12 +648,28 @@ cMeasurementLoop::updateFromSd(
             File firmwareFile;
             cDownload::Status_t status;
             cDownload::Request_t request;
+            // size of the file, and bytes handed to the downloader
+            std::uint32_t fileSize;
+            std::uint32_t nDone;
+            // CRC-32 of the bytes of an image read from the file
+            std::uint32_t crc;
+            unsigned nextPercent;
+            // data read from the file but not yet handed over
+            size_t nAhead;
+            size_t iAhead;
+            std::uint8_t readAhead[kReadAheadBytes];
+            // set if the file is a patch to the running image
+            bool fPatch;
+            cDeltaPatch patch;
             };
-    context_t context { this, true };
+    context_t context {};
+
+    context.pThis = this;
+    context.fWorking = true;
 
     this->m_fFwUpdate = true;
 
-    gLog.printf(gLog.kInfo, "Attempting to load firmware from %s\n", sUpdate);
+    gLogFwUpdate.printf(gLogFwUpdate.kInfo, "Attempting to load firmware from %s\n", sUpdate);
 
     // power management: typically the SPI2 is powered down by a sleep,
     // and it's not powered back up when we wake up. The SPI flash is on
@@ -471,7 +686,7 @@ cMeasurementLoop::updateFromSd(
         {
         // something went wrong at boot time, we can't do anything
         // with firwmare update...
-        gLog.printf(gLog.kError, "SPI2 pointer is null, give up\n");
+        gLogFwUpdate.printf(gLogFwUpdate.kError, "SPI2 pointer is null, give up\n");
         return false;
         }
 
@@ -481,10 +696,35 @@ cMeasurementLoop::updateFromSd(
     if (! context.firmwareFile)
         {
         // hmm. it exists but we could not open it.
-        gLog.printf(gLog.kError, "%s: exists but can't open: %s\n", FUNCTION, sUpdate);
+        gLogFwUpdate.printf(gLogFwUpdate.kError, "%s: exists but can't open: %s\n", FUNCTION, sUpdate);
         return false;
         }
 
+    context.fileSize = context.firmwareFile.size();
+    context.nDone = 0;
+    context.crc = 0;
+    context.nextPercent = kProgressStep;
+    context.nAhead = context.iAhead = 0;
+    context.fPatch = fPatch;
+
+    if (fPatch)
+        {
+        size_t nOldMax;
+        auto const pOld = getRunningImage(nOldMax);
+
+        // checked by sdVerifyPatch(), so this only fails if the card
+        // was changed since.
+        if (! context.patch.begin(readPatchFile, &context.firmwareFile, pOld, nOldMax))
+            {
+            gLogFwUpdate.printf(gLogFwUpdate.kError, "%s: %s\n", sUpdate, getPatchError(context.patch.getError()));
+            context.firmwareFile.close();
+            return false;
+            }
+
+        // progress is through the new image.
+        context.fileSize = context.patch.getHeader().newSize;
+        }
+
     // the downloader requires a "request block" that tells it what to do.
     // since we loop in this function, we can allocate it as a local variable,
     // and keep it in the context object. Save some typing by defining an
@@ -514,7 +754,7 @@ cMeasurementLoop::updateFromSd(
     // a file. But this means we must fill buffer to max size in read
     // when we hit end of file.
     request.QueryAvailableData.init(
-        [](void *pUserData) -> int
+        [](void *) -> int
             {
             return cDownload::kTransferChunkBytes;
             },
@@ -525,24 +765,66 @@ cMeasurementLoop::updateFromSd(
     // when reading from a file.
     request.PromptForData.init(nullptr, nullptr);
 
-    // initialize the read-byte callback
+    // initialize the read-byte callback. The SD card and the SPI flash
+    // share SPI2, and both drivers are synchronous, so reading can't
+    // overlap programming. Instead, the file is read several chunks at a
+    // time with File::read(), which transfers whole sectors, rather than
+    // with Stream::readBytes(), which goes through read() a byte at a
+    // time.
     request.ReadBytes.init(
         // this is called each time the downloader wants more data
         [](void *pUserData, std::uint8_t *pBuffer, size_t nBuffer) -> size_t
             {
             context_t * const pCtx = (context_t *)pUserData;
+            size_t n = 0;
 
-            gLog.printf(gLog.kInfo, ".");
             gCatena.poll();
 
-            auto n = pCtx->firmwareFile.readBytes(pBuffer, nBuffer);
+            // a patch produces the new image from the running one.
+            if (pCtx->fPatch)
+                n = pCtx->patch.read(pBuffer, nBuffer);
+
+            while (! pCtx->fPatch && n < nBuffer)
+                {
+                if (pCtx->iAhead == pCtx->nAhead)
+                    {
+                    int const nRead = pCtx->firmwareFile.read(pCtx->readAhead, sizeof(pCtx->readAhead));
+
+                    pCtx->iAhead = 0;
+                    pCtx->nAhead = nRead > 0 ? nRead : 0;
+                    if (pCtx->nAhead == 0)
+                        break;
+                    }
+
+                size_t nCopy = pCtx->nAhead - pCtx->iAhead;
+                if (nCopy > nBuffer - n)
+                    nCopy = nBuffer - n;
+
+                memcpy(pBuffer + n, pCtx->readAhead + pCtx->iAhead, nCopy);
+                pCtx->crc = crc32_ieee(pCtx->readAhead + pCtx->iAhead, nCopy, pCtx->crc);
+                pCtx->iAhead += nCopy;
+                n += nCopy;
+                }
+
             if (n < nBuffer)
                 {
                 // at end of file we have spare bytes that are not
                 // used. Initialize to 0xFF because that's nice for
                 // SPI flash.
                 memset(pBuffer + n, 0xFF, nBuffer - n);
-                gLog.printf(gLog.kInfo, "\n");
+                }
+
+            // show progress in steps, not per chunk.
+            pCtx->nDone += n;
+            if (pCtx->fileSize != 0)
+                {
+                unsigned const percent = std::uint64_t(pCtx->nDone) * 100 / pCtx->fileSize;
+
+                if (percent >= pCtx->nextPercent)
+                    {
+                    gLogFwUpdate.printf(gLogFwUpdate.kInfo, "%u%%\n", percent);
+                    pCtx->nextPercent = percent - percent % kProgressStep + kProgressStep;
+                    }
                 }
 
             return nBuffer;
@@ -566,6 +848,8 @@ cMeasurementLoop::updateFromSd(
     // set the request code in the request.
     request.rq = rq;
 
+    std::uint32_t const tStart = millis();
+
     // launch the request.
     if (! gDownload.evStart(request))
         {
@@ -585,23 +869,57 @@ cMeasurementLoop::updateFromSd(
         gCatena.poll();
 
     // download operation is complete.
-    // close and remove the file
     context.firmwareFile.close();
-    gSD.remove(sUpdate);
+
+    // a patch that fails part way, or an image that doesn't read back as
+    // it was verified, was padded with 0xFF; leave the file for next time.
+    bool const fIntact = fPatch ? context.patch.isComplete()
+                                : context.nDone == size && context.crc == crc;
+    if (fIntact)
+        gSD.remove(sUpdate);
+
+    std::uint32_t const ms = millis() - tStart;
+    gLogFwUpdate.printf(
+        gLogFwUpdate.kInfo,
+        "%s: %lu bytes in %lu.%03lu s (%lu bytes/s)\n",
+        sUpdate,
+        (unsigned long) context.nDone,
+        (unsigned long) (ms / 1000),
+        (unsigned long) (ms % 1000),
+        (unsigned long) (ms == 0 ? 0 : std::uint64_t(context.nDone) * 1000 / ms)
+        );
 
     // if it failed, display the error code.
     if (context.status != cDownload::Status_t::kSuccessful)
         {
-        gLog.printf(gLog.kError, "download failed, status %u\n", std::uint32_t(context.status));
+        gLogFwUpdate.printf(gLogFwUpdate.kError, "download failed, status %u\n", std::uint32_t(context.status));
         // no need to reboot.
         return false;
         }
+    else if (fPatch && ! fIntact)
+        {
+        gLogFwUpdate.printf(gLogFwUpdate.kError, "%s: %s since it was checked; not booted\n", sUpdate, getPatchError(context.patch.getError()));
+        return false;
+        }
+    else if (! fIntact)
+        {
+        gLogFwUpdate.printf(
+            gLogFwUpdate.kError,
+            "%s: read %lu bytes, crc %08lx, not the %lu bytes, crc %08lx checked; not booted\n",
+            sUpdate,
+            (unsigned long) context.nDone,
+            (unsigned long) context.crc,
+            (unsigned long) size,
+            (unsigned long) crc
+            );
+        return false;
+        }
     // if it succeeeded, say so, and tell caller to reboot.
     // don't reboot here, because the outer app may need to shut things down
     // in an orderly way.
     else
         {
-        gLog.printf(gLog.kInfo, "download succeded.\n");
+        gLogFwUpdate.printf(gLogFwUpdate.kInfo, "download succeded.\n");
         return true;
         }
     }
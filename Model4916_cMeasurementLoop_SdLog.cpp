@@ -0,0 +1,791 @@
+/*
+
+Module: Model4916_cMeasurementLoop_SdLog.cpp
+
+Function:
+    Logging measurements to the SD card.
+
+Copyright:
+    See accompanying LICENSE file for copyright and license information.
+
+Author:
+    Dhinesh Kumar Pitchai, MCCI Corporation   November 2022
+
+*/
+
+#include "Model4916_cMeasurementLoop.h"
+
+#include "Model4916-MultiGas-Sensor.h"
+#include "Model4916_SdLogFormat.h"
+#include "Model4916_cCsvRow.h"
+#include "Model4916_cLogCategory.h"
+#include "Model4916_crc.h"
+
+#include <Catena_Fram.h>
+
+#include <SD.h>
+#include <cstring>
+
+using namespace McciModel4916;
+using namespace McciCatena;
+
+/****************************************************************************\
+|
+|   Manifest constants & typedefs.
+|
+\****************************************************************************/
+
+const char cMeasurementLoop::kSdCsvHeader[] =
+    "Timestamp,DevEUI,Raw,Uplink Port,Vbat,Vsystem,BootCount,Latitude,Longitude,"
+    "T,RH,CO2,TVOC,IAQ,PC0.1,PC0.3,PC0.5,PC1.0,PC2.5,PC5.0,PC10,"
+    "PM0.1,PM0.3,PM0.5,PM1.0,PM2.5,PM5.0,PM10,CO,NO2,O3,SO2";
+
+static_assert(SdLogFormat::kMaxRaw >= cMeasurementLoop::MeasurementFormat::kTxBufferSize,
+              "binary SD records can't hold a whole uplink");
+
+// records in a binary log file
+static constexpr std::uint32_t kSdLogRecords =
+    SdLogFormat::recordCapacity(cMeasurementLoop::kSdLogFileSectors);
+
+// fetch the DevEUI, most significant byte first.
+static bool getDevEUI(std::uint8_t (&eui)[8])
+    {
+    CatenaBase::EUI64_buffer_t devEUI;
+    auto const pFram = gCatena.getFram();
+
+    if (pFram == nullptr ||
+        ! pFram->getField(cFramStorage::StandardKeys::kDevEUI, devEUI))
+        return false;
+
+    // the devEUI is stored in little-endian order.
+    for (unsigned i = 0; i < sizeof(eui); ++i)
+        eui[i] = devEUI.b[sizeof(devEUI.b) - i - 1];
+
+    return true;
+    }
+
+/*
+
+Name:	cMeasurementLoop::writeSdCard()
+
+Function:
+    Log a measurement and its uplink to the SD card.
+
+Definition:
+    bool cMeasurementLoop::writeSdCard(
+            cMeasurementLoop::TxBuffer_t &b,
+            cMeasurementLoop::Measurement const & mData
+            );
+
+Description:
+    The record is staged in m_SdLogger, and goes to the card a sector at
+    a time. Records are CSV with kSdCsvHeader columns, or if fSdBinaryLog
+    is set in the operating flags, fixed-size binary records as described
+    in Model4916_SdLogFormat.h. The two formats go to different files.
+
+    Files are rotated daily and when full (see sdSelectLogFile()). Every
+    kSdIndexInterval records, the time and file offset of the record are
+    added to the file's index, so the dump command can go straight to
+    the records it wants.
+
+Returns:
+    true if the record was accepted.
+
+*/
+
+bool
+cMeasurementLoop::writeSdCard(
+    cMeasurementLoop::TxBuffer_t &b,
+    cMeasurementLoop::Measurement const & mData
+    )
+    {
+    bool fResult;
+    bool const fBinary = gCatena.GetOperatingFlags() &
+                            static_cast<uint32_t>(OPERATING_FLAGS::fSdBinaryLog);
+
+    fResult = this->checkSdCard();
+    if (! fResult)
+        gLogSd.printf(gLogSd.kError, "** SD card not detected!\n");
+
+    if (fResult && ! this->m_fSdDataDir)
+        {
+        // make a directory
+        std::uint32_t const tStart = micros();
+        fResult = gSD.mkdir("Data");
+        gSdStats.done(cSdStats::Phase::kMkdir, tStart, fResult);
+        if (! fResult)
+            gLogSd.printf(gLogSd.kError, "mkdir failed\n");
+        else
+            this->m_fSdDataDir = true;
+        }
+
+    if (fResult)
+        fResult = this->sdSelectLogFile(mData, fBinary);
+
+    if (fResult)
+        {
+        // records are staged in RAM; the logger writes them out a
+        // sector at a time.
+        auto &dataFile = this->m_SdLogger;
+        std::uint32_t const offset = dataFile.getPosition();
+        SdLogFormat::Record_t record;
+
+        this->fillSdRecord(record, b, mData);
+        if (fBinary)
+            {
+            this->writeSdRecordBinary(record);
+            }
+        else
+            {
+            std::uint8_t devEUI[8];
+
+            printSdRecordCsv(dataFile, getDevEUI(devEUI) ? devEUI : nullptr, record);
+            }
+
+        dataFile.endRecord();
+
+        // records without a time can't be looked up by time.
+        if (record.time != 0)
+            {
+            if (this->m_nSdIndexCountdown == 0)
+                {
+                this->m_nSdIndexCountdown = kSdIndexInterval;
+                this->sdWriteIndex(record.time, offset);
+                }
+            --this->m_nSdIndexCountdown;
+            }
+
+        // on a low battery, don't leave anything in RAM; otherwise
+        // write only whole sectors, every few records.
+        if ((mData.flags & Flags::Vbat) != Flags(0) &&
+            mData.Vbat < kSdLowBatteryVolts)
+            fResult = dataFile.flush(true);
+        else if (dataFile.getRecords() >= kSdFlushRecords)
+            fResult = dataFile.flush(false);
+
+        if (! fResult)
+            gLogSd.printf(gLogSd.kError, "can't write: %s\n", dataFile.getFile());
+        }
+
+    if (! fResult)
+        {
+        // start over with a fresh mount next time.
+        this->m_SdLogger.discard();
+        this->sdTeardown();
+        }
+
+    return fResult;
+    }
+
+// write out everything the logger is holding, so the card is up to date
+// (e.g. before reading the logs back).
+bool
+cMeasurementLoop::flushSdLog()
+    {
+    if (! this->m_fSdCardUp)
+        return true;
+
+    return this->m_SdLogger.flush(true);
+    }
+
+/*
+
+Name:	cMeasurementLoop::sdSelectLogFile()
+
+Function:
+    Point m_SdLogger at the file a record belongs in.
+
+Definition:
+    bool cMeasurementLoop::sdSelectLogFile(
+            cMeasurementLoop::Measurement const & mData,
+            bool fBinary
+            );
+
+Description:
+    The file is named for the UTC day of the record (or the boot count,
+    if the time isn't known) and a part number; see
+    SdLogFormat::fileName(). When the day or the format changes, we
+    continue in the highest part that already exists, so a reboot
+    appends to the day's log. When a part is full (kSdLogFileSectors),
+    the next part is started. A binary log is extended first if the
+    record would go past the space allocated so far.
+
+Returns:
+    true if the logger is ready for the record.
+
+*/
+
+bool
+cMeasurementLoop::sdSelectLogFile(
+    cMeasurementLoop::Measurement const & mData,
+    bool fBinary
+    )
+    {
+    char fName[32];
+    const char * const pExt = fBinary ? "REC" : "CSV";
+    std::uint32_t const key = SdLogFormat::fileKey(mData.position.UnixTime, mData.BootCount);
+
+    if (key != this->m_nSdFileKey || fBinary != this->m_fSdFileBinary || ! this->m_fSdFileKnown)
+        {
+        this->m_nSdFileKey = key;
+        this->m_fSdFileBinary = fBinary;
+        this->m_fSdFileKnown = true;
+
+        for (this->m_nSdPart = 0; this->m_nSdPart + 1 < SdLogFormat::kMaxParts; ++this->m_nSdPart)
+            {
+            SdLogFormat::fileName(fName, sizeof(fName), key, this->m_nSdPart + 1, pExt);
+            if (! gSD.exists(fName))
+                break;
+            }
+        }
+
+    for (;;)
+        {
+        bool fFull;
+
+        SdLogFormat::fileName(fName, sizeof(fName), key, this->m_nSdPart, pExt);
+        if (std::strcmp(fName, this->m_SdLogger.getFile()) != 0)
+            {
+            bool const fResult = fBinary ? this->sdOpenBinaryLog(fName, mData)
+                                         : this->sdOpenCsvLog(fName);
+            if (! fResult)
+                return false;
+
+            // index the first record we write to the file.
+            this->m_nSdIndexCountdown = 0;
+            }
+
+        if (fBinary)
+            fFull = this->m_nSdRecords >= kSdLogRecords;
+        else
+            fFull = this->m_SdLogger.getPosition() >= kSdLogFileSectors * cSdLogger::kSectorSize;
+
+        if (! fFull)
+            return fBinary ? this->sdExtendBinaryLog() : true;
+
+        if (this->m_nSdPart + 1 >= SdLogFormat::kMaxParts)
+            {
+            gLogSd.printf(gLogSd.kWarning, "%s: no more parts for today\n", fName);
+            return false;
+            }
+
+        ++this->m_nSdPart;
+        }
+    }
+
+// open a CSV log for appending; a new one gets the heading line.
+bool
+cMeasurementLoop::sdOpenCsvLog(
+    const char *pName
+    )
+    {
+    std::uint32_t size = 0;
+    std::uint32_t tStart = micros();
+    File f = gSD.open(pName, FILE_READ);
+
+    // a new file isn't there yet; that's not a failure.
+    gSdStats.done(cSdStats::Phase::kOpen, tStart, true);
+    if (f)
+        {
+        size = f.size();
+        tStart = micros();
+        f.close();
+        gSdStats.done(cSdStats::Phase::kClose, tStart, true);
+        }
+
+    // anything staged for the previous file is written first.
+    bool const fResult = this->m_SdLogger.setFile(pName, size, false);
+    if (size == 0)
+        this->m_SdLogger.println(kSdCsvHeader);
+
+    return fResult;
+    }
+
+/*
+
+Name:	cMeasurementLoop::sdOpenBinaryLog()
+
+Function:
+    Open a binary log file for writing records in place.
+
+Definition:
+    bool cMeasurementLoop::sdOpenBinaryLog(
+            const char *pName,
+            cMeasurementLoop::Measurement const & mData
+            );
+
+Description:
+    A new file gets its header sector. The space for records is
+    allocated by writing zero sectors, kSdLogAllocSectors at a time
+    before the records reach them (see sdExtendBinaryLog()), so opening
+    a file costs no more than a few reads, and the allocation never
+    holds up a single measurement for long. Records are written in
+    place, so only every kSdLogAllocSectors'th sector touches the FAT
+    or the directory.
+
+    Records are written in sequence, so the valid ones are a prefix of
+    the file; a binary search for the first record with a bad CRC or
+    sequence number finds where to continue, whether the last write was
+    cut short or not. The valid records in the last, partial sector are
+    read back into m_SdLogger so the sector is rewritten whole.
+
+Returns:
+    true if the file is ready; m_nSdRecords is the number of valid
+    records in it, and m_nSdAllocated the whole sectors allocated.
+
+*/
+
+bool
+cMeasurementLoop::sdOpenBinaryLog(
+    const char *pName,
+    cMeasurementLoop::Measurement const & mData
+    )
+    {
+    using namespace SdLogFormat;
+    static const std::uint8_t kZeroSector[kSectorSize] {};
+    FileHeader_t header {};
+    bool fResult;
+
+    // anything staged for the previous file is written first.
+    this->m_SdLogger.setFile(pName, 0, true);
+
+    std::uint32_t tStart = micros();
+    File f = gSD.open(pName, O_READ | O_WRITE | O_CREAT);
+    gSdStats.done(cSdStats::Phase::kOpen, tStart, bool(f));
+    if (! f)
+        return false;
+
+    std::uint32_t size = f.size();
+    if (size < kSectorSize)
+        {
+        std::memcpy(header.magic, kFileMagic, sizeof(header.magic));
+        header.schemaVersion = kSchemaVersion;
+        header.headerSize = kSectorSize;
+        header.recordSize = kRecordSize;
+        header.recordsPerSector = kRecordsPerSector;
+        header.messageFormat = kMessageFormat;
+        getDevEUI(header.devEUI);
+        header.bootCount = mData.BootCount;
+        header.createTime = mData.position.UnixTime;
+        header.recordCapacity = kSdLogRecords;
+        header.crc = crc32_ieee(&header, offsetof(FileHeader_t, crc));
+
+        tStart = micros();
+        fResult = f.seek(0) &&
+                  f.write((const std::uint8_t *)&header, sizeof(header)) == sizeof(header) &&
+                  f.write(kZeroSector, kSectorSize - sizeof(header)) == kSectorSize - sizeof(header);
+        gSdStats.done(cSdStats::Phase::kWrite, tStart, fResult);
+        size = kSectorSize;
+        }
+    else
+        {
+        fResult = f.seek(0) &&
+                  f.read(&header, sizeof(header)) == sizeof(header) &&
+                  std::memcmp(header.magic, kFileMagic, sizeof(header.magic)) == 0 &&
+                  header.crc == crc32_ieee(&header, offsetof(FileHeader_t, crc)) &&
+                  header.recordSize == kRecordSize &&
+                  header.recordCapacity == kSdLogRecords;
+        if (! fResult)
+            gLogSd.printf(gLogSd.kWarning, "%s: not a log file\n", pName);
+        }
+
+    // a partial last sector is from an extension cut short; it's
+    // written again.
+    this->m_nSdAllocated = size - size % kSectorSize;
+
+    if (fResult)
+        {
+        std::uint32_t const nAllocated =
+            recordCapacity(this->m_nSdAllocated / kSectorSize);
+        std::uint32_t lo = 0;
+        std::uint32_t hi = nAllocated < kSdLogRecords ? nAllocated : kSdLogRecords;
+
+        // records [0, lo) are valid, [hi, capacity) are not.
+        while (lo < hi)
+            {
+            std::uint32_t const mid = lo + (hi - lo) / 2;
+
+            if (this->sdCheckRecord(f, mid))
+                lo = mid + 1;
+            else
+                hi = mid;
+            }
+
+        this->m_nSdRecords = lo;
+
+        std::uint32_t const first = lo - lo % kRecordsPerSector;
+        fResult = this->m_SdLogger.seek(recordOffset(first));
+
+        for (std::uint32_t i = first; fResult && i < lo; ++i)
+            {
+            Record_t record;
+
+            fResult = f.seek(recordOffset(i)) &&
+                      f.read(&record, sizeof(record)) == sizeof(record);
+            if (fResult)
+                this->m_SdLogger.write((const std::uint8_t *)&record, sizeof(record));
+            }
+        }
+
+    tStart = micros();
+    f.close();
+    gSdStats.done(cSdStats::Phase::kClose, tStart, true);
+    return fResult;
+    }
+
+// make sure the sector of the next binary record is allocated, by
+// writing the next kSdLogAllocSectors zero sectors if it isn't.
+bool
+cMeasurementLoop::sdExtendBinaryLog()
+    {
+    using namespace SdLogFormat;
+    static const std::uint8_t kZeroSector[kSectorSize] {};
+    std::uint32_t const nFileBytes = kSdLogFileSectors * kSectorSize;
+    std::uint32_t const nNeeded = recordOffset(this->m_nSdRecords) + kRecordSize;
+
+    if (nNeeded <= this->m_nSdAllocated)
+        return true;
+
+    std::uint32_t nEnd = this->m_nSdAllocated + kSdLogAllocSectors * kSectorSize;
+    if (nEnd > nFileBytes)
+        nEnd = nFileBytes;
+
+    const char * const pName = this->m_SdLogger.getFile();
+    gLogSd.printf(gLogSd.kTrace, "allocating %s to %u\n", pName, unsigned(nEnd));
+
+    std::uint32_t tStart = micros();
+    File f = gSD.open(pName, O_READ | O_WRITE);
+    gSdStats.done(cSdStats::Phase::kOpen, tStart, bool(f));
+    if (! f)
+        return false;
+
+    bool fResult = f.seek(this->m_nSdAllocated);
+    while (fResult && this->m_nSdAllocated < nEnd)
+        {
+        tStart = micros();
+        fResult = f.write(kZeroSector, kSectorSize) == kSectorSize;
+        gSdStats.done(cSdStats::Phase::kWrite, tStart, fResult);
+        if (fResult)
+            this->m_nSdAllocated += kSectorSize;
+        }
+
+    tStart = micros();
+    f.close();
+    gSdStats.done(cSdStats::Phase::kClose, tStart, true);
+    return fResult;
+    }
+
+bool
+cMeasurementLoop::sdCheckRecord(
+    File &f,
+    std::uint32_t i
+    )
+    {
+    SdLogFormat::Record_t record;
+
+    return f.seek(SdLogFormat::recordOffset(i)) &&
+           f.read(&record, sizeof(record)) == sizeof(record) &&
+           record.sequence == i &&
+           record.crc == crc32_ieee(&record, offsetof(SdLogFormat::Record_t, crc));
+    }
+
+// add an entry to the index of the current log file. The index is only
+// a hint for the dump command, so failures are reported but not fatal.
+bool
+cMeasurementLoop::sdWriteIndex(
+    std::uint32_t time,
+    std::uint32_t offset
+    )
+    {
+    char fName[32];
+    SdLogFormat::IndexEntry_t const entry = { time, offset };
+
+    SdLogFormat::fileName(
+        fName, sizeof(fName),
+        this->m_nSdFileKey, this->m_nSdPart,
+        this->m_fSdFileBinary ? "RCI" : "CSI"
+        );
+
+    std::uint32_t tStart = micros();
+    File f = gSD.open(fName, FILE_WRITE);
+    bool fResult = f;
+    gSdStats.done(cSdStats::Phase::kOpen, tStart, fResult);
+    if (fResult)
+        {
+        tStart = micros();
+        fResult = f.write((const std::uint8_t *)&entry, sizeof(entry)) == sizeof(entry);
+        gSdStats.done(cSdStats::Phase::kWrite, tStart, fResult);
+
+        tStart = micros();
+        f.close();
+        gSdStats.done(cSdStats::Phase::kClose, tStart, true);
+        }
+
+    if (! fResult)
+        gLogSd.printf(gLogSd.kError, "can't write: %s\n", fName);
+
+    return fResult;
+    }
+
+/*
+
+Name:	cMeasurementLoop::sdWriteTrace()
+
+Function:
+    Append the raw inputs of the last measurement to the day's trace.
+
+Definition:
+    bool cMeasurementLoop::sdWriteTrace(
+            void
+            );
+
+Description:
+    Called after writeSdCard() if fSdTrace is set in the operating
+    flags, so the card is mounted, the Data directory exists, and
+    m_nSdFileKey names the day. The trace is Data/YYMMDD00.TRC; a new
+    file gets a TraceHeader_t first. See Model4916_SdLogFormat.h.
+
+    Traces are a debugging aid: a failure is reported, but doesn't
+    disturb the log.
+
+Returns:
+    true if the record was written.
+
+*/
+
+bool
+cMeasurementLoop::sdWriteTrace(
+    void
+    )
+    {
+    char fName[32];
+    auto &record = this->m_trace;
+
+    SdLogFormat::fileName(fName, sizeof(fName), this->m_nSdFileKey, 0, "TRC");
+    record.crc = crc32_ieee(&record, offsetof(SdLogFormat::TraceRecord_t, crc));
+
+    std::uint32_t tStart = micros();
+    File f = gSD.open(fName, FILE_WRITE);
+    bool fResult = f;
+    gSdStats.done(cSdStats::Phase::kOpen, tStart, fResult);
+    if (fResult)
+        {
+        tStart = micros();
+        if (f.size() == 0)
+            {
+            SdLogFormat::TraceHeader_t header;
+
+            std::memset(&header, 0, sizeof(header));
+            std::memcpy(header.magic, SdLogFormat::kTraceMagic, sizeof(header.magic));
+            header.schemaVersion = SdLogFormat::kTraceSchemaVersion;
+            header.headerSize = sizeof(header);
+            header.recordSize = sizeof(record);
+            (void) getDevEUI(header.devEUI);
+            header.bootCount = record.bootCount;
+            header.createTime = record.time;
+            header.crc = crc32_ieee(&header, offsetof(SdLogFormat::TraceHeader_t, crc));
+
+            fResult = f.write((const std::uint8_t *)&header, sizeof(header)) == sizeof(header);
+            }
+        if (fResult)
+            fResult = f.write((const std::uint8_t *)&record, sizeof(record)) == sizeof(record);
+        gSdStats.done(cSdStats::Phase::kWrite, tStart, fResult);
+
+        tStart = micros();
+        f.close();
+        gSdStats.done(cSdStats::Phase::kClose, tStart, true);
+        }
+
+    if (! fResult)
+        gLogSd.printf(gLogSd.kError, "can't write: %s\n", fName);
+
+    // the next record has an SCD30 reading only if there's a new one.
+    record.valid &= ~SdLogFormat::kTraceScd30;
+    return fResult;
+    }
+
+/****************************************************************************\
+|
+|   Records
+|
+\****************************************************************************/
+
+// the fields of a record, in the binary layout; also the source of the
+// CSV rows, so both formats say the same thing.
+void
+cMeasurementLoop::fillSdRecord(
+    SdLogFormat::Record_t &record,
+    cMeasurementLoop::TxBuffer_t &b,
+    cMeasurementLoop::Measurement const & mData
+    )
+    {
+    std::memset(&record, 0, sizeof(record));
+
+    record.time = mData.position.UnixTime;
+    record.flags = std::uint16_t(mData.flags);
+    record.port = MeasurementFormat::kMessagePort;
+    record.bootCount = mData.BootCount;
+    record.vBat = mData.Vbat;
+    record.vBus = mData.Vbus;
+    record.tempC = mData.env.TempC;
+    record.humidity = mData.env.Humidity;
+    record.latitude = mData.position.Latitude;
+    record.longitude = mData.position.Longitude;
+    record.co2ppm = mData.co2ppm.CO2ppm;
+    for (unsigned i = 0; i < 7; ++i)
+        {
+        record.count[i] = mData.particle.Count[i];
+        record.mass[i] = mData.particle.Mass[i];
+        }
+    record.gases[0] = mData.gases.CO;
+    record.gases[1] = mData.gases.NO2;
+    record.gases[2] = mData.gases.O3;
+    record.gases[3] = mData.gases.SO2;
+
+    record.nRaw = std::uint8_t(b.getn() < sizeof(record.raw) ? b.getn() : sizeof(record.raw));
+    std::memcpy(record.raw, b.getbase(), record.nRaw);
+    }
+
+// one binary record, plus the sector padding after the last record
+// that fits in a sector.
+void
+cMeasurementLoop::writeSdRecordBinary(
+    SdLogFormat::Record_t &record
+    )
+    {
+    record.sequence = this->m_nSdRecords;
+    record.crc = crc32_ieee(&record, offsetof(SdLogFormat::Record_t, crc));
+
+    this->m_SdLogger.write((const std::uint8_t *)&record, sizeof(record));
+
+    ++this->m_nSdRecords;
+    if (this->m_nSdRecords % SdLogFormat::kRecordsPerSector == 0)
+        {
+        static const std::uint8_t kPad[SdLogFormat::kRecordPad] {};
+        this->m_SdLogger.write(kPad, sizeof(kPad));
+        }
+    }
+
+/*
+
+Name:	cMeasurementLoop::printSdRecordCsv()
+
+Function:
+    Print a log record as a CSV row.
+
+Definition:
+    static void cMeasurementLoop::printSdRecordCsv(
+            Print &out,
+            const std::uint8_t *pDevEUI,
+            const SdLogFormat::Record_t &record
+            );
+
+Description:
+    The row has the kSdCsvHeader columns; fields whose flag is clear are
+    left empty. pDevEUI, if not nullptr, points to the 8-byte DevEUI,
+    most significant byte first.
+
+    This is used both for the CSV log and to dump binary logs, so the
+    two read the same. The row is formatted by cCsvRow into one buffer
+    and handed to out in a single write(); the numbers read exactly as
+    Print::print() would print them.
+
+*/
+
+void
+cMeasurementLoop::printSdRecordCsv(
+    Print &out,
+    const std::uint8_t *pDevEUI,
+    const SdLogFormat::Record_t &record
+    )
+    {
+    static char buffer[kSdCsvMaxRow];
+    cCsvRow row(buffer, sizeof(buffer));
+    auto const flags = Flags(record.flags);
+
+    if (record.time != 0)
+        row.putUnsigned(record.time);
+    row.putChar(',');
+
+    if (pDevEUI != nullptr)
+        {
+        row.putChar('"');
+        row.putHex(pDevEUI, 8);
+        row.putChar('"');
+        }
+    row.putChar(',');
+
+    row.putChar('"');
+    row.putHex(record.raw, record.nRaw < sizeof(record.raw) ? record.nRaw : sizeof(record.raw));
+    row.putBytes("\",", 2);
+
+    row.putUnsigned(record.port);
+    row.putChar(',');
+
+    if ((flags & Flags::Vbat) != Flags(0))
+        row.putFloat(record.vBat);
+    row.putChar(',');
+
+    // Vsystem isn't measured on this board.
+    row.putChar(',');
+
+    if ((flags & Flags::Boot) != Flags(0))
+        row.putUnsigned(record.bootCount);
+    row.putChar(',');
+
+    if ((flags & Flags::GPS) != Flags(0))
+        {
+        row.putFloat(record.latitude);
+        row.putChar(',');
+        row.putFloat(record.longitude);
+        row.putChar(',');
+        }
+    else
+        row.putBytes(",,", 2);
+
+    if ((flags & Flags::TH) != Flags(0))
+        {
+        row.putFloat(record.tempC);
+        row.putChar(',');
+        row.putFloat(record.humidity);
+        row.putChar(',');
+        }
+    else
+        row.putBytes(",,", 2);
+
+    if ((flags & Flags::CO2) != Flags(0))
+        row.putFloat(record.co2ppm);
+    row.putChar(',');
+
+    // TVOC and IAQ aren't measured yet.
+    row.putBytes(",,", 2);
+
+    if ((flags & Flags::PM) != Flags(0))
+        {
+        for (unsigned i = 0; i < 7; ++i)
+            {
+            row.putUnsigned(record.count[i]);
+            row.putChar(',');
+            }
+        for (unsigned i = 0; i < 7; ++i)
+            {
+            row.putFloat(record.mass[i]);
+            row.putChar(',');
+            }
+        }
+    else
+        row.putString(",,,,,,,,,,,,,,");
+
+    static const Flags kGasFlags[4] = { Flags::CO, Flags::NO2, Flags::O3, Flags::SO2 };
+    for (unsigned i = 0; i < 4; ++i)
+        {
+        if ((flags & kGasFlags[i]) != Flags(0))
+            row.putFloat(record.gases[i]);
+        if (i < 3)
+            row.putChar(',');
+        }
+
+    row.putBytes("\r\n", 2);
+
+    out.write((const std::uint8_t *)row.getBase(), row.getn());
+    }
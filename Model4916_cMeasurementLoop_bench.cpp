@@ -0,0 +1,265 @@
+/*
+
+Module: Model4916_cMeasurementLoop_bench.cpp
+
+Function:
+    The kernels timed by the "bench" command and by hostbench.
+
+Copyright:
+    See accompanying LICENSE file for copyright and license information.
+
+Author:
+    Dhinesh Kumar Pitchai, MCCI Corporation   November 2022
+
+*/
+
+#include "Model4916_cMeasurementLoop.h"
+
+#include <cstring>
+
+using namespace McciModel4916;
+using namespace McciCatena;
+
+/****************************************************************************\
+|
+|   Manifest constants & typedefs.
+|
+\****************************************************************************/
+
+namespace {
+
+// inputs go round this many values, so nothing is hoisted out of the
+// loop; a power of two.
+constexpr unsigned kInputs = 16;
+
+// counts what's printed to it, and keeps nothing.
+class cNullPrint : public Print
+    {
+public:
+    virtual size_t write(uint8_t c) override
+        {
+        ++this->m_n;
+        return 1;
+        }
+
+    virtual size_t write(const uint8_t *p, size_t n) override
+        {
+        this->m_n += n;
+        return n;
+        }
+    using Print::write;
+
+    std::uint32_t                   m_n = 0;
+    };
+
+} // namespace
+
+/*
+
+Name:   cMeasurementLoop::runBench()
+
+Function:
+    Time the encoding, conversion and formatting kernels.
+
+Definition:
+    void cMeasurementLoop::runBench(
+            cBench &bench
+            );
+
+Description:
+    Each kernel is timed by bench on made-up inputs with every field
+    present:
+
+    tx.fillTxBuffer     the port 1 uplink, from a measurement
+    tx.f2uflt16         TxBufferBase_t::f2uflt16()
+    tx.putV, tx.putT    a voltage, a temperature
+    gas.concentration   the four get*Concentration() calibrations
+    fmt.getDecimal      getDecimal()
+    sd.fillSdRecord     a log record, from a measurement and its uplink
+    sd.csvRow           the record as a CSV row (printSdRecordCsv())
+
+    Nothing is sent or written to the card. fillTxBuffer() logs at
+    info level in the sensors category, so that should be at warning
+    or above.
+
+Returns:
+    No explicit result.
+
+*/
+
+void
+cMeasurementLoop::runBench(
+    cBench &bench
+    )
+    {
+    struct Context_t
+        {
+        cMeasurementLoop *pThis;
+        Measurement m;
+        TxBuffer_t b;
+        SdLogFormat::Record_t record;
+        float input[kInputs];
+        cNullPrint out;
+        };
+    static const std::uint8_t kDevEUI[8] = { 0x00, 0x02, 0xcc, 0x01, 0x00, 0x00, 0x49, 0x16 };
+    Context_t c;
+
+    c.pThis = this;
+    std::memset(&c.m, 0, sizeof(c.m));
+    c.m.flags = Flags::Vbat | Flags::Boot | Flags::TH | Flags::GPS | Flags::PM |
+                Flags::CO2 | Flags::CO | Flags::NO2 | Flags::O3 | Flags::SO2;
+    c.m.Vbat = 3.912f;
+    c.m.Vbus = 0.04f;
+    c.m.BootCount = 17;
+    c.m.env.TempC = 21.37f;
+    c.m.env.Humidity = 43.2f;
+    c.m.co2ppm.CO2ppm = 612.5f;
+    for (unsigned i = 0; i < 7; ++i)
+        {
+        c.m.particle.Mass[i] = 1.5f * (i + 1);
+        c.m.particle.Count[i] = 9000 >> i;
+        }
+    c.m.gases.CO = 0.42f;
+    c.m.gases.NO2 = 0.021f;
+    c.m.gases.O3 = 0.034f;
+    c.m.gases.SO2 = 0.003f;
+    c.m.position.Latitude = 42.4434f;
+    c.m.position.Longitude = -76.5019f;
+    c.m.position.UnixTime = 1667260800;
+
+    this->fillTxBuffer(c.b, c.m);
+    this->fillSdRecord(c.record, c.b, c.m);
+
+    // gas cell voltages from 1.4 to 1.9 V, around the 1.65 V zero point;
+    // less 1.4 V, they're in [0, 0.5) for uflt16.
+    for (unsigned i = 0; i < kInputs; ++i)
+        c.input[i] = 1.4f + 0.5f * i / kInputs;
+
+    bench.begin();
+
+    bench.run(
+        "tx.fillTxBuffer",
+        [](void *pContext, std::uint32_t nOps)
+            {
+            auto &c = *static_cast<Context_t *>(pContext);
+
+            for (std::uint32_t i = 0; i < nOps; ++i)
+                {
+                c.m.BootCount = i;
+                c.pThis->fillTxBuffer(c.b, c.m);
+                cBench::sink(std::uint32_t(c.b.getn()));
+                }
+            },
+        &c
+        );
+
+    bench.run(
+        "tx.f2uflt16",
+        [](void *pContext, std::uint32_t nOps)
+            {
+            auto &c = *static_cast<Context_t *>(pContext);
+
+            for (std::uint32_t i = 0; i < nOps; ++i)
+                cBench::sink(std::uint32_t(TxBufferBase_t::f2uflt16(c.input[i % kInputs] - 1.4f)));
+            },
+        &c
+        );
+
+    bench.run(
+        "tx.putV",
+        [](void *pContext, std::uint32_t nOps)
+            {
+            auto &c = *static_cast<Context_t *>(pContext);
+
+            for (std::uint32_t i = 0; i < nOps; ++i)
+                {
+                c.b.begin();
+                c.b.putV(2.0f * c.input[i % kInputs]);
+                cBench::sink(std::uint32_t(c.b.getbase()[0]));
+                }
+            },
+        &c
+        );
+
+    bench.run(
+        "tx.putT",
+        [](void *pContext, std::uint32_t nOps)
+            {
+            auto &c = *static_cast<Context_t *>(pContext);
+
+            for (std::uint32_t i = 0; i < nOps; ++i)
+                {
+                c.b.begin();
+                c.b.putT(15.0f * c.input[i % kInputs]);
+                cBench::sink(std::uint32_t(c.b.getbase()[0]));
+                }
+            },
+        &c
+        );
+
+    bench.run(
+        "gas.concentration",
+        [](void *pContext, std::uint32_t nOps)
+            {
+            auto &c = *static_cast<Context_t *>(pContext);
+            auto const pThis = c.pThis;
+
+            for (std::uint32_t i = 0; i < nOps; ++i)
+                {
+                float const v = c.input[i % kInputs];
+
+                cBench::sink(
+                    pThis->getCOConcentration(v) +
+                    pThis->getNO2Concentration(v) +
+                    pThis->getO3Concentration(v) +
+                    pThis->getSO2Concentration(v)
+                    );
+                }
+            },
+        &c
+        );
+
+    bench.run(
+        "fmt.getDecimal",
+        [](void *pContext, std::uint32_t nOps)
+            {
+            auto &c = *static_cast<Context_t *>(pContext);
+
+            for (std::uint32_t i = 0; i < nOps; ++i)
+                cBench::sink(c.pThis->getDecimal(100.0f * c.input[i % kInputs]));
+            },
+        &c
+        );
+
+    bench.run(
+        "sd.fillSdRecord",
+        [](void *pContext, std::uint32_t nOps)
+            {
+            auto &c = *static_cast<Context_t *>(pContext);
+
+            for (std::uint32_t i = 0; i < nOps; ++i)
+                {
+                c.m.BootCount = i;
+                c.pThis->fillSdRecord(c.record, c.b, c.m);
+                cBench::sink(c.record.bootCount);
+                }
+            },
+        &c
+        );
+
+    bench.run(
+        "sd.csvRow",
+        [](void *pContext, std::uint32_t nOps)
+            {
+            auto &c = *static_cast<Context_t *>(pContext);
+
+            for (std::uint32_t i = 0; i < nOps; ++i)
+                {
+                c.record.bootCount = i;
+                printSdRecordCsv(c.out, kDevEUI, c.record);
+                }
+            cBench::sink(c.out.m_n);
+            },
+        &c
+        );
+    }
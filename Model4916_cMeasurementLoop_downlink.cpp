@@ -0,0 +1,515 @@
+/*
+
+Module: Model4916_cMeasurementLoop_downlink.cpp
+
+Function:
+    Remote configuration of cMeasurementLoop by downlink.
+
+Copyright:
+    See accompanying LICENSE file for copyright and license information.
+
+Author:
+    Dhinesh Kumar Pitchai, MCCI Corporation   November 2022
+
+*/
+
+#include "Model4916_cMeasurementLoop.h"
+
+#include "Model4916_cLogCategory.h"
+#include "Model4916_crc.h"
+#include "Model4916_FramLayout.h"
+
+#include <Catena_Fram.h>
+
+#include <cmath>
+
+using namespace McciModel4916;
+using namespace McciCatena;
+
+/****************************************************************************\
+|
+|   Manifest constants & typedefs.
+|
+\****************************************************************************/
+
+namespace {
+
+// command opcodes; see extra/catena-message-port-2-command-format.md
+enum Opcode : std::uint8_t
+    {
+    kOpTxCycle          = 0x01, // uint16 secs
+    kOpFastCycle        = 0x02, // uint16 secs, uint8 count
+    kOpSensorMask       = 0x03, // uint8 mask
+    kOpCalibration      = 0x04, // uint8 channel, float32 factor
+    kOpGasZero          = 0x05, // float32 volts
+    kOpThreshold        = 0x06, // uint8 channel, float32 ppm
+    kOpDefaults         = 0x07, // none
+    kOpSdStats          = 0x08, // none
+    };
+
+// acknowledgement status codes
+enum AckStatus : std::uint8_t
+    {
+    kAckOk              = 0,
+    kAckBadLength       = 1,
+    kAckBadOpcode       = 2,
+    kAckBadValue        = 3,
+    kAckSaveFailed      = 4,
+    };
+
+constexpr std::uint32_t kMinTxCycleSec = 10;
+constexpr std::uint32_t kMaxTxCycleSec = 24 * 60 * 60;
+
+std::uint16_t getU16(const std::uint8_t *p)
+    {
+    return std::uint16_t((p[0] << 8) | p[1]);
+    }
+
+void putU16(std::uint8_t *p, std::uint32_t v)
+    {
+    // saturate rather than wrap.
+    if (v > 0xFFFF)
+        v = 0xFFFF;
+    p[0] = std::uint8_t(v >> 8);
+    p[1] = std::uint8_t(v);
+    }
+
+float getF32(const std::uint8_t *p)
+    {
+    std::uint32_t const u = (std::uint32_t(p[0]) << 24) |
+                            (std::uint32_t(p[1]) << 16) |
+                            (std::uint32_t(p[2]) << 8) |
+                             std::uint32_t(p[3]);
+    float f;
+
+    memcpy(&f, &u, sizeof(f));
+    return f;
+    }
+
+} // namespace
+
+/****************************************************************************\
+|
+|   The persistent configuration
+|
+\****************************************************************************/
+
+void cMeasurementLoop::setDefaultConfig()
+    {
+    auto &c = this->m_config;
+
+    memset(&c, 0, sizeof(c));
+    c.magic = kConfigMagic;
+    c.size = sizeof(c);
+    c.sensorMask = kSensorAll;
+    c.txCycleSec_Permanent = kDefaultTxCycleSec_Permanent;
+    c.txCycleSec_Fast = kDefaultTxCycleSec_Fast;
+    c.txCycleCount_Fast = kDefaultTxCycleCount_Fast;
+    c.vGasZero = kDefaultVGasZero;
+    c.calibrationFactor[kGasCO] = kDefaultCalibrationFactorCO;
+    c.calibrationFactor[kGasNO2] = kDefaultCalibrationFactorNO2;
+    c.calibrationFactor[kGasO3] = kDefaultCalibrationFactorO3;
+    c.calibrationFactor[kGasSO2] = kDefaultCalibrationFactorSO2;
+    }
+
+void cMeasurementLoop::loadConfig()
+    {
+    static_assert(sizeof(AppConfig_t) <= FramLayout::kAppConfigSize, "AppConfig_t too large");
+
+    auto const pFram = gCatena.getFram();
+    AppConfig_t c;
+
+    if (pFram != nullptr &&
+        pFram->read(FramLayout::kAppConfig, (std::uint8_t *)&c, sizeof(c)) &&
+        c.magic == kConfigMagic &&
+        c.size == sizeof(c) &&
+        c.crc == crc16_ccitt(&c, offsetof(AppConfig_t, crc)))
+        {
+        this->m_config = c;
+        gCatena.SafePrintf(
+            "Config: tx cycle %u secs, sensors %#x (from FRAM)\n",
+            unsigned(c.txCycleSec_Permanent),
+            c.sensorMask
+            );
+        }
+    else
+        {
+        this->setDefaultConfig();
+        }
+
+    this->applyConfig();
+    }
+
+bool cMeasurementLoop::saveConfig()
+    {
+    auto const pFram = gCatena.getFram();
+
+    this->m_config.crc = crc16_ccitt(&this->m_config, offsetof(AppConfig_t, crc));
+
+    if (pFram == nullptr)
+        return false;
+
+    return pFram->write(
+                FramLayout::kAppConfig,
+                (const std::uint8_t *)&this->m_config,
+                sizeof(this->m_config)
+                );
+    }
+
+// copy the settings that live in their own members.
+void cMeasurementLoop::applyConfig()
+    {
+    auto const &c = this->m_config;
+
+    this->m_txCycleSec_Permanent = c.txCycleSec_Permanent;
+    this->m_vGasZero = c.vGasZero;
+    this->m_calibrationFactorCO = c.calibrationFactor[kGasCO];
+    this->m_calibrationFactorNO2 = c.calibrationFactor[kGasNO2];
+    this->m_calibrationFactorO3 = c.calibrationFactor[kGasO3];
+    this->m_calibrationFactorSO2 = c.calibrationFactor[kGasSO2];
+    }
+
+/*
+
+Name:   cMeasurementLoop::processDownlink()
+
+Function:
+    Handle a downlink message.
+
+Definition:
+    void cMeasurementLoop::processDownlink(
+        std::uint8_t port,
+        const std::uint8_t *pMessage,
+        size_t nMessage
+        );
+
+Description:
+    Messages on MeasurementFormat::kCommandPort carry a sequence number
+    followed by zero or more commands (see
+    extra/catena-message-port-2-command-format.md). The whole message
+    is checked before anything is changed, so a bad command leaves the
+    configuration untouched. The result is saved in FRAM and an
+    acknowledgement is queued for the next uplink opportunity.
+
+    Messages on other ports are ignored.
+
+Returns:
+    No explicit result.
+
+*/
+
+void cMeasurementLoop::processDownlink(
+    std::uint8_t port,
+    const std::uint8_t *pMessage,
+    size_t nMessage
+    )
+    {
+    // any downlink, even one we ignore, shows the network hears us.
+    this->setLinkProven();
+
+    if (port != MeasurementFormat::kCommandPort)
+        {
+        if (port != 0)
+            gLogRadio.printf(gLogRadio.kTrace, "downlink: ignoring port %u, %u bytes\n", port, unsigned(nMessage));
+        return;
+        }
+
+    if (nMessage < 1)
+        return;
+
+    std::uint8_t const seq = pMessage[0];
+    std::uint8_t status;
+
+    status = this->parseCommands(pMessage + 1, nMessage - 1, false);
+    if (status == kAckOk)
+        {
+        this->parseCommands(pMessage + 1, nMessage - 1, true);
+        this->m_config.lastSeq = seq;
+        this->applyConfig();
+
+        if (! this->saveConfig())
+            status = kAckSaveFailed;
+        }
+
+    gLogRadio.printf(gLogRadio.kInfo, "downlink: command %u status %u\n", seq, status);
+
+    // report what we're running with now, so the sender can tell.
+    auto const crc = crc16_ccitt(&this->m_config, offsetof(AppConfig_t, crc));
+    this->m_AckBuffer[0] = MeasurementFormat::kAckFormat;
+    this->m_AckBuffer[1] = seq;
+    this->m_AckBuffer[2] = status;
+    this->m_AckBuffer[3] = std::uint8_t(crc >> 8);
+    this->m_AckBuffer[4] = std::uint8_t(crc);
+    this->m_fAckPending = true;
+    }
+
+// check (fApply false) or apply (fApply true) the commands in a message.
+std::uint8_t cMeasurementLoop::parseCommands(
+    const std::uint8_t *p,
+    size_t n,
+    bool fApply
+    )
+    {
+    auto &c = this->m_config;
+
+    while (n > 0)
+        {
+        std::uint8_t const op = *p++;
+        --n;
+
+        switch (op)
+            {
+        case kOpTxCycle:
+            {
+            if (n < 2)
+                return kAckBadLength;
+            std::uint32_t const secs = getU16(p);
+            if (secs < kMinTxCycleSec || secs > kMaxTxCycleSec)
+                return kAckBadValue;
+            if (fApply)
+                {
+                c.txCycleSec_Permanent = secs;
+                this->m_txCycleSec_Permanent = secs;
+                // if we're not in a fast cycle, take effect now.
+                if (this->m_txCycleCount == 0)
+                    this->setTxCycleTime(secs, 0);
+                }
+            p += 2; n -= 2;
+            break;
+            }
+
+        case kOpFastCycle:
+            {
+            if (n < 3)
+                return kAckBadLength;
+            std::uint32_t const secs = getU16(p);
+            std::uint32_t const count = p[2];
+            if (secs < kMinTxCycleSec || secs > kMaxTxCycleSec)
+                return kAckBadValue;
+            if (fApply)
+                {
+                c.txCycleSec_Fast = secs;
+                c.txCycleCount_Fast = count;
+                if (count != 0)
+                    this->setTxCycleTime(secs, count);
+                else if (this->m_txCycleCount != 0)
+                    {
+                    // a count of zero turns fast reporting off, now too.
+                    this->setTxCycleTime(this->m_txCycleSec_Permanent, 0);
+                    }
+                }
+            p += 3; n -= 3;
+            break;
+            }
+
+        case kOpSensorMask:
+            if (n < 1)
+                return kAckBadLength;
+            if ((p[0] & ~kSensorAll) != 0)
+                return kAckBadValue;
+            if (fApply)
+                c.sensorMask = p[0];
+            p += 1; n -= 1;
+            break;
+
+        case kOpCalibration:
+        case kOpThreshold:
+            {
+            if (n < 5)
+                return kAckBadLength;
+            std::uint8_t const channel = p[0];
+            float const v = getF32(p + 1);
+            if (channel >= kGasChannels || ! std::isfinite(v))
+                return kAckBadValue;
+            if (op == kOpCalibration && v == 0.0f)
+                return kAckBadValue;
+            if (op == kOpThreshold && v < 0.0f)
+                return kAckBadValue;
+            if (fApply)
+                {
+                if (op == kOpCalibration)
+                    c.calibrationFactor[channel] = v;
+                else
+                    c.threshold[channel] = v;
+                }
+            p += 5; n -= 5;
+            break;
+            }
+
+        case kOpGasZero:
+            {
+            if (n < 4)
+                return kAckBadLength;
+            float const v = getF32(p);
+            if (! std::isfinite(v) || v < 0.0f || v > 3.3f)
+                return kAckBadValue;
+            if (fApply)
+                c.vGasZero = v;
+            p += 4; n -= 4;
+            break;
+            }
+
+        case kOpDefaults:
+            if (fApply)
+                {
+                auto const lastSeq = c.lastSeq;
+                this->setDefaultConfig();
+                c.lastSeq = lastSeq;
+
+                // and leave any fast cycle for the default interval.
+                this->m_txCycleSec_Permanent = c.txCycleSec_Permanent;
+                this->setTxCycleTime(c.txCycleSec_Permanent, 0);
+                }
+            break;
+
+        case kOpSdStats:
+            // not a setting: just ask for the report.
+            if (fApply)
+                this->m_fSdStatsPending = true;
+            break;
+
+        default:
+            return kAckBadOpcode;
+            }
+        }
+
+    return kAckOk;
+    }
+
+/****************************************************************************\
+|
+|   Reporting thresholds and acknowledgements
+|
+\****************************************************************************/
+
+// if any gas is over its threshold, switch to the fast uplink cycle.
+void cMeasurementLoop::checkThresholds(Measurement const &mData)
+    {
+    static const Flags kGasFlags[kGasChannels] = { Flags::CO, Flags::NO2, Flags::O3, Flags::SO2 };
+    float const values[kGasChannels] = { mData.gases.CO, mData.gases.NO2, mData.gases.O3, mData.gases.SO2 };
+
+    // already reporting fast?
+    if (this->m_txCycleCount != 0 || this->m_config.txCycleCount_Fast == 0)
+        return;
+
+    for (unsigned i = 0; i < kGasChannels; ++i)
+        {
+        auto const threshold = this->m_config.threshold[i];
+
+        if (threshold > 0.0f &&
+            (mData.flags & kGasFlags[i]) != Flags(0) &&
+            values[i] > threshold)
+            {
+            gLogSensors.printf(gLogSensors.kInfo, "gas channel %u over threshold: fast uplinks\n", i);
+            this->setTxCycleTime(
+                this->m_config.txCycleSec_Fast,
+                this->m_config.txCycleCount_Fast
+                );
+            return;
+            }
+        }
+    }
+
+// send the pending acknowledgement, if any. Returns true if an uplink
+// was launched.
+bool cMeasurementLoop::startAckTransmission()
+    {
+    if (! this->m_fAckPending ||
+        this->m_UplinkTimer.getRemaining() < kBacklogGuardMs ||
+        ! gLoRaWAN.IsProvisioned())
+        return false;
+
+    auto sendBufferDoneCb =
+        [](void *pClientData, bool fSuccess)
+            {
+            auto const pThis = (cMeasurementLoop *)pClientData;
+            pThis->sendBufferDone(fSuccess);
+            };
+
+    this->m_txKind = UplinkKind::kAck;
+    this->m_fTxConfirmed = false;
+    this->m_txpending = true;
+    this->m_txcomplete = this->m_txerr = false;
+
+    if (! gLoRaWAN.SendBuffer(
+                this->m_AckBuffer, sizeof(this->m_AckBuffer),
+                sendBufferDoneCb, (void *)this,
+                false, MeasurementFormat::kCommandPort
+                ))
+        {
+        this->sendBufferDone(false);
+        return false;
+        }
+
+    return true;
+    }
+
+/****************************************************************************\
+|
+|   SD card statistics report
+|
+\****************************************************************************/
+
+// fill m_SdStatsBuffer; see extra/catena-message-port-2-command-format.md
+size_t cMeasurementLoop::fillSdStatsBuffer()
+    {
+    std::uint8_t *p = this->m_SdStatsBuffer;
+
+    *p++ = MeasurementFormat::kSdStatsFormat;
+    *p++ = this->m_fSdCardUp ? 1 : 0;
+    putU16(p, this->m_SdLogger.getLost());
+    p += 2;
+
+    for (unsigned iPhase = 0; iPhase < cSdStats::kPhases; ++iPhase)
+        {
+        auto const &s = gSdStats.get(cSdStats::Phase(iPhase));
+
+        putU16(p, s.nOps);
+        p[2] = std::uint8_t(s.nFail > 0xFF ? 0xFF : s.nFail);
+        // times in units of 100 us
+        putU16(p + 3, (s.getMeanUs() + 50) / 100);
+        putU16(p + 5, (s.maxUs + 50) / 100);
+        p += 7;
+        }
+
+    return p - this->m_SdStatsBuffer;
+    }
+
+// send the SD card statistics, if requested. Returns true if an uplink
+// was launched.
+bool cMeasurementLoop::startSdStatsTransmission()
+    {
+    if (! this->m_fSdStatsPending ||
+        this->m_UplinkTimer.getRemaining() < kBacklogGuardMs ||
+        ! gLoRaWAN.IsProvisioned())
+        return false;
+
+    // wait for a data rate that can carry it.
+    size_t const nBuffer = this->fillSdStatsBuffer();
+    if (nBuffer > this->getMaxUplinkBytes())
+        return false;
+
+    auto sendBufferDoneCb =
+        [](void *pClientData, bool fSuccess)
+            {
+            auto const pThis = (cMeasurementLoop *)pClientData;
+            pThis->sendBufferDone(fSuccess);
+            };
+
+    this->m_txKind = UplinkKind::kSdStats;
+    this->m_fTxConfirmed = false;
+    this->m_txpending = true;
+    this->m_txcomplete = this->m_txerr = false;
+
+    if (! gLoRaWAN.SendBuffer(
+                this->m_SdStatsBuffer, nBuffer,
+                sendBufferDoneCb, (void *)this,
+                false, MeasurementFormat::kCommandPort
+                ))
+        {
+        this->sendBufferDone(false);
+        return false;
+        }
+
+    return true;
+    }
@@ -1,6 +1,6 @@
 /*
 
-Module: Model4916_cMeasurementLoop_fillBuffer.cpp
+Module: Model4916_cMeasurementLoop_fillTxBuffer.cpp
 
 Function:
     Class for transmitting accumulated measurements.
@@ -17,11 +17,39 @@ Author:
 
 #include "Model4916_cMeasurementLoop.h"
 
+#include "Model4916_cLogCategory.h"
+
 #include <arduino_lmic.h>
 
+#include <cmath>
+
 using namespace McciCatena;
 using namespace McciModel4916;
 
+namespace {
+
+// bytes in a port 1 message with the given fields.
+size_t getMessageSize(cMeasurementLoop::Flags flags)
+    {
+    using Flags = cMeasurementLoop::Flags;
+    static const struct { Flags flag; std::uint8_t nBytes; } kFields[] =
+        {
+        { Flags::Vbat, 2 }, { Flags::Boot, 1 }, { Flags::TH, 4 },
+        { Flags::GPS, 12 }, { Flags::PM, 14 }, { Flags::CO2, 2 },
+        { Flags::CO, 2 }, { Flags::NO2, 2 },
+        };
+    size_t n = 2;
+
+    for (auto const &field : kFields)
+        {
+        if ((flags & field.flag) != Flags(0))
+            n += field.nBytes;
+        }
+    return n;
+    }
+
+} // namespace
+
 /*
 
 Name:   McciModel4916::cMeasurementLoop::fillTxBuffer()
@@ -35,8 +63,9 @@ Definition:
             );
 
 Description:
-    A format 0x28 message is prepared from the data in the cMeasurementLoop
-    object.
+    A format 0x27 message is prepared from the data in the cMeasurementLoop
+    object. Each field whose bit is set in the flags byte follows, in the
+    order of the bits; see extra/catena-message-0x27-port-1-format.md.
 
 */
 
@@ -54,60 +83,74 @@ cMeasurementLoop::fillTxBuffer(
     // insert format byte
     b.put(kMessageFormat);
 
-    // the flags in Measurement correspond to the over-the-air flags.
-    b.put(std::uint8_t(this->m_data.flags));
-    gCatena.SafePrintf("Flag:    %2x\n", std::uint8_t(this->m_data.flags));
+    // the flags in Measurement correspond to the over-the-air flags, up
+    // to NO2. If the message wouldn't fit at the current data rate, the
+    // largest optional fields are left out, and their flags cleared.
+    static const Flags kDropOrder[] = { Flags::GPS, Flags::PM, Flags::NO2, Flags::CO };
+    Flags flags = Flags(std::uint8_t(mData.flags));
+    for (auto const drop : kDropOrder)
+        {
+        if (getMessageSize(flags) <= this->getMaxUplinkBytes())
+            break;
+        flags = Flags(std::uint16_t(flags) & ~std::uint16_t(drop));
+        }
+
+    b.put(std::uint8_t(flags));
+    gLogSensors.printf(gLogSensors.kInfo, "Flag:    %2x\n", std::uint8_t(flags));
 
     // send Vbat
-    if ((this->m_data.flags &  Flags::Vbat) !=  Flags(0))
+    if ((flags & Flags::Vbat) !=  Flags(0))
         {
         float Vbat = mData.Vbat;
-        gCatena.SafePrintf("Vbat:    %d mV\n", (int) (Vbat * 1000.0f));
+        gLogSensors.printf(gLogSensors.kInfo, "Vbat:    %d mV\n", (int) (Vbat * 1000.0f));
         b.putV(Vbat);
         }
 
     // print Vbus data
     float Vbus = mData.Vbus;
-    gCatena.SafePrintf("Vbus:    %d mV\n", (int) (Vbus * 1000.0f));
+    gLogSensors.printf(gLogSensors.kInfo, "Vbus:    %d mV\n", (int) (Vbus * 1000.0f));
 
     // send boot count
-    if ((this->m_data.flags &  Flags::Boot) !=  Flags(0))
+    if ((flags & Flags::Boot) !=  Flags(0))
         {
-        b.putBootCountLsb(this->m_data.BootCount);
+        b.putBootCountLsb(mData.BootCount);
         }
 
-    if ((mData.flags & Flags::TH) != Flags(0))
+    if ((flags & Flags::TH) != Flags(0))
         {
-        if (this->m_fSht3x)
-            {
-            gCatena.SafePrintf(
-                    "SHT3x      :  T: %d RH: %d\n",
-                    (int) mData.env.TempC,
-                    (int) mData.env.Humidity
-                    );
-            b.putT(mData.env.TempC);
-            // no method for 2-byte RH, directly encode it.
-            b.put2uf((mData.env.Humidity / 100.0f) * 65535.0f);
-            }
+        gLogSensors.printf(
+                gLogSensors.kInfo,
+                "SHT3x      :  T: %d RH: %d\n",
+                (int) mData.env.TempC,
+                (int) mData.env.Humidity
+                );
+        b.putT(mData.env.TempC);
+        // no method for 2-byte RH, directly encode it.
+        b.put2uf((mData.env.Humidity / 100.0f) * 65535.0f);
         }
 
-    // put co2ppm
-    if ((mData.flags & Flags::CO2) != Flags(0))
+    // put time and position
+    if ((flags & Flags::GPS) != Flags(0))
         {
-        gCatena.SafePrintf(
-            "SCD30      :  T(C): %c%d.%02d  RH(%%): %d.%02d  CO2(ppm): %d.%02d\n",
-            this->ts, this->tint, this->tfrac,
-            this->rhint, this->rhfrac,
-            this->co2int, this->co2frac
+        gLogSensors.printf(
+            gLogSensors.kInfo,
+            "SAM-M8Q GPS  :  Latitude(deg): %d.%02d  Longitude(deg): %d.%02d  Unix Time: %d\n",
+            (int) mData.position.Latitude, this->getDecimal(mData.position.Latitude),
+            (int) mData.position.Longitude, this->getDecimal(mData.position.Longitude),
+            (int) mData.position.UnixTime
             );
 
-        b.put2u(TxBufferBase_t::f2uflt16(mData.co2ppm.CO2ppm / 40000.0f));
+        b.put4u(std::uint32_t(mData.position.UnixTime));
+        // degrees * 10^7, as the GNSS receiver reports them.
+        b.put4(std::int32_t(std::lrint(double(mData.position.Latitude) * 1e7)));
+        b.put4(std::int32_t(std::lrint(double(mData.position.Longitude) * 1e7)));
         }
 
-    // put pm and pc data
-    if ((mData.flags & Flags::PM) != Flags(0))
+    // put pm data; the counts are only logged.
+    if ((flags & Flags::PM) != Flags(0))
         {
-        gCatena.SafePrintf(
+        gLogSensors.printf(
+            gLogSensors.kInfo,
             "IPS7100    :  PM0.1: %d.%02d  PM0.3: %d.%02d  PM0.5: %d.%02d  PM1.0 %d.%02d  PM2.5 %d.%02d   PM5.0 %d.%02d   PM10 %d.%02d\n",
             (int) mData.particle.Mass[0], this->getDecimal(mData.particle.Mass[0]),
             (int) mData.particle.Mass[1], this->getDecimal(mData.particle.Mass[1]),
@@ -118,7 +161,8 @@ cMeasurementLoop::fillTxBuffer(
             (int) mData.particle.Mass[6], this->getDecimal(mData.particle.Mass[6])
             );
 
-        gCatena.SafePrintf(
+        gLogSensors.printf(
+            gLogSensors.kInfo,
             "IPS7100    :  PC0.1: %d  PC0.3: %d  PC0.5: %d  PC1.0 %d  PC2.5 %d  PC5.0 %d  PC10 %d\n",
             mData.particle.Count[0],
             mData.particle.Count[1],
@@ -128,29 +172,44 @@ cMeasurementLoop::fillTxBuffer(
             mData.particle.Count[5],
             mData.particle.Count[6]
             );
+
+        for (auto const mass : mData.particle.Mass)
+            b.put2u(TxBufferBase_t::f2uflt16(mass / 65536.0f));
+        }
+
+    // put co2ppm
+    if ((flags & Flags::CO2) != Flags(0))
+        {
+        gLogSensors.printf(
+            gLogSensors.kInfo,
+            "SCD30      :  T(C): %c%d.%02d  RH(%%): %d.%02d  CO2(ppm): %d.%02d\n",
+            this->ts, this->tint, this->tfrac,
+            this->rhint, this->rhfrac,
+            this->co2int, this->co2frac
+            );
+
+        b.put2u(TxBufferBase_t::f2uflt16(mData.co2ppm.CO2ppm / 40000.0f));
         }
 
-    // put co
     if ((mData.flags & (Flags::CO | Flags::NO2 | Flags::O3 | Flags::SO2)) != Flags(0))
         {
-        gCatena.SafePrintf(
-            "ADS131M04  :  CO: %d.%02d  NO2: %d.%02d  O3: %d.%02d  NO2: %d.%02d\n",
+        gLogSensors.printf(
+            gLogSensors.kInfo,
+            "ADS131M04  :  CO: %d.%02d  NO2: %d.%02d  O3: %d.%02d  SO2: %d.%02d\n",
             (int) mData.gases.CO, this->getDecimal(mData.gases.CO),
             (int) mData.gases.NO2, this->getDecimal(mData.gases.NO2),
             (int) mData.gases.O3, this->getDecimal(mData.gases.O3),
             (int) mData.gases.SO2, this->getDecimal(mData.gases.SO2)
             );
         }
-    gLed.Set(McciCatena::LedPattern::Off);
 
-    // put pm and pc data
-    if ((mData.flags & Flags::GPS) != Flags(0))
-        {
-        gCatena.SafePrintf(
-            "SAM-M8Q GPS  :  Latitude(deg): %d.%02d  Longitude(deg): %d.%02d  Unix Time: %d\n",
-            (int) mData.position.Latitude, this->getDecimal(mData.position.Latitude),
-            (int) mData.position.Longitude, this->getDecimal(mData.position.Longitude),
-            (int) mData.position.UnixTime
-            );
-        }
+    // put co and no2; O3 and SO2 have no bits in the flags byte, and
+    // are only logged.
+    if ((flags & Flags::CO) != Flags(0))
+        b.put2u(TxBufferBase_t::f2uflt16(mData.gases.CO / 1000.0f));
+
+    if ((flags & Flags::NO2) != Flags(0))
+        b.put2u(TxBufferBase_t::f2uflt16(mData.gases.NO2 / 4.0f));
+
+    gLed.Set(McciCatena::LedPattern::Off);
     }
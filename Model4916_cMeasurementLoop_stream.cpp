@@ -0,0 +1,266 @@
+/*
+
+Module: Model4916_cMeasurementLoop_stream.cpp
+
+Function:
+    Streaming samples to the console for calibration.
+
+Copyright:
+    See accompanying LICENSE file for copyright and license information.
+
+Author:
+    Dhinesh Kumar Pitchai, MCCI Corporation   November 2022
+
+*/
+
+#include "Model4916_cMeasurementLoop.h"
+
+#include "Model4916_cCsvRow.h"
+#include "Model4916_cStats.h"
+#include "Model4916_crc.h"
+
+#include <cstring>
+
+using namespace McciModel4916;
+using namespace McciCatena;
+
+/****************************************************************************\
+|
+|   Manifest constants & typedefs.
+|
+\****************************************************************************/
+
+namespace {
+
+// binary frames; see extra/catena-stream-format.md
+constexpr std::uint8_t kSync0 = 0xA5;
+constexpr std::uint8_t kSync1 = 0x5A;
+// sync, length, mask, seq, ms, 7 floats, crc
+constexpr size_t kMaxFrame = 2 + 1 + 1 + 4 + 4 + 7 * 4 + 2;
+
+cStatsCounter sStreamSamples("stream.samples");
+cStatsCounter sStreamDropped("stream.dropped");
+
+void putU32(std::uint8_t *p, std::uint32_t v)
+    {
+    p[0] = std::uint8_t(v);
+    p[1] = std::uint8_t(v >> 8);
+    p[2] = std::uint8_t(v >> 16);
+    p[3] = std::uint8_t(v >> 24);
+    }
+
+} // namespace
+
+/****************************************************************************\
+|
+|   Starting and stopping
+|
+\****************************************************************************/
+
+bool
+cMeasurementLoop::startStreaming(
+    std::uint8_t rateHz,
+    std::uint8_t channels,
+    bool fBinary
+    )
+    {
+    if (this->m_fStreaming ||
+        rateHz == 0 || rateHz > kStreamMaxRateHz ||
+        channels == 0 || (channels & ~kStreamChannels) != 0)
+        return false;
+
+    // the FSM has stopped; nothing would pick up the request.
+    if (this->m_fsm.getState() == State::stFinal)
+        return false;
+
+    this->m_streamPeriodMs = 1000 / rateHz;
+    this->m_streamChannels = channels;
+    this->m_fStreamBinary = fBinary;
+    this->m_fStreaming = true;
+    this->m_rqStreamStop = false;
+    this->m_rqStream = true;
+
+    // an uplink in flight is finished first.
+    this->m_fsm.eval();
+    return true;
+    }
+
+void
+cMeasurementLoop::stopStreaming()
+    {
+    if (! this->m_fStreaming)
+        return;
+
+    if (this->m_rqStream)
+        {
+        // never started.
+        this->m_rqStream = false;
+        this->m_fStreaming = false;
+        return;
+        }
+
+    this->m_rqStreamStop = true;
+    this->m_fsm.eval();
+    }
+
+void
+cMeasurementLoop::streamBegin()
+    {
+    this->m_rqStream = false;
+    this->m_streamSeq = 0;
+    this->m_streamSamples = 0;
+    this->m_streamDropped = 0;
+    this->m_streamNextMs = millis();
+
+    gCatena.SafePrintf(
+        "$H,%u,%02x,%s\n",
+        unsigned(1000 / this->m_streamPeriodMs),
+        this->m_streamChannels,
+        this->m_fStreamBinary ? "bin" : "csv"
+        );
+    }
+
+void
+cMeasurementLoop::streamEnd()
+    {
+    this->m_rqStreamStop = false;
+    this->m_fStreaming = false;
+
+    gCatena.SafePrintf(
+        "$E,%lu,%lu\n",
+        (unsigned long) this->m_streamSamples,
+        (unsigned long) this->m_streamDropped
+        );
+    }
+
+/****************************************************************************\
+|
+|   Taking a sample
+|
+\****************************************************************************/
+
+// Take the sample that's due, and send it if the console can take it
+// without waiting. Samples missed because we were late, or because the
+// console was full, are counted as dropped; their sequence numbers are
+// skipped, so the host sees the gap.
+void
+cMeasurementLoop::streamSample()
+    {
+    std::uint32_t const now = millis();
+    std::uint32_t const late = now - this->m_streamNextMs;
+
+    if (late >= this->m_streamPeriodMs)
+        {
+        std::uint32_t const nMissed = late / this->m_streamPeriodMs;
+
+        this->m_streamSeq += nMissed;
+        this->m_streamDropped += nMissed;
+        sStreamDropped.add(nMissed);
+        this->m_streamNextMs += nMissed * this->m_streamPeriodMs;
+        }
+    this->m_streamNextMs += this->m_streamPeriodMs;
+
+    auto const seq = this->m_streamSeq++;
+    auto const channels = this->m_streamChannels;
+    float values[7];
+    unsigned nValues = 0;
+
+    if (channels & kSensorGas)
+        {
+        // raw cell voltages: calibration is what the bench is for.
+        for (std::uint8_t channel = 0; channel < kGasChannels; ++channel)
+            values[nValues++] = this->m_fAds131m04 ? this->m_Ads.readVoltage(channel) : 0.0f;
+        }
+
+    if (channels & kSensorSht3x)
+        {
+        cSHT3x::Measurements m {};
+
+        if (! this->m_fSht3x || ! this->m_Sht.getTemperatureHumidity(m))
+            m.Temperature = m.Humidity = 0.0f;
+        values[nValues++] = m.Temperature;
+        values[nValues++] = m.Humidity;
+        }
+
+    if (channels & kSensorScd30)
+        {
+        // the SCD30 measures every two seconds at best; this repeats
+        // the latest.
+        values[nValues++] = this->m_fScd30 && this->m_measurement_valid
+                                ? this->m_Scd.getMeasurement().CO2ppm
+                                : 0.0f;
+        }
+
+    std::uint8_t frame[kMaxFrame];
+    char line[128];
+    const std::uint8_t *pOut;
+    size_t nOut;
+
+    if (this->m_fStreamBinary)
+        {
+        size_t n = 2;
+
+        frame[0] = kSync0;
+        frame[1] = kSync1;
+        frame[n++] = std::uint8_t(1 + 4 + 4 + 4 * nValues);
+        frame[n++] = channels;
+        putU32(frame + n, seq);
+        n += 4;
+        putU32(frame + n, now);
+        n += 4;
+        for (unsigned i = 0; i < nValues; ++i)
+            {
+            std::uint32_t v;
+
+            std::memcpy(&v, &values[i], sizeof(v));
+            putU32(frame + n, v);
+            n += 4;
+            }
+
+        auto const crc = crc16_ccitt(frame + 2, n - 2);
+        frame[n++] = std::uint8_t(crc);
+        frame[n++] = std::uint8_t(crc >> 8);
+
+        pOut = frame;
+        nOut = n;
+        }
+    else
+        {
+        cCsvRow row(line, sizeof(line), 4);
+        unsigned iValue = 0;
+
+        row.putString("$S,");
+        row.putUnsigned(seq);
+        row.putChar(',');
+        row.putUnsigned(now);
+
+        // a column per channel, empty if it isn't streamed.
+        static const std::uint8_t kColumns[7] =
+            {
+            kSensorGas, kSensorGas, kSensorGas, kSensorGas,
+            kSensorSht3x, kSensorSht3x, kSensorScd30,
+            };
+        for (auto column : kColumns)
+            {
+            row.putChar(',');
+            if (channels & column)
+                row.putFloat(values[iValue++]);
+            }
+        row.putChar('\n');
+
+        pOut = reinterpret_cast<const std::uint8_t *>(row.getBase());
+        nOut = row.getn();
+        }
+
+    // never wait for the host: a full console drops the sample.
+    if (Serial.availableForWrite() < int(nOut))
+        {
+        ++this->m_streamDropped;
+        ++sStreamDropped;
+        return;
+        }
+
+    Serial.write(pOut, nOut);
+    ++this->m_streamSamples;
+    ++sStreamSamples;
+    }
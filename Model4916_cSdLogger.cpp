@@ -0,0 +1,192 @@
+/*
+
+Module: Model4916_cSdLogger.cpp
+
+Function:
+    Buffered, sector-aligned SD log writer.
+
+Copyright:
+    See accompanying LICENSE file for copyright and license information.
+
+Author:
+    Dhinesh Kumar Pitchai, MCCI Corporation   November 2022
+
+*/
+
+#include "Model4916_cSdLogger.h"
+
+#include "Model4916_cSdStats.h"
+
+#include <SD.h>
+#include <cstring>
+
+using namespace McciModel4916;
+
+extern SDClass gSD;
+
+/****************************************************************************\
+|
+|   Staging
+|
+\****************************************************************************/
+
+bool
+cSdLogger::setFile(
+    const char *pName,
+    std::uint32_t offset,
+    bool fInPlace
+    )
+    {
+    bool fResult = true;
+
+    if (this->m_nBuffer != 0)
+        fResult = this->flush(true);
+
+    // a partial sector written in place is on the card; anything else
+    // left behind by a failed flush is lost.
+    if (! fResult)
+        this->m_nLost += this->m_nBuffer;
+    this->m_nBuffer = 0;
+
+    std::strncpy(this->m_fileName, pName, sizeof(this->m_fileName) - 1);
+    this->m_fileName[sizeof(this->m_fileName) - 1] = '\0';
+    this->m_offset = offset;
+    this->m_fInPlace = fInPlace;
+    return fResult;
+    }
+
+bool
+cSdLogger::seek(
+    std::uint32_t offset
+    )
+    {
+    if (this->m_nBuffer != 0 || ! this->m_fInPlace)
+        return false;
+
+    this->m_offset = offset;
+    return true;
+    }
+
+size_t
+cSdLogger::write(
+    std::uint8_t c
+    )
+    {
+    return this->write(&c, 1);
+    }
+
+size_t
+cSdLogger::write(
+    const std::uint8_t *pBuffer,
+    size_t nBuffer
+    )
+    {
+    size_t nWritten = 0;
+
+    while (nBuffer > 0)
+        {
+        if (this->m_nBuffer == sizeof(this->m_buffer))
+            {
+            // full: push out whole sectors to make room. If the card
+            // won't take them, drop them rather than stall logging.
+            if (! this->flush(false))
+                {
+                this->m_nLost += this->m_nBuffer;
+                this->m_nBuffer = 0;
+                }
+            }
+
+        size_t n = sizeof(this->m_buffer) - this->m_nBuffer;
+        if (n > nBuffer)
+            n = nBuffer;
+
+        std::memcpy(this->m_buffer + this->m_nBuffer, pBuffer, n);
+        this->m_nBuffer += n;
+        pBuffer += n;
+        nBuffer -= n;
+        nWritten += n;
+        }
+
+    return nWritten;
+    }
+
+/****************************************************************************\
+|
+|   Writing to the card
+|
+\****************************************************************************/
+
+bool
+cSdLogger::flush(
+    bool fAll
+    )
+    {
+    size_t const nWhole = this->m_nBuffer - this->m_nBuffer % kSectorSize;
+    size_t nBytes = nWhole;
+    size_t nConsume = nWhole;
+
+    if (fAll)
+        {
+        nBytes = this->m_nBuffer;
+
+        // appending, the tail can go; in place, it has to be written
+        // again when its sector is complete.
+        if (! this->m_fInPlace)
+            nConsume = this->m_nBuffer;
+        }
+
+    this->m_nRecords = 0;
+    if (nBytes == 0)
+        return true;
+
+    return this->writeOut(nBytes, nConsume);
+    }
+
+bool
+cSdLogger::writeOut(
+    size_t nBytes,
+    size_t nConsume
+    )
+    {
+    if (this->m_fileName[0] == '\0')
+        return false;
+
+    bool const fInPlace = this->m_fInPlace;
+    std::uint32_t tStart = micros();
+    File dataFile = gSD.open(this->m_fileName, fInPlace ? O_READ | O_WRITE : FILE_WRITE);
+    gSdStats.done(cSdStats::Phase::kOpen, tStart, bool(dataFile));
+    if (! dataFile)
+        return false;
+
+    size_t nWritten = 0;
+    if (! fInPlace || dataFile.seek(this->m_offset))
+        {
+        tStart = micros();
+        nWritten = dataFile.write(this->m_buffer, nBytes);
+        gSdStats.done(cSdStats::Phase::kWrite, tStart, nWritten == nBytes);
+        }
+
+    tStart = micros();
+    dataFile.close();
+    gSdStats.done(cSdStats::Phase::kClose, tStart, true);
+
+    if (nWritten != nBytes)
+        return false;
+
+    // keep the tail for next time.
+    this->m_offset += nConsume;
+    this->m_nBuffer -= nConsume;
+    std::memmove(this->m_buffer, this->m_buffer + nConsume, this->m_nBuffer);
+    return true;
+    }
+
+void
+cSdLogger::discard()
+    {
+    this->m_nLost += this->m_nBuffer;
+    this->m_nBuffer = 0;
+    this->m_nRecords = 0;
+    this->m_fileName[0] = '\0';
+    this->m_offset = 0;
+    this->m_fInPlace = false;
+    }
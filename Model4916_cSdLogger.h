@@ -0,0 +1,130 @@
+/*
+
+Module: Model4916_cSdLogger.h
+
+Function:
+    cSdLogger: stages SD log records in RAM and writes whole sectors.
+
+Copyright:
+    See accompanying LICENSE file for copyright and license information.
+
+Author:
+    Dhinesh Kumar Pitchai, MCCI Corporation   November 2022
+
+*/
+
+#ifndef _Model4916_cSdLogger_h_
+# define _Model4916_cSdLogger_h_
+
+#pragma once
+
+#include <Arduino.h>
+#include <cstddef>
+#include <cstdint>
+
+namespace McciModel4916 {
+
+/****************************************************************************\
+|
+|   Buffered SD log writer
+|
+\****************************************************************************/
+
+// Records are printed into a RAM buffer. When the buffer fills, the data
+// is written to the current file in whole 512-byte sectors, so each flush
+// costs one open/write/close instead of one per record. The caller must
+// have the card up whenever data may be written (any write() or flush()).
+//
+// A file is either appended to, or written in place at a given offset
+// inside space that was allocated beforehand. In place, nothing about
+// the file's size or clusters changes, so the FAT and directory are
+// never written; a partial last sector is written but kept in RAM, and
+// is written again once it fills, so the file stays sector aligned.
+// Appending, flush(true) and close() (before every deep sleep) write the
+// partial tail and drop it, so later appends start wherever it ended.
+class cSdLogger : public Print
+    {
+public:
+    static constexpr size_t kSectorSize = 512;
+    static constexpr size_t kBufferSize = 2 * kSectorSize;
+    static constexpr size_t kMaxFileName = 32;
+
+    cSdLogger() {}
+
+    // neither copyable nor movable
+    cSdLogger(const cSdLogger&) = delete;
+    cSdLogger& operator=(const cSdLogger&) = delete;
+    cSdLogger(const cSdLogger&&) = delete;
+    cSdLogger& operator=(const cSdLogger&&) = delete;
+
+    // select the file that following records go to, and the file offset
+    // they start at (the file size, when appending). Anything staged for
+    // the previous file is written first; returns false if that failed.
+    bool setFile(const char *pName, std::uint32_t offset, bool fInPlace);
+    // move the in-place write position; only while nothing is staged.
+    bool seek(std::uint32_t offset);
+    // file offset of the next byte written.
+    std::uint32_t getPosition() const
+        {
+        return this->m_offset + this->m_nBuffer;
+        }
+    const char *getFile() const
+        {
+        return this->m_fileName;
+        }
+
+    // Print interface: stage bytes.
+    virtual size_t write(std::uint8_t c) override;
+    virtual size_t write(const std::uint8_t *pBuffer, size_t nBuffer) override;
+    using Print::write;
+
+    // mark the end of a record.
+    void endRecord()
+        {
+        ++this->m_nRecords;
+        }
+
+    // write staged data: only whole sectors, unless fAll.
+    bool flush(bool fAll);
+
+    // write out everything staged and forget the current file.
+    bool close()
+        {
+        return this->setFile("", 0, false);
+        }
+
+    // forget staged data and the current file (e.g. card removed).
+    void discard();
+
+    size_t getPending() const
+        {
+        return this->m_nBuffer;
+        }
+    // records since the last flush.
+    unsigned getRecords() const
+        {
+        return this->m_nRecords;
+        }
+    // bytes thrown away because the card couldn't take them.
+    std::uint32_t getLost() const
+        {
+        return this->m_nLost;
+        }
+
+private:
+    bool writeOut(size_t nBytes, size_t nConsume);
+
+    std::uint8_t                    m_buffer[kBufferSize];
+    size_t                          m_nBuffer = 0;
+    unsigned                        m_nRecords = 0;
+    std::uint32_t                   m_nLost = 0;
+    // file offset of m_buffer[0]
+    std::uint32_t                   m_offset = 0;
+    // set true if writing in place rather than appending
+    bool                            m_fInPlace = false;
+    char                            m_fileName[kMaxFileName] {};
+    };
+
+} // namespace McciModel4916
+
+#endif /* _Model4916_cSdLogger_h_ */
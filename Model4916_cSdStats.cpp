@@ -0,0 +1,123 @@
+/*
+
+Module: Model4916_cSdStats.cpp
+
+Function:
+    Timing statistics for SD card operations.
+
+Copyright:
+    See accompanying LICENSE file for copyright and license information.
+
+Author:
+    Dhinesh Kumar Pitchai, MCCI Corporation   November 2022
+
+*/
+
+#include "Model4916_cSdStats.h"
+
+#include "Model4916_cStats.h"
+
+#include <cstring>
+
+using namespace McciModel4916;
+
+/****************************************************************************\
+|
+|   globals
+|
+\****************************************************************************/
+
+cSdStats gSdStats;
+
+namespace {
+
+// the card is on SPI2; its failures are the SPI errors we see.
+cStatsCounter sSpiErrors("spi.errors");
+
+} // namespace
+
+/****************************************************************************\
+|
+|   Read-only data
+|
+\****************************************************************************/
+
+namespace {
+
+// 1-3-10 steps from 100 us to 1 s; the last bucket is everything slower.
+const std::uint32_t kBucketLimitUs[cSdStats::kBuckets - 1] =
+    {
+    100, 300, 1000, 3000, 10000, 30000, 100000, 300000, 1000000,
+    };
+
+const char * const kPhaseNames[cSdStats::kPhases] =
+    {
+    "mount", "mkdir", "open", "write", "close", "end",
+    };
+} // namespace
+
+/****************************************************************************\
+|
+|   Code
+|
+\****************************************************************************/
+
+void
+cSdStats::reset()
+    {
+    std::memset(this->m_phase, 0, sizeof(this->m_phase));
+    for (auto &p : this->m_phase)
+        p.minUs = UINT32_MAX;
+    }
+
+void
+cSdStats::record(
+    Phase phase,
+    std::uint32_t us,
+    bool fOk
+    )
+    {
+    if (unsigned(phase) >= kPhases)
+        return;
+
+    auto &p = this->m_phase[unsigned(phase)];
+    unsigned iBucket = 0;
+
+    while (iBucket < kBuckets - 1 && us >= kBucketLimitUs[iBucket])
+        ++iBucket;
+
+    ++p.nOps;
+    if (! fOk)
+        {
+        ++p.nFail;
+        ++sSpiErrors;
+        }
+    if (us < p.minUs)
+        p.minUs = us;
+    if (us > p.maxUs)
+        p.maxUs = us;
+    p.totalUs += us;
+    ++p.hist[iBucket];
+    }
+
+const char *
+cSdStats::getPhaseName(
+    Phase phase
+    )
+    {
+    if (unsigned(phase) >= kPhases)
+        return "?";
+
+    return kPhaseNames[unsigned(phase)];
+    }
+
+std::uint32_t
+cSdStats::getBucketLimitUs(
+    unsigned iBucket
+    )
+    {
+    if (iBucket >= kBuckets - 1)
+        return UINT32_MAX;
+
+    return kBucketLimitUs[iBucket];
+    }
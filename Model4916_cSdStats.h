@@ -0,0 +1,110 @@
+/*
+
+Module: Model4916_cSdStats.h
+
+Function:
+    cSdStats: timing statistics for SD card operations.
+
+Copyright:
+    See accompanying LICENSE file for copyright and license information.
+
+Author:
+    Dhinesh Kumar Pitchai, MCCI Corporation   November 2022
+
+*/
+
+#ifndef _Model4916_cSdStats_h_
+# define _Model4916_cSdStats_h_
+
+#pragma once
+
+#include <Arduino.h>
+#include <cstddef>
+#include <cstdint>
+
+namespace McciModel4916 {
+
+/****************************************************************************\
+|
+|   SD operation statistics
+|
+\****************************************************************************/
+
+// Count, failures, min/mean/max time and a histogram of the time taken,
+// for each kind of SD card operation. The counters are in RAM, which is
+// kept through deep sleep, so they cover everything since boot (or the
+// last reset()). A card that is wearing out shows up as a growing tail
+// in the write and close histograms well before it starts failing.
+class cSdStats
+    {
+public:
+    enum class Phase : std::uint8_t
+        {
+        kMount,         // gSD.begin()
+        kMkdir,         // gSD.mkdir()
+        kOpen,          // gSD.open()
+        kWrite,         // File::write()
+        kClose,         // File::close(), which writes the directory entry
+        kEnd,           // gSD.end(), putting the card in idle
+        kCount          // number of phases
+        };
+    static constexpr unsigned kPhases = unsigned(Phase::kCount);
+
+    // histogram bucket i holds times below getBucketLimitUs(i); the last
+    // bucket holds the rest.
+    static constexpr unsigned kBuckets = 10;
+
+    struct PhaseStats_t
+        {
+        std::uint32_t               nOps;
+        std::uint32_t               nFail;
+        std::uint32_t               minUs;
+        std::uint32_t               maxUs;
+        std::uint64_t               totalUs;
+        std::uint32_t               hist[kBuckets];
+
+        std::uint32_t getMeanUs() const
+            {
+            return this->nOps == 0 ? 0 : std::uint32_t(this->totalUs / this->nOps);
+            }
+        };
+
+    cSdStats()
+        {
+        this->reset();
+        }
+
+    // neither copyable nor movable
+    cSdStats(const cSdStats&) = delete;
+    cSdStats& operator=(const cSdStats&) = delete;
+    cSdStats(const cSdStats&&) = delete;
+    cSdStats& operator=(const cSdStats&&) = delete;
+
+    void reset();
+
+    // count an operation that took us microseconds.
+    void record(Phase phase, std::uint32_t us, bool fOk);
+
+    // count an operation that started at micros() == tStart.
+    void done(Phase phase, std::uint32_t tStart, bool fOk)
+        {
+        this->record(phase, micros() - tStart, fOk);
+        }
+
+    const PhaseStats_t &get(Phase phase) const
+        {
+        return this->m_phase[unsigned(phase)];
+        }
+
+    static const char *getPhaseName(Phase phase);
+    static std::uint32_t getBucketLimitUs(unsigned iBucket);
+
+private:
+    PhaseStats_t                    m_phase[kPhases];
+    };
+
+} // namespace McciModel4916
+
+extern McciModel4916::cSdStats gSdStats;
+
+#endif /* _Model4916_cSdStats_h_ */
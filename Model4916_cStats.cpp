@@ -0,0 +1,60 @@
+/*
+
+Module: Model4916_cStats.cpp
+
+Function:
+    The registry of named counters and gauges.
+
+Copyright:
+    See accompanying LICENSE file for copyright and license information.
+
+Author:
+    Dhinesh Kumar Pitchai, MCCI Corporation   November 2022
+
+*/
+
+#include "Model4916_cStats.h"
+
+#include <cstring>
+
+using namespace McciModel4916;
+
+/****************************************************************************\
+|
+|   Variables
+|
+\****************************************************************************/
+
+// constant-initialized, so it's valid before any constructor runs.
+cStat *cStat::s_pHead = nullptr;
+
+/****************************************************************************\
+|
+|   Code
+|
+\****************************************************************************/
+
+// statistics are constructed at file scope, before setup(); insert in
+// name order so the listing is the same from build to build.
+cStat::cStat(
+    const char *pName,
+    Kind kind
+    )
+    : m_pName(pName)
+    , m_kind(kind)
+    {
+    cStat **ppLink = &s_pHead;
+
+    while (*ppLink != nullptr && std::strcmp((*ppLink)->m_pName, pName) < 0)
+        ppLink = &(*ppLink)->m_pNext;
+
+    this->m_pNext = *ppLink;
+    *ppLink = this;
+    }
+
+void
+cStat::resetAll()
+    {
+    for (auto p = s_pHead; p != nullptr; p = p->m_pNext)
+        p->reset();
+    }
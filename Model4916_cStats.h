@@ -0,0 +1,141 @@
+/*
+
+Module: Model4916_cStats.h
+
+Function:
+    cStat: named counters and gauges, shown by the "stats" command.
+
+Copyright:
+    See accompanying LICENSE file for copyright and license information.
+
+Author:
+    Dhinesh Kumar Pitchai, MCCI Corporation   November 2022
+
+*/
+
+#ifndef _Model4916_cStats_h_
+# define _Model4916_cStats_h_
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace McciModel4916 {
+
+/****************************************************************************\
+|
+|   Statistics registry
+|
+\****************************************************************************/
+
+// A statistic adds itself to the registry when it's constructed, so a
+// module only has to define one at file scope:
+//
+//      cStatsCounter sTxOk("tx.ok");
+//      ...
+//      ++sTxOk;
+//
+// Updating is inline: a counter is one increment, a gauge a store and a
+// compare. Statistics live in RAM, which is kept through deep sleep, so
+// they cover everything since boot (or the last resetAll()). The
+// registry is kept sorted by name.
+class cStat
+    {
+public:
+    enum class Kind : std::uint8_t
+        {
+        kCounter,       // counts events
+        kGauge,         // the last value set, and the largest
+        };
+
+    // neither copyable nor movable
+    cStat(const cStat&) = delete;
+    cStat& operator=(const cStat&) = delete;
+    cStat(const cStat&&) = delete;
+    cStat& operator=(const cStat&&) = delete;
+
+    const char *getName() const
+        {
+        return this->m_pName;
+        }
+    Kind getKind() const
+        {
+        return this->m_kind;
+        }
+    std::uint32_t getValue() const
+        {
+        return this->m_value;
+        }
+    // gauges only: the largest value set.
+    std::uint32_t getMax() const
+        {
+        return this->m_max;
+        }
+
+    void reset()
+        {
+        this->m_value = this->m_max = 0;
+        }
+
+    // walk the registry.
+    static cStat *getFirst()
+        {
+        return s_pHead;
+        }
+    cStat *getNext() const
+        {
+        return this->m_pNext;
+        }
+
+    static void resetAll();
+
+protected:
+    cStat(const char *pName, Kind kind);
+
+    std::uint32_t                   m_value = 0;
+    std::uint32_t                   m_max = 0;
+
+private:
+    static cStat                    *s_pHead;
+
+    const char                      *m_pName;
+    cStat                           *m_pNext = nullptr;
+    Kind                            m_kind;
+    };
+
+class cStatsCounter : public cStat
+    {
+public:
+    explicit cStatsCounter(const char *pName)
+        : cStat(pName, Kind::kCounter)
+        {}
+
+    void operator++()
+        {
+        ++this->m_value;
+        }
+    void add(std::uint32_t n)
+        {
+        this->m_value += n;
+        }
+    };
+
+class cStatsGauge : public cStat
+    {
+public:
+    explicit cStatsGauge(const char *pName)
+        : cStat(pName, Kind::kGauge)
+        {}
+
+    void set(std::uint32_t v)
+        {
+        this->m_value = v;
+        if (v > this->m_max)
+            this->m_max = v;
+        }
+    };
+
+} // namespace McciModel4916
+
+#endif /* _Model4916_cStats_h_ */
@@ -0,0 +1,113 @@
+/*
+
+Module: Model4916_cTxBufferPool.h
+
+Function:
+    cTxBufferPool: a small pool of uplink slots with explicit ownership.
+
+Copyright:
+    See accompanying LICENSE file for copyright and license information.
+
+Author:
+    Dhinesh Kumar Pitchai, MCCI Corporation   November 2022
+
+*/
+
+#ifndef _Model4916_cTxBufferPool_h_
+# define _Model4916_cTxBufferPool_h_
+
+#pragma once
+
+#include <cstdint>
+
+namespace McciModel4916 {
+
+/****************************************************************************\
+|
+|   A fixed pool of slots, each held by a set of owners
+|
+\****************************************************************************/
+
+// A slot is free when no owner holds it. Each stage of the uplink path
+// (collection, radio, SD logging) claims the slot while it needs the
+// contents and releases it when done; nobody copies the payload, and a
+// slot can't be reused while any stage still holds it.
+template <typename TSlot, unsigned nSlots>
+class cTxBufferPool
+    {
+public:
+    static_assert(nSlots > 0 && nSlots <= 8, "nSlots must be in 1..8");
+
+    enum Owner : std::uint8_t
+        {
+        kOwnerCollect   = 1 << 0,   // a measurement is being collected
+        kOwnerRadio     = 1 << 1,   // payload is being sent by LoRaWAN
+        kOwnerSd        = 1 << 2,   // payload is being logged to SD
+        };
+
+    cTxBufferPool()
+        : m_owners {}
+        {}
+
+    // neither copyable nor movable
+    cTxBufferPool(const cTxBufferPool&) = delete;
+    cTxBufferPool& operator=(const cTxBufferPool&) = delete;
+    cTxBufferPool(const cTxBufferPool&&) = delete;
+    cTxBufferPool& operator=(const cTxBufferPool&&) = delete;
+
+    // find a free slot and give it to owner; nullptr if all are busy.
+    TSlot *acquire(Owner owner)
+        {
+        for (unsigned i = 0; i < nSlots; ++i)
+            {
+            if (this->m_owners[i] == 0)
+                {
+                this->m_owners[i] = owner;
+                return &this->m_slots[i];
+                }
+            }
+        return nullptr;
+        }
+
+    // add an owner to a slot that is already held.
+    void claim(TSlot *pSlot, Owner owner)
+        {
+        this->m_owners[this->index(pSlot)] |= owner;
+        }
+
+    // drop an owner; the slot is free once the last owner lets go.
+    void release(TSlot *pSlot, Owner owner)
+        {
+        if (pSlot != nullptr)
+            this->m_owners[this->index(pSlot)] &= ~owner;
+        }
+
+    bool isHeld(const TSlot *pSlot, Owner owner) const
+        {
+        return (this->m_owners[this->index(pSlot)] & owner) != 0;
+        }
+
+    unsigned getFreeCount() const
+        {
+        unsigned n = 0;
+        for (auto owners : this->m_owners)
+            {
+            if (owners == 0)
+                ++n;
+            }
+        return n;
+        }
+
+private:
+    unsigned index(const TSlot *pSlot) const
+        {
+        return unsigned(pSlot - this->m_slots);
+        }
+
+    TSlot                   m_slots[nSlots];
+    std::uint8_t            m_owners[nSlots];
+    };
+
+} // namespace McciModel4916
+
+#endif /* _Model4916_cTxBufferPool_h_ */
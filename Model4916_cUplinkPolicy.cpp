@@ -0,0 +1,179 @@
+/*
+
+Module: Model4916_cUplinkPolicy.cpp
+
+Function:
+    Adaptive confirmed-uplink policy.
+
+Copyright:
+    See accompanying LICENSE file for copyright and license information.
+
+Author:
+    Dhinesh Kumar Pitchai, MCCI Corporation   November 2022
+
+*/
+
+#include "Model4916_cUplinkPolicy.h"
+
+using namespace McciModel4916;
+
+/****************************************************************************\
+|
+|   Decisions
+|
+\****************************************************************************/
+
+bool
+cUplinkPolicy::shouldConfirm()
+    {
+    // without history, find out.
+    if (this->m_nSamples < kMinSamples)
+        return true;
+
+    ++this->m_sinceConfirmed;
+    return this->m_sinceConfirmed >= this->m_interval;
+    }
+
+void
+cUplinkPolicy::recordResult(
+    bool fConfirmed,
+    bool fSuccess,
+    std::int16_t rssi,
+    std::int16_t snr
+    )
+    {
+    if (! fConfirmed)
+        {
+        // an uplink that couldn't even be launched says the link is
+        // down; start confirming again.
+        if (! fSuccess)
+            this->m_interval = 1;
+        return;
+        }
+
+    this->m_sinceConfirmed = 0;
+
+    auto &s = this->m_samples[this->m_iNext];
+    s.fAcked = fSuccess;
+    s.rssi = std::int8_t(rssi < -128 ? -128 : rssi > 127 ? 127 : rssi);
+    s.snr = std::int8_t(snr < -128 ? -128 : snr > 127 ? 127 : snr);
+
+    this->m_iNext = (this->m_iNext + 1) % kWindow;
+    if (this->m_nSamples < kWindow)
+        ++this->m_nSamples;
+
+    switch (this->getHealth())
+        {
+    case Health::kHealthy:
+        // back off.
+        if (this->m_interval < kMaxInterval)
+            this->m_interval *= 2;
+        break;
+
+    case Health::kMarginal:
+        if (this->m_interval > 1)
+            this->m_interval /= 2;
+        break;
+
+    default:
+        this->m_interval = 1;
+        break;
+        }
+
+    // a missed ack always escalates, whatever the history says.
+    if (! fSuccess)
+        this->m_interval = 1;
+    }
+
+unsigned
+cUplinkPolicy::getRetryBudget(
+    unsigned nMax
+    ) const
+    {
+    switch (this->getHealth())
+        {
+    case Health::kHealthy:  return nMax;
+    case Health::kFailing:  return 0;
+    default:                return nMax > 0 ? 1 : 0;
+        }
+    }
+
+/****************************************************************************\
+|
+|   Link assessment
+|
+\****************************************************************************/
+
+cUplinkPolicy::Health
+cUplinkPolicy::getHealth() const
+    {
+    if (this->m_nSamples < kMinSamples)
+        return Health::kUnknown;
+
+    auto const ackPercent = this->getAckPercent();
+    auto const snr = this->getMeanSnr();
+    auto const rssi = this->getMeanRssi();
+
+    if (ackPercent >= kHealthyAckPercent && snr >= kHealthySnrQuarterDb &&
+        rssi >= kHealthyRssiDbm)
+        return Health::kHealthy;
+    else if (ackPercent >= 50 && snr >= kMarginalSnrQuarterDb)
+        return Health::kMarginal;
+    else
+        return Health::kFailing;
+    }
+
+unsigned
+cUplinkPolicy::getAckPercent() const
+    {
+    unsigned nAcked = 0;
+
+    if (this->m_nSamples == 0)
+        return 0;
+
+    for (unsigned i = 0; i < this->m_nSamples; ++i)
+        {
+        if (this->m_samples[i].fAcked)
+            ++nAcked;
+        }
+
+    return nAcked * 100 / this->m_nSamples;
+    }
+
+// mean RSSI of the acks in the window (dBm); 0 if there are none.
+std::int16_t
+cUplinkPolicy::getMeanRssi() const
+    {
+    std::int32_t sum = 0;
+    unsigned n = 0;
+
+    for (unsigned i = 0; i < this->m_nSamples; ++i)
+        {
+        if (this->m_samples[i].fAcked)
+            {
+            sum += this->m_samples[i].rssi;
+            ++n;
+            }
+        }
+
+    return n == 0 ? 0 : std::int16_t(sum / std::int32_t(n));
+    }
+
+// mean SNR of the acks in the window (quarter dB); 0 if there are none.
+std::int16_t
+cUplinkPolicy::getMeanSnr() const
+    {
+    std::int32_t sum = 0;
+    unsigned n = 0;
+
+    for (unsigned i = 0; i < this->m_nSamples; ++i)
+        {
+        if (this->m_samples[i].fAcked)
+            {
+            sum += this->m_samples[i].snr;
+            ++n;
+            }
+        }
+
+    return n == 0 ? 0 : std::int16_t(sum / std::int32_t(n));
+    }
@@ -0,0 +1,126 @@
+/*
+
+Module: Model4916_cUplinkPolicy.h
+
+Function:
+    cUplinkPolicy: decides which uplinks are confirmed, from link history.
+
+Copyright:
+    See accompanying LICENSE file for copyright and license information.
+
+Author:
+    Dhinesh Kumar Pitchai, MCCI Corporation   November 2022
+
+*/
+
+#ifndef _Model4916_cUplinkPolicy_h_
+# define _Model4916_cUplinkPolicy_h_
+
+#pragma once
+
+#include <cstdint>
+
+namespace McciModel4916 {
+
+/****************************************************************************\
+|
+|   Confirmed-uplink policy
+|
+\****************************************************************************/
+
+// Only confirmed uplinks tell us anything about the link, so the policy
+// keeps a rolling window of their outcomes (ack, RSSI and SNR of the
+// ack). With too little history, every uplink is confirmed. A link whose
+// acks arrive near the receiver's floor is marginal at best, however many
+// get through, since a little more fading loses it. A clearly healthy
+// link doubles the interval between confirmed uplinks, up to
+// kMaxInterval; a marginal one halves it; a missed ack drops it to one.
+// The same assessment sets how many backlog (retry) frames are worth
+// spending airtime on each cycle.
+class cUplinkPolicy
+    {
+public:
+    static constexpr unsigned kWindow = 16;
+    static constexpr unsigned kMinSamples = 4;
+    static constexpr unsigned kMaxInterval = 16;
+
+    // thresholds for calling a link healthy
+    static constexpr unsigned kHealthyAckPercent = 90;
+    static constexpr std::int16_t kHealthySnrQuarterDb = 0 * 4;
+    static constexpr std::int16_t kMarginalSnrQuarterDb = -10 * 4;
+    static constexpr std::int16_t kHealthyRssiDbm = -120;
+
+    enum class Health : std::uint8_t
+        {
+        kUnknown,
+        kFailing,
+        kMarginal,
+        kHealthy,
+        };
+
+    cUplinkPolicy() {}
+
+    // neither copyable nor movable
+    cUplinkPolicy(const cUplinkPolicy&) = delete;
+    cUplinkPolicy& operator=(const cUplinkPolicy&) = delete;
+    cUplinkPolicy(const cUplinkPolicy&&) = delete;
+    cUplinkPolicy& operator=(const cUplinkPolicy&&) = delete;
+
+    // called once per live uplink; true if it should be confirmed.
+    bool shouldConfirm();
+
+    // record the outcome of a live uplink. rssi is in dBm, snr in
+    // quarter dB; both are only meaningful for an acked confirmed uplink.
+    void recordResult(bool fConfirmed, bool fSuccess, std::int16_t rssi, std::int16_t snr);
+
+    // how many backlog frames to send per cycle.
+    unsigned getRetryBudget(unsigned nMax) const;
+
+    Health getHealth() const;
+
+    unsigned getInterval() const
+        {
+        return this->m_interval;
+        }
+
+    // summary of the window, for display.
+    unsigned getSampleCount() const
+        {
+        return this->m_nSamples;
+        }
+    unsigned getAckPercent() const;
+    std::int16_t getMeanRssi() const;
+    std::int16_t getMeanSnr() const;
+
+    static const char *getHealthName(Health h)
+        {
+        switch (h)
+            {
+            case Health::kUnknown:  return "unknown";
+            case Health::kFailing:  return "failing";
+            case Health::kMarginal: return "marginal";
+            case Health::kHealthy:  return "healthy";
+            default:                return "<<unknown>>";
+            }
+        }
+
+private:
+    struct Sample_t
+        {
+        bool                    fAcked;
+        std::int8_t             rssi;
+        std::int8_t             snr;
+        };
+
+    Sample_t                    m_samples[kWindow] {};
+    unsigned                    m_iNext = 0;
+    unsigned                    m_nSamples = 0;
+    // confirm one uplink in this many
+    unsigned                    m_interval = 1;
+    // uplinks since the last confirmed one
+    unsigned                    m_sinceConfirmed = 0;
+    };
+
+} // namespace McciModel4916
+
+#endif /* _Model4916_cUplinkPolicy_h_ */
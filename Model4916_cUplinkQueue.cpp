@@ -0,0 +1,229 @@
+/*
+
+Module: Model4916_cUplinkQueue.cpp
+
+Function:
+    Persistent store-and-forward queue of uplink payloads.
+
+Copyright:
+    See accompanying LICENSE file for copyright and license information.
+
+Author:
+    Dhinesh Kumar Pitchai, MCCI Corporation   November 2022
+
+*/
+
+#include "Model4916_cUplinkQueue.h"
+
+#include "Model4916_crc.h"
+
+#include <Catena_Log.h>
+#include <cstring>
+
+using namespace McciModel4916;
+using namespace McciCatena;
+
+/****************************************************************************\
+|
+|   Recovery
+|
+\****************************************************************************/
+
+bool
+cUplinkQueue::begin(
+    cFram *pFram
+    )
+    {
+    Header_t header[2];
+    bool fValid[2];
+
+    this->m_pFram = pFram;
+    if (pFram == nullptr)
+        return false;
+
+    fValid[0] = this->readHeader(0, header[0]);
+    fValid[1] = this->readHeader(1, header[1]);
+
+    if (fValid[0] && fValid[1])
+        {
+        // both survived; the later generation wins.
+        this->m_header = std::int32_t(header[1].generation - header[0].generation) > 0
+                            ? header[1] : header[0];
+        }
+    else if (fValid[0] || fValid[1])
+        {
+        this->m_header = fValid[0] ? header[0] : header[1];
+        }
+    else
+        {
+        gLog.printf(gLog.kInfo, "uplink queue: formatting %u slots\n", kCapacity);
+        this->m_header = Header_t {};
+        this->m_header.magic = kMagic;
+        this->writeHeader();
+        }
+
+    return true;
+    }
+
+bool
+cUplinkQueue::readHeader(
+    unsigned iCopy,
+    Header_t &header
+    ) const
+    {
+    if (! this->m_pFram->read(
+                FramLayout::kUplinkQueue + iCopy * sizeof(header),
+                (std::uint8_t *)&header,
+                sizeof(header)
+                ))
+        return false;
+
+    return header.magic == kMagic &&
+           header.crc == headerCrc(header) &&
+           header.head < kCapacity &&
+           header.count <= kCapacity;
+    }
+
+void
+cUplinkQueue::writeHeader()
+    {
+    // alternate between the copies, so the one we're not writing is
+    // always a valid fallback.
+    ++this->m_header.generation;
+    this->m_header.crc = headerCrc(this->m_header);
+
+    this->m_pFram->write(
+        FramLayout::kUplinkQueue + (this->m_header.generation & 1) * sizeof(Header_t),
+        (const std::uint8_t *)&this->m_header,
+        sizeof(this->m_header)
+        );
+    }
+
+std::uint16_t
+cUplinkQueue::headerCrc(
+    const Header_t &header
+    )
+    {
+    return crc16_ccitt(&header, offsetof(Header_t, crc));
+    }
+
+std::uint16_t
+cUplinkQueue::recordCrc(
+    const Record_t &record
+    )
+    {
+    auto crc = crc16_ccitt(&record, offsetof(Record_t, crc));
+    return crc16_ccitt(record.payload, record.nPayload, crc);
+    }
+
+cFramStorage::Offset
+cUplinkQueue::recordOffset(
+    unsigned iRing
+    ) const
+    {
+    return FramLayout::kUplinkQueue + 2 * sizeof(Header_t) + iRing * sizeof(Record_t);
+    }
+
+/****************************************************************************\
+|
+|   Queue operations
+|
+\****************************************************************************/
+
+bool
+cUplinkQueue::push(
+    std::uint8_t port,
+    std::uint32_t time,
+    const std::uint8_t *pPayload,
+    size_t nPayload
+    )
+    {
+    if (this->m_pFram == nullptr || nPayload > kMaxPayload)
+        return false;
+
+    if (this->m_header.count == kCapacity)
+        {
+        // full: the oldest record makes room.
+        this->m_header.head = (this->m_header.head + 1) % kCapacity;
+        --this->m_header.count;
+        ++this->m_header.dropped;
+        }
+
+    Record_t record;
+    record.time = time;
+    record.port = port;
+    record.nPayload = std::uint8_t(nPayload);
+    std::memcpy(record.payload, pPayload, nPayload);
+    record.crc = recordCrc(record);
+
+    // write the record before the header that makes it visible.
+    unsigned const iRing = (this->m_header.head + this->m_header.count) % kCapacity;
+    if (! this->m_pFram->write(
+                this->recordOffset(iRing),
+                (const std::uint8_t *)&record,
+                offsetof(Record_t, payload) + nPayload
+                ))
+        return false;
+
+    ++this->m_header.count;
+    this->writeHeader();
+    return true;
+    }
+
+bool
+cUplinkQueue::peek(
+    unsigned i,
+    Record_t &record
+    ) const
+    {
+    if (this->m_pFram == nullptr || i >= this->m_header.count)
+        return false;
+
+    unsigned const iRing = (this->m_header.head + i) % kCapacity;
+    if (! this->m_pFram->read(
+                this->recordOffset(iRing),
+                (std::uint8_t *)&record,
+                sizeof(record)
+                ))
+        return false;
+
+    return record.nPayload <= kMaxPayload && record.crc == recordCrc(record);
+    }
+
+void
+cUplinkQueue::pop(
+    unsigned n
+    )
+    {
+    if (this->m_pFram == nullptr || n == 0)
+        return;
+
+    if (n > this->m_header.count)
+        n = this->m_header.count;
+
+    this->m_header.head = (this->m_header.head + n) % kCapacity;
+    this->m_header.count -= n;
+    this->writeHeader();
+    }
+
+void
+cUplinkQueue::dropNewest(
+    unsigned n
+    )
+    {
+    if (this->m_pFram == nullptr || n == 0)
+        return;
+
+    if (n > this->m_header.count)
+        n = this->m_header.count;
+
+    // the newest records are at the tail; the head doesn't move.
+    this->m_header.count -= n;
+    this->writeHeader();
+    }
+
+void
+cUplinkQueue::clear()
+    {
+    this->pop(this->m_header.count);
+    }
@@ -0,0 +1,129 @@
+/*
+
+Module: Model4916_cUplinkQueue.h
+
+Function:
+    cUplinkQueue: a persistent FIFO of uplink payloads kept in FRAM.
+
+Copyright:
+    See accompanying LICENSE file for copyright and license information.
+
+Author:
+    Dhinesh Kumar Pitchai, MCCI Corporation   November 2022
+
+*/
+
+#ifndef _Model4916_cUplinkQueue_h_
+# define _Model4916_cUplinkQueue_h_
+
+#pragma once
+
+#include "Model4916_FramLayout.h"
+#include <Catena_Fram.h>
+#include <cstddef>
+#include <cstdint>
+
+namespace McciModel4916 {
+
+/****************************************************************************\
+|
+|   Store-and-forward queue of encoded uplinks
+|
+\****************************************************************************/
+
+// Records are fixed size and live in a ring in FRAM. The ring indices
+// are kept in two alternating header copies, each with a generation
+// number and CRC, so a brown-out while updating one copy leaves the
+// other intact. When the ring is full, the oldest record is dropped.
+class cUplinkQueue
+    {
+public:
+    // largest payload we keep; must hold a port 1 message.
+    static constexpr size_t kMaxPayload = 48;
+
+    struct Record_t
+        {
+        // capture time (seconds since the Unix epoch), 0 if unknown.
+        std::uint32_t           time;
+        // LoRaWAN port the payload was meant for.
+        std::uint8_t            port;
+        // number of valid bytes in payload[].
+        std::uint8_t            nPayload;
+        // CRC over all the fields above and the valid payload bytes.
+        std::uint16_t           crc;
+        std::uint8_t            payload[kMaxPayload];
+        };
+
+    cUplinkQueue() {}
+
+    // neither copyable nor movable
+    cUplinkQueue(const cUplinkQueue&) = delete;
+    cUplinkQueue& operator=(const cUplinkQueue&) = delete;
+    cUplinkQueue(const cUplinkQueue&&) = delete;
+    cUplinkQueue& operator=(const cUplinkQueue&&) = delete;
+
+    // attach to FRAM and recover the queue; formats it if no valid
+    // header is found. Returns false if there's no FRAM.
+    bool begin(McciCatena::cFram *pFram);
+
+    // append a record, dropping the oldest if the ring is full.
+    bool push(std::uint8_t port, std::uint32_t time, const std::uint8_t *pPayload, size_t nPayload);
+
+    // fetch the i-th oldest record; false if absent or corrupt.
+    bool peek(unsigned i, Record_t &record) const;
+
+    // discard the n oldest records.
+    void pop(unsigned n);
+
+    // discard the n newest records.
+    void dropNewest(unsigned n);
+
+    // discard everything.
+    void clear();
+
+    unsigned getCount() const
+        {
+        return this->m_header.count;
+        }
+    unsigned getCapacity() const
+        {
+        return kCapacity;
+        }
+    std::uint32_t getDropped() const
+        {
+        return this->m_header.dropped;
+        }
+    bool isEnabled() const
+        {
+        return this->m_pFram != nullptr;
+        }
+
+private:
+    struct Header_t
+        {
+        std::uint32_t           magic;
+        std::uint32_t           generation;
+        std::uint32_t           dropped;
+        std::uint16_t           head;
+        std::uint16_t           count;
+        std::uint16_t           reserved;
+        std::uint16_t           crc;
+        };
+
+    static constexpr std::uint32_t kMagic = 0x31305155;    // "UQ01"
+    static constexpr unsigned kCapacity =
+        (FramLayout::kUplinkQueueSize - 2 * sizeof(Header_t)) / sizeof(Record_t);
+
+    bool readHeader(unsigned iCopy, Header_t &header) const;
+    void writeHeader();
+    static std::uint16_t headerCrc(const Header_t &header);
+    static std::uint16_t recordCrc(const Record_t &record);
+    McciCatena::cFramStorage::Offset recordOffset(unsigned iRing) const;
+
+    McciCatena::cFram               *m_pFram = nullptr;
+    Header_t                        m_header {};
+    };
+
+} // namespace McciModel4916
+
+#endif /* _Model4916_cUplinkQueue_h_ */
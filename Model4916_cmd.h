@@ -20,6 +20,13 @@ Author:
 #include <Catena_CommandStream.h>
 
 McciCatena::cCommandStream::CommandFn cmdLog;
+McciCatena::cCommandStream::CommandFn cmdBench;
 McciCatena::cCommandStream::CommandFn cmdDir;
+McciCatena::cCommandStream::CommandFn cmdCsvBench;
+McciCatena::cCommandStream::CommandFn cmdDump;
+McciCatena::cCommandStream::CommandFn cmdExport;
+McciCatena::cCommandStream::CommandFn cmdSdStats;
+McciCatena::cCommandStream::CommandFn cmdStats;
+McciCatena::cCommandStream::CommandFn cmdStream;
 
 #endif /* _Model4916_cmd_h_ */
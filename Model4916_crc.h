@@ -0,0 +1,73 @@
+/*
+
+Module: Model4916_crc.h
+
+Function:
+    CRC helpers used for records kept in non-volatile storage.
+
+Copyright:
+    See accompanying LICENSE file for copyright and license information.
+
+Author:
+    Dhinesh Kumar Pitchai, MCCI Corporation   November 2022
+
+*/
+
+#ifndef _Model4916_crc_h_
+# define _Model4916_crc_h_
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace McciModel4916 {
+
+// CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF). Pass the previous
+// result as crc to continue over several buffers.
+static inline std::uint16_t
+crc16_ccitt(
+    const void *pBuffer,
+    size_t nBuffer,
+    std::uint16_t crc = 0xFFFF
+    )
+    {
+    auto p = static_cast<const std::uint8_t *>(pBuffer);
+
+    while (nBuffer-- > 0)
+        {
+        crc ^= std::uint16_t(*p++) << 8;
+        for (unsigned i = 0; i < 8; ++i)
+            crc = (crc & 0x8000) ? std::uint16_t((crc << 1) ^ 0x1021)
+                                 : std::uint16_t(crc << 1);
+        }
+
+    return crc;
+    }
+
+// CRC-32 (IEEE 802.3, reflected, poly 0xEDB88320). Start with the
+// default and pass the previous result to continue; the final value
+// is complemented on return, so chaining works on returned values.
+static inline std::uint32_t
+crc32_ieee(
+    const void *pBuffer,
+    size_t nBuffer,
+    std::uint32_t crc = 0
+    )
+    {
+    auto p = static_cast<const std::uint8_t *>(pBuffer);
+
+    crc = ~crc;
+    while (nBuffer-- > 0)
+        {
+        crc ^= *p++;
+        for (unsigned i = 0; i < 8; ++i)
+            crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1)));
+        }
+
+    return ~crc;
+    }
+
+} // namespace McciModel4916
+
+#endif /* _Model4916_crc_h_ */
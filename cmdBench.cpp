@@ -0,0 +1,183 @@
+/*
+
+Module:	cmdBench.cpp
+
+Function:
+    Time the encoding, conversion and formatting kernels on the device.
+
+Copyright:
+    See accompanying LICENSE file for copyright and license information.
+
+Author:
+    Dhinesh Kumar Pitchai, MCCI Corporation	November 2022
+
+*/
+
+#include "Model4916_cmd.h"
+
+#include "Model4916-MultiGas-Sensor.h"
+#include "Model4916_cBench.h"
+#include "Model4916_cLogCategory.h"
+
+using namespace McciCatena;
+using namespace McciModel4916;
+
+/****************************************************************************\
+|
+|   Manifest declarations
+|
+\****************************************************************************/
+
+namespace {
+
+// lets cBench print to a command stream.
+class cCommandStreamPrint : public Print
+    {
+public:
+    cCommandStreamPrint(cCommandStream *pThis)
+        : m_pThis(pThis)
+        {}
+
+    ~cCommandStreamPrint()
+        {
+        this->emit();
+        }
+
+    virtual size_t write(uint8_t c) override
+        {
+        this->m_buffer[this->m_nBuffer++] = char(c);
+        if (this->m_nBuffer == sizeof(this->m_buffer))
+            this->emit();
+        return 1;
+        }
+    using Print::write;
+
+    void emit()
+        {
+        if (this->m_nBuffer != 0)
+            this->m_pThis->printf("%.*s", int(this->m_nBuffer), this->m_buffer);
+        this->m_nBuffer = 0;
+        }
+
+private:
+    cCommandStream                  *m_pThis;
+    char                            m_buffer[64];
+    size_t                          m_nBuffer = 0;
+    };
+
+} // namespace
+
+static std::uint64_t readCycles(void);
+
+/*
+
+Name:   ::cmdBench()
+
+Function:
+    Command dispatcher for "bench" command.
+
+Definition:
+    McciCatena::cCommandStream::CommandFn cmdBench;
+
+    McciCatena::cCommandStream::CommandFn cmdBench(
+        cCommandStream *pThis,
+        void *pContext,
+        int argc,
+        char **argv
+        );
+
+Description:
+    The "bench" command has the following syntax:
+
+    bench [{ms} [{prefix}]]
+        Time each kernel of cMeasurementLoop::runBench() for about {ms}
+        milliseconds (default 200), or only those whose names start
+        with {prefix}. The results are CSV, with the time and CPU
+        cycles per operation; save them with a terminal log and compare
+        runs with extra/benchcmp.py.
+
+    Cycles are counted with SysTick: the Cortex-M0+ has no DWT cycle
+    counter. The measurement loop keeps running, so run this with the
+    loop idle (e.g. "system configure operatingflags" with deep sleep
+    disabled, between uplinks) for steady numbers.
+
+Returns:
+    cCommandStream::CommandStatus::kSuccess if successful.
+    Some other value for failure.
+
+*/
+
+// argv[0] is "bench"
+// argv[1], if present, is the time per kernel in milliseconds
+// argv[2], if present, selects kernels by prefix
+cCommandStream::CommandStatus cmdBench(
+    cCommandStream *pThis,
+    void *pContext,
+    int argc,
+    char **argv
+    )
+    {
+    std::uint32_t msPerKernel;
+
+    if (argc > 3)
+        return cCommandStream::CommandStatus::kInvalidParameter;
+
+    auto const status = cCommandStream::getuint32(argc, argv, 1, 0, msPerKernel, 200);
+    if (status != cCommandStream::CommandStatus::kSuccess)
+        return status;
+    if (msPerKernel == 0 || msPerKernel > 10 * 1000)
+        return cCommandStream::CommandStatus::kInvalidParameter;
+
+    cBench::Clock_t const clock { readCycles, SystemCoreClock, true };
+    cCommandStreamPrint out(pThis);
+    cBench bench(out, clock, msPerKernel);
+
+    if (argc > 2)
+        bench.setFilter(argv[2]);
+
+    // log output from the kernels would swamp the results, and its time
+    // would be counted; only warnings and errors get through meanwhile.
+    cLogCategory::Level levels[cLogCategory::kCategories];
+    for (unsigned i = 0; i < cLogCategory::kCategories; ++i)
+        {
+        auto const pCategory = cLogCategory::getCategory(i);
+
+        levels[i] = pCategory->getLevel();
+        if (levels[i] > cLogCategory::kWarning)
+            pCategory->setLevel(cLogCategory::kWarning);
+        }
+
+    gMeasurementLoop.runBench(bench);
+    out.emit();
+
+    for (unsigned i = 0; i < cLogCategory::kCategories; ++i)
+        cLogCategory::getCategory(i)->setLevel(levels[i]);
+
+    if (bench.getCount() == 0)
+        {
+        pThis->printf("%s: no kernel matches %s\n", argv[0], argv[2]);
+        return cCommandStream::CommandStatus::kNotFound;
+        }
+
+    return cCommandStream::CommandStatus::kSuccess;
+    }
+
+// SysTick counts down from LOAD to zero at the CPU clock, and its
+// interrupt advances millis(); together they count cycles. If the
+// interrupt comes between the two reads, read again.
+static std::uint64_t
+readCycles(
+    void
+    )
+    {
+    std::uint32_t ms;
+    std::uint32_t val;
+
+    do  {
+        ms = millis();
+        val = SysTick->VAL;
+        } while (ms != millis());
+
+    std::uint32_t const reload = SysTick->LOAD + 1;
+    return std::uint64_t(ms) * reload + (reload - 1 - val);
+    }
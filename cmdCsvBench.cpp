@@ -0,0 +1,332 @@
+/*
+
+Module:	cmdCsvBench.cpp
+
+Function:
+    Compare the speed of the CSV row formatters.
+
+Copyright:
+    See accompanying LICENSE file for copyright and license information.
+
+Author:
+    Dhinesh Kumar Pitchai, MCCI Corporation	November 2022
+
+*/
+
+#include "Model4916_cmd.h"
+
+#include "Model4916-MultiGas-Sensor.h"
+#include "Model4916_SdLogFormat.h"
+
+#include <mcciadk_baselib.h>
+#include <cstring>
+
+using namespace McciCatena;
+using namespace McciModel4916;
+
+/****************************************************************************\
+|
+|   Manifest declarations
+|
+\****************************************************************************/
+
+namespace {
+
+// keeps the last row printed to it.
+class cRowPrint : public Print
+    {
+public:
+    virtual size_t write(uint8_t c) override
+        {
+        return this->write(&c, 1);
+        }
+
+    virtual size_t write(const uint8_t *p, size_t n) override
+        {
+        if (n > sizeof(this->m_buffer) - this->m_n)
+            n = sizeof(this->m_buffer) - this->m_n;
+        std::memcpy(this->m_buffer + this->m_n, p, n);
+        this->m_n += n;
+        ++this->m_nWrites;
+        return n;
+        }
+    using Print::write;
+
+    void clear()
+        {
+        this->m_n = 0;
+        }
+
+    char                            m_buffer[512];
+    size_t                          m_n = 0;
+    std::uint32_t                   m_nWrites = 0;
+    };
+
+} // namespace
+
+static void makeRecord(SdLogFormat::Record_t &record, std::uint32_t &seed);
+static void printRowPrint(Print &out, const std::uint8_t *pDevEUI, const SdLogFormat::Record_t &record);
+
+/*
+
+Name:   ::cmdCsvBench()
+
+Function:
+    Command dispatcher for "csvbench" command.
+
+Definition:
+    McciCatena::cCommandStream::CommandFn cmdCsvBench;
+
+    McciCatena::cCommandStream::CommandStatus cmdCsvBench(
+        cCommandStream *pThis,
+        void *pContext,
+        int argc,
+        char **argv
+        );
+
+Description:
+    The "csvbench" command has the following syntax:
+
+    csvbench [{rows}]
+        Format {rows} (default 200) made-up log records as CSV rows,
+        first with Print, field by field (as the CSV log used to), then
+        with cMeasurementLoop::printSdRecordCsv(), and show the rows per
+        second and the number of write() calls for each. Every row is
+        then checked to be the same both ways.
+
+    Nothing is written to the SD card.
+
+Returns:
+    cCommandStream::CommandStatus::kSuccess if successful.
+    Some other value for failure.
+
+*/
+
+// argv[0] is "csvbench"
+// argv[1], if present, is the number of rows
+cCommandStream::CommandStatus cmdCsvBench(
+    cCommandStream *pThis,
+    void *pContext,
+    int argc,
+    char **argv
+    )
+    {
+    static const std::uint8_t kDevEUI[8] = { 0x00, 0x02, 0xcc, 0x01, 0x00, 0x00, 0x4a, 0x16 };
+    std::uint32_t nRows;
+
+    if (argc > 2)
+        return cCommandStream::CommandStatus::kInvalidParameter;
+
+    auto const status = cCommandStream::getuint32(argc, argv, 1, 0, nRows, 200);
+    if (status != cCommandStream::CommandStatus::kSuccess)
+        return status;
+    if (nRows == 0)
+        return cCommandStream::CommandStatus::kInvalidParameter;
+
+    static const char * const kNames[2] = { "Print", "cCsvRow" };
+    cRowPrint out[2];
+    std::uint32_t us[2];
+    SdLogFormat::Record_t record;
+
+    for (unsigned iMethod = 0; iMethod < 2; ++iMethod)
+        {
+        std::uint32_t seed = 1;
+        std::uint32_t const tStart = micros();
+
+        for (std::uint32_t i = 0; i < nRows; ++i)
+            {
+            makeRecord(record, seed);
+            out[iMethod].clear();
+            if (iMethod == 0)
+                printRowPrint(out[iMethod], kDevEUI, record);
+            else
+                cMeasurementLoop::printSdRecordCsv(out[iMethod], kDevEUI, record);
+            }
+
+        us[iMethod] = micros() - tStart;
+        if (us[iMethod] == 0)
+            us[iMethod] = 1;
+
+        pThis->printf(
+            "%-8s %lu rows in %lu us: %lu rows/s, %lu writes/row\n",
+            kNames[iMethod],
+            (unsigned long) nRows,
+            (unsigned long) us[iMethod],
+            (unsigned long) (std::uint64_t(nRows) * 1000000 / us[iMethod]),
+            (unsigned long) (out[iMethod].m_nWrites / nRows)
+            );
+        }
+
+    pThis->printf(
+        "speedup %lu.%02lux\n",
+        (unsigned long) (us[0] / us[1]),
+        (unsigned long) (us[0] % us[1] * 100 / us[1])
+        );
+
+    // make sure they agree.
+    std::uint32_t seed = 1;
+    std::uint32_t nDiffer = 0;
+    for (std::uint32_t i = 0; i < nRows; ++i)
+        {
+        makeRecord(record, seed);
+        out[0].clear();
+        out[1].clear();
+        printRowPrint(out[0], kDevEUI, record);
+        cMeasurementLoop::printSdRecordCsv(out[1], kDevEUI, record);
+
+        if (out[0].m_n == out[1].m_n &&
+            std::memcmp(out[0].m_buffer, out[1].m_buffer, out[0].m_n) == 0)
+            continue;
+
+        if (nDiffer++ == 0)
+            pThis->printf(
+                "row %lu differs:\n%.*s%.*s",
+                (unsigned long) i,
+                int(out[0].m_n), out[0].m_buffer,
+                int(out[1].m_n), out[1].m_buffer
+                );
+        }
+
+    pThis->printf("%lu of %lu rows differ\n", (unsigned long) nDiffer, (unsigned long) nRows);
+    return nDiffer == 0 ? cCommandStream::CommandStatus::kSuccess
+                        : cCommandStream::CommandStatus::kError;
+    }
+
+// a record with every field present and plausible values.
+static void
+makeRecord(
+    SdLogFormat::Record_t &record,
+    std::uint32_t &seed
+    )
+    {
+    auto next = [&seed](std::uint32_t range) -> std::uint32_t
+        {
+        seed = seed * 1664525 + 1013904223;
+        return (seed >> 8) % range;
+        };
+
+    std::memset(&record, 0, sizeof(record));
+    record.time = 1700000000 + next(86400);
+    record.flags = 0x3FF;
+    record.port = cMeasurementLoop::MeasurementFormat::kMessagePort;
+    record.nRaw = 40;
+    record.bootCount = next(1000);
+    record.vBat = 3.0f + next(1500) / 1000.0f;
+    record.tempC = -10.0f + next(50000) / 1000.0f;
+    record.humidity = next(100000) / 1000.0f;
+    record.latitude = 40.0f + next(1000000) / 1000000.0f;
+    record.longitude = -74.0f - next(1000000) / 1000000.0f;
+    record.co2ppm = 400.0f + next(200000) / 100.0f;
+    for (unsigned i = 0; i < 7; ++i)
+        {
+        record.count[i] = next(100000);
+        record.mass[i] = next(50000) / 100.0f;
+        }
+    for (unsigned i = 0; i < 4; ++i)
+        record.gases[i] = next(10000) / 1000.0f;
+    for (unsigned i = 0; i < record.nRaw; ++i)
+        record.raw[i] = std::uint8_t(next(256));
+    }
+
+// the row as the CSV log printed it before cCsvRow: a Print call per
+// field. Kept here as the reference.
+static void
+printRowPrint(
+    Print &out,
+    const std::uint8_t *pDevEUI,
+    const SdLogFormat::Record_t &record
+    )
+    {
+    using Flags = cMeasurementLoop::Flags;
+    char buf[32];
+
+    if (record.time != 0)
+        out.print(record.time);
+    out.print(',');
+
+    if (pDevEUI != nullptr)
+        {
+        out.print('"');
+        for (auto i = 0; i < 8; ++i)
+            {
+            McciAdkLib_Snprintf(buf, sizeof(buf), 0, "%02x", pDevEUI[i]);
+            out.print(buf);
+            }
+        out.print('"');
+        }
+    out.print(',');
+
+    out.print('"');
+    for (unsigned i = 0; i < record.nRaw && i < sizeof(record.raw); ++i)
+        {
+        McciAdkLib_Snprintf(buf, sizeof(buf), 0, "%02x", record.raw[i]);
+        out.print(buf);
+        }
+    out.print("\",");
+
+    out.print(record.port);
+    out.print(',');
+
+    if ((Flags(record.flags) & Flags::Vbat) != Flags(0))
+        out.print(record.vBat);
+    out.print(',');
+
+    out.print(',');
+
+    if ((Flags(record.flags) & Flags::Boot) != Flags(0))
+        out.print(record.bootCount);
+    out.print(',');
+
+    if ((Flags(record.flags) & Flags::GPS) != Flags(0))
+        {
+        out.print(record.latitude);
+        out.print(',');
+        out.print(record.longitude);
+        out.print(',');
+        }
+    else
+        out.print(",,");
+
+    if ((Flags(record.flags) & Flags::TH) != Flags(0))
+        {
+        out.print(record.tempC);
+        out.print(',');
+        out.print(record.humidity);
+        out.print(',');
+        }
+    else
+        out.print(",,");
+
+    if ((Flags(record.flags) & Flags::CO2) != Flags(0))
+        out.print(record.co2ppm);
+    out.print(',');
+
+    out.print(",,");
+
+    if ((Flags(record.flags) & Flags::PM) != Flags(0))
+        {
+        for (unsigned i = 0; i < 7; ++i)
+            {
+            out.print(record.count[i]);
+            out.print(',');
+            }
+        for (unsigned i = 0; i < 7; ++i)
+            {
+            out.print(record.mass[i]);
+            out.print(',');
+            }
+        }
+    else
+        out.print(",,,,,,,,,,,,,,");
+
+    static const Flags kGasFlags[4] = { Flags::CO, Flags::NO2, Flags::O3, Flags::SO2 };
+    for (unsigned i = 0; i < 4; ++i)
+        {
+        if ((Flags(record.flags) & kGasFlags[i]) != Flags(0))
+            out.print(record.gases[i]);
+        if (i < 3)
+            out.print(',');
+        }
+
+    out.println();
+    }
@@ -23,6 +23,9 @@ Author:
 
 #include "Model4916-MultiGas-Sensor.h"
 
+#include <cctype>
+#include <cstring>
+
 using namespace McciCatena;
 
 /****************************************************************************\
@@ -31,13 +34,91 @@ using namespace McciCatena;
 |
 \****************************************************************************/
 
-static void
-printDirectory(
-    cCommandStream *pThis,
-    File &dir,
-    unsigned level,
-    bool fRecurse
-    );
+namespace {
+
+// walks a directory tree a few entries per poll, so the measurement
+// loop keeps running during a long listing. The stack of open
+// directories is explicit and bounded, rather than one call per level.
+class cSdWalk : public cPollableObject
+    {
+public:
+    // deeper directories are listed but not entered.
+    static constexpr unsigned kMaxDepth = 8;
+    // entries read per poll.
+    static constexpr unsigned kEntriesPerPoll = 8;
+    // the card has 8.3 names: 12 characters and a separator per level.
+    static constexpr size_t kMaxPath = 1 + kMaxDepth * 13 + 1;
+    static constexpr size_t kMaxPattern = 16;
+
+    struct Options_t
+        {
+        // lines to show; zero for all
+        std::uint32_t count;
+        // lines to skip first
+        std::uint32_t offset;
+        bool fRecurse;
+        // show only the totals for each directory
+        bool fSummary;
+        // if not empty, only files matching this are counted and shown
+        char pattern[kMaxPattern];
+        };
+
+    bool begin(cCommandStream *pThis, const char *pPath, const Options_t &options);
+    void stop(const char *pReason);
+
+    bool isActive() const
+        {
+        return this->m_fActive;
+        }
+
+    virtual void poll() override;
+
+private:
+    struct Frame_t
+        {
+        File            dir;
+        // length of this directory's path in m_path
+        std::uint16_t   nPath;
+        // entries read so far, to find our place again after a remount
+        std::uint32_t   nSeen;
+        // totals of the files (matching the pattern) and directories
+        // directly in this directory
+        std::uint32_t   nFiles;
+        std::uint32_t   nDirs;
+        std::uint32_t   nBytes;
+        };
+
+    void step();
+    bool push(File &dir, const char *pName);
+    void pop();
+    bool reopen();
+    bool matches(const char *pName) const;
+    // true if the line is to be printed; ends the walk after a full page.
+    bool pageLine();
+    void finish();
+
+    cCommandStream                  *m_pThis = nullptr;
+    Options_t                       m_options {};
+    Frame_t                         m_stack[kMaxDepth];
+    unsigned                        m_depth = 0;
+    char                            m_path[kMaxPath] {};
+    // the card mount the open directories belong to
+    std::uint32_t                   m_nMount = 0;
+    // lines produced so far, shown or skipped
+    std::uint32_t                   m_nLines = 0;
+    // grand totals
+    std::uint32_t                   m_nFiles = 0;
+    std::uint32_t                   m_nDirs = 0;
+    std::uint32_t                   m_nBytes = 0;
+    bool                            m_fActive = false;
+    bool                            m_fRegistered = false;
+    };
+
+cSdWalk sSdWalk;
+
+bool globMatch(const char *pPattern, const char *pName);
+
+} // namespace
 
 /*
 
@@ -59,14 +140,34 @@ Definition:
 Description:
     The "dir" command has the following syntax:
 
-    dir
-        Display the root directory.
+    dir [{options}] [{path} [{pattern}]]
+        Display the directory {path}, or the root directory. If
+        {pattern} is given, only files whose names match it are shown;
+        it may use "*" and "?", and case is ignored.
 
-    dir {path}
-        Display a directory of path
+    dir --stop
+        Stop the listing in progress.
+
+    The options are:
+
+    --count {n}
+        Show at most {n} lines. If there are more, the listing ends
+        with the --offset to give for the next page.
+
+    --offset {n}
+        Skip the first {n} lines.
+
+    --summary
+        Instead of the entries, show a line per directory with the
+        number of files, their total size, and the number of
+        subdirectories.
 
     If "tree" is used instead of "dir", then a recursive
-    directory listing is produced.
+    directory listing is produced. Directories deeper than 8
+    levels are shown but not entered.
+
+    The command returns at once; the listing is printed a few entries
+    per poll. Starting a listing stops the one in progress.
 
 Returns:
     cCommandStream::CommandStatus::kSuccess if successful.
@@ -74,8 +175,8 @@ Returns:
 
 */
 
-// argv[0] is "dir"
-// argv[1] is path; if omitted, root is listed
+// argv[0] is "dir" or "tree"
+// argv[1..] are options, then the path and the pattern
 cCommandStream::CommandStatus cmdDir(
     cCommandStream *pThis,
     void *pContext,
@@ -83,16 +184,60 @@ cCommandStream::CommandStatus cmdDir(
     char **argv
     )
     {
-    const char *sFile;
-    cCommandStream::CommandStatus result;
+    cSdWalk::Options_t options {};
+    const char *sFile = "/";
+    int iArg;
+
+    options.fRecurse = argv[0][0] == 't';
+
+    for (iArg = 1; iArg < argc && argv[iArg][0] == '-' && argv[iArg][1] == '-'; ++iArg)
+        {
+        auto const pOption = argv[iArg];
+
+        if (std::strcmp(pOption, "--stop") == 0 && argc == 2)
+            {
+            if (sSdWalk.isActive())
+                sSdWalk.stop("stopped");
+            return cCommandStream::CommandStatus::kSuccess;
+            }
+        else if (std::strcmp(pOption, "--summary") == 0)
+            options.fSummary = true;
+        else if (std::strcmp(pOption, "--count") == 0 ||
+                 std::strcmp(pOption, "--offset") == 0)
+            {
+            if (iArg + 1 >= argc)
+                return cCommandStream::CommandStatus::kInvalidParameter;
+
+            auto const status = cCommandStream::getuint32(
+                                    argc, argv, ++iArg, 0,
+                                    pOption[2] == 'c' ? options.count : options.offset,
+                                    0
+                                    );
+            if (status != cCommandStream::CommandStatus::kSuccess)
+                return status;
+            }
+        else
+            return cCommandStream::CommandStatus::kInvalidParameter;
+        }
+
+    if (argc - iArg > 2)
+        return cCommandStream::CommandStatus::kInvalidParameter;
+
+    if (iArg < argc)
+        sFile = argv[iArg++];
 
-    if (argc > 2)
+    if (iArg < argc)
+        {
+        if (std::strlen(argv[iArg]) >= sizeof(options.pattern))
+            return cCommandStream::CommandStatus::kInvalidParameter;
+        std::strcpy(options.pattern, argv[iArg]);
+        }
+
+    if (std::strlen(sFile) >= cSdWalk::kMaxPath)
         return cCommandStream::CommandStatus::kInvalidParameter;
 
-    if (argc == 1)
-        sFile = "/";
-    else
-        sFile = argv[1];
+    if (sSdWalk.isActive())
+        sSdWalk.stop("replaced");
 
     bool fHaveCard = gMeasurementLoop.checkSdCard();
     if (! fHaveCard)
@@ -101,49 +246,334 @@ cCommandStream::CommandStatus cmdDir(
         return cCommandStream::CommandStatus::kIoError;
         }
 
-    auto dir = gSD.open(sFile);
-    if (! dir)
+    if (! sSdWalk.begin(pThis, sFile, options))
         {
         pThis->printf("%s: not found: %s\n", argv[0], sFile);
-        result = cCommandStream::CommandStatus::kReadError;
+        gMeasurementLoop.sdFinish();
+        return cCommandStream::CommandStatus::kReadError;
         }
-    else
+
+    return cCommandStream::CommandStatus::kSuccess;
+    }
+
+/****************************************************************************\
+|
+|   The background walk
+|
+\****************************************************************************/
+
+bool
+cSdWalk::begin(
+    cCommandStream *pThis,
+    const char *pPath,
+    const Options_t &options
+    )
+    {
+    File dir = gSD.open(pPath);
+    if (! dir)
+        return false;
+
+    if (! dir.isDirectory())
         {
-        printDirectory(pThis, dir, 0, argv[0][0] == 't');
         dir.close();
-        result = cCommandStream::CommandStatus::kSuccess;
+        return false;
+        }
+
+    this->m_pThis = pThis;
+    this->m_options = options;
+    this->m_nMount = gMeasurementLoop.getSdMountCount();
+    this->m_nLines = 0;
+    this->m_nFiles = this->m_nDirs = this->m_nBytes = 0;
+
+    // the root is the one path that ends in a separator.
+    std::strcpy(this->m_path, pPath[0] == '\0' ? "/" : pPath);
+    size_t nPath = std::strlen(this->m_path);
+    while (nPath > 1 && this->m_path[nPath - 1] == '/')
+        this->m_path[--nPath] = '\0';
+
+    this->m_depth = 1;
+    auto &root = this->m_stack[0];
+    root.dir = dir;
+    root.nPath = std::uint16_t(nPath);
+    root.nSeen = root.nFiles = root.nDirs = root.nBytes = 0;
+
+    this->m_fActive = true;
+    if (! this->m_fRegistered)
+        {
+        gCatena.registerObject(this);
+        this->m_fRegistered = true;
         }
 
+    return true;
+    }
+
+void
+cSdWalk::stop(
+    const char *pReason
+    )
+    {
+    // the directories are only read, so closing one from an earlier
+    // mount does no I/O; it just frees the handle.
+    while (this->m_depth > 0)
+        this->m_stack[--this->m_depth].dir.close();
+
+    if (pReason != nullptr)
+        this->m_pThis->printf("%s: %s\n", this->m_path, pReason);
+
+    this->m_fActive = false;
     gMeasurementLoop.sdFinish();
-    return result;    
     }
 
-static void
-printDirectory(
-    cCommandStream *pThis,
+void
+cSdWalk::poll()
+    {
+    if (! this->m_fActive)
+        return;
+
+    // others use the card between polls, and may have remounted it.
+    if (! gMeasurementLoop.checkSdCard())
+        {
+        this->stop("no SD card");
+        return;
+        }
+
+    if (this->m_nMount != gMeasurementLoop.getSdMountCount() && ! this->reopen())
+        {
+        this->stop("directory changed during listing");
+        return;
+        }
+
+    for (unsigned i = 0; i < kEntriesPerPoll && this->m_fActive; ++i)
+        this->step();
+    }
+
+// read one entry from the directory on top of the stack.
+void
+cSdWalk::step()
+    {
+    auto &top = this->m_stack[this->m_depth - 1];
+    unsigned const indent = 4 * (this->m_depth - 1);
+
+    File entry = top.dir.openNextFile();
+    if (! entry)
+        {
+        this->pop();
+        return;
+        }
+
+    ++top.nSeen;
+
+    if (entry.isDirectory())
+        {
+        ++top.nDirs;
+        ++this->m_nDirs;
+
+        if (! this->m_options.fSummary && this->pageLine())
+            this->m_pThis->printf(
+                "%*s%s/%s\n",
+                indent, "",
+                entry.name(),
+                this->m_options.fRecurse && this->m_depth == kMaxDepth ? " (too deep)" : ""
+                );
+
+        if (this->m_fActive &&
+            this->m_options.fRecurse &&
+            this->m_depth < kMaxDepth &&
+            this->push(entry, entry.name()))
+            return;
+        }
+    else if (this->matches(entry.name()))
+        {
+        std::uint32_t const size = entry.size();
+
+        ++top.nFiles;
+        top.nBytes += size;
+        ++this->m_nFiles;
+        this->m_nBytes += size;
+
+        if (! this->m_options.fSummary && this->pageLine())
+            this->m_pThis->printf(
+                "%*s%-16s%10lu\n",
+                indent, "",
+                entry.name(),
+                (unsigned long) size
+                );
+        }
+
+    entry.close();
+    }
+
+// enter a directory; it's owned by the stack from now on.
+bool
+cSdWalk::push(
     File &dir,
-    unsigned level,
-    bool fRecurse
+    const char *pName
     )
     {
-    while (true)
+    auto const &top = this->m_stack[this->m_depth - 1];
+    size_t nPath = top.nPath;
+    size_t const nName = std::strlen(pName);
+
+    if (nPath + 1 + nName >= sizeof(this->m_path))
+        return false;
+
+    if (this->m_path[nPath - 1] != '/')
+        this->m_path[nPath++] = '/';
+    std::memcpy(this->m_path + nPath, pName, nName + 1);
+
+    auto &frame = this->m_stack[this->m_depth++];
+    frame.dir = dir;
+    frame.nPath = std::uint16_t(nPath + nName);
+    frame.nSeen = frame.nFiles = frame.nDirs = frame.nBytes = 0;
+    return true;
+    }
+
+// leave the directory on top of the stack, having read all of it.
+void
+cSdWalk::pop()
+    {
+    auto &top = this->m_stack[this->m_depth - 1];
+
+    if (this->m_options.fSummary && this->pageLine())
+        this->m_pThis->printf(
+            "%s%s %lu files, %lu bytes, %lu dirs\n",
+            this->m_path,
+            top.nPath > 1 ? "/" : "",
+            (unsigned long) top.nFiles,
+            (unsigned long) top.nBytes,
+            (unsigned long) top.nDirs
+            );
+
+    if (! this->m_fActive)
+        return;
+
+    top.dir.close();
+    if (--this->m_depth == 0)
         {
-        File entry = dir.openNextFile();
-        if (! entry)
-            return;
+        this->finish();
+        return;
+        }
 
-        pThis->printf("%*s", 4 * level, "");
-        pThis->printf("%s", entry.name());
-        if (entry.isDirectory())
+    this->m_path[this->m_stack[this->m_depth - 1].nPath] = '\0';
+    }
+
+// after the card was remounted: open each directory on the stack
+// again, and read past the entries already seen.
+bool
+cSdWalk::reopen()
+    {
+    for (unsigned i = 0; i < this->m_depth; ++i)
+        {
+        auto &frame = this->m_stack[i];
+        char const c = this->m_path[frame.nPath];
+
+        this->m_path[frame.nPath] = '\0';
+        frame.dir.close();
+        frame.dir = gSD.open(this->m_path);
+        this->m_path[frame.nPath] = c;
+
+        if (! frame.dir)
             {
-            pThis->printf("/\n");
-            if (fRecurse)
-                printDirectory(pThis, entry, level + 1, fRecurse);
+            // stop() closes the rest.
+            this->m_depth = i;
+            return false;
             }
-        else
+
+        for (std::uint32_t n = 0; n < frame.nSeen; ++n)
             {
-            pThis->printf("%*s%10u\n", 16 - strlen(entry.name()), "", entry.size());
+            File entry = frame.dir.openNextFile();
+            if (! entry)
+                break;
+            entry.close();
             }
-        entry.close();
         }
+
+    this->m_nMount = gMeasurementLoop.getSdMountCount();
+    return true;
+    }
+
+bool
+cSdWalk::matches(
+    const char *pName
+    ) const
+    {
+    return this->m_options.pattern[0] == '\0' ||
+           globMatch(this->m_options.pattern, pName);
+    }
+
+bool
+cSdWalk::pageLine()
+    {
+    auto const n = this->m_nLines++;
+
+    if (n < this->m_options.offset)
+        return false;
+
+    if (this->m_options.count != 0 &&
+        n - this->m_options.offset >= this->m_options.count)
+        {
+        this->m_pThis->printf("-- more: --offset %lu\n", (unsigned long) n);
+        this->stop(nullptr);
+        return false;
+        }
+
+    return true;
+    }
+
+void
+cSdWalk::finish()
+    {
+    this->m_pThis->printf(
+        "%lu files, %lu bytes, %lu dirs\n",
+        (unsigned long) this->m_nFiles,
+        (unsigned long) this->m_nBytes,
+        (unsigned long) this->m_nDirs
+        );
+
+    this->m_fActive = false;
+    gMeasurementLoop.sdFinish();
     }
+
+namespace {
+
+// "*" matches any run of characters, "?" any one; case is ignored.
+bool
+globMatch(
+    const char *pPattern,
+    const char *pName
+    )
+    {
+    // where to resume after the last "*", if a later match fails.
+    const char *pStar = nullptr;
+    const char *pStarName = nullptr;
+
+    while (*pName != '\0')
+        {
+        if (*pPattern == '*')
+            {
+            pStar = ++pPattern;
+            pStarName = pName;
+            }
+        else if (*pPattern == '?' ||
+                 (*pPattern != '\0' &&
+                  std::toupper((unsigned char) *pPattern) == std::toupper((unsigned char) *pName)))
+            {
+            ++pPattern;
+            ++pName;
+            }
+        else if (pStar != nullptr)
+            {
+            pPattern = pStar;
+            pName = ++pStarName;
+            }
+        else
+            return false;
+        }
+
+    while (*pPattern == '*')
+        ++pPattern;
+
+    return *pPattern == '\0';
+    }
+
+} // namespace
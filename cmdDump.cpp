@@ -0,0 +1,404 @@
+/*
+
+Module:	cmdDump.cpp
+
+Function:
+    Print the logged records for a time range.
+
+Copyright:
+    See accompanying LICENSE file for copyright and license information.
+
+Author:
+    Dhinesh Kumar Pitchai, MCCI Corporation	November 2022
+
+*/
+
+#include "Model4916_cmd.h"
+
+#include "Model4916-MultiGas-Sensor.h"
+#include "Model4916_SdLogFormat.h"
+#include "Model4916_crc.h"
+
+#include <cstdlib>
+#include <cstring>
+
+using namespace McciCatena;
+using namespace McciModel4916;
+
+/****************************************************************************\
+|
+|   Manifest declarations
+|
+\****************************************************************************/
+
+namespace {
+
+// lets printSdRecordCsv() print to a command stream.
+class cCommandStreamPrint : public Print
+    {
+public:
+    cCommandStreamPrint(cCommandStream *pThis)
+        : m_pThis(pThis)
+        {}
+
+    ~cCommandStreamPrint()
+        {
+        this->emit();
+        }
+
+    virtual size_t write(uint8_t c) override
+        {
+        this->m_buffer[this->m_nBuffer++] = char(c);
+        if (this->m_nBuffer == sizeof(this->m_buffer))
+            this->emit();
+        return 1;
+        }
+    using Print::write;
+
+    void emit()
+        {
+        if (this->m_nBuffer != 0)
+            this->m_pThis->printf("%.*s", int(this->m_nBuffer), this->m_buffer);
+        this->m_nBuffer = 0;
+        }
+
+private:
+    cCommandStream                  *m_pThis;
+    char                            m_buffer[64];
+    size_t                          m_nBuffer = 0;
+    };
+
+} // namespace
+
+static bool parseTime(const char *s, std::uint32_t &t);
+static std::uint32_t findStart(const char *pIndex, std::uint32_t from, std::uint32_t offset);
+static bool dumpBinary(Print &out, const char *pName, std::uint32_t offset, std::uint32_t from, std::uint32_t to);
+static bool dumpCsv(Print &out, const char *pName, std::uint32_t offset, std::uint32_t from, std::uint32_t to);
+
+/*
+
+Name:   ::cmdDump()
+
+Function:
+    Command dispatcher for "dump" command.
+
+Definition:
+    McciCatena::cCommandStream::CommandFn cmdDump;
+
+    McciCatena::cCommandStream::CommandStatus cmdDump(
+        cCommandStream *pThis,
+        void *pContext,
+        int argc,
+        char **argv
+        );
+
+Description:
+    The "dump" command has the following syntax:
+
+    dump {from} [{to}]
+        Print the logged records captured from {from} to {to}
+        (inclusive), as CSV. Times are Unix seconds, or UTC in the form
+        YYYY-MM-DD[Thh:mm[:ss]]. If {to} is omitted, it's now (or the
+        end of the day of {from}, if the clock isn't set).
+
+    Only the log files for the days in the range are opened, and each
+    is entered at the last index entry before {from}, so the time taken
+    depends on the size of the range, not on the size of the logs.
+    Records logged before the clock was set can't be found by time.
+
+Returns:
+    cCommandStream::CommandStatus::kSuccess if successful.
+    Some other value for failure.
+
+*/
+
+// argv[0] is "dump"
+// argv[1] is the start of the range
+// argv[2], if present, is the end of the range
+cCommandStream::CommandStatus cmdDump(
+    cCommandStream *pThis,
+    void *pContext,
+    int argc,
+    char **argv
+    )
+    {
+    std::uint32_t from, to;
+
+    if (argc < 2 || argc > 3 || ! parseTime(argv[1], from))
+        return cCommandStream::CommandStatus::kInvalidParameter;
+
+    if (argc > 2)
+        {
+        if (! parseTime(argv[2], to))
+            return cCommandStream::CommandStatus::kInvalidParameter;
+        }
+    else if (gMeasurementLoop.isTimeValid())
+        to = gMeasurementLoop.getUnixTime();
+    else
+        to = from - from % 86400 + 86399;
+
+    if (to < from)
+        return cCommandStream::CommandStatus::kInvalidParameter;
+
+    bool fHaveCard = gMeasurementLoop.checkSdCard();
+    if (! fHaveCard)
+        {
+        pThis->printf("%s: no SD card found\n", argv[0]);
+        return cCommandStream::CommandStatus::kIoError;
+        }
+
+    // records still in RAM need to be on the card first.
+    gMeasurementLoop.flushSdLog();
+
+    unsigned nFiles = 0;
+    bool fDone = false;
+
+    do  {
+        cCommandStreamPrint out(pThis);
+
+        out.println(cMeasurementLoop::kSdCsvHeader);
+
+        for (std::uint32_t day = from / 86400; ! fDone && day <= to / 86400; ++day)
+            {
+            for (unsigned part = 0; ! fDone && part < SdLogFormat::kMaxParts; ++part)
+                {
+                bool fFound = false;
+
+                for (unsigned iFormat = 0; ! fDone && iFormat < 2; ++iFormat)
+                    {
+                    bool const fBinary = iFormat == 0;
+                    char fName[32];
+                    char fIndex[32];
+
+                    SdLogFormat::fileName(fName, sizeof(fName), day, part, fBinary ? "REC" : "CSV");
+                    if (! gSD.exists(fName))
+                        continue;
+
+                    fFound = true;
+                    ++nFiles;
+
+                    SdLogFormat::fileName(fIndex, sizeof(fIndex), day, part, fBinary ? "RCI" : "CSI");
+                    if (fBinary)
+                        fDone = dumpBinary(out, fName, findStart(fIndex, from, SdLogFormat::kSectorSize), from, to);
+                    else
+                        fDone = dumpCsv(out, fName, findStart(fIndex, from, 0), from, to);
+                    }
+
+                // parts are numbered without gaps.
+                if (! fFound)
+                    break;
+                }
+            }
+        } while (0);
+
+    if (nFiles == 0)
+        pThis->printf("%s: no logs for that range\n", argv[0]);
+
+    gMeasurementLoop.sdFinish();
+    return cCommandStream::CommandStatus::kSuccess;
+    }
+
+// Unix seconds, or YYYY-MM-DD[Thh:mm[:ss]] in UTC.
+static bool
+parseTime(
+    const char *s,
+    std::uint32_t &t
+    )
+    {
+    char *p;
+    unsigned long const v = std::strtoul(s, &p, 10);
+
+    if (p == s)
+        return false;
+    if (*p == '\0')
+        {
+        t = v;
+        return true;
+        }
+    if (*p != '-')
+        return false;
+
+    unsigned long const year = v;
+    unsigned long const month = std::strtoul(p + 1, &p, 10);
+    if (*p != '-')
+        return false;
+    unsigned long const day = std::strtoul(p + 1, &p, 10);
+
+    unsigned long hh = 0, mm = 0, ss = 0;
+    if (*p == 'T')
+        {
+        hh = std::strtoul(p + 1, &p, 10);
+        if (*p == ':')
+            {
+            mm = std::strtoul(p + 1, &p, 10);
+            if (*p == ':')
+                ss = std::strtoul(p + 1, &p, 10);
+            }
+        }
+
+    if (*p != '\0' || year < 1970 || year > 2105 ||
+        month < 1 || month > 12 || day < 1 || day > 31 ||
+        hh > 23 || mm > 59 || ss > 59)
+        return false;
+
+    t = std::uint32_t(SdLogFormat::daysFromCivil(year, month, day)) * 86400 + hh * 3600 + mm * 60 + ss;
+    return true;
+    }
+
+// the offset of the last indexed record before from; offset if there's
+// no such entry, or no index.
+static std::uint32_t
+findStart(
+    const char *pIndex,
+    std::uint32_t from,
+    std::uint32_t offset
+    )
+    {
+    File f = gSD.open(pIndex, FILE_READ);
+    if (! f)
+        return offset;
+
+    SdLogFormat::IndexEntry_t entries[8];
+    bool fDone = false;
+
+    while (! fDone)
+        {
+        int const nRead = f.read(entries, sizeof(entries));
+        if (nRead <= 0)
+            break;
+
+        for (unsigned i = 0; i < unsigned(nRead) / sizeof(entries[0]); ++i)
+            {
+            if (entries[i].time > from)
+                {
+                fDone = true;
+                break;
+                }
+            offset = entries[i].offset;
+            }
+        }
+
+    f.close();
+    return offset;
+    }
+
+// print the records of a binary log from offset on; true if we got
+// past to.
+static bool
+dumpBinary(
+    Print &out,
+    const char *pName,
+    std::uint32_t offset,
+    std::uint32_t from,
+    std::uint32_t to
+    )
+    {
+    using namespace SdLogFormat;
+    FileHeader_t header;
+    bool fDone = false;
+
+    File f = gSD.open(pName, FILE_READ);
+    if (! f)
+        return false;
+
+    if (f.read(&header, sizeof(header)) == sizeof(header) &&
+        std::memcmp(header.magic, kFileMagic, sizeof(header.magic)) == 0 &&
+        header.crc == crc32_ieee(&header, offsetof(FileHeader_t, crc)) &&
+        header.recordSize == kRecordSize)
+        {
+        static const std::uint8_t kNoEUI[sizeof(header.devEUI)] {};
+        const std::uint8_t * const pDevEUI =
+            std::memcmp(header.devEUI, kNoEUI, sizeof(kNoEUI)) == 0 ? nullptr : header.devEUI;
+        std::uint32_t i = 0;
+
+        if (offset >= kSectorSize)
+            i = (offset / kSectorSize - 1) * kRecordsPerSector + (offset % kSectorSize) / kRecordSize;
+
+        for (;; ++i)
+            {
+            Record_t record;
+
+            // the records end at the first one that isn't valid.
+            if (! f.seek(recordOffset(i)) ||
+                f.read(&record, sizeof(record)) != sizeof(record) ||
+                record.sequence != i ||
+                record.crc != crc32_ieee(&record, offsetof(Record_t, crc)))
+                break;
+
+            if (record.time > to)
+                {
+                fDone = true;
+                break;
+                }
+
+            if (record.time >= from)
+                cMeasurementLoop::printSdRecordCsv(out, pDevEUI, record);
+            }
+        }
+
+    f.close();
+    return fDone;
+    }
+
+// print the rows of a CSV log from offset on; true if we got past to.
+static bool
+dumpCsv(
+    Print &out,
+    const char *pName,
+    std::uint32_t offset,
+    std::uint32_t from,
+    std::uint32_t to
+    )
+    {
+    static char line[cMeasurementLoop::kSdCsvMaxRow];
+    static std::uint8_t chunk[64];
+    size_t nLine = 0;
+    bool fOverflow = false;
+    bool fDone = false;
+
+    File f = gSD.open(pName, FILE_READ);
+    if (! f)
+        return false;
+
+    if (! f.seek(offset))
+        {
+        f.close();
+        return false;
+        }
+
+    while (! fDone)
+        {
+        int const nRead = f.read(chunk, sizeof(chunk));
+        if (nRead <= 0)
+            break;
+
+        for (int i = 0; i < nRead && ! fDone; ++i)
+            {
+            if (nLine < sizeof(line))
+                line[nLine++] = char(chunk[i]);
+            else
+                fOverflow = true;
+
+            if (chunk[i] != '\n')
+                continue;
+
+            // a complete row: rows without a time (and the heading)
+            // don't start with a digit.
+            if (! fOverflow && line[0] >= '0' && line[0] <= '9')
+                {
+                std::uint32_t const t = std::strtoul(line, nullptr, 10);
+
+                if (t > to)
+                    fDone = true;
+                else if (t >= from)
+                    out.write((const std::uint8_t *)line, nLine);
+                }
+
+            nLine = 0;
+            fOverflow = false;
+            }
+        }
+
+    f.close();
+    return fDone;
+    }
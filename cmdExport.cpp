@@ -0,0 +1,419 @@
+/*
+
+Module:	cmdExport.cpp
+
+Function:
+    Stream a file from the SD card over the command console.
+
+Copyright:
+    See accompanying LICENSE file for copyright and license information.
+
+Author:
+    Dhinesh Kumar Pitchai, MCCI Corporation	November 2022
+
+*/
+
+#include "Model4916_cmd.h"
+
+#include "Model4916-MultiGas-Sensor.h"
+#include "Model4916_SdLogFormat.h"
+#include "Model4916_crc.h"
+
+#include <cstdio>
+#include <cstring>
+
+using namespace McciCatena;
+using namespace McciModel4916;
+
+/****************************************************************************\
+|
+|   Manifest declarations
+|
+\****************************************************************************/
+
+namespace {
+
+// sends one block of a file per poll, so the measurement loop keeps
+// running while a file is exported. The file stays open from block to
+// block; it's opened again only if the card was remounted meanwhile.
+// A frame goes out only as fast as the console takes it: each poll sends
+// what fits, and the next block is read once the frame is all out.
+class cSdExport : public cPollableObject
+    {
+public:
+    // one sector per block, so each read is a single aligned sector.
+    static constexpr size_t kBlockSize = SdLogFormat::kSectorSize;
+    // a whole data frame: "@D", offset, CRC, base64 and newline.
+    static constexpr size_t kFrameSize = 3 + 11 + 9 + 4 * ((kBlockSize + 2) / 3) + 2;
+    // most of a frame passed to one printf(), well inside its buffer.
+    static constexpr size_t kPrintChunk = 64;
+
+    bool begin(cCommandStream *pThis, const char *pName, std::uint32_t offset, std::uint32_t length);
+    void stop(const char *pReason);
+    void printStatus(cCommandStream *pThis) const;
+
+    bool isActive() const
+        {
+        return this->m_fActive;
+        }
+
+    virtual void poll() override;
+
+private:
+    bool openFile();
+    void finish();
+    void sendBlock(const std::uint8_t *pData, size_t nData);
+    bool sendFrame();
+
+    cCommandStream                  *m_pThis = nullptr;
+    char                            m_fileName[cSdLogger::kMaxFileName] {};
+    File                            m_file;
+    // the mount count m_file was opened in
+    std::uint32_t                   m_nMount = 0;
+    std::uint32_t                   m_offset = 0;
+    std::uint32_t                   m_end = 0;
+    std::uint32_t                   m_crc = 0;
+    bool                            m_fActive = false;
+    bool                            m_fRegistered = false;
+    std::uint8_t                    m_block[kBlockSize];
+    char                            m_frame[kFrameSize];
+    // the frame, and how much of it has been sent
+    size_t                          m_nFrame = 0;
+    size_t                          m_iFrame = 0;
+    };
+
+cSdExport sSdExport;
+
+} // namespace
+
+/*
+
+Name:   ::cmdExport()
+
+Function:
+    Command dispatcher for "export" command.
+
+Definition:
+    McciCatena::cCommandStream::CommandFn cmdExport;
+
+    McciCatena::cCommandStream::CommandStatus cmdExport(
+        cCommandStream *pThis,
+        void *pContext,
+        int argc,
+        char **argv
+        );
+
+Description:
+    The "export" command has the following syntax:
+
+    export {file} [{offset} [{length}]]
+        Start sending {length} bytes of {file}, from {offset}. If
+        {length} is omitted or zero, the rest of the file is sent.
+
+    export stop
+        Stop the export in progress.
+
+    export
+        Show the state of the export.
+
+    The command returns at once; the data is sent in the background, one
+    512-byte block per poll, as text frames (see
+    extra/catena-sd-export-protocol.md). Each block carries its offset
+    and CRC, so a receiver that loses a block can ask again from that
+    offset. Starting an export stops the one in progress.
+
+Returns:
+    cCommandStream::CommandStatus::kSuccess if successful.
+    Some other value for failure.
+
+*/
+
+// argv[0] is "export"
+// argv[1] is the file name, or "stop"
+// argv[2], if present, is the offset
+// argv[3], if present, is the length
+cCommandStream::CommandStatus cmdExport(
+    cCommandStream *pThis,
+    void *pContext,
+    int argc,
+    char **argv
+    )
+    {
+    std::uint32_t offset, length;
+
+    if (argc == 1)
+        {
+        sSdExport.printStatus(pThis);
+        return cCommandStream::CommandStatus::kSuccess;
+        }
+
+    if (argc == 2 && std::strcmp(argv[1], "stop") == 0)
+        {
+        if (sSdExport.isActive())
+            sSdExport.stop("stopped");
+        return cCommandStream::CommandStatus::kSuccess;
+        }
+
+    if (argc > 4)
+        return cCommandStream::CommandStatus::kInvalidParameter;
+
+    auto status = cCommandStream::getuint32(argc, argv, 2, 0, offset, 0);
+    if (status != cCommandStream::CommandStatus::kSuccess)
+        return status;
+
+    status = cCommandStream::getuint32(argc, argv, 3, 0, length, 0);
+    if (status != cCommandStream::CommandStatus::kSuccess)
+        return status;
+
+    if (std::strlen(argv[1]) >= cSdLogger::kMaxFileName)
+        return cCommandStream::CommandStatus::kInvalidParameter;
+
+    if (sSdExport.isActive())
+        sSdExport.stop("replaced");
+
+    bool fHaveCard = gMeasurementLoop.checkSdCard();
+    if (! fHaveCard)
+        {
+        pThis->printf("%s: no SD card found\n", argv[0]);
+        return cCommandStream::CommandStatus::kIoError;
+        }
+
+    // records still in RAM need to be on the card first.
+    gMeasurementLoop.flushSdLog();
+
+    if (! sSdExport.begin(pThis, argv[1], offset, length))
+        {
+        gMeasurementLoop.sdFinish();
+        pThis->printf("%s: can't read %s from %lu\n", argv[0], argv[1], (unsigned long) offset);
+        return cCommandStream::CommandStatus::kNotFound;
+        }
+
+    return cCommandStream::CommandStatus::kSuccess;
+    }
+
+/****************************************************************************\
+|
+|   The background export
+|
+\****************************************************************************/
+
+bool
+cSdExport::begin(
+    cCommandStream *pThis,
+    const char *pName,
+    std::uint32_t offset,
+    std::uint32_t length
+    )
+    {
+    File f = gSD.open(pName, FILE_READ);
+    if (! f)
+        return false;
+
+    bool const fIsDir = f.isDirectory();
+    std::uint32_t const size = fIsDir ? 0 : f.size();
+
+    if (fIsDir || offset > size || ! f.seek(offset))
+        {
+        f.close();
+        return false;
+        }
+
+    if (length == 0 || length > size - offset)
+        length = size - offset;
+
+    this->m_pThis = pThis;
+    std::strcpy(this->m_fileName, pName);
+    this->m_offset = offset;
+    this->m_end = offset + length;
+    this->m_crc = 0;
+    this->m_nFrame = this->m_iFrame = 0;
+    this->m_fActive = true;
+    this->m_file = f;
+    this->m_nMount = gMeasurementLoop.getSdMountCount();
+
+    if (! this->m_fRegistered)
+        {
+        gCatena.registerObject(this);
+        this->m_fRegistered = true;
+        }
+
+    pThis->printf(
+        "@S %s %lu %lu %lu\n",
+        pName,
+        (unsigned long) size,
+        (unsigned long) offset,
+        (unsigned long) length
+        );
+
+    return true;
+    }
+
+void
+cSdExport::stop(
+    const char *pReason
+    )
+    {
+    // end a frame cut short, so the receiver sees "@X" on its own line.
+    if (this->m_iFrame != this->m_nFrame)
+        this->m_pThis->printf("\n");
+    this->m_nFrame = this->m_iFrame = 0;
+
+    this->m_pThis->printf("@X %lu %s\n", (unsigned long) this->m_offset, pReason);
+    this->finish();
+    }
+
+void
+cSdExport::finish()
+    {
+    // the file is only read, so closing one from an earlier mount does
+    // no I/O; it just frees the handle.
+    if (this->m_file)
+        this->m_file.close();
+
+    this->m_fActive = false;
+    gMeasurementLoop.sdFinish();
+    }
+
+// open the file again in a new mount, at the next block.
+bool
+cSdExport::openFile()
+    {
+    if (this->m_file)
+        this->m_file.close();
+
+    this->m_file = gSD.open(this->m_fileName, FILE_READ);
+    if (! this->m_file)
+        return false;
+
+    this->m_nMount = gMeasurementLoop.getSdMountCount();
+    return this->m_file.seek(this->m_offset);
+    }
+
+void
+cSdExport::printStatus(
+    cCommandStream *pThis
+    ) const
+    {
+    if (! this->m_fActive)
+        pThis->printf("no export in progress\n");
+    else
+        pThis->printf(
+            "exporting %s: at %lu, %lu bytes to go\n",
+            this->m_fileName,
+            (unsigned long) this->m_offset,
+            (unsigned long) (this->m_end - this->m_offset)
+            );
+    }
+
+void
+cSdExport::poll()
+    {
+    if (! this->m_fActive)
+        return;
+
+    // finish the last frame before reading another block.
+    if (! this->sendFrame())
+        return;
+
+    if (this->m_offset >= this->m_end)
+        {
+        this->m_pThis->printf(
+            "@E %lu %08lx\n",
+            (unsigned long) this->m_offset,
+            (unsigned long) this->m_crc
+            );
+        this->finish();
+        return;
+        }
+
+    // the card may have been powered down (e.g. for sleep) since the
+    // last block.
+    if (! gMeasurementLoop.checkSdCard())
+        {
+        this->stop("no SD card");
+        return;
+        }
+
+    // stay on block boundaries after an unaligned start.
+    size_t nData = kBlockSize - this->m_offset % kBlockSize;
+    if (nData > this->m_end - this->m_offset)
+        nData = this->m_end - this->m_offset;
+
+    int nRead = -1;
+    if (this->m_nMount == gMeasurementLoop.getSdMountCount() || this->openFile())
+        nRead = this->m_file.read(this->m_block, nData);
+
+    if (nRead <= 0)
+        {
+        this->stop("read error");
+        return;
+        }
+
+    this->sendBlock(this->m_block, nRead);
+    this->m_crc = crc32_ieee(this->m_block, nRead, this->m_crc);
+    this->m_offset += nRead;
+    this->sendFrame();
+    }
+
+// one data frame: "@D {offset} {crc32} {base64}". The frame is built
+// whole in m_frame; sendFrame() then passes it to the console.
+void
+cSdExport::sendBlock(
+    const std::uint8_t *pData,
+    size_t nData
+    )
+    {
+    static const char kBase64[] =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    char * const text = this->m_frame;
+    size_t nText = std::snprintf(
+        text,
+        kFrameSize,
+        "@D %lu %08lx ",
+        (unsigned long) this->m_offset,
+        (unsigned long) crc32_ieee(pData, nData)
+        );
+
+    for (size_t i = 0; i < nData; i += 3)
+        {
+        std::uint32_t v = std::uint32_t(pData[i]) << 16;
+        if (i + 1 < nData)
+            v |= std::uint32_t(pData[i + 1]) << 8;
+        if (i + 2 < nData)
+            v |= pData[i + 2];
+
+        text[nText++] = kBase64[(v >> 18) & 0x3F];
+        text[nText++] = kBase64[(v >> 12) & 0x3F];
+        text[nText++] = i + 1 < nData ? kBase64[(v >> 6) & 0x3F] : '=';
+        text[nText++] = i + 2 < nData ? kBase64[v & 0x3F] : '=';
+        }
+
+    text[nText++] = '\n';
+    this->m_nFrame = nText;
+    this->m_iFrame = 0;
+    }
+
+// send as much of the frame as the console can take without waiting
+// for the host; the command console is on Serial. Returns true once the
+// whole frame is out.
+bool
+cSdExport::sendFrame()
+    {
+    while (this->m_iFrame < this->m_nFrame)
+        {
+        int const nRoom = Serial.availableForWrite();
+        if (nRoom <= 0)
+            return false;
+
+        size_t n = this->m_nFrame - this->m_iFrame;
+        if (n > size_t(nRoom))
+            n = nRoom;
+        if (n > kPrintChunk)
+            n = kPrintChunk;
+
+        this->m_pThis->printf("%.*s", int(n), this->m_frame + this->m_iFrame);
+        this->m_iFrame += n;
+        }
+
+    return true;
+    }
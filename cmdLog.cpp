@@ -21,9 +21,16 @@ Author:
 
 #include "Model4916_cmd.h"
 
+#include "Model4916_cLogCategory.h"
+
 #include <Catena_Log.h>
+#include <cstring>
 
 using namespace McciCatena;
+using namespace McciModel4916;
+
+static cCommandStream::CommandStatus setCategory(cCommandStream *pThis, int argc, char **argv);
+static void printCategory(cCommandStream *pThis, const cLogCategory &c);
 
 /*
 
@@ -46,11 +53,19 @@ Description:
     The "log" command has the following syntax:
 
     log
-        Display the current log mask.
+        Display the current log mask, and the level, rate limit and
+        suppressed-message count of each category.
 
     log {number}
         Set the log mask to {number}
 
+    log {category} [{level} [{rate} [{burst}]]]
+        Display or set the level of {category}: fsm, sensors, radio,
+        sd, fw-update or power, or "all". {level} is off, error,
+        warning, info or trace (or 0 to 4). If {rate} is given, at
+        most {rate} messages a second are printed, with bursts of up
+        to {burst} (default 10); rate 0 removes the limit.
+
 Returns:
     cCommandStream::CommandStatus::kSuccess if successful.
     Some other value for failure.
@@ -58,7 +73,8 @@ Returns:
 */
 
 // argv[0] is "log"
-// argv[1] is new log flag mask; if omitted, mask is printed
+// argv[1] is new log flag mask, or a category; if omitted, mask is printed
+// argv[2..4], if present, are the category's level, rate and burst
 cCommandStream::CommandStatus cmdLog(
     cCommandStream *pThis,
     void *pContext,
@@ -66,14 +82,24 @@ cCommandStream::CommandStatus cmdLog(
     char **argv
     )
     {
-    if (argc > 2)
+    if (argc > 5)
         return cCommandStream::CommandStatus::kInvalidParameter;
 
     if (argc == 1)
         {
         pThis->printf("log flags: %#x\n", gLog.getFlags());
+        for (unsigned i = 0; i < cLogCategory::kCategories; ++i)
+            printCategory(pThis, *cLogCategory::getCategory(i));
         return cCommandStream::CommandStatus::kSuccess;
         }
+    else if (argv[1][0] < '0' || argv[1][0] > '9')
+        {
+        return setCategory(pThis, argc, argv);
+        }
+    else if (argc > 2)
+        {
+        return cCommandStream::CommandStatus::kInvalidParameter;
+        }
     else
         {
         cCommandStream::CommandStatus status;
@@ -91,3 +117,67 @@ cCommandStream::CommandStatus cmdLog(
         return status;
         }
     }
+
+// argv[1] is the category, or "all"
+static cCommandStream::CommandStatus
+setCategory(
+    cCommandStream *pThis,
+    int argc,
+    char **argv
+    )
+    {
+    bool const fAll = std::strcmp(argv[1], "all") == 0;
+    cLogCategory * const pCategory = fAll ? nullptr : cLogCategory::find(argv[1]);
+
+    if (! fAll && pCategory == nullptr)
+        {
+        pThis->printf("%s: no category %s\n", argv[0], argv[1]);
+        return cCommandStream::CommandStatus::kInvalidParameter;
+        }
+
+    cLogCategory::Level level = cLogCategory::kOff;
+    if (argc > 2 && ! cLogCategory::parseLevel(argv[2], level))
+        return cCommandStream::CommandStatus::kInvalidParameter;
+
+    std::uint32_t rate, burst;
+    auto status = cCommandStream::getuint32(argc, argv, 3, 0, rate, 0);
+    if (status == cCommandStream::CommandStatus::kSuccess)
+        status = cCommandStream::getuint32(argc, argv, 4, 0, burst, 10);
+    if (status != cCommandStream::CommandStatus::kSuccess)
+        return status;
+    if (rate > UINT16_MAX || burst > UINT16_MAX)
+        return cCommandStream::CommandStatus::kInvalidParameter;
+
+    for (unsigned i = 0; i < cLogCategory::kCategories; ++i)
+        {
+        auto const pThisCategory = cLogCategory::getCategory(i);
+
+        if (! fAll && pThisCategory != pCategory)
+            continue;
+
+        if (argc > 2)
+            pThisCategory->setLevel(level);
+        if (argc > 3)
+            pThisCategory->setRate(std::uint16_t(rate), std::uint16_t(burst));
+
+        printCategory(pThis, *pThisCategory);
+        }
+
+    return cCommandStream::CommandStatus::kSuccess;
+    }
+
+static void
+printCategory(
+    cCommandStream *pThis,
+    const cLogCategory &c
+    )
+    {
+    pThis->printf("%-10s %-8s", c.getName(), cLogCategory::getLevelName(c.getLevel()));
+
+    if (c.getRatePerSec() == 0)
+        pThis->printf(" no limit");
+    else
+        pThis->printf(" %u/s burst %u", c.getRatePerSec(), c.getBurst());
+
+    pThis->printf(", %lu suppressed\n", (unsigned long) c.getSuppressed());
+    }
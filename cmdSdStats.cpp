@@ -0,0 +1,147 @@
+/*
+
+Module:	cmdSdStats.cpp
+
+Function:
+    Show the SD card timing statistics.
+
+Copyright:
+    See accompanying LICENSE file for copyright and license information.
+
+Author:
+    Dhinesh Kumar Pitchai, MCCI Corporation	November 2022
+
+*/
+
+#include "Model4916_cmd.h"
+
+#include "Model4916-MultiGas-Sensor.h"
+#include "Model4916_cSdStats.h"
+
+#include <cstring>
+
+using namespace McciCatena;
+using namespace McciModel4916;
+
+static void printMs(cCommandStream *pThis, std::uint32_t us);
+
+/*
+
+Name:   ::cmdSdStats()
+
+Function:
+    Command dispatcher for "sdstats" command.
+
+Definition:
+    McciCatena::cCommandStream::CommandFn cmdSdStats;
+
+    McciCatena::cCommandStream::CommandStatus cmdSdStats(
+        cCommandStream *pThis,
+        void *pContext,
+        int argc,
+        char **argv
+        );
+
+Description:
+    The "sdstats" command has the following syntax:
+
+    sdstats
+        For each kind of SD operation (mount, mkdir, open, write, close,
+        and end, which idles the card), show the number of operations,
+        failures, the min/mean/max time in milliseconds, and a histogram
+        of the times. Also shows the log data lost because the card
+        couldn't take it.
+
+    sdstats reset
+        Zero the statistics.
+
+Returns:
+    cCommandStream::CommandStatus::kSuccess if successful.
+    Some other value for failure.
+
+*/
+
+// argv[0] is "sdstats"
+// argv[1], if present, is "reset"
+cCommandStream::CommandStatus cmdSdStats(
+    cCommandStream *pThis,
+    void *pContext,
+    int argc,
+    char **argv
+    )
+    {
+    if (argc > 2)
+        return cCommandStream::CommandStatus::kInvalidParameter;
+
+    if (argc == 2)
+        {
+        if (std::strcmp(argv[1], "reset") != 0)
+            return cCommandStream::CommandStatus::kInvalidParameter;
+
+        gSdStats.reset();
+        return cCommandStream::CommandStatus::kSuccess;
+        }
+
+    pThis->printf("%-6s %8s %6s %9s %9s %9s  histogram (ms)\n", "phase", "count", "fail", "min", "mean", "max");
+    pThis->printf("%53s", "");
+    for (unsigned i = 0; i < cSdStats::kBuckets - 1; ++i)
+        {
+        std::uint32_t const limit = cSdStats::getBucketLimitUs(i);
+
+        if (limit < 1000)
+            pThis->printf(" <.%lu", (unsigned long) (limit / 100));
+        else
+            pThis->printf(" <%lu", (unsigned long) (limit / 1000));
+        }
+    pThis->printf(" more\n");
+
+    for (unsigned iPhase = 0; iPhase < cSdStats::kPhases; ++iPhase)
+        {
+        auto const phase = cSdStats::Phase(iPhase);
+        auto const &p = gSdStats.get(phase);
+
+        pThis->printf(
+            "%-6s %8lu %6lu",
+            cSdStats::getPhaseName(phase),
+            (unsigned long) p.nOps,
+            (unsigned long) p.nFail
+            );
+
+        if (p.nOps == 0)
+            {
+            pThis->printf("\n");
+            continue;
+            }
+
+        printMs(pThis, p.minUs);
+        printMs(pThis, p.getMeanUs());
+        printMs(pThis, p.maxUs);
+        pThis->printf(" ");
+
+        for (auto n : p.hist)
+            pThis->printf(" %lu", (unsigned long) n);
+        pThis->printf("\n");
+        }
+
+    pThis->printf(
+        "card %s, log bytes lost: %lu\n",
+        gMeasurementLoop.isSdCardUp() ? "up" : "down",
+        (unsigned long) gMeasurementLoop.getSdLost()
+        );
+
+    return cCommandStream::CommandStatus::kSuccess;
+    }
+
+// print a time in ms with three decimals, in a 10-column field.
+static void
+printMs(
+    cCommandStream *pThis,
+    std::uint32_t us
+    )
+    {
+    pThis->printf(
+        " %5lu.%03lu",
+        (unsigned long) (us / 1000),
+        (unsigned long) (us % 1000)
+        );
+    }
@@ -0,0 +1,121 @@
+/*
+
+Module:	cmdStats.cpp
+
+Function:
+    Show the counters and gauges kept by the firmware.
+
+Copyright:
+    See accompanying LICENSE file for copyright and license information.
+
+Author:
+    Dhinesh Kumar Pitchai, MCCI Corporation	November 2022
+
+*/
+
+#include "Model4916_cmd.h"
+
+#include "Model4916-MultiGas-Sensor.h"
+#include "Model4916_cSdStats.h"
+#include "Model4916_cStats.h"
+
+#include <cstring>
+
+using namespace McciCatena;
+using namespace McciModel4916;
+
+/*
+
+Name:   ::cmdStats()
+
+Function:
+    Command dispatcher for "stats" command.
+
+Definition:
+    McciCatena::cCommandStream::CommandFn cmdStats;
+
+    McciCatena::cCommandStream::CommandStatus cmdStats(
+        cCommandStream *pThis,
+        void *pContext,
+        int argc,
+        char **argv
+        );
+
+Description:
+    The "stats" command has the following syntax:
+
+    stats
+        Show every registered statistic (see Model4916_cStats.h): the
+        count for counters, the last and largest value for gauges.
+        Then, for each kind of SD operation, the count and the mean and
+        largest time in microseconds; "sdstats" has the details.
+
+    stats reset
+        Zero the statistics, including those shown by "sdstats".
+
+Returns:
+    cCommandStream::CommandStatus::kSuccess if successful.
+    Some other value for failure.
+
+*/
+
+// argv[0] is "stats"
+// argv[1], if present, is "reset"
+cCommandStream::CommandStatus cmdStats(
+    cCommandStream *pThis,
+    void *pContext,
+    int argc,
+    char **argv
+    )
+    {
+    if (argc > 2)
+        return cCommandStream::CommandStatus::kInvalidParameter;
+
+    if (argc == 2)
+        {
+        if (std::strcmp(argv[1], "reset") != 0)
+            return cCommandStream::CommandStatus::kInvalidParameter;
+
+        cStat::resetAll();
+        gSdStats.reset();
+        return cCommandStream::CommandStatus::kSuccess;
+        }
+
+    pThis->printf("%-20s %10s %10s\n", "name", "value", "max");
+
+    for (auto p = cStat::getFirst(); p != nullptr; p = p->getNext())
+        {
+        if (p->getKind() == cStat::Kind::kGauge)
+            pThis->printf(
+                "%-20s %10lu %10lu\n",
+                p->getName(),
+                (unsigned long) p->getValue(),
+                (unsigned long) p->getMax()
+                );
+        else
+            pThis->printf(
+                "%-20s %10lu\n",
+                p->getName(),
+                (unsigned long) p->getValue()
+                );
+        }
+
+    for (unsigned iPhase = 0; iPhase < cSdStats::kPhases; ++iPhase)
+        {
+        auto const phase = cSdStats::Phase(iPhase);
+        auto const &sd = gSdStats.get(phase);
+
+        if (sd.nOps == 0)
+            continue;
+
+        pThis->printf(
+            "sd.%-17s %10lu %10lu  (%lu ops)\n",
+            cSdStats::getPhaseName(phase),
+            (unsigned long) sd.getMeanUs(),
+            (unsigned long) sd.maxUs,
+            (unsigned long) sd.nOps
+            );
+        }
+
+    return cCommandStream::CommandStatus::kSuccess;
+    }
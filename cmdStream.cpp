@@ -0,0 +1,170 @@
+/*
+
+Module:	cmdStream.cpp
+
+Function:
+    Stream sensor samples to the console for calibration.
+
+Copyright:
+    See accompanying LICENSE file for copyright and license information.
+
+Author:
+    Dhinesh Kumar Pitchai, MCCI Corporation	November 2022
+
+*/
+
+#include "Model4916_cmd.h"
+
+#include "Model4916-MultiGas-Sensor.h"
+
+#include <cstring>
+
+using namespace McciCatena;
+using namespace McciModel4916;
+
+static bool parseChannels(const char *pList, std::uint8_t &channels);
+
+/*
+
+Name:   ::cmdStream()
+
+Function:
+    Command dispatcher for "stream" command.
+
+Definition:
+    McciCatena::cCommandStream::CommandFn cmdStream;
+
+    McciCatena::cCommandStream::CommandStatus cmdStream(
+        cCommandStream *pThis,
+        void *pContext,
+        int argc,
+        char **argv
+        );
+
+Description:
+    The "stream" command has the following syntax:
+
+    stream {rate} [{channels} [csv|bin]]
+        Suspend uplinks and send a sample of {channels} to the console
+        {rate} times a second (1 to 10). {channels} is a comma-separated
+        list of "gas" (the four cell voltages), "sht" (temperature and
+        humidity) and "scd" (CO2); the default is all of them. Samples
+        are CSV lines unless "bin" is given. The frames are described
+        in extra/catena-stream-format.md.
+
+    stream stop
+        Stop streaming, report the samples sent and dropped, and go
+        back to normal operation.
+
+    stream
+        Show whether streaming, and the counts so far.
+
+Returns:
+    cCommandStream::CommandStatus::kSuccess if successful.
+    Some other value for failure.
+
+*/
+
+// argv[0] is "stream"
+// argv[1] is the rate, or "stop"
+// argv[2], if present, is the channel list
+// argv[3], if present, is "csv" or "bin"
+cCommandStream::CommandStatus cmdStream(
+    cCommandStream *pThis,
+    void *pContext,
+    int argc,
+    char **argv
+    )
+    {
+    if (argc == 1)
+        {
+        pThis->printf(
+            "%s: %lu samples, %lu dropped\n",
+            gMeasurementLoop.isStreaming() ? "streaming" : "not streaming",
+            (unsigned long) gMeasurementLoop.getStreamSamples(),
+            (unsigned long) gMeasurementLoop.getStreamDropped()
+            );
+        return cCommandStream::CommandStatus::kSuccess;
+        }
+
+    if (argc == 2 && std::strcmp(argv[1], "stop") == 0)
+        {
+        gMeasurementLoop.stopStreaming();
+        return cCommandStream::CommandStatus::kSuccess;
+        }
+
+    if (argc > 4)
+        return cCommandStream::CommandStatus::kInvalidParameter;
+
+    std::uint32_t rateHz;
+    auto const status = cCommandStream::getuint32(argc, argv, 1, 0, rateHz, 0);
+    if (status != cCommandStream::CommandStatus::kSuccess)
+        return status;
+    if (rateHz == 0 || rateHz > cMeasurementLoop::kStreamMaxRateHz)
+        return cCommandStream::CommandStatus::kInvalidParameter;
+
+    std::uint8_t channels = cMeasurementLoop::kStreamChannels;
+    if (argc > 2 && ! parseChannels(argv[2], channels))
+        return cCommandStream::CommandStatus::kInvalidParameter;
+
+    bool fBinary = false;
+    if (argc > 3)
+        {
+        if (std::strcmp(argv[3], "bin") == 0)
+            fBinary = true;
+        else if (std::strcmp(argv[3], "csv") != 0)
+            return cCommandStream::CommandStatus::kInvalidParameter;
+        }
+
+    if (! gMeasurementLoop.startStreaming(std::uint8_t(rateHz), channels, fBinary))
+        {
+        pThis->printf("%s: can't start (already streaming, or stopped)\n", argv[0]);
+        return cCommandStream::CommandStatus::kError;
+        }
+
+    return cCommandStream::CommandStatus::kSuccess;
+    }
+
+// "gas,sht,scd" to SensorMask bits.
+static bool
+parseChannels(
+    const char *pList,
+    std::uint8_t &channels
+    )
+    {
+    static const struct
+        {
+        const char *pName;
+        std::uint8_t mask;
+        } kChannels[] =
+        {
+        { "gas", cMeasurementLoop::kSensorGas },
+        { "sht", cMeasurementLoop::kSensorSht3x },
+        { "scd", cMeasurementLoop::kSensorScd30 },
+        };
+
+    channels = 0;
+    while (*pList != '\0')
+        {
+        size_t const n = std::strcspn(pList, ",");
+        bool fFound = false;
+
+        for (auto const &c : kChannels)
+            {
+            if (std::strlen(c.pName) == n && std::strncmp(c.pName, pList, n) == 0)
+                {
+                channels |= c.mask;
+                fFound = true;
+                }
+            }
+
+        if (! fFound)
+            return false;
+
+        pList += n;
+        if (*pList == ',')
+            ++pList;
+        }
+
+    return channels != 0;
+    }
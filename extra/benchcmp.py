@@ -0,0 +1,97 @@
+#!/usr/bin/env python3
+#
+# Module: benchcmp.py
+#
+# Function:
+#     Compare two runs of the Model4916 microbenchmarks.
+#
+# Copyright:
+#     See accompanying LICENSE file for copyright and license information.
+#
+# Author:
+#     Dhinesh Kumar Pitchai, MCCI Corporation   November 2022
+#
+# Usage:
+#     python3 benchcmp.py [--threshold 10] baseline.csv current.csv
+#
+#     The files are the output of the "bench" command (from a terminal
+#     log) or of hostsim/hostbench. Kernels are compared by cycles per
+#     op if both runs counted cycles, otherwise by ns per op. Exits 1 if
+#     any kernel is slower than the threshold (percent), or allocates
+#     more, so it can gate a release.
+#
+
+import argparse
+import csv
+import sys
+
+
+def load(path):
+    """Return {kernel: row} from a results file; other lines (comments,
+    console chatter around the results) are skipped."""
+    results = {}
+    header = None
+
+    with open(path, newline="") as f:
+        for row in csv.reader(f):
+            if not row or row[0].startswith("#"):
+                continue
+            if row[0] == "kernel":
+                header = row
+                continue
+            if header is None or len(row) != len(header):
+                continue
+            results[row[0]] = dict(zip(header, row))
+
+    if not results:
+        raise SystemExit("%s: no results" % path)
+    return results
+
+
+def number(row, name):
+    value = row.get(name, "")
+    return float(value) if value else None
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Compare two microbenchmark runs.")
+    parser.add_argument("--threshold", type=float, default=10.0,
+                        help="percent slower that counts as a regression (10)")
+    parser.add_argument("baseline")
+    parser.add_argument("current")
+    args = parser.parse_args()
+
+    baseline = load(args.baseline)
+    current = load(args.current)
+    regressions = 0
+
+    print("%-22s %12s %12s %8s  %s" % ("kernel", "baseline", "current", "change", "unit"))
+    for name in sorted(set(baseline) | set(current)):
+        if name not in baseline or name not in current:
+            print("%-22s %s" % (name, "only in " + ("current" if name in current else "baseline")))
+            continue
+
+        old, new = baseline[name], current[name]
+        unit = "cycles_per_op"
+        if number(old, unit) is None or number(new, unit) is None:
+            unit = "ns_per_op"
+
+        a, b = number(old, unit), number(new, unit)
+        change = (b - a) * 100.0 / a if a else 0.0
+        notes = []
+        if change > args.threshold:
+            notes.append("SLOWER")
+
+        allocsA, allocsB = number(old, "allocs_per_op"), number(new, "allocs_per_op")
+        if allocsA is not None and allocsB is not None and allocsB > allocsA:
+            notes.append("ALLOCATES %.2f/op, was %.2f" % (allocsB, allocsA))
+
+        if notes:
+            regressions += 1
+        print("%-22s %12.1f %12.1f %+7.1f%%  %s %s" % (name, a, b, change, unit, " ".join(notes)))
+
+    return 1 if regressions else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
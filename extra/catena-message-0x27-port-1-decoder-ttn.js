@@ -1,5 +1,5 @@
 /*
-Name:   model4916-decoder-ttn.js
+Name:   catena-message-0x27-port-1-decoder-ttn.js
 
 Function:
     This function decodes the record (port 1, format 0x27) sent by the
@@ -33,18 +33,43 @@ function dewpoint(t, rh) {
     return tdew;
 }
 
+// decode a uflt16 at bytes[i]: 4 bits of exponent b, 12 of fraction f,
+// f / 4096 * 2^(b - 15), in [0, 1).
+function uflt16(bytes, i) {
+    var raw = (bytes[i] << 8) + bytes[i + 1];
+    var exp1 = raw >> 12;
+    var mant1 = (raw & 0xFFF) / 4096.0;
+    return mant1 * Math.pow(2, exp1 - 15);
+}
+
+// bytes of each field, in the order of the bits of the flags byte.
+var FIELD_BYTES = [2, 1, 4, 12, 14, 2, 2, 2];
+
 function Decoder(bytes, port) {
     // Decode an uplink message from a buffer
     // (array) of bytes to an object of fields.
     var decoded = {};
 
     if (port === 1) {
-        cmd = bytes[0];
+        var cmd = bytes[0];
         if (cmd == 0x27) {
+            // i is used as the index into the message. Start with the flag byte.
             var i = 1;
             // fetch the bitmap.
             var flags = bytes[i++];
 
+            // a message whose length doesn't match its flags can't be
+            // decoded reliably; don't guess.
+            var nExpected = 2;
+            for (var iField = 0; iField < 8; ++iField) {
+                if (flags & (1 << iField))
+                    nExpected += FIELD_BYTES[iField];
+            }
+            if (bytes.length !== nExpected) {
+                decoded.error = "length " + bytes.length + ", flags need " + nExpected;
+                return decoded;
+            }
+
             if (flags & 0x1) {
                 // set vRaw to a uint16, and increment pointer
                 var vRaw = (bytes[i] << 8) + bytes[i + 1];
@@ -62,27 +87,57 @@ function Decoder(bytes, port) {
                 decoded.boot = iBoot;
             }
 
-            if (flags & 0x8) {
-                // we have temp, pressure, RH
+            if (flags & 0x4) {
+                // we have temp, RH
                 var tRaw = (bytes[i] << 8) + bytes[i + 1];
                 if (tRaw & 0x8000)
                     tRaw = -0x10000 + tRaw;
                 i += 2;
-                var pRaw = (bytes[i] << 8) + bytes[i + 1];
+                var hRaw = (bytes[i] << 8) + bytes[i + 1];
                 i += 2;
-                var hRaw = bytes[i++];
 
                 decoded.tempC = tRaw / 256;
-                decoded.error = "none";
-                decoded.p = pRaw * 4 / 100.0;
-                decoded.rh = hRaw / 256 * 100;
+                decoded.rh = hRaw * 100 / 65535;
                 decoded.tDewC = dewpoint(decoded.tempC, decoded.rh);
             }
 
-			// To Be Continued
+            if (flags & 0x8) {
+                // time, then latitude and longitude in 10^-7 degrees.
+                decoded.time = ((bytes[i] << 24) >>> 0) + (bytes[i + 1] << 16) + (bytes[i + 2] << 8) + bytes[i + 3];
+                i += 4;
+                decoded.lat = ((bytes[i] << 24) | (bytes[i + 1] << 16) | (bytes[i + 2] << 8) | bytes[i + 3]) / 1e7;
+                i += 4;
+                decoded.lon = ((bytes[i] << 24) | (bytes[i + 1] << 16) | (bytes[i + 2] << 8) | bytes[i + 3]) / 1e7;
+                i += 4;
+            }
+
+            if (flags & 0x10) {
+                // particle mass, ug/m3.
+                var pmNames = ["0.1", "0.3", "0.5", "1.0", "2.5", "5.0", "10"];
+                decoded.pm = {};
+                for (var iPm = 0; iPm < pmNames.length; ++iPm) {
+                    decoded.pm[pmNames[iPm]] = uflt16(bytes, i) * 65536;
+                    i += 2;
+                }
+            }
+
+            if (flags & 0x20) {
+                decoded.co2ppm = uflt16(bytes, i) * 40000;
+                i += 2;
+            }
+
+            if (flags & 0x40) {
+                decoded.coPpm = uflt16(bytes, i) * 1000;
+                i += 2;
+            }
+
+            if (flags & 0x80) {
+                decoded.no2Ppm = uflt16(bytes, i) * 4;
+                i += 2;
+            }
 
         } else {
-            // nothing
+            decoded.error = "not format 0x27";
         }
     }
     return decoded;
@@ -0,0 +1,186 @@
+/*
+
+Module: hostbench.cpp
+
+Function:
+    Time the sketch's encoding, conversion and formatting kernels on a
+    host.
+
+Copyright:
+    See accompanying LICENSE file for copyright and license information.
+
+Author:
+    Dhinesh Kumar Pitchai, MCCI Corporation   November 2022
+
+Usage:
+    hostbench [--ms {n}] [--filter {prefix}] > results.csv
+
+    Runs the kernels of cMeasurementLoop::runBench(), as the "bench"
+    command does on the device, with the host's steady clock, and
+    counts the allocations each one makes. See README.md.
+
+*/
+
+#include "hostsim.h"
+
+#include "../../Model4916-MultiGas-Sensor.h"
+#include "../../Model4916_cBench.h"
+#include "../../Model4916_cLogCategory.h"
+#include "../../Model4916_cMeasurementLoop.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+using namespace McciCatena;
+using namespace McciModel4916;
+
+/****************************************************************************\
+|
+|   Allocations
+|
+\****************************************************************************/
+
+namespace {
+
+std::uint32_t sAllocations;
+
+std::uint32_t getAllocations()
+    {
+    return sAllocations;
+    }
+
+void *allocate(std::size_t n)
+    {
+    ++sAllocations;
+    if (auto const p = std::malloc(n != 0 ? n : 1))
+        return p;
+    throw std::bad_alloc();
+    }
+
+} // namespace
+
+void *operator new(std::size_t n)
+    {
+    return allocate(n);
+    }
+
+void *operator new[](std::size_t n)
+    {
+    return allocate(n);
+    }
+
+void operator delete(void *p) noexcept
+    {
+    std::free(p);
+    }
+
+void operator delete[](void *p) noexcept
+    {
+    std::free(p);
+    }
+
+void operator delete(void *p, std::size_t) noexcept
+    {
+    std::free(p);
+    }
+
+void operator delete[](void *p, std::size_t) noexcept
+    {
+    std::free(p);
+    }
+
+/****************************************************************************\
+|
+|   Output
+|
+\****************************************************************************/
+
+namespace {
+
+class cStdoutPrint : public Print
+    {
+public:
+    virtual size_t write(std::uint8_t c) override
+        {
+        return std::fputc(c, stdout) == EOF ? 0 : 1;
+        }
+
+    virtual size_t write(const std::uint8_t *p, size_t n) override
+        {
+        return std::fwrite(p, 1, n, stdout);
+        }
+    using Print::write;
+    };
+
+std::uint64_t readNs()
+    {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()
+                ).count();
+    }
+
+const char * const kUsage =
+    "usage: hostbench [options]\n"
+    "  --ms {n}            time per kernel, in milliseconds (200)\n"
+    "  --filter {prefix}   only the kernels whose names start with prefix\n";
+
+} // namespace
+
+/****************************************************************************\
+|
+|   main
+|
+\****************************************************************************/
+
+int main(int argc, char **argv)
+    {
+    std::uint32_t msPerKernel = 200;
+    const char *pFilter = nullptr;
+
+    for (int i = 1; i < argc; ++i)
+        {
+        if (std::strcmp(argv[i], "--ms") == 0 && i + 1 < argc)
+            msPerKernel = std::uint32_t(std::strtoul(argv[++i], nullptr, 0));
+        else if (std::strcmp(argv[i], "--filter") == 0 && i + 1 < argc)
+            pFilter = argv[++i];
+        else
+            {
+            std::fputs(kUsage, stderr);
+            return 2;
+            }
+        }
+
+    if (msPerKernel == 0)
+        {
+        std::fputs(kUsage, stderr);
+        return 2;
+        }
+
+    // bring the loop up as the sketch does, on the virtual clock, with
+    // the console and the logs out of the way of the results.
+    HostSim::gOptions.fEcho = false;
+    for (unsigned i = 0; i < cLogCategory::kCategories; ++i)
+        cLogCategory::getCategory(i)->setLevel(cLogCategory::kWarning);
+
+    gCatena.begin();
+    gMeasurementLoop.begin();
+
+    cBench::Clock_t const clock { readNs, 1000000000, false };
+    cStdoutPrint out;
+    cBench bench(out, clock, msPerKernel);
+
+    bench.setAllocationCounter(getAllocations);
+    bench.setFilter(pFilter);
+    gMeasurementLoop.runBench(bench);
+
+    if (bench.getCount() == 0)
+        {
+        std::fprintf(stderr, "no kernel matches %s\n", pFilter);
+        return 1;
+        }
+
+    return 0;
+    }
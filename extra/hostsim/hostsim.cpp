@@ -0,0 +1,488 @@
+/*
+
+Module: hostsim.cpp
+
+Function:
+    Run the Model4916 measurement loop on a host, on a virtual clock.
+
+Copyright:
+    See accompanying LICENSE file for copyright and license information.
+
+Author:
+    Dhinesh Kumar Pitchai, MCCI Corporation   November 2022
+
+Usage:
+    hostsim [options]
+
+    Builds the sketch's globals, runs the same setup as the sketch, and
+    calls gCatena.poll() until the simulated time is up; then prints
+    what happened, and the sketch's own statistics. See README.md.
+
+*/
+
+#include "hostsim.h"
+
+#include "../../Model4916-MultiGas-Sensor.h"
+#include "../../Model4916_cLogCategory.h"
+#include "../../Model4916_cMeasurementLoop.h"
+#include "../../Model4916_cSdStats.h"
+#include "../../Model4916_cStats.h"
+
+#include <arduino_lmic.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+using namespace McciCatena;
+using namespace McciModel4916;
+using namespace McciCatenaScd30;
+
+/****************************************************************************\
+|
+|   Options
+|
+\****************************************************************************/
+
+namespace {
+
+const char * const kUsage =
+    "usage: hostsim [options]\n"
+    "  --days {n}          simulate n days (default 7); also --hours\n"
+    "  --tick {ms}         device time per pass of the main loop (10)\n"
+    "  --seed {n}          random seed\n"
+    "  --drift {ppm}       device clock error\n"
+    "  --loss {percent}    uplinks lost\n"
+    "  --dr {n}            data rate, 0..4 (3)\n"
+    "  --no-network-time   the network doesn't answer DeviceTimeReq\n"
+    "  --no-sd             no card in the slot\n"
+    "  --attended          a terminal on USB: no deep sleep\n"
+    "  --flags {hex}       operating flags (default 1: unattended)\n"
+    "  --downlink {s}:{port}:{hex}\n"
+    "                      send a downlink after the first uplink at s seconds\n"
+    "  --log {category}={level}\n"
+    "                      log level for a category (all are 'warning')\n"
+    "  --quiet             don't echo the console\n"
+    "  --sd-out {dir}      write the card's files to dir at the end\n"
+    "  --interval {s}      uplink interval, as set by downlink\n"
+    "  --profile {file}    currents and battery for the energy report\n"
+    "  --set {name}={value}\n"
+    "                      one profile value\n"
+    "  --replay {file}     read the sensors from a trace (.TRC) until it ends\n"
+    "  --uplinks {file}    write each uplink to file, as time,port,hex\n";
+
+struct Args_t
+    {
+    std::uint64_t durationSec = 7 * 86400;
+    bool fDuration = false;
+    std::uint32_t operatingFlags = CatenaBase::fUnattended;
+    const char *pSdOut = nullptr;
+    std::uint32_t txCycleSec = 0;
+    };
+
+bool parseHex(const char *p, std::uint8_t *pBuffer, size_t &nBuffer)
+    {
+    size_t n = 0;
+
+    while (p[0] != '\0')
+        {
+        unsigned v;
+
+        if (p[1] == '\0' || n == nBuffer || std::sscanf(p, "%2x", &v) != 1)
+            return false;
+        pBuffer[n++] = std::uint8_t(v);
+        p += 2;
+        }
+
+    nBuffer = n;
+    return true;
+    }
+
+bool parseDownlink(const char *pArg)
+    {
+    unsigned long atSec;
+    unsigned port;
+    int nConsumed = 0;
+    std::uint8_t buffer[242];
+    size_t nBuffer = sizeof(buffer);
+
+    if (std::sscanf(pArg, "%lu:%u:%n", &atSec, &port, &nConsumed) != 2 || nConsumed == 0 ||
+        ! parseHex(pArg + nConsumed, buffer, nBuffer))
+        return false;
+
+    return HostSim::queueDownlink(std::uint32_t(atSec), std::uint8_t(port), buffer, nBuffer);
+    }
+
+bool parseLogLevel(const char *pArg)
+    {
+    char name[16];
+    auto const pEquals = std::strchr(pArg, '=');
+    cLogCategory::Level level;
+
+    if (pEquals == nullptr || size_t(pEquals - pArg) >= sizeof(name))
+        return false;
+
+    std::memcpy(name, pArg, pEquals - pArg);
+    name[pEquals - pArg] = '\0';
+    if (! cLogCategory::parseLevel(pEquals + 1, level))
+        return false;
+
+    if (std::strcmp(name, "all") == 0)
+        {
+        for (unsigned i = 0; i < cLogCategory::kCategories; ++i)
+            cLogCategory::getCategory(i)->setLevel(level);
+        return true;
+        }
+
+    auto const pCategory = cLogCategory::find(name);
+    if (pCategory == nullptr)
+        return false;
+    pCategory->setLevel(level);
+    return true;
+    }
+
+bool parseArgs(int argc, char **argv, Args_t &args)
+    {
+    auto &options = HostSim::gOptions;
+
+    // a long run at the sketch's defaults would print every transition.
+    for (unsigned i = 0; i < cLogCategory::kCategories; ++i)
+        cLogCategory::getCategory(i)->setLevel(cLogCategory::kWarning);
+
+    for (int i = 1; i < argc; ++i)
+        {
+        const char * const pArg = argv[i];
+        const char * const pValue = i + 1 < argc ? argv[i + 1] : nullptr;
+        auto const isOption = [pArg, pValue](const char *pName)
+            {
+            return std::strcmp(pArg, pName) == 0 && pValue != nullptr;
+            };
+
+        if (isOption("--days"))
+            {
+            args.durationSec = std::strtoull(pValue, nullptr, 0) * 86400;
+            args.fDuration = true;
+            }
+        else if (isOption("--hours"))
+            {
+            args.durationSec = std::strtoull(pValue, nullptr, 0) * 3600;
+            args.fDuration = true;
+            }
+        else if (isOption("--tick"))
+            options.tickUs = std::uint32_t(std::strtoul(pValue, nullptr, 0) * 1000);
+        else if (isOption("--seed"))
+            HostSim::setSeed(std::uint32_t(std::strtoul(pValue, nullptr, 0)));
+        else if (isOption("--drift"))
+            options.driftPpm = std::int32_t(std::strtol(pValue, nullptr, 0));
+        else if (isOption("--loss"))
+            options.lossPercent = unsigned(std::strtoul(pValue, nullptr, 0));
+        else if (isOption("--dr"))
+            options.datarate = std::uint8_t(std::strtoul(pValue, nullptr, 0));
+        else if (isOption("--flags"))
+            args.operatingFlags = std::uint32_t(std::strtoul(pValue, nullptr, 16));
+        else if (isOption("--downlink"))
+            {
+            if (! parseDownlink(pValue))
+                {
+                std::fprintf(stderr, "bad downlink: %s\n", pValue);
+                return false;
+                }
+            }
+        else if (isOption("--log"))
+            {
+            if (! parseLogLevel(pValue))
+                {
+                std::fprintf(stderr, "bad log level: %s\n", pValue);
+                return false;
+                }
+            }
+        else if (isOption("--sd-out"))
+            args.pSdOut = pValue;
+        else if (isOption("--interval"))
+            args.txCycleSec = std::uint32_t(std::strtoul(pValue, nullptr, 0));
+        else if (isOption("--profile"))
+            {
+            if (! HostSim::loadEnergyProfile(pValue))
+                return false;
+            }
+        else if (isOption("--set"))
+            {
+            if (! HostSim::setEnergyProfileValue(pValue))
+                {
+                std::fprintf(stderr, "bad profile setting: %s\n", pValue);
+                return false;
+                }
+            }
+        else if (isOption("--replay"))
+            {
+            if (! HostSim::loadTrace(pValue))
+                return false;
+            }
+        else if (isOption("--uplinks"))
+            {
+            if (! HostSim::openUplinkLog(pValue))
+                return false;
+            }
+        else if (std::strcmp(pArg, "--no-network-time") == 0)
+            {
+            options.fNetworkTime = false;
+            continue;
+            }
+        else if (std::strcmp(pArg, "--no-sd") == 0)
+            {
+            options.fSdCard = false;
+            continue;
+            }
+        else if (std::strcmp(pArg, "--attended") == 0)
+            {
+            options.fAttended = true;
+            continue;
+            }
+        else if (std::strcmp(pArg, "--quiet") == 0)
+            {
+            options.fEcho = false;
+            continue;
+            }
+        else
+            {
+            std::fputs(kUsage, stderr);
+            return false;
+            }
+
+        // the option took a value.
+        ++i;
+        }
+
+    // a replay starts when the trace does, measures as often, and runs
+    // until it ends, unless told otherwise.
+    if (HostSim::isReplaying())
+        {
+        auto const intervalSec = HostSim::getTraceIntervalSec();
+
+        if (HostSim::getTraceStartTime() != 0)
+            options.unixStart = HostSim::getTraceStartTime();
+        if (args.txCycleSec == 0 && intervalSec >= 10 && intervalSec <= 0xFFFF)
+            args.txCycleSec = intervalSec;
+        if (! args.fDuration)
+            args.durationSec = ~std::uint64_t(0) / 1000000;
+        }
+
+    if (options.tickUs == 0 || options.datarate > 4 || options.lossPercent > 100 ||
+        options.driftPpm <= -1000000 || args.txCycleSec > 0xFFFF)
+        {
+        std::fputs(kUsage, stderr);
+        return false;
+        }
+
+    return true;
+    }
+
+/****************************************************************************\
+|
+|   The sketch's setup()
+|
+\****************************************************************************/
+
+void receiveMessage(void *pContext, std::uint8_t port, const std::uint8_t *pMessage, size_t nMessage)
+    {
+    gMeasurementLoop.processDownlink(port, pMessage, nMessage);
+    }
+
+void setup()
+    {
+    auto const &profile = HostSim::gEnergyProfile;
+
+    HostSim::setLoad(HostSim::Load::kBoard, profile.board);
+    HostSim::setLoad(HostSim::Load::kMcu, profile.mcuRun);
+
+    gCatena.begin();
+    gCatena.SafePrintf("Model4916 host simulation\n");
+
+    gSPI2.begin();
+    if (gFlash.begin(&gSPI2, Catena::PIN_SPI2_FLASH_SS))
+        {
+        gMeasurementLoop.registerSecondSpi(&gSPI2);
+        gFlash.powerDown();
+        }
+
+    gDownload.begin(gFlash, gBootloaderApi);
+    gMeasurementLoop.begin();
+
+    gLoRaWAN.begin(&gCatena);
+    gCatena.registerObject(&gLoRaWAN);
+    gLoRaWAN.SetReceiveBufferBufferCb(receiveMessage);
+    LMIC_setClockError(5 * MAX_CLOCK_ERROR / 100);
+
+    gMeasurementLoop.requestActive(true);
+    }
+
+// set the uplink interval the way an operator would: by the port 2
+// command, which also saves it in FRAM. The sketch acknowledges it on
+// its next uplink.
+void setTxCycle(std::uint32_t txCycleSec)
+    {
+    std::uint8_t const message[] =
+        {
+        0,                  // sequence
+        0x01,               // set the uplink interval
+        std::uint8_t(txCycleSec >> 8),
+        std::uint8_t(txCycleSec)
+        };
+
+    gMeasurementLoop.processDownlink(2, message, sizeof(message));
+    }
+
+// start a replay with the sensors and calibration the device had.
+void setTraceConfig()
+    {
+    std::uint8_t message[64];
+    auto const nMessage = HostSim::getTraceConfigMessage(message, sizeof(message));
+
+    if (nMessage != 0)
+        gMeasurementLoop.processDownlink(2, message, nMessage);
+    }
+
+/****************************************************************************\
+|
+|   The report
+|
+\****************************************************************************/
+
+void printDuration(const char *pLabel, std::uint64_t us)
+    {
+    auto const sec = us / 1000000;
+
+    std::printf(
+        "%-22s %lud %02u:%02u:%02u\n",
+        pLabel,
+        (unsigned long)(sec / 86400),
+        unsigned(sec / 3600 % 24),
+        unsigned(sec / 60 % 60),
+        unsigned(sec % 60)
+        );
+    }
+
+void report(double wallSec)
+    {
+    auto const &c = HostSim::gCounters;
+    auto const trueUs = HostSim::getTrueUs();
+    unsigned nFiles, nDirs;
+    std::uint64_t nSdBytes;
+
+    std::printf("\n---- hostsim ----\n");
+    printDuration("simulated", trueUs);
+    std::printf("%-22s %.2f s (%.0fx)\n", "wall clock", wallSec, wallSec > 0 ? trueUs / 1e6 / wallSec : 0.0);
+    std::printf("%-22s %llu\n", "polls", (unsigned long long) c.nPolls);
+    printDuration("deep sleep", c.usDeepSleep);
+    std::printf(
+        "%-22s %.1f%% (%lu sleeps)\n",
+        "asleep",
+        trueUs == 0 ? 0.0 : 100.0 * c.usDeepSleep / trueUs,
+        (unsigned long) c.nDeepSleeps
+        );
+    std::printf(
+        "%-22s %lu (port 1 %lu, 2 %lu, 3 %lu, other %lu), %lu bytes\n",
+        "uplinks",
+        (unsigned long)(c.nUplinks[0] + c.nUplinks[1] + c.nUplinks[2] + c.nUplinks[3]),
+        (unsigned long) c.nUplinks[1],
+        (unsigned long) c.nUplinks[2],
+        (unsigned long) c.nUplinks[3],
+        (unsigned long) c.nUplinks[0],
+        (unsigned long) c.nUplinkBytes
+        );
+    std::printf(
+        "%-22s %lu delivered, %lu failed; %lu transmissions, %.1f s on air\n",
+        "",
+        (unsigned long) c.nDelivered,
+        (unsigned long) c.nSendFailed,
+        (unsigned long) c.nTransmissions,
+        c.usAirtime / 1e6
+        );
+    std::printf("%-22s %lu\n", "downlinks", (unsigned long) c.nDownlinks);
+    std::printf("%-22s %lu bytes\n", "console", (unsigned long) c.nConsoleBytes);
+
+    HostSim::getSdUsage(nFiles, nDirs, nSdBytes);
+    std::printf(
+        "%-22s %u files, %u directories, %llu bytes\n",
+        "sd card",
+        nFiles,
+        nDirs,
+        (unsigned long long) nSdBytes
+        );
+
+    // the same as the "stats" command.
+    std::printf("\n%-22s %10s %10s\n", "statistic", "value", "max");
+    for (auto p = cStat::getFirst(); p != nullptr; p = p->getNext())
+        {
+        if (p->getKind() == cStat::Kind::kGauge)
+            std::printf(
+                "%-22s %10lu %10lu\n",
+                p->getName(),
+                (unsigned long) p->getValue(),
+                (unsigned long) p->getMax()
+                );
+        else
+            std::printf("%-22s %10lu\n", p->getName(), (unsigned long) p->getValue());
+        }
+
+    for (unsigned iPhase = 0; iPhase < cSdStats::kPhases; ++iPhase)
+        {
+        auto const phase = cSdStats::Phase(iPhase);
+        auto const &sd = gSdStats.get(phase);
+
+        if (sd.nOps == 0)
+            continue;
+
+        std::printf(
+            "sd.%-19s %10lu %10lu  (%lu ops)\n",
+            cSdStats::getPhaseName(phase),
+            (unsigned long) sd.getMeanUs(),
+            (unsigned long) sd.maxUs,
+            (unsigned long) sd.nOps
+            );
+        }
+
+    HostSim::printEnergyReport();
+    if (HostSim::gOptions.fAttended)
+        std::printf("%-22s on USB power, not the battery\n", "");
+    }
+
+} // namespace
+
+/****************************************************************************\
+|
+|   main
+|
+\****************************************************************************/
+
+int main(int argc, char **argv)
+    {
+    Args_t args;
+
+    if (! parseArgs(argc, argv, args))
+        return 2;
+
+    gCatena.SetOperatingFlags(args.operatingFlags);
+
+    auto const tStart = std::chrono::steady_clock::now();
+    std::uint64_t const endUs = args.durationSec * 1000000;
+
+    setup();
+    if (args.txCycleSec != 0)
+        setTxCycle(args.txCycleSec);
+    if (HostSim::isReplaying())
+        setTraceConfig();
+
+    while (HostSim::getTrueUs() < endUs && ! HostSim::isTraceDone())
+        gCatena.poll();
+
+    std::chrono::duration<double> const wall = std::chrono::steady_clock::now() - tStart;
+    std::fflush(stdout);
+    report(wall.count());
+
+    if (args.pSdOut != nullptr && ! HostSim::saveSdCard(args.pSdOut))
+        return 1;
+
+    return 0;
+    }
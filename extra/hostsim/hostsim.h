@@ -0,0 +1,256 @@
+/*
+
+Module: hostsim.h
+
+Function:
+    The Model4916 host simulation: virtual clock and world model.
+
+Copyright:
+    See accompanying LICENSE file for copyright and license information.
+
+Author:
+    Dhinesh Kumar Pitchai, MCCI Corporation   November 2022
+
+Notes:
+    The stand-in libraries in include/ call these; the sketch never
+    does, so it's compiled exactly as it is for the device.
+
+*/
+
+#ifndef _hostsim_h_
+# define _hostsim_h_
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace McciModel4916 {
+namespace SdLogFormat {
+struct TraceRecord_t;
+} // namespace SdLogFormat
+} // namespace McciModel4916
+
+namespace HostSim {
+
+/****************************************************************************\
+|
+|   The virtual clock
+|
+\****************************************************************************/
+
+// There are two clocks. True time is the world's; it drives the
+// environment and the network. Device time is what millis() and
+// micros() count, and runs fast or slow by the simulated crystal error.
+// Nothing happens between calls: time passes only when the sketch
+// spends it, in a poll, a delay, a bus transfer, or a deep sleep.
+std::uint64_t getTrueUs();
+std::uint64_t getDeviceUs();
+
+// the sketch spends us microseconds of device time.
+void spendUs(std::uint64_t us);
+
+// seconds since the Unix epoch, in true time.
+std::uint32_t getUnixTime();
+
+/****************************************************************************\
+|
+|   Options
+|
+\****************************************************************************/
+
+struct Options_t
+    {
+    // device time taken by each Catena::poll()
+    std::uint32_t                   tickUs = 10 * 1000;
+    // crystal error of the device clock, parts per million
+    std::int32_t                    driftPpm = 0;
+    // true time at the start of the simulation
+    std::uint32_t                   unixStart = 1667260800;     // 2022-11-01
+    // uplinks (or their acks) lost, in percent
+    unsigned                        lossPercent = 0;
+    // data rate the network has us at
+    std::uint8_t                    datarate = 3;
+    // whether the network answers DeviceTimeReq
+    bool                            fNetworkTime = true;
+    // whether a card is in the slot
+    bool                            fSdCard = true;
+    // a terminal on USB: keeps the sketch out of deep sleep
+    bool                            fAttended = false;
+    // copy the console to stdout
+    bool                            fEcho = true;
+    };
+
+extern Options_t gOptions;
+
+/****************************************************************************\
+|
+|   What happened
+|
+\****************************************************************************/
+
+struct Counters_t
+    {
+    std::uint64_t                   nPolls;
+    std::uint32_t                   nDeepSleeps;
+    std::uint64_t                   usDeepSleep;
+    // uplinks by port (0 for any other), and what reached the network
+    std::uint32_t                   nUplinks[4];
+    std::uint32_t                   nUplinkBytes;
+    std::uint32_t                   nDelivered;
+    std::uint32_t                   nSendFailed;
+    std::uint32_t                   nTransmissions;
+    std::uint64_t                   usAirtime;
+    std::uint32_t                   nDownlinks;
+    std::uint32_t                   nConsoleBytes;
+    };
+
+extern Counters_t gCounters;
+
+/****************************************************************************\
+|
+|   The world
+|
+\****************************************************************************/
+
+// what the sensors see now: a daily cycle, with CO2 from people in the
+// room on weekday office hours, and noise.
+struct Environment_t
+    {
+    float                           TempC;
+    float                           RH;
+    float                           CO2ppm;
+    float                           PM25;
+    // CO, NO2, O3, SO2
+    float                           gasPpm[4];
+    };
+
+void getEnvironment(Environment_t &env);
+
+// a repeatable random stream.
+void setSeed(std::uint32_t seed);
+std::uint32_t random32();
+// true with the given probability, in percent.
+bool chance(unsigned percent);
+// normally distributed, mean 0.
+float gaussian(float sigma);
+
+// a downlink to deliver after the first uplink at or after atSec
+// seconds of true time.
+bool queueDownlink(std::uint32_t atSec, std::uint8_t port, const std::uint8_t *pData, size_t nData);
+// the next downlink due now, if any.
+bool takeDownlink(std::uint8_t &port, std::uint8_t *pBuffer, size_t &nBuffer);
+
+// the card: what's on it, and a copy in a host directory.
+void getSdUsage(unsigned &nFiles, unsigned &nDirs, std::uint64_t &nBytes);
+bool saveSdCard(const char *pDirectory);
+
+/****************************************************************************\
+|
+|   Energy
+|
+\****************************************************************************/
+
+// what draws current from the battery. The stand-ins set each one's
+// current as the part changes state; the ledger integrates over true
+// time. The radio is charged a lump per transmission.
+enum class Load : unsigned
+    {
+    kBoard,         // regulators, FRAM, expanders: always on
+    kMcu,
+    kSht3x,
+    kScd30,
+    kIps7100,
+    kGas,           // the ADS131M04 and the cells' bias
+    kGps,
+    kRadio,
+    kSd,
+    kLoads          // the number of loads
+    };
+
+// currents in microamps, from the parts' data sheets; measure a board
+// and load its own with --profile. See README.md.
+struct EnergyProfile_t
+    {
+    float                           board = 25.0f;
+    float                           mcuRun = 6000.0f;       // 32 MHz, peripherals on
+    float                           mcuStop = 2.0f;         // stop mode, RTC running
+    float                           sht3x = 800.0f;         // while measuring
+    float                           scd30 = 19000.0f;       // mean, measuring every 2 s
+    float                           ips7100 = 40000.0f;     // fan and laser
+    float                           gas = 1200.0f;
+    float                           gpsAcquire = 29000.0f;
+    float                           gpsBackup = 30.0f;      // between fixes
+    float                           radioTx = 120000.0f;    // +20 dBm
+    float                           radioRx = 11500.0f;
+    float                           radioRxMs = 60.0f;      // listening, per transmission
+    float                           sdIdle = 1000.0f;       // mounted
+    float                           sdActive = 30000.0f;
+    float                           batteryMah = 2600.0f;
+    float                           batteryUsablePercent = 80.0f;
+    float                           selfDischargePercentPerYear = 3.0f;
+    };
+
+extern EnergyProfile_t gEnergyProfile;
+
+// set one value, as "name=value"; or read a file of them, one a line,
+// with # comments.
+bool setEnergyProfileValue(const char *pSetting);
+bool loadEnergyProfile(const char *pPath);
+
+// from now, the load draws uA.
+void setLoad(Load load, float uA);
+// from now, the load draws uA for us microseconds, then uAAfter.
+void setLoadFor(Load load, float uA, std::uint64_t us, float uAAfter);
+// a charge drawn all at once, in microamp-microseconds.
+void addCharge(Load load, double uAus);
+
+// the sketch's FSM is now in the named state; the time and charge that
+// follow are charged to it. Returns the state it was in.
+const char *setEnergyState(const char *pName);
+
+// the breakdown, and the projected battery life.
+void printEnergyReport();
+
+/****************************************************************************\
+|
+|   Replay
+|
+\****************************************************************************/
+
+using TraceRecord_t = McciModel4916::SdLogFormat::TraceRecord_t;
+
+// read a sensor trace captured on a device (see
+// ../catena-sd-trace-format.md). While one is loaded, the sensors
+// return its readings instead of the modelled room's.
+bool loadTrace(const char *pPath);
+bool isReplaying();
+
+// a measurement is starting: move to the next record. Returns false,
+// and sets the trace done, if there isn't one.
+bool nextTraceRecord();
+bool isTraceDone();
+
+// the record being measured. The SCD30 is read before each measurement
+// starts, so it reads the record that comes next.
+const TraceRecord_t &getTraceRecord();
+const TraceRecord_t &getNextTraceRecord();
+
+// a port 2 message that sets the sensor mask and gas calibration of
+// the first record; changes after that are sent as downlinks, as an
+// operator would have. Returns the size of the message.
+size_t getTraceConfigMessage(std::uint8_t *pBuffer, size_t nBuffer);
+
+// what the first records suggest: the time the device started at, and
+// the uplink interval; 0 if they don't say.
+std::uint32_t getTraceStartTime();
+std::uint32_t getTraceIntervalSec();
+
+// write each uplink to a file, one per line as "time,port,hex", so two
+// runs can be compared with diff.
+bool openUplinkLog(const char *pPath);
+void logUplink(std::uint8_t port, const std::uint8_t *pBuffer, size_t nBuffer);
+
+} // namespace HostSim
+
+#endif /* _hostsim_h_ */
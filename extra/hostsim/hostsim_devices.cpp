@@ -0,0 +1,493 @@
+/*
+
+Module: hostsim_devices.cpp
+
+Function:
+    Host simulation: the environment, and the sensors that measure it.
+
+Copyright:
+    See accompanying LICENSE file for copyright and license information.
+
+Author:
+    Dhinesh Kumar Pitchai, MCCI Corporation   November 2022
+
+*/
+
+#include "hostsim.h"
+
+#include "../../Model4916_SdLogFormat.h"
+
+#include <Arduino.h>
+#include <Catena-SHT3x.h>
+#include <MCCI_Catena_ADS131M04.h>
+#include <MCCI_Catena_IPS-7100.h>
+#include <MCCI_Catena_SAM-M8Q.h>
+#include <MCCI_Catena_SCD30.h>
+
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+/****************************************************************************\
+|
+|   Random numbers
+|
+\****************************************************************************/
+
+namespace {
+
+// xorshift32: small, fast, and the same on every host.
+std::uint32_t sRandomState = 4916;
+
+} // namespace
+
+void HostSim::setSeed(std::uint32_t seed)
+    {
+    sRandomState = seed != 0 ? seed : 4916;
+    }
+
+std::uint32_t HostSim::random32()
+    {
+    auto x = sRandomState;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    sRandomState = x;
+    return x;
+    }
+
+bool HostSim::chance(unsigned percent)
+    {
+    return percent != 0 && random32() % 100 < percent;
+    }
+
+float HostSim::gaussian(float sigma)
+    {
+    // the sum of four uniforms is close enough, and cheap.
+    float sum = 0.0f;
+
+    for (unsigned i = 0; i < 4; ++i)
+        sum += float(random32() >> 8) / float(1u << 24);
+    return (sum - 2.0f) * 1.7320508f * sigma;
+    }
+
+/****************************************************************************\
+|
+|   The environment
+|
+\****************************************************************************/
+
+void HostSim::getEnvironment(Environment_t &env)
+    {
+    constexpr float kPi = 3.14159265f;
+    std::uint32_t const t = getUnixTime();
+    std::uint32_t const secOfDay = t % 86400;
+    // 1970-01-01 was a Thursday.
+    unsigned const dayOfWeek = (t / 86400 + 4) % 7;
+    float const hour = secOfDay / 3600.0f;
+    // warmest mid-afternoon
+    float const daily = std::sin(2.0f * kPi * (hour - 9.0f) / 24.0f);
+    bool const fOccupied = dayOfWeek >= 1 && dayOfWeek <= 5 && hour >= 9.0f && hour < 17.0f;
+
+    env.TempC = 21.0f + 3.0f * daily + gaussian(0.1f);
+    env.RH = 45.0f - 8.0f * daily + gaussian(0.5f);
+    env.CO2ppm = 420.0f + (fOccupied ? 450.0f : 0.0f) + gaussian(15.0f);
+    env.PM25 = 8.0f + 3.0f * daily + gaussian(1.0f);
+    if (env.PM25 < 0.0f)
+        env.PM25 = 0.0f;
+
+    // a morning and evening traffic peak in CO and NO2; O3 follows the sun.
+    float const traffic = std::exp(-std::pow((hour - 8.0f) / 1.5f, 2.0f)) +
+                          std::exp(-std::pow((hour - 18.0f) / 1.5f, 2.0f));
+    env.gasPpm[0] = 0.3f + 1.2f * traffic + gaussian(0.05f);
+    env.gasPpm[1] = 0.015f + 0.03f * traffic + gaussian(0.002f);
+    env.gasPpm[2] = 0.02f + 0.03f * (daily > 0.0f ? daily : 0.0f) + gaussian(0.002f);
+    env.gasPpm[3] = 0.003f + gaussian(0.001f);
+    }
+
+/****************************************************************************\
+|
+|   Downlinks
+|
+\****************************************************************************/
+
+namespace {
+
+struct Downlink_t
+    {
+    std::uint32_t atSec;
+    std::uint8_t port;
+    std::vector<std::uint8_t> data;
+    };
+
+std::vector<Downlink_t> sDownlinks;
+
+} // namespace
+
+bool HostSim::queueDownlink(std::uint32_t atSec, std::uint8_t port, const std::uint8_t *pData, size_t nData)
+    {
+    if (port == 0 || port > 223 || nData > 242)
+        return false;
+
+    // kept in time order.
+    auto it = sDownlinks.begin();
+    while (it != sDownlinks.end() && it->atSec <= atSec)
+        ++it;
+    sDownlinks.insert(it, Downlink_t { atSec, port, std::vector<std::uint8_t>(pData, pData + nData) });
+    return true;
+    }
+
+bool HostSim::takeDownlink(std::uint8_t &port, std::uint8_t *pBuffer, size_t &nBuffer)
+    {
+    if (sDownlinks.empty() ||
+        sDownlinks.front().atSec > getTrueUs() / 1000000 ||
+        sDownlinks.front().data.size() > nBuffer)
+        return false;
+
+    auto const &d = sDownlinks.front();
+    port = d.port;
+    nBuffer = d.data.size();
+    std::memcpy(pBuffer, d.data.data(), nBuffer);
+    sDownlinks.erase(sDownlinks.begin());
+    return true;
+    }
+
+/****************************************************************************\
+|
+|   SHT3x
+|
+\****************************************************************************/
+
+using namespace McciCatenaSht3x;
+
+bool cSHT3x::begin()
+    {
+    HostSim::spendUs(1000);
+    return true;
+    }
+
+bool cSHT3x::getTemperatureHumidity(Measurements &m)
+    {
+    HostSim::Environment_t env;
+
+    HostSim::setLoad(HostSim::Load::kSht3x, HostSim::gEnergyProfile.sht3x);
+    HostSim::spendUs(15 * 1000);
+    HostSim::setLoad(HostSim::Load::kSht3x, 0.0f);
+    if (HostSim::isReplaying())
+        {
+        auto const &r = HostSim::getTraceRecord();
+
+        m.Temperature = r.shtTempC;
+        m.Humidity = r.shtHumidity;
+        return (r.valid & McciModel4916::SdLogFormat::kTraceSht3x) != 0;
+        }
+
+    HostSim::getEnvironment(env);
+    m.Temperature = env.TempC;
+    m.Humidity = env.RH;
+    return true;
+    }
+
+/****************************************************************************\
+|
+|   SCD30
+|
+\****************************************************************************/
+
+using namespace McciCatenaScd30;
+
+namespace {
+
+constexpr std::uint32_t kScd30IntervalMs = 2000;
+
+} // namespace
+
+bool cSCD30::begin()
+    {
+    // soft reset and start continuous measurement.
+    HostSim::setLoad(HostSim::Load::kScd30, HostSim::gEnergyProfile.scd30);
+    HostSim::spendUs(30 * 1000);
+    this->m_fRunning = true;
+    this->m_startMs = millis();
+    this->m_nRead = 0;
+    this->m_lastError = Error::kOk;
+    return true;
+    }
+
+void cSCD30::end()
+    {
+    HostSim::spendUs(1000);
+    HostSim::setLoad(HostSim::Load::kScd30, 0.0f);
+    this->m_fRunning = false;
+    }
+
+cSCD30::Info cSCD30::getInfo() const
+    {
+    Info info {};
+
+    info.FirmwareVersion = 0x0342;
+    info.fASC_status = true;
+    info.MeasurementInterval = kScd30IntervalMs / 1000;
+    info.ForcedRecalibrationValue = 400;
+    return info;
+    }
+
+const char *cSCD30::getLastErrorName() const
+    {
+    switch (this->m_lastError)
+        {
+    case Error::kOk:            return "kOk";
+    case Error::kNotMeasuring:  return "kNotMeasuring";
+    case Error::kCrc:           return "kCrc";
+    default:                    return "<<unknown>>";
+        }
+    }
+
+// measurements come every interval after begin(); one is ready if it
+// hasn't been read.
+bool cSCD30::queryReady(bool &fError)
+    {
+    HostSim::spendUs(1000);
+    fError = false;
+    if (! this->m_fRunning)
+        {
+        this->m_lastError = Error::kNotMeasuring;
+        fError = true;
+        return false;
+        }
+
+    return (millis() - this->m_startMs) / kScd30IntervalMs > this->m_nRead;
+    }
+
+bool cSCD30::readMeasurement()
+    {
+    HostSim::Environment_t env;
+
+    HostSim::spendUs(3 * 1000);
+    if (! this->m_fRunning)
+        {
+        this->m_lastError = Error::kNotMeasuring;
+        return false;
+        }
+
+    this->m_nRead = (millis() - this->m_startMs) / kScd30IntervalMs;
+    this->m_lastError = Error::kOk;
+    if (HostSim::isReplaying())
+        {
+        auto const &r = HostSim::getNextTraceRecord();
+
+        this->m_measurement.CO2ppm = r.scdCO2ppm;
+        this->m_measurement.Temperature = r.scdTempC;
+        this->m_measurement.RelativeHumidity = r.scdHumidity;
+        return true;
+        }
+
+    HostSim::getEnvironment(env);
+    this->m_measurement.CO2ppm = env.CO2ppm;
+    this->m_measurement.Temperature = env.TempC + 0.3f;
+    this->m_measurement.RelativeHumidity = env.RH;
+    return true;
+    }
+
+std::uint32_t cSCD30::getMsToNextMeasurement() const
+    {
+    if (! this->m_fRunning)
+        return kScd30IntervalMs;
+
+    std::uint32_t const elapsed = millis() - this->m_startMs;
+    if (elapsed / kScd30IntervalMs > this->m_nRead)
+        return 0;
+
+    return kScd30IntervalMs - elapsed % kScd30IntervalMs;
+    }
+
+/****************************************************************************\
+|
+|   IPS-7100
+|
+\****************************************************************************/
+
+using namespace McciCatenaIps7100;
+
+// it runs from begin(): the sketch never stops it.
+bool cIPS7100::begin()
+    {
+    HostSim::setLoad(HostSim::Load::kIps7100, HostSim::gEnergyProfile.ips7100);
+    HostSim::spendUs(5 * 1000);
+    return true;
+    }
+
+// PM2.5 sets the scale; the bins are cumulative, as the sensor reports.
+void cIPS7100::updateData()
+    {
+    static const float kMassShare[kBins] = { 0.05f, 0.2f, 0.4f, 0.7f, 1.0f, 1.4f, 1.8f };
+    static const float kCountPerUg[kBins] = { 900.0f, 400.0f, 150.0f, 40.0f, 10.0f, 2.0f, 0.5f };
+    HostSim::Environment_t env;
+
+    HostSim::spendUs(25 * 1000);
+    if (HostSim::isReplaying())
+        {
+        auto const &r = HostSim::getTraceRecord();
+
+        std::memcpy(this->m_count, r.ipsCount, sizeof(this->m_count));
+        std::memcpy(this->m_mass, r.ipsMass, sizeof(this->m_mass));
+        return;
+        }
+
+    HostSim::getEnvironment(env);
+    for (unsigned i = 0; i < kBins; ++i)
+        {
+        this->m_mass[i] = env.PM25 * kMassShare[i];
+        this->m_count[i] = std::uint32_t(env.PM25 * kCountPerUg[i]);
+        }
+    }
+
+/****************************************************************************\
+|
+|   ADS131M04 and the gas cells
+|
+\****************************************************************************/
+
+using namespace McciCatenaAds131m04;
+
+namespace {
+
+// the cells' zero, and their nominal sensitivities in V/ppm (the
+// firmware's default calibration is the inverse).
+constexpr float kVGasZero = 1.65f;
+constexpr float kGasSensitivity[4] = { 0.000427f, -0.01535423f, -0.01497998f, 0.00286f };
+
+} // namespace
+
+bool cADS131M04::begin(SPIClass *pSpi)
+    {
+    HostSim::setLoad(HostSim::Load::kGas, HostSim::gEnergyProfile.gas);
+    HostSim::spendUs(2 * 1000);
+    return true;
+    }
+
+float cADS131M04::readVoltage(std::uint8_t channel)
+    {
+    HostSim::Environment_t env;
+
+    HostSim::spendUs(1000);
+    if (channel >= 4)
+        return 0.0f;
+    if (HostSim::isReplaying())
+        return HostSim::getTraceRecord().adcVolts[channel];
+
+    HostSim::getEnvironment(env);
+    return kVGasZero + env.gasPpm[channel] * kGasSensitivity[channel] + HostSim::gaussian(0.00002f);
+    }
+
+/****************************************************************************\
+|
+|   SAM-M8Q
+|
+\****************************************************************************/
+
+namespace {
+
+constexpr float kLatitude = 42.4434f;
+constexpr float kLongitude = -76.5019f;
+constexpr std::uint32_t kGpsQueryUs = 40 * 1000;
+
+} // namespace
+
+// the receiver acquires from begin() until powerOff(), and again once
+// the time is up.
+bool SAM_M8Q::begin()
+    {
+    HostSim::setLoad(HostSim::Load::kGps, HostSim::gEnergyProfile.gpsAcquire);
+    HostSim::spendUs(kGpsQueryUs);
+    return true;
+    }
+
+bool SAM_M8Q::configureMessage(std::uint8_t msgClass, std::uint8_t msgId, std::uint8_t port, std::uint8_t rate)
+    {
+    HostSim::spendUs(kGpsQueryUs);
+    return true;
+    }
+
+bool SAM_M8Q::enableGNSS(bool fEnable, int gnssId)
+    {
+    HostSim::spendUs(kGpsQueryUs);
+    if (fEnable)
+        this->m_enabled |= 1u << gnssId;
+    else
+        this->m_enabled &= ~(1u << gnssId);
+    return true;
+    }
+
+bool SAM_M8Q::isGNSSenabled(int gnssId)
+    {
+    HostSim::spendUs(kGpsQueryUs);
+    return (this->m_enabled & (1u << gnssId)) != 0;
+    }
+
+bool SAM_M8Q::setI2COutput(std::uint8_t comType)
+    {
+    HostSim::spendUs(kGpsQueryUs);
+    return true;
+    }
+
+bool SAM_M8Q::saveConfiguration()
+    {
+    HostSim::spendUs(kGpsQueryUs);
+    return true;
+    }
+
+bool SAM_M8Q::isAwake()
+    {
+    if (this->m_fAsleep && std::int32_t(millis() - this->m_wakeMs) >= 0)
+        this->m_fAsleep = false;
+    return ! this->m_fAsleep;
+    }
+
+float SAM_M8Q::getLatitude()
+    {
+    if (! this->isAwake())
+        return 0.0f;
+
+    HostSim::spendUs(kGpsQueryUs);
+    if (HostSim::isReplaying())
+        return HostSim::getTraceRecord().latitude;
+    return kLatitude + HostSim::gaussian(0.00002f);
+    }
+
+float SAM_M8Q::getLongitude()
+    {
+    if (! this->isAwake())
+        return 0.0f;
+
+    HostSim::spendUs(kGpsQueryUs);
+    if (HostSim::isReplaying())
+        return HostSim::getTraceRecord().longitude;
+    return kLongitude + HostSim::gaussian(0.00002f);
+    }
+
+std::uint32_t SAM_M8Q::getUnixEpoch()
+    {
+    if (! this->isAwake())
+        return 0;
+
+    HostSim::spendUs(kGpsQueryUs);
+    if (HostSim::isReplaying())
+        return HostSim::getTraceRecord().gpsTime;
+    return HostSim::getUnixTime();
+    }
+
+bool SAM_M8Q::powerOff(std::uint32_t durationInMs)
+    {
+    HostSim::spendUs(kGpsQueryUs);
+    HostSim::setLoadFor(
+        HostSim::Load::kGps,
+        HostSim::gEnergyProfile.gpsBackup,
+        std::uint64_t(durationInMs) * 1000,
+        HostSim::gEnergyProfile.gpsAcquire
+        );
+    this->m_fAsleep = true;
+    this->m_wakeMs = millis() + durationInMs;
+    return true;
+    }
@@ -0,0 +1,333 @@
+/*
+
+Module: hostsim_energy.cpp
+
+Function:
+    Host simulation: the energy ledger, and the battery life it implies.
+
+Copyright:
+    See accompanying LICENSE file for copyright and license information.
+
+Author:
+    Dhinesh Kumar Pitchai, MCCI Corporation   November 2022
+
+*/
+
+#include "hostsim.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+/****************************************************************************\
+|
+|   The profile
+|
+\****************************************************************************/
+
+HostSim::EnergyProfile_t HostSim::gEnergyProfile;
+
+namespace {
+
+struct ProfileKey_t
+    {
+    const char *pName;
+    float HostSim::EnergyProfile_t::*pValue;
+    };
+
+const ProfileKey_t kProfileKeys[] =
+    {
+    { "board",                  &HostSim::EnergyProfile_t::board },
+    { "mcu.run",                &HostSim::EnergyProfile_t::mcuRun },
+    { "mcu.stop",               &HostSim::EnergyProfile_t::mcuStop },
+    { "sht3x",                  &HostSim::EnergyProfile_t::sht3x },
+    { "scd30",                  &HostSim::EnergyProfile_t::scd30 },
+    { "ips7100",                &HostSim::EnergyProfile_t::ips7100 },
+    { "gas",                    &HostSim::EnergyProfile_t::gas },
+    { "gps.acquire",            &HostSim::EnergyProfile_t::gpsAcquire },
+    { "gps.backup",             &HostSim::EnergyProfile_t::gpsBackup },
+    { "radio.tx",               &HostSim::EnergyProfile_t::radioTx },
+    { "radio.rx",               &HostSim::EnergyProfile_t::radioRx },
+    { "radio.rxms",             &HostSim::EnergyProfile_t::radioRxMs },
+    { "sd.idle",                &HostSim::EnergyProfile_t::sdIdle },
+    { "sd.active",              &HostSim::EnergyProfile_t::sdActive },
+    { "battery.mah",            &HostSim::EnergyProfile_t::batteryMah },
+    { "battery.usable",         &HostSim::EnergyProfile_t::batteryUsablePercent },
+    { "battery.selfdischarge",  &HostSim::EnergyProfile_t::selfDischargePercentPerYear },
+    };
+
+const char * const kLoadNames[unsigned(HostSim::Load::kLoads)] =
+    {
+    "board", "mcu", "sht3x", "scd30", "ips7100", "gas", "gps", "radio", "sd",
+    };
+
+} // namespace
+
+bool HostSim::setEnergyProfileValue(const char *pSetting)
+    {
+    char name[32];
+    auto const pEquals = std::strchr(pSetting, '=');
+
+    if (pEquals == nullptr || size_t(pEquals - pSetting) >= sizeof(name))
+        return false;
+
+    std::memcpy(name, pSetting, pEquals - pSetting);
+    name[pEquals - pSetting] = '\0';
+
+    char *pEnd;
+    float const value = std::strtof(pEquals + 1, &pEnd);
+    if (pEnd == pEquals + 1 || *pEnd != '\0' || value < 0.0f)
+        return false;
+
+    for (auto const &key : kProfileKeys)
+        {
+        if (std::strcmp(key.pName, name) == 0)
+            {
+            gEnergyProfile.*key.pValue = value;
+            return true;
+            }
+        }
+
+    return false;
+    }
+
+bool HostSim::loadEnergyProfile(const char *pPath)
+    {
+    auto const pFile = std::fopen(pPath, "r");
+    if (pFile == nullptr)
+        {
+        std::perror(pPath);
+        return false;
+        }
+
+    char line[128];
+    unsigned iLine = 0;
+    bool fResult = true;
+
+    while (std::fgets(line, sizeof(line), pFile) != nullptr)
+        {
+        ++iLine;
+
+        // drop the comment and the blanks; what's left is name=value.
+        char setting[sizeof(line)];
+        size_t n = 0;
+        for (auto p = line; *p != '\0' && *p != '#'; ++p)
+            {
+            if (*p != ' ' && *p != '\t' && *p != '\r' && *p != '\n')
+                setting[n++] = *p;
+            }
+        setting[n] = '\0';
+
+        if (n != 0 && ! setEnergyProfileValue(setting))
+            {
+            std::fprintf(stderr, "%s:%u: bad setting: %s\n", pPath, iLine, setting);
+            fResult = false;
+            }
+        }
+
+    std::fclose(pFile);
+    return fResult;
+    }
+
+/****************************************************************************\
+|
+|   The ledger
+|
+\****************************************************************************/
+
+namespace {
+
+struct LoadState_t
+    {
+    float uA;
+    // if not zero: true time at which uA becomes uAAfter
+    std::uint64_t untilUs;
+    float uAAfter;
+    // microamp-microseconds drawn
+    double charge;
+    };
+
+struct StateBucket_t
+    {
+    const char *pName;
+    std::uint64_t us;
+    double charge;
+    };
+
+LoadState_t sLoads[unsigned(HostSim::Load::kLoads)];
+std::vector<StateBucket_t> sStates;
+unsigned sState;
+std::uint64_t sLastUs;
+
+StateBucket_t &getState()
+    {
+    if (sStates.empty())
+        sStates.push_back(StateBucket_t { "(setup)", 0, 0.0 });
+    return sStates[sState];
+    }
+
+// charge everything from the last sync to now.
+void sync()
+    {
+    auto const now = HostSim::getTrueUs();
+    auto const dt = now - sLastUs;
+    auto &state = getState();
+    double total = 0.0;
+
+    if (dt == 0)
+        return;
+
+    for (auto &load : sLoads)
+        {
+        double charge;
+
+        if (load.untilUs != 0 && load.untilUs <= now)
+            {
+            auto const tSwitch = load.untilUs > sLastUs ? load.untilUs : sLastUs;
+
+            charge = double(load.uA) * (tSwitch - sLastUs) + double(load.uAAfter) * (now - tSwitch);
+            load.uA = load.uAAfter;
+            load.untilUs = 0;
+            }
+        else
+            charge = double(load.uA) * dt;
+
+        load.charge += charge;
+        total += charge;
+        }
+
+    state.us += dt;
+    state.charge += total;
+    sLastUs = now;
+    }
+
+} // namespace
+
+void HostSim::setLoad(Load load, float uA)
+    {
+    auto &l = sLoads[unsigned(load)];
+
+    sync();
+    l.uA = uA;
+    l.untilUs = 0;
+    }
+
+void HostSim::setLoadFor(Load load, float uA, std::uint64_t us, float uAAfter)
+    {
+    auto &l = sLoads[unsigned(load)];
+
+    sync();
+    l.uA = us != 0 ? uA : uAAfter;
+    l.untilUs = us != 0 ? getTrueUs() + us : 0;
+    l.uAAfter = uAAfter;
+    }
+
+void HostSim::addCharge(Load load, double uAus)
+    {
+    sync();
+    sLoads[unsigned(load)].charge += uAus;
+    getState().charge += uAus;
+    }
+
+const char *HostSim::setEnergyState(const char *pName)
+    {
+    sync();
+
+    auto const pPrevious = getState().pName;
+    for (unsigned i = 0; i < sStates.size(); ++i)
+        {
+        if (std::strcmp(sStates[i].pName, pName) == 0)
+            {
+            sState = i;
+            return pPrevious;
+            }
+        }
+
+    sStates.push_back(StateBucket_t { pName, 0, 0.0 });
+    sState = unsigned(sStates.size() - 1);
+    return pPrevious;
+    }
+
+/****************************************************************************\
+|
+|   The report
+|
+\****************************************************************************/
+
+namespace {
+
+// microamp-microseconds in a milliamp-hour.
+constexpr double kUaUsPerMah = 1000.0 * 3600.0 * 1e6;
+
+} // namespace
+
+void HostSim::printEnergyReport()
+    {
+    auto const &profile = gEnergyProfile;
+
+    sync();
+
+    double total = 0.0;
+    for (auto const &load : sLoads)
+        total += load.charge;
+
+    auto const trueUs = getTrueUs();
+    auto const share = [total](double charge)
+        {
+        return total > 0.0 ? 100.0 * charge / total : 0.0;
+        };
+
+    std::printf("\n%-22s %10s %7s %10s\n", "energy", "mAh", "share", "mean uA");
+    for (unsigned i = 0; i < unsigned(Load::kLoads); ++i)
+        {
+        auto const charge = sLoads[i].charge;
+
+        std::printf(
+            "%-22s %10.3f %6.1f%% %10.1f\n",
+            kLoadNames[i],
+            charge / kUaUsPerMah,
+            share(charge),
+            trueUs != 0 ? charge / trueUs : 0.0
+            );
+        }
+    std::printf(
+        "%-22s %10.3f %6.1f%% %10.1f\n",
+        "total",
+        total / kUaUsPerMah,
+        100.0,
+        trueUs != 0 ? total / trueUs : 0.0
+        );
+
+    std::printf("\n%-22s %10s %7s %10s %7s\n", "state", "time (s)", "share", "mAh", "share");
+    for (auto const &state : sStates)
+        {
+        std::printf(
+            "%-22s %10.1f %6.1f%% %10.3f %6.1f%%\n",
+            state.pName,
+            state.us / 1e6,
+            trueUs != 0 ? 100.0 * state.us / trueUs : 0.0,
+            state.charge / kUaUsPerMah,
+            share(state.charge)
+            );
+        }
+
+    // self-discharge is a drain like any other: fold it into the mean.
+    double const usable = profile.batteryMah * profile.batteryUsablePercent / 100.0;
+    double const selfDischargeUa = profile.batteryMah * 1000.0 * profile.selfDischargePercentPerYear / 100.0 / (365.25 * 24.0);
+    double const meanUa = (trueUs != 0 ? total / trueUs : 0.0) + selfDischargeUa;
+
+    std::printf(
+        "\n%-22s %.0f mAh, %.0f%% usable, %.1f%%/year self-discharge\n",
+        "battery",
+        profile.batteryMah,
+        profile.batteryUsablePercent,
+        profile.selfDischargePercentPerYear
+        );
+    if (meanUa <= 0.0)
+        return;
+
+    double const hours = usable * 1000.0 / meanUa;
+    std::printf("%-22s %.1f uA\n", "mean current", meanUa);
+    std::printf("%-22s %.1f days (%.2f years)\n", "battery life", hours / 24.0, hours / (365.25 * 24.0));
+    }
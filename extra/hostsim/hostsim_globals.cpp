@@ -0,0 +1,51 @@
+/*
+
+Module: hostsim_globals.cpp
+
+Function:
+    Host simulation: the sketch's globals, as the .ino defines them.
+
+Copyright:
+    See accompanying LICENSE file for copyright and license information.
+
+Author:
+    Dhinesh Kumar Pitchai, MCCI Corporation   November 2022
+
+*/
+
+#include "../../Model4916-MultiGas-Sensor.h"
+#include "../../Model4916_cMeasurementLoop.h"
+
+using namespace McciCatena;
+using namespace McciModel4916;
+using namespace McciCatenaScd30;
+
+/****************************************************************************\
+|
+|   The sketch's globals
+|
+\****************************************************************************/
+
+cPCA9574                i2cgpiopower    { &Wire, 0 };
+c4916Gpios gpiopower    { &i2cgpiopower };
+cPCA9574                i2cgpioenable   { &Wire, 1 };
+c4916Gpios gpioenable   { &i2cgpioenable };
+
+Catena gCatena;
+Catena::LoRaWAN gLoRaWAN;
+StatusLed gLed (Catena::PIN_STATUS_LED);
+
+cSHT3x gSht { Wire };
+cSCD30 gScd { Wire };
+cIPS7100 gIps { Wire };
+
+cMeasurementLoop gMeasurementLoop { gSht, gScd, gIps };
+
+cBootloaderApi gBootloaderApi;
+SPIClass gSPI2(
+    Catena::PIN_SPI2_MOSI,
+    Catena::PIN_SPI2_MISO,
+    Catena::PIN_SPI2_SCK
+    );
+Catena_Mx25v8035f gFlash;
+cDownload gDownload;
@@ -0,0 +1,690 @@
+/*
+
+Module: hostsim_platform.cpp
+
+Function:
+    Host simulation: the clock, the Arduino core, the Catena platform and
+    the LoRaWAN stack.
+
+Copyright:
+    See accompanying LICENSE file for copyright and license information.
+
+Author:
+    Dhinesh Kumar Pitchai, MCCI Corporation   November 2022
+
+*/
+
+#include "hostsim.h"
+
+#include "../../Model4916_SdLogFormat.h"
+
+#include <Arduino.h>
+#include <arduino_lmic.h>
+#include <Catena.h>
+#include <Catena_Download.h>
+#include <Catena_Log.h>
+#include <Catena_TxBuffer.h>
+#include <mcciadk_baselib.h>
+#include <SPI.h>
+#include <Wire.h>
+
+#include <cstdarg>
+#include <cstdio>
+
+using namespace McciCatena;
+
+/****************************************************************************\
+|
+|   The virtual clock
+|
+\****************************************************************************/
+
+namespace {
+
+std::uint64_t sTrueUs;
+
+} // namespace
+
+HostSim::Options_t HostSim::gOptions;
+HostSim::Counters_t HostSim::gCounters;
+
+std::uint64_t HostSim::getTrueUs()
+    {
+    return sTrueUs;
+    }
+
+std::uint64_t HostSim::getDeviceUs()
+    {
+    return sTrueUs + std::int64_t(sTrueUs) * gOptions.driftPpm / 1000000;
+    }
+
+void HostSim::spendUs(std::uint64_t us)
+    {
+    sTrueUs += std::uint64_t(std::int64_t(us) * 1000000 / (1000000 + gOptions.driftPpm));
+    }
+
+std::uint32_t HostSim::getUnixTime()
+    {
+    return gOptions.unixStart + std::uint32_t(sTrueUs / 1000000);
+    }
+
+/****************************************************************************\
+|
+|   The Arduino core
+|
+\****************************************************************************/
+
+USBSerial Serial;
+SPIClass SPI;
+TwoWire Wire;
+
+namespace {
+
+SCB_Type sScb;
+bool sfConsoleLineStart = true;
+
+} // namespace
+
+SCB_Type *SCB = &sScb;
+
+std::uint32_t millis()
+    {
+    return std::uint32_t(HostSim::getDeviceUs() / 1000);
+    }
+
+std::uint32_t micros()
+    {
+    return std::uint32_t(HostSim::getDeviceUs());
+    }
+
+void delay(std::uint32_t ms)
+    {
+    HostSim::spendUs(std::uint64_t(ms) * 1000);
+    }
+
+void delayMicroseconds(std::uint32_t us)
+    {
+    HostSim::spendUs(us);
+    }
+
+void yield()
+    {
+    }
+
+void pinMode(int pin, int mode)
+    {
+    }
+
+void digitalWrite(int pin, int value)
+    {
+    }
+
+int digitalRead(int pin)
+    {
+    return LOW;
+    }
+
+size_t Print::print(const char *s)
+    {
+    return this->write(s);
+    }
+
+size_t Print::print(char c)
+    {
+    return this->write(std::uint8_t(c));
+    }
+
+size_t Print::print(unsigned long v, int base)
+    {
+    char buf[24];
+
+    std::snprintf(buf, sizeof(buf), base == 16 ? "%lX" : base == 8 ? "%lo" : "%lu", v);
+    return this->write(buf);
+    }
+
+size_t Print::print(long v, int base)
+    {
+    if (base != 10)
+        return this->print((unsigned long)v, base);
+
+    char buf[24];
+
+    std::snprintf(buf, sizeof(buf), "%ld", v);
+    return this->write(buf);
+    }
+
+size_t Print::print(double v, int digits)
+    {
+    char buf[48];
+
+    std::snprintf(buf, sizeof(buf), "%.*f", digits, v);
+    return this->write(buf);
+    }
+
+size_t Stream::readBytes(std::uint8_t *pBuffer, size_t nBuffer)
+    {
+    size_t n = 0;
+
+    while (n < nBuffer)
+        {
+        int const c = this->read();
+        if (c < 0)
+            break;
+        pBuffer[n++] = std::uint8_t(c);
+        }
+    return n;
+    }
+
+void USBSerial::begin(unsigned long baud)
+    {
+    }
+
+void USBSerial::end()
+    {
+    }
+
+bool USBSerial::dtr()
+    {
+    return HostSim::gOptions.fAttended;
+    }
+
+int USBSerial::availableForWrite()
+    {
+    // the simulated host always keeps up.
+    return 64;
+    }
+
+// each line is stamped with the true time since the start.
+size_t USBSerial::write(std::uint8_t c)
+    {
+    ++HostSim::gCounters.nConsoleBytes;
+    if (! HostSim::gOptions.fEcho)
+        return 1;
+
+    if (sfConsoleLineStart)
+        {
+        auto const ms = HostSim::getTrueUs() / 1000;
+        auto const sec = ms / 1000;
+
+        std::printf(
+            "[%3lu+%02u:%02u:%02u.%03u] ",
+            (unsigned long)(sec / 86400),
+            unsigned(sec / 3600 % 24),
+            unsigned(sec / 60 % 60),
+            unsigned(sec % 60),
+            unsigned(ms % 1000)
+            );
+        sfConsoleLineStart = false;
+        }
+
+    if (c == '\n')
+        sfConsoleLineStart = true;
+    if (c != '\r')
+        std::putchar(c);
+    return 1;
+    }
+
+size_t USBSerial::write(const std::uint8_t *pBuffer, size_t nBuffer)
+    {
+    for (size_t i = 0; i < nBuffer; ++i)
+        this->write(pBuffer[i]);
+    return nBuffer;
+    }
+
+extern "C" size_t McciAdkLib_Snprintf(char *pBuffer, size_t nBuffer, size_t iBuffer, const char *pFmt, ...)
+    {
+    if (pBuffer == nullptr || iBuffer >= nBuffer)
+        return 0;
+
+    va_list ap;
+    va_start(ap, pFmt);
+    int const n = std::vsnprintf(pBuffer + iBuffer, nBuffer - iBuffer, pFmt, ap);
+    va_end(ap);
+
+    if (n < 0)
+        return 0;
+    return size_t(n) < nBuffer - iBuffer ? n : nBuffer - iBuffer - 1;
+    }
+
+/****************************************************************************\
+|
+|   The Catena platform
+|
+\****************************************************************************/
+
+cLog McciCatena::gLog;
+
+void cLog::printf(DebugFlags flags, const char *pFmt, ...)
+    {
+    if (! this->isEnabled(flags))
+        return;
+
+    char buf[256];
+    va_list ap;
+    va_start(ap, pFmt);
+    std::vsnprintf(buf, sizeof(buf), pFmt, ap);
+    va_end(ap);
+
+    Serial.write(buf);
+    }
+
+bool Catena::begin()
+    {
+    return true;
+    }
+
+void Catena::registerObject(cPollableObject *pObject)
+    {
+    pObject->m_pNext = nullptr;
+
+    auto ppLast = &this->m_pPollHead;
+    while (*ppLast != nullptr)
+        ppLast = &(*ppLast)->m_pNext;
+    *ppLast = pObject;
+    }
+
+// a pass of the main loop takes a tick.
+void Catena::poll()
+    {
+    ++HostSim::gCounters.nPolls;
+    HostSim::spendUs(HostSim::gOptions.tickUs);
+
+    for (auto p = this->m_pPollHead; p != nullptr; p = p->m_pNext)
+        p->poll();
+    }
+
+void Catena::SafePrintf(const char *pFmt, ...)
+    {
+    char buf[256];
+    va_list ap;
+    va_start(ap, pFmt);
+    std::vsnprintf(buf, sizeof(buf), pFmt, ap);
+    va_end(ap);
+
+    Serial.write(buf);
+    }
+
+std::uint32_t Catena::GetOperatingFlags()
+    {
+    return this->m_operatingFlags;
+    }
+
+std::uint32_t Catena::GetPlatformFlags()
+    {
+    return 0;
+    }
+
+std::uint32_t Catena::PlatformFlags_GetModNumber(std::uint32_t flags)
+    {
+    return 0;
+    }
+
+// each measurement starts by reading the battery; a replay moves on to
+// the next record then.
+float Catena::ReadVbat() const
+    {
+    if (HostSim::isReplaying())
+        {
+        HostSim::nextTraceRecord();
+        return HostSim::getTraceRecord().vBat;
+        }
+
+    return 3.9f + HostSim::gaussian(0.005f);
+    }
+
+float Catena::ReadVbus() const
+    {
+    return HostSim::gOptions.fAttended ? 5.0f : 0.0f;
+    }
+
+bool Catena::getBootCount(std::uint32_t &bootCount)
+    {
+    bootCount = this->m_bootCount;
+    return true;
+    }
+
+cFram *Catena::getFram()
+    {
+    return &this->m_fram;
+    }
+
+void Catena::Sleep(std::uint32_t howLongInSeconds)
+    {
+    std::uint64_t const us = std::uint64_t(howLongInSeconds) * 1000000;
+    std::uint64_t const tStart = HostSim::getTrueUs();
+    auto const &profile = HostSim::gEnergyProfile;
+
+    // the MCU stops; deep sleep is charged apart from the FSM state.
+    HostSim::setLoad(HostSim::Load::kMcu, profile.mcuStop);
+    auto const pState = HostSim::setEnergyState("(deep sleep)");
+
+    HostSim::spendUs(us);
+    ++HostSim::gCounters.nDeepSleeps;
+    HostSim::gCounters.usDeepSleep += HostSim::getTrueUs() - tStart;
+
+    HostSim::setEnergyState(pState);
+    HostSim::setLoad(HostSim::Load::kMcu, profile.mcuRun);
+    }
+
+const Catena::EUI64_buffer_t *Catena::GetSysEUI()
+    {
+    static const EUI64_buffer_t sEui = {{ 0x00, 0x02, 0xCC, 0x01, 0x00, 0x00, 0x49, 0x16 }};
+    return &sEui;
+    }
+
+const char *Catena::GetUniqueIDstring(UniqueID_string_t *pId)
+    {
+    std::snprintf(pId->c, sizeof(pId->c), "hostsim");
+    return pId->c;
+    }
+
+const CATENA_PLATFORM *Catena::GetPlatform()
+    {
+    return nullptr;
+    }
+
+std::uint32_t Catena::GetSystemClockRate() const
+    {
+    return 32000000;
+    }
+
+bool cFram::read(cFramStorage::Offset uOffset, std::uint8_t *pBuffer, size_t nBuffer)
+    {
+    if (uOffset > kSize || nBuffer > kSize - uOffset)
+        return false;
+
+    // 1 MHz I2C: about 10 us a byte.
+    HostSim::spendUs(100 + 10 * nBuffer);
+    std::memcpy(pBuffer, this->m_data + uOffset, nBuffer);
+    return true;
+    }
+
+bool cFram::write(cFramStorage::Offset uOffset, const std::uint8_t *pBuffer, size_t nBuffer)
+    {
+    if (uOffset > kSize || nBuffer > kSize - uOffset)
+        return false;
+
+    HostSim::spendUs(100 + 10 * nBuffer);
+    std::memcpy(this->m_data + uOffset, pBuffer, nBuffer);
+    return true;
+    }
+
+std::uint16_t AbstractTxBufferBase_t::f2uflt16(float f)
+    {
+    if (f <= 0.0f)
+        return 0;
+    if (f >= 1.0f)
+        return 0xFFFF;
+
+    int iExp;
+    float const normal = std::frexp(f, &iExp);
+
+    // f is in (0, 1), so iExp is at most 0; 15 steps are kept.
+    iExp += 15;
+    if (iExp < 0)
+        return 0;
+
+    std::uint32_t fraction = std::uint32_t(std::ldexp(normal, 12) + 0.5f);
+    if (fraction >= (1u << 12))
+        {
+        fraction = 1u << 11;
+        ++iExp;
+        }
+    if (iExp > 15)
+        return 0xFFFF;
+
+    return std::uint16_t((iExp << 12) | (fraction & 0xFFF));
+    }
+
+std::uint16_t AbstractTxBufferBase_t::f2sflt16(float f)
+    {
+    if (f <= -1.0f)
+        return 0xFFFF;
+    if (f >= 1.0f)
+        return 0x7FFF;
+
+    std::uint16_t const sign = f < 0.0f ? 0x8000 : 0;
+    float const a = f < 0.0f ? -f : f;
+    if (a == 0.0f)
+        return sign;
+
+    int iExp;
+    float const normal = std::frexp(a, &iExp);
+
+    iExp += 15;
+    if (iExp < 0)
+        return sign;
+
+    std::uint32_t fraction = std::uint32_t(std::ldexp(normal, 12) + 0.5f);
+    if (fraction >= (1u << 12))
+        {
+        fraction = 1u << 11;
+        ++iExp;
+        }
+    if (iExp > 15)
+        return sign | 0x7FFF;
+
+    return std::uint16_t(sign | (iExp << 11) | (fraction & 0x7FF));
+    }
+
+// no flash to program: read the image through, as the real download
+// would, and say it went.
+bool cDownload::evStart(Request_t &request)
+    {
+    if (request.ReadBytes.pfn == nullptr)
+        return false;
+
+    std::uint8_t buffer[kTransferChunkBytes];
+    auto const status = Status_t::kSuccessful;
+
+    for (;;)
+        {
+        if (request.QueryAvailableData.pfn != nullptr &&
+            request.QueryAvailableData.pfn(request.QueryAvailableData.pUserData) <= 0)
+            break;
+
+        size_t const n = request.ReadBytes.pfn(request.ReadBytes.pUserData, buffer, sizeof(buffer));
+        if (n == 0)
+            break;
+
+        // programming a page of SPI flash: about 1 ms.
+        HostSim::spendUs(1000);
+        }
+
+    if (request.Completion.pfn != nullptr)
+        request.Completion.pfn(request.Completion.pUserData, status);
+    return true;
+    }
+
+/****************************************************************************\
+|
+|   The LoRaWAN stack
+|
+\****************************************************************************/
+
+lmic_t LMIC;
+
+namespace {
+
+// LMIC retries a confirmed uplink that isn't acknowledged.
+constexpr unsigned kConfirmedAttempts = 8;
+// from the end of the uplink to the end of the RX2 window.
+constexpr std::uint32_t kRxWindowsMs = 2200;
+// LoRaWAN framing around the application payload.
+constexpr size_t kFrameOverhead = 13;
+
+lmic_request_network_time_cb_t *spNetworkTimeCb;
+void *spNetworkTimeCtx;
+lmic_time_reference_t sNetworkTimeRef;
+bool sfNetworkTimeRef;
+
+// time on air, from the LoRa modem design guide, for US915: DR0..3 are
+// SF10..SF7 at 125 kHz, DR4 is SF8 at 500 kHz. CR 4/5, explicit header,
+// CRC on, 8 preamble symbols.
+std::uint32_t getAirtimeUs(std::uint8_t datarate, size_t nPayload)
+    {
+    static const std::uint8_t kSf[] = { 10, 9, 8, 7, 8 };
+    if (datarate >= sizeof(kSf))
+        datarate = 0;
+
+    int const sf = kSf[datarate];
+    int const bwHz = datarate == 4 ? 500000 : 125000;
+    int const de = (sf >= 11 && bwHz == 125000) ? 1 : 0;
+    double const tSymUs = double(1u << sf) * 1e6 / bwHz;
+    int const pl = int(nPayload + kFrameOverhead);
+
+    int const num = 8 * pl - 4 * sf + 28 + 16;
+    int const den = 4 * (sf - 2 * de);
+    int const nPayloadSyms = 8 + (num > 0 ? (num + den - 1) / den * 5 : 0);
+
+    return std::uint32_t((8 + 4.25 + nPayloadSyms) * tSymUs);
+    }
+
+} // namespace
+
+ostime_t os_getTime()
+    {
+    return ostime_t(HostSim::getDeviceUs() * OSTICKS_PER_SEC / 1000000);
+    }
+
+void LMIC_setClockError(std::uint16_t error)
+    {
+    }
+
+void LMIC_requestNetworkTime(lmic_request_network_time_cb_t *pCallback, void *pUserData)
+    {
+    spNetworkTimeCb = pCallback;
+    spNetworkTimeCtx = pUserData;
+    }
+
+int LMIC_getNetworkTimeReference(lmic_time_reference_t *pReference)
+    {
+    if (! sfNetworkTimeRef)
+        return 0;
+
+    *pReference = sNetworkTimeRef;
+    return 1;
+    }
+
+bool Catena::LoRaWAN::begin(Catena *pCatena)
+    {
+    LMIC.datarate = HostSim::gOptions.datarate;
+    LMIC.txpow = 20;
+    return true;
+    }
+
+// Airtime and the receive windows are waited out on the device clock;
+// the result is decided when they're over. The radio's charge for all
+// the attempts is taken now.
+bool Catena::LoRaWAN::SendBuffer(
+    const std::uint8_t *pBuffer,
+    size_t nBuffer,
+    SendBufferCbFn *pDoneFn,
+    void *pCtx,
+    bool fConfirmed,
+    std::uint8_t port
+    )
+    {
+    if (this->m_fBusy)
+        return false;
+
+    auto &counters = HostSim::gCounters;
+
+    ++counters.nUplinks[port < 4 ? port : 0];
+    counters.nUplinkBytes += nBuffer;
+    HostSim::logUplink(port, pBuffer, nBuffer);
+
+    this->m_fBusy = true;
+    this->m_fConfirmed = fConfirmed;
+    this->m_port = port;
+    this->m_pDoneFn = pDoneFn;
+    this->m_pDoneCtx = pCtx;
+
+    // an unconfirmed uplink is sent once; a confirmed one until it's
+    // acknowledged or the attempts run out.
+    LMIC.datarate = HostSim::gOptions.datarate;
+    std::uint32_t const airtimeUs = getAirtimeUs(LMIC.datarate, nBuffer);
+    std::uint32_t totalMs = 0;
+    unsigned nAttempts = 0;
+    bool fDelivered = false;
+
+    auto const &profile = HostSim::gEnergyProfile;
+    do  {
+        ++nAttempts;
+        ++counters.nTransmissions;
+        counters.usAirtime += airtimeUs;
+        HostSim::addCharge(
+            HostSim::Load::kRadio,
+            double(profile.radioTx) * airtimeUs + double(profile.radioRx) * profile.radioRxMs * 1000
+            );
+        totalMs += airtimeUs / 1000 + kRxWindowsMs;
+        fDelivered = ! HostSim::chance(HostSim::gOptions.lossPercent);
+        } while (fConfirmed && ! fDelivered && nAttempts < kConfirmedAttempts);
+
+    this->m_doneMs = millis() + totalMs;
+    this->m_fDelivered = fDelivered;
+    return true;
+    }
+
+void Catena::LoRaWAN::poll()
+    {
+    if (this->m_fBusy && std::int32_t(millis() - this->m_doneMs) >= 0)
+        this->finishUplink();
+    }
+
+void Catena::LoRaWAN::finishUplink()
+    {
+    auto &counters = HostSim::gCounters;
+    bool const fDelivered = this->m_fDelivered;
+
+    this->m_fBusy = false;
+    if (fDelivered)
+        ++counters.nDelivered;
+
+    LMIC.rssi = std::int8_t(-95 + int(HostSim::gaussian(4.0f)) + RSSI_OFF);
+    LMIC.snr = std::int8_t(4 * (6 + int(HostSim::gaussian(2.0f))));
+
+    // DeviceTimeAns rides on the downlink after a delivered uplink; the
+    // reference is the end of the uplink.
+    if (spNetworkTimeCb != nullptr)
+        {
+        auto const pCallback = spNetworkTimeCb;
+        bool const fAnswer = fDelivered && HostSim::gOptions.fNetworkTime;
+
+        spNetworkTimeCb = nullptr;
+        if (fAnswer)
+            {
+            // GPS seconds: from 1980-01-06, ahead of UTC by the leap seconds.
+            sNetworkTimeRef.tLocal = os_getTime() - ms2osticks(kRxWindowsMs);
+            sNetworkTimeRef.tNetwork = HostSim::getUnixTime() - kRxWindowsMs / 1000 - 315964800 + 18;
+            sfNetworkTimeRef = true;
+            }
+        pCallback(spNetworkTimeCtx, fAnswer);
+        }
+
+    // class A: anything queued for us comes down after the uplink.
+    std::uint8_t port;
+    std::uint8_t buffer[242];
+    size_t nBuffer = sizeof(buffer);
+
+    if (fDelivered && HostSim::takeDownlink(port, buffer, nBuffer))
+        {
+        ++counters.nDownlinks;
+        if (this->m_pReceiveFn != nullptr)
+            this->m_pReceiveFn(this->m_pReceiveCtx, port, buffer, nBuffer);
+        }
+
+    // a device can't tell an unconfirmed uplink was lost.
+    bool const fSuccess = fDelivered || ! this->m_fConfirmed;
+    if (! fSuccess)
+        ++counters.nSendFailed;
+
+    if (this->m_pDoneFn != nullptr)
+        this->m_pDoneFn(this->m_pDoneCtx, fSuccess);
+    }
+
+const char *Catena::LoRaWAN::GetRegionString(char *pBuffer, size_t nBuffer) const
+    {
+    std::snprintf(pBuffer, nBuffer, "US915");
+    return pBuffer;
+    }
@@ -0,0 +1,266 @@
+/*
+
+Module: hostsim_replay.cpp
+
+Function:
+    Host simulation: replaying a sensor trace from a device.
+
+Copyright:
+    See accompanying LICENSE file for copyright and license information.
+
+Author:
+    Dhinesh Kumar Pitchai, MCCI Corporation   November 2022
+
+*/
+
+#include "hostsim.h"
+
+#include "../../Model4916_SdLogFormat.h"
+#include "../../Model4916_crc.h"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+using namespace McciModel4916;
+
+/****************************************************************************\
+|
+|   The trace
+|
+\****************************************************************************/
+
+namespace {
+
+std::vector<SdLogFormat::TraceRecord_t> sRecords;
+// the record being measured; sRecords.size() before the first.
+size_t sCurrent;
+bool sfDone;
+std::uint8_t sSequence;
+
+// the parts of a record that are set by port 2 commands.
+bool isSameConfig(const SdLogFormat::TraceRecord_t &a, const SdLogFormat::TraceRecord_t &b)
+    {
+    return a.sensorMask == b.sensorMask &&
+           a.vGasZero == b.vGasZero &&
+           std::memcmp(a.calibrationFactor, b.calibrationFactor, sizeof(a.calibrationFactor)) == 0;
+    }
+
+std::uint8_t *putF32(std::uint8_t *p, float v)
+    {
+    std::uint32_t u;
+
+    std::memcpy(&u, &v, sizeof(u));
+    *p++ = std::uint8_t(u >> 24);
+    *p++ = std::uint8_t(u >> 16);
+    *p++ = std::uint8_t(u >> 8);
+    *p++ = std::uint8_t(u);
+    return p;
+    }
+
+// the commands that take the sketch from pFrom's settings (or anything,
+// if null) to to's; see ../catena-message-port-2-command-format.md.
+size_t buildConfigMessage(
+    const SdLogFormat::TraceRecord_t *pFrom,
+    const SdLogFormat::TraceRecord_t &to,
+    std::uint8_t *pBuffer,
+    size_t nBuffer
+    )
+    {
+    std::uint8_t message[1 + 2 + 5 + 4 * 6];
+    auto p = message;
+
+    *p++ = ++sSequence;
+    if (pFrom == nullptr || pFrom->sensorMask != to.sensorMask)
+        {
+        *p++ = 0x03;
+        *p++ = to.sensorMask;
+        }
+    if (pFrom == nullptr || pFrom->vGasZero != to.vGasZero)
+        {
+        *p++ = 0x05;
+        p = putF32(p, to.vGasZero);
+        }
+    for (unsigned i = 0; i < 4; ++i)
+        {
+        if (pFrom == nullptr || pFrom->calibrationFactor[i] != to.calibrationFactor[i])
+            {
+            *p++ = 0x04;
+            *p++ = std::uint8_t(i);
+            p = putF32(p, to.calibrationFactor[i]);
+            }
+        }
+
+    size_t const n = p - message;
+    if (n > nBuffer)
+        return 0;
+    std::memcpy(pBuffer, message, n);
+    return n;
+    }
+
+} // namespace
+
+bool HostSim::loadTrace(const char *pPath)
+    {
+    auto const pFile = std::fopen(pPath, "rb");
+    SdLogFormat::TraceHeader_t header;
+    SdLogFormat::TraceRecord_t record;
+    unsigned nBad = 0;
+
+    if (pFile == nullptr)
+        {
+        std::perror(pPath);
+        return false;
+        }
+
+    if (std::fread(&header, sizeof(header), 1, pFile) != 1 ||
+        std::memcmp(header.magic, SdLogFormat::kTraceMagic, sizeof(header.magic)) != 0 ||
+        header.crc != crc32_ieee(&header, offsetof(SdLogFormat::TraceHeader_t, crc)))
+        {
+        std::fprintf(stderr, "%s: not a sensor trace\n", pPath);
+        std::fclose(pFile);
+        return false;
+        }
+
+    if (header.schemaVersion != SdLogFormat::kTraceSchemaVersion ||
+        header.headerSize != sizeof(header) ||
+        header.recordSize != sizeof(record))
+        {
+        std::fprintf(
+            stderr, "%s: trace version %u (%u-byte records) not supported\n",
+            pPath, header.schemaVersion, header.recordSize
+            );
+        std::fclose(pFile);
+        return false;
+        }
+
+    // a partial record at the end was cut short by a reset.
+    sRecords.clear();
+    while (std::fread(&record, sizeof(record), 1, pFile) == 1)
+        {
+        if (record.crc == crc32_ieee(&record, offsetof(SdLogFormat::TraceRecord_t, crc)))
+            sRecords.push_back(record);
+        else
+            ++nBad;
+        }
+    std::fclose(pFile);
+
+    if (nBad != 0)
+        std::fprintf(stderr, "%s: %u records with bad CRCs skipped\n", pPath, nBad);
+    if (sRecords.empty())
+        {
+        std::fprintf(stderr, "%s: no records\n", pPath);
+        return false;
+        }
+
+    sCurrent = sRecords.size();
+    sfDone = false;
+    return true;
+    }
+
+bool HostSim::isReplaying()
+    {
+    return ! sRecords.empty();
+    }
+
+bool HostSim::nextTraceRecord()
+    {
+    if (sfDone)
+        return false;
+
+    sCurrent = sCurrent == sRecords.size() ? 0 : sCurrent + 1;
+    if (sCurrent == sRecords.size())
+        {
+        // stay on the last record for what's left of the run.
+        --sCurrent;
+        sfDone = true;
+        return false;
+        }
+
+    // a change of settings before the next record came by downlink, so
+    // it arrives after this measurement's uplink.
+    if (sCurrent + 1 < sRecords.size() &&
+        ! isSameConfig(sRecords[sCurrent], sRecords[sCurrent + 1]))
+        {
+        std::uint8_t message[64];
+        auto const n = buildConfigMessage(&sRecords[sCurrent], sRecords[sCurrent + 1], message, sizeof(message));
+
+        queueDownlink(std::uint32_t(getTrueUs() / 1000000), 2, message, n);
+        }
+
+    return true;
+    }
+
+bool HostSim::isTraceDone()
+    {
+    return sfDone;
+    }
+
+const HostSim::TraceRecord_t &HostSim::getTraceRecord()
+    {
+    return sRecords[sCurrent < sRecords.size() ? sCurrent : 0];
+    }
+
+const HostSim::TraceRecord_t &HostSim::getNextTraceRecord()
+    {
+    if (sCurrent == sRecords.size())
+        return sRecords[0];
+    return sRecords[sCurrent + 1 < sRecords.size() ? sCurrent + 1 : sCurrent];
+    }
+
+size_t HostSim::getTraceConfigMessage(std::uint8_t *pBuffer, size_t nBuffer)
+    {
+    if (sRecords.empty())
+        return 0;
+    return buildConfigMessage(nullptr, sRecords[0], pBuffer, nBuffer);
+    }
+
+// the first record was measured ms after the device started.
+std::uint32_t HostSim::getTraceStartTime()
+    {
+    if (sRecords.empty() || sRecords[0].time < sRecords[0].ms / 1000)
+        return 0;
+    return sRecords[0].time - sRecords[0].ms / 1000;
+    }
+
+std::uint32_t HostSim::getTraceIntervalSec()
+    {
+    if (sRecords.size() < 2 || sRecords[0].time == 0 || sRecords[1].time <= sRecords[0].time)
+        return 0;
+    return sRecords[1].time - sRecords[0].time;
+    }
+
+/****************************************************************************\
+|
+|   Uplinks
+|
+\****************************************************************************/
+
+namespace {
+
+std::FILE *spUplinkLog;
+
+} // namespace
+
+bool HostSim::openUplinkLog(const char *pPath)
+    {
+    spUplinkLog = std::fopen(pPath, "w");
+    if (spUplinkLog == nullptr)
+        {
+        std::perror(pPath);
+        return false;
+        }
+    return true;
+    }
+
+void HostSim::logUplink(std::uint8_t port, const std::uint8_t *pBuffer, size_t nBuffer)
+    {
+    // the measurement that found the trace used up has no record.
+    if (spUplinkLog == nullptr || isTraceDone())
+        return;
+
+    std::fprintf(spUplinkLog, "%lu,%u,", (unsigned long) getUnixTime(), port);
+    for (size_t i = 0; i < nBuffer; ++i)
+        std::fprintf(spUplinkLog, "%02x", pBuffer[i]);
+    std::fputc('\n', spUplinkLog);
+    }
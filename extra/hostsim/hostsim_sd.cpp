@@ -0,0 +1,494 @@
+/*
+
+Module: hostsim_sd.cpp
+
+Function:
+    Host simulation: the SD library, on an in-memory card.
+
+Copyright:
+    See accompanying LICENSE file for copyright and license information.
+
+Author:
+    Dhinesh Kumar Pitchai, MCCI Corporation   November 2022
+
+*/
+
+#include "hostsim.h"
+
+#include <SD.h>
+
+#include <cctype>
+#include <cstdio>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <sys/stat.h>
+
+/****************************************************************************\
+|
+|   The card
+|
+\****************************************************************************/
+
+namespace {
+
+// times at half speed (8 MHz SPI), typical of a small card.
+constexpr std::uint32_t kMountUs = 50 * 1000;
+constexpr std::uint32_t kEndUs = 2 * 1000;
+constexpr std::uint32_t kOpenUs = 2 * 1000;
+constexpr std::uint32_t kMkdirUs = 5 * 1000;
+constexpr std::uint32_t kCloseUs = 3 * 1000;
+constexpr std::uint32_t kAccessUs = 500;
+constexpr std::uint32_t kPerByteNs = 2000;
+
+struct Node_t
+    {
+    std::string name;               // as created, without the path
+    bool fDir;
+    std::vector<std::uint8_t> data;
+    };
+
+// FAT names don't care about case: nodes are keyed by the upper-case
+// path, without a leading slash. The root is "".
+std::map<std::string, Node_t> sCard = { { "", Node_t { "/", true, {} } } };
+bool sfMounted;
+
+std::string getKey(const char *pPath)
+    {
+    std::string key;
+
+    for (auto p = pPath; *p != '\0'; ++p)
+        {
+        if (*p == '/' && (key.empty() || key.back() == '/'))
+            continue;
+        key += char(std::toupper((unsigned char) *p));
+        }
+    if (! key.empty() && key.back() == '/')
+        key.pop_back();
+    return key;
+    }
+
+std::string getParent(const std::string &key)
+    {
+    auto const i = key.rfind('/');
+    return i == std::string::npos ? std::string() : key.substr(0, i);
+    }
+
+std::string getBaseName(const char *pPath)
+    {
+    std::string name(pPath);
+
+    while (! name.empty() && name.back() == '/')
+        name.pop_back();
+    auto const i = name.rfind('/');
+    return i == std::string::npos ? name : name.substr(i + 1);
+    }
+
+Node_t *findNode(const std::string &key)
+    {
+    auto const it = sCard.find(key);
+    return it == sCard.end() ? nullptr : &it->second;
+    }
+
+// the card draws its active current for the operation, then idles
+// while it's mounted.
+void spendSdUs(std::uint64_t us)
+    {
+    auto const &profile = HostSim::gEnergyProfile;
+
+    HostSim::setLoad(HostSim::Load::kSd, profile.sdActive);
+    HostSim::spendUs(us);
+    HostSim::setLoad(HostSim::Load::kSd, sfMounted ? profile.sdIdle : 0.0f);
+    }
+
+void spendTransfer(size_t n)
+    {
+    spendSdUs(kAccessUs + std::uint64_t(n) * kPerByteNs / 1000);
+    }
+
+} // namespace
+
+struct File::Handle_t
+    {
+    std::string key;
+    std::uint8_t mode;
+    std::uint32_t pos;
+    bool fOpen;
+    // directories: the key of the last entry returned by openNextFile()
+    std::string lastChild;
+    char name[64];
+    };
+
+/****************************************************************************\
+|
+|   SDClass
+|
+\****************************************************************************/
+
+bool SDClass::begin(SPIClass &spi, std::uint32_t clock, std::uint8_t csPin)
+    {
+    sfMounted = HostSim::gOptions.fSdCard;
+    spendSdUs(kMountUs);
+    return sfMounted;
+    }
+
+bool SDClass::end()
+    {
+    sfMounted = false;
+    spendSdUs(kEndUs);
+    return true;
+    }
+
+File SDClass::open(const char *pPath, std::uint8_t mode)
+    {
+    spendSdUs(kOpenUs);
+    if (! sfMounted)
+        return File();
+
+    auto const key = getKey(pPath);
+    auto pNode = findNode(key);
+
+    if (pNode == nullptr)
+        {
+        auto const pParent = findNode(getParent(key));
+
+        if ((mode & O_CREAT) == 0 || pParent == nullptr || ! pParent->fDir)
+            return File();
+
+        pNode = &sCard[key];
+        pNode->name = getBaseName(pPath);
+        pNode->fDir = false;
+        }
+    else if (pNode->fDir && (mode & O_WRITE) != 0)
+        return File();
+
+    if ((mode & O_TRUNC) != 0 && ! pNode->fDir)
+        pNode->data.clear();
+
+    auto pHandle = std::make_shared<File::Handle_t>();
+    pHandle->key = key;
+    pHandle->mode = mode;
+    pHandle->pos = (mode & O_APPEND) != 0 ? std::uint32_t(pNode->data.size()) : 0;
+    pHandle->fOpen = true;
+    std::snprintf(pHandle->name, sizeof(pHandle->name), "%s", pNode->name.c_str());
+    return File(pHandle);
+    }
+
+bool SDClass::exists(const char *pPath)
+    {
+    spendSdUs(kAccessUs);
+    return sfMounted && findNode(getKey(pPath)) != nullptr;
+    }
+
+bool SDClass::mkdir(const char *pPath)
+    {
+    spendSdUs(kMkdirUs);
+    if (! sfMounted)
+        return false;
+
+    // makes the parents too, as the SD library does.
+    std::string key;
+    auto p = pPath;
+
+    for (;;)
+        {
+        while (*p == '/')
+            ++p;
+        if (*p == '\0')
+            return true;
+
+        auto pEnd = p;
+        while (*pEnd != '\0' && *pEnd != '/')
+            ++pEnd;
+
+        std::string const name(p, pEnd);
+        if (! key.empty())
+            key += '/';
+        key += getKey(name.c_str());
+
+        auto const pNode = findNode(key);
+        if (pNode == nullptr)
+            sCard[key] = Node_t { name, true, {} };
+        else if (! pNode->fDir)
+            return false;
+
+        p = pEnd;
+        }
+    }
+
+bool SDClass::remove(const char *pPath)
+    {
+    spendSdUs(kMkdirUs);
+    if (! sfMounted)
+        return false;
+
+    auto const it = sCard.find(getKey(pPath));
+    if (it == sCard.end() || it->second.fDir)
+        return false;
+
+    sCard.erase(it);
+    return true;
+    }
+
+bool SDClass::rmdir(const char *pPath)
+    {
+    spendSdUs(kMkdirUs);
+    auto const key = getKey(pPath);
+    auto const it = sCard.find(key);
+
+    if (! sfMounted || key.empty() || it == sCard.end() || ! it->second.fDir)
+        return false;
+
+    for (auto const &entry : sCard)
+        if (getParent(entry.first) == key && entry.first != key)
+            return false;
+
+    sCard.erase(it);
+    return true;
+    }
+
+/****************************************************************************\
+|
+|   File
+|
+\****************************************************************************/
+
+namespace {
+
+// the node an open handle refers to, if the card is still up and it's
+// still there.
+Node_t *getOpenNode(const std::shared_ptr<File::Handle_t> &pHandle)
+    {
+    if (! pHandle || ! pHandle->fOpen || ! sfMounted)
+        return nullptr;
+
+    return findNode(pHandle->key);
+    }
+
+} // namespace
+
+size_t File::write(std::uint8_t c)
+    {
+    return this->write(&c, 1);
+    }
+
+size_t File::write(const std::uint8_t *pBuffer, size_t nBuffer)
+    {
+    auto const pNode = getOpenNode(this->m_pHandle);
+
+    if (pNode == nullptr || pNode->fDir || (this->m_pHandle->mode & O_WRITE) == 0)
+        return 0;
+
+    auto &pos = this->m_pHandle->pos;
+    if ((this->m_pHandle->mode & O_APPEND) != 0)
+        pos = std::uint32_t(pNode->data.size());
+    if (pos + nBuffer > pNode->data.size())
+        pNode->data.resize(pos + nBuffer);
+
+    spendTransfer(nBuffer);
+    std::memcpy(pNode->data.data() + pos, pBuffer, nBuffer);
+    pos += std::uint32_t(nBuffer);
+    return nBuffer;
+    }
+
+int File::available()
+    {
+    auto const pNode = getOpenNode(this->m_pHandle);
+
+    if (pNode == nullptr || pNode->fDir || this->m_pHandle->pos >= pNode->data.size())
+        return 0;
+    return int(pNode->data.size() - this->m_pHandle->pos);
+    }
+
+int File::read()
+    {
+    std::uint8_t c;
+
+    return this->read(&c, 1) == 1 ? c : -1;
+    }
+
+int File::read(void *pBuffer, std::uint16_t nBuffer)
+    {
+    auto const pNode = getOpenNode(this->m_pHandle);
+
+    if (pNode == nullptr || pNode->fDir || (this->m_pHandle->mode & O_READ) == 0)
+        return -1;
+
+    auto &pos = this->m_pHandle->pos;
+    size_t n = pos < pNode->data.size() ? pNode->data.size() - pos : 0;
+    if (n > nBuffer)
+        n = nBuffer;
+
+    spendTransfer(n);
+    std::memcpy(pBuffer, pNode->data.data() + pos, n);
+    pos += std::uint32_t(n);
+    return int(n);
+    }
+
+int File::peek()
+    {
+    auto const pNode = getOpenNode(this->m_pHandle);
+
+    if (pNode == nullptr || pNode->fDir || this->m_pHandle->pos >= pNode->data.size())
+        return -1;
+    return pNode->data[this->m_pHandle->pos];
+    }
+
+void File::flush()
+    {
+    if (getOpenNode(this->m_pHandle) != nullptr)
+        spendSdUs(kCloseUs);
+    }
+
+bool File::seek(std::uint32_t pos)
+    {
+    auto const pNode = getOpenNode(this->m_pHandle);
+
+    if (pNode == nullptr || pos > pNode->data.size())
+        return false;
+
+    spendSdUs(kAccessUs);
+    this->m_pHandle->pos = pos;
+    return true;
+    }
+
+std::uint32_t File::position()
+    {
+    return this->m_pHandle ? this->m_pHandle->pos : 0;
+    }
+
+std::uint32_t File::size()
+    {
+    auto const pNode = getOpenNode(this->m_pHandle);
+
+    return pNode == nullptr ? 0 : std::uint32_t(pNode->data.size());
+    }
+
+void File::close()
+    {
+    if (! this->m_pHandle || ! this->m_pHandle->fOpen)
+        return;
+
+    if ((this->m_pHandle->mode & O_WRITE) != 0)
+        spendSdUs(kCloseUs);
+    this->m_pHandle->fOpen = false;
+    }
+
+File::operator bool()
+    {
+    return this->m_pHandle && this->m_pHandle->fOpen;
+    }
+
+char *File::name()
+    {
+    return this->m_pHandle ? this->m_pHandle->name : nullptr;
+    }
+
+bool File::isDirectory()
+    {
+    auto const pNode = getOpenNode(this->m_pHandle);
+
+    return pNode != nullptr && pNode->fDir;
+    }
+
+// entries come in name order: the map is sorted.
+File File::openNextFile(std::uint8_t mode)
+    {
+    auto const pNode = getOpenNode(this->m_pHandle);
+
+    if (pNode == nullptr || ! pNode->fDir)
+        return File();
+
+    auto &h = *this->m_pHandle;
+    auto it = h.lastChild.empty() ? sCard.begin() : sCard.upper_bound(h.lastChild);
+
+    for (; it != sCard.end(); ++it)
+        {
+        if (it->first.empty() || getParent(it->first) != h.key)
+            continue;
+
+        h.lastChild = it->first;
+        spendSdUs(kAccessUs);
+
+        auto pHandle = std::make_shared<Handle_t>();
+        pHandle->key = it->first;
+        pHandle->mode = it->second.fDir ? O_READ : mode;
+        pHandle->pos = 0;
+        pHandle->fOpen = true;
+        std::snprintf(pHandle->name, sizeof(pHandle->name), "%s", it->second.name.c_str());
+        return File(pHandle);
+        }
+
+    return File();
+    }
+
+void File::rewindDirectory()
+    {
+    if (this->m_pHandle)
+        this->m_pHandle->lastChild.clear();
+    }
+
+/****************************************************************************\
+|
+|   Looking at the card from the host
+|
+\****************************************************************************/
+
+void HostSim::getSdUsage(unsigned &nFiles, unsigned &nDirs, std::uint64_t &nBytes)
+    {
+    nFiles = nDirs = 0;
+    nBytes = 0;
+    for (auto const &entry : sCard)
+        {
+        if (entry.first.empty())
+            continue;
+        if (entry.second.fDir)
+            ++nDirs;
+        else
+            {
+            ++nFiles;
+            nBytes += entry.second.data.size();
+            }
+        }
+    }
+
+// the card's files under pDirectory, with the names they were given.
+bool HostSim::saveSdCard(const char *pDirectory)
+    {
+    ::mkdir(pDirectory, 0777);
+
+    // parents sort before their children, so they're made first.
+    std::map<std::string, std::string> hostPath = { { "", pDirectory } };
+
+    for (auto const &entry : sCard)
+        {
+        if (entry.first.empty())
+            continue;
+
+        auto const path = hostPath[getParent(entry.first)] + "/" + entry.second.name;
+        hostPath[entry.first] = path;
+
+        if (entry.second.fDir)
+            {
+            ::mkdir(path.c_str(), 0777);
+            continue;
+            }
+
+        auto const pFile = std::fopen(path.c_str(), "wb");
+        if (pFile == nullptr)
+            {
+            std::perror(path.c_str());
+            return false;
+            }
+        auto const &data = entry.second.data;
+        bool const fOk = std::fwrite(data.data(), 1, data.size(), pFile) == data.size();
+        if (std::fclose(pFile) != 0 || ! fOk)
+            {
+            std::perror(path.c_str());
+            return false;
+            }
+        }
+
+    return true;
+    }
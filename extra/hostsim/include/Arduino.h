@@ -0,0 +1,153 @@
+/*
+
+Module: Arduino.h
+
+Function:
+    Host simulation: the parts of the Arduino core the sketch uses.
+
+Copyright:
+    See accompanying LICENSE file for copyright and license information.
+
+Author:
+    Dhinesh Kumar Pitchai, MCCI Corporation   November 2022
+
+Notes:
+    Time comes from the simulation's virtual clock (see ../hostsim.h);
+    the console goes to stdout.
+
+*/
+
+#ifndef _hostsim_Arduino_h_
+# define _hostsim_Arduino_h_
+
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+typedef std::uint8_t byte;
+
+std::uint32_t millis();
+std::uint32_t micros();
+void delay(std::uint32_t ms);
+void delayMicroseconds(std::uint32_t us);
+void yield();
+
+enum { INPUT = 0, OUTPUT = 1, INPUT_PULLUP = 2 };
+enum { LOW = 0, HIGH = 1 };
+enum { D5 = 5, D11 = 11, D12 = 12, A0 = 14 };
+
+void pinMode(int pin, int mode);
+void digitalWrite(int pin, int value);
+int digitalRead(int pin);
+
+class Print
+    {
+public:
+    virtual ~Print() {}
+    virtual size_t write(std::uint8_t c) = 0;
+    virtual size_t write(const std::uint8_t *pBuffer, size_t nBuffer)
+        {
+        size_t n = 0;
+        while (nBuffer-- > 0)
+            n += this->write(*pBuffer++);
+        return n;
+        }
+    size_t write(const char *s)
+        {
+        return this->write((const std::uint8_t *)s, std::strlen(s));
+        }
+    size_t write(const char *p, size_t n)
+        {
+        return this->write((const std::uint8_t *)p, n);
+        }
+    virtual void flush() {}
+
+    size_t print(const char *s);
+    size_t print(char c);
+    size_t print(unsigned long v, int base = 10);
+    size_t print(long v, int base = 10);
+    size_t print(unsigned v, int base = 10)
+        {
+        return this->print((unsigned long)v, base);
+        }
+    size_t print(int v, int base = 10)
+        {
+        return this->print((long)v, base);
+        }
+    size_t print(double v, int digits = 2);
+    size_t println()
+        {
+        return this->write("\r\n");
+        }
+    template <typename T>
+    size_t println(T v)
+        {
+        return this->print(v) + this->println();
+        }
+    template <typename T>
+    size_t println(T v, int arg)
+        {
+        return this->print(v, arg) + this->println();
+        }
+    };
+
+class Stream : public Print
+    {
+public:
+    virtual int available()
+        {
+        return 0;
+        }
+    virtual int read()
+        {
+        return -1;
+        }
+    virtual int peek()
+        {
+        return -1;
+        }
+    size_t readBytes(std::uint8_t *pBuffer, size_t nBuffer);
+    size_t readBytes(char *pBuffer, size_t nBuffer)
+        {
+        return this->readBytes((std::uint8_t *)pBuffer, nBuffer);
+        }
+    };
+
+// the USB console. dtr() is true when the simulation runs "attended",
+// which keeps the sketch out of deep sleep, as a connected terminal does.
+class USBSerial : public Stream
+    {
+public:
+    void begin(unsigned long baud = 115200);
+    void end();
+    operator bool()
+        {
+        return this->dtr();
+        }
+    bool dtr();
+    size_t write(std::uint8_t c) override;
+    size_t write(const std::uint8_t *pBuffer, size_t nBuffer) override;
+    using Print::write;
+    int availableForWrite();
+    };
+
+extern USBSerial Serial;
+
+#define USBCON 1
+
+// the vector table register, for the running image. The simulation has
+// no flash image, so it reads as zero.
+struct SCB_Type
+    {
+    volatile std::uint32_t VTOR;
+    };
+extern SCB_Type *SCB;
+
+#define FLASH_END 0x0802FFFFUL
+
+#endif /* _hostsim_Arduino_h_ */
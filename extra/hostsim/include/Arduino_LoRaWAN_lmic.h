@@ -0,0 +1,23 @@
+/*
+
+Module: Arduino_LoRaWAN_lmic.h
+
+Function:
+    Host simulation: the LoRaWAN library's LMIC header.
+
+Copyright:
+    See accompanying LICENSE file for copyright and license information.
+
+Author:
+    Dhinesh Kumar Pitchai, MCCI Corporation   November 2022
+
+*/
+
+#ifndef _hostsim_Arduino_LoRaWAN_lmic_h_
+# define _hostsim_Arduino_LoRaWAN_lmic_h_
+
+#pragma once
+
+#include <arduino_lmic.h>
+
+#endif /* _hostsim_Arduino_LoRaWAN_lmic_h_ */
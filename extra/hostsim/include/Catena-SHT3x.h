@@ -0,0 +1,42 @@
+/*
+
+Module: Catena-SHT3x.h
+
+Function:
+    Host simulation: the SHT3x temperature/humidity sensor.
+
+Copyright:
+    See accompanying LICENSE file for copyright and license information.
+
+Author:
+    Dhinesh Kumar Pitchai, MCCI Corporation   November 2022
+
+*/
+
+#ifndef _hostsim_Catena_SHT3x_h_
+# define _hostsim_Catena_SHT3x_h_
+
+#pragma once
+
+#include <Wire.h>
+
+namespace McciCatenaSht3x {
+
+class cSHT3x
+    {
+public:
+    struct Measurements
+        {
+        float Temperature;
+        float Humidity;
+        };
+
+    cSHT3x(TwoWire &wire) {}
+    bool begin();
+    // a single-shot, high-repeatability measurement: 15 ms.
+    bool getTemperatureHumidity(Measurements &m);
+    };
+
+} // namespace McciCatenaSht3x
+
+#endif /* _hostsim_Catena_SHT3x_h_ */
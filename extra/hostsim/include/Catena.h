@@ -0,0 +1,159 @@
+/*
+
+Module: Catena.h
+
+Function:
+    Host simulation: the Catena platform and its LoRaWAN object.
+
+Copyright:
+    See accompanying LICENSE file for copyright and license information.
+
+Author:
+    Dhinesh Kumar Pitchai, MCCI Corporation   November 2022
+
+*/
+
+#ifndef _hostsim_Catena_h_
+# define _hostsim_Catena_h_
+
+#pragma once
+
+#include <Arduino.h>
+#include <Catena_CommandStream.h>
+#include <Catena_Fram.h>
+#include <Catena_PollableInterface.h>
+
+#define CATENA_ARDUINO_PLATFORM_VERSION_CALC(major, minor, patch, local)    \
+    (((major) << 24u) | ((minor) << 16u) | ((patch) << 8u) | (local))
+#define CATENA_ARDUINO_PLATFORM_VERSION                                     \
+    CATENA_ARDUINO_PLATFORM_VERSION_CALC(0, 21, 0, 5)
+#define CATENA_ARDUINO_PLATFORM_VERSION_COMPARE_GE(a, b)                    \
+    ((a) >= (b))
+
+struct CATENA_PLATFORM;
+
+namespace McciCatena {
+
+class CatenaBase
+    {
+public:
+    struct EUI64_buffer_t
+        {
+        std::uint8_t b[8];
+        };
+    struct UniqueID_string_t
+        {
+        char c[40];
+        };
+
+    enum OPERATING_FLAGS : std::uint32_t
+        {
+        fUnattended = 1 << 0,
+        fManufacturingTest = 1 << 1,
+        fConfirmedUplink = 1 << 16,
+        fDisableDeepSleep = 1 << 17,
+        fQuickLightSleep = 1 << 18,
+        fDeepSleepTest = 1 << 19,
+        };
+    };
+
+// Sleep() is where the virtual clock jumps ahead; poll() is where it
+// ticks along while the sketch is awake.
+class Catena : public CatenaBase
+    {
+public:
+    enum
+        {
+        PIN_STATUS_LED = 13,
+        PIN_SPI2_MOSI = 20,
+        PIN_SPI2_MISO = 21,
+        PIN_SPI2_SCK = 22,
+        PIN_SPI2_FLASH_SS = 23,
+        };
+
+    bool begin();
+    void poll();
+    void registerObject(cPollableObject *pObject);
+    void SafePrintf(const char *pFmt, ...) __attribute__((__format__(__printf__, 2, 3)));
+
+    std::uint32_t GetOperatingFlags();
+    void SetOperatingFlags(std::uint32_t flags)
+        {
+        this->m_operatingFlags = flags;
+        }
+    std::uint32_t GetPlatformFlags();
+    static std::uint32_t PlatformFlags_GetModNumber(std::uint32_t flags);
+
+    float ReadVbat() const;
+    float ReadVbus() const;
+    bool getBootCount(std::uint32_t &bootCount);
+    cFram *getFram();
+    void Sleep(std::uint32_t howLongInSeconds);
+
+    const EUI64_buffer_t *GetSysEUI();
+    const char *GetUniqueIDstring(UniqueID_string_t *pId);
+    const CATENA_PLATFORM *GetPlatform();
+    std::uint32_t GetSystemClockRate() const;
+    void addCommands(cCommandStream::cDispatch &dispatch, void *pContext) {}
+
+    class LoRaWAN;
+
+private:
+    cPollableObject                 *m_pPollHead = nullptr;
+    cFram                           m_fram;
+    std::uint32_t                   m_operatingFlags = 0;
+    std::uint32_t                   m_bootCount = 1;
+    };
+
+// Uplinks take their airtime on the virtual clock, then succeed or fail
+// as the simulation's radio model decides. Downlinks arrive after an
+// uplink, as in class A.
+class Catena::LoRaWAN : public cPollableObject
+    {
+public:
+    typedef void SendBufferCbFn(void *pCtx, bool fSuccess);
+    typedef void ReceivePortBufferCbFn(void *pCtx, std::uint8_t uPort, const std::uint8_t *pBuffer, size_t nBuffer);
+
+    bool begin(Catena *pCatena);
+    void poll() override;
+    bool SendBuffer(
+        const std::uint8_t *pBuffer,
+        size_t nBuffer,
+        SendBufferCbFn *pDoneFn = nullptr,
+        void *pCtx = nullptr,
+        bool fConfirmed = false,
+        std::uint8_t port = 1
+        );
+    void SetReceiveBufferBufferCb(ReceivePortBufferCbFn *pFn, void *pCtx = nullptr)
+        {
+        this->m_pReceiveFn = pFn;
+        this->m_pReceiveCtx = pCtx;
+        }
+    bool IsProvisioned()
+        {
+        return true;
+        }
+    const char *GetNetworkName() const
+        {
+        return "hostsim";
+        }
+    const char *GetRegionString(char *pBuffer, size_t nBuffer) const;
+
+private:
+    void finishUplink();
+
+    SendBufferCbFn                  *m_pDoneFn = nullptr;
+    void                            *m_pDoneCtx = nullptr;
+    ReceivePortBufferCbFn           *m_pReceiveFn = nullptr;
+    void                            *m_pReceiveCtx = nullptr;
+    bool                            m_fBusy = false;
+    bool                            m_fConfirmed = false;
+    bool                            m_fDelivered = false;
+    std::uint8_t                    m_port = 0;
+    // device millis() when the uplink in flight is done
+    std::uint32_t                   m_doneMs = 0;
+    };
+
+} // namespace McciCatena
+
+#endif /* _hostsim_Catena_h_ */
@@ -0,0 +1,29 @@
+/*
+
+Module: Catena_BootloaderApi.h
+
+Function:
+    Host simulation: the bootloader API.
+
+Copyright:
+    See accompanying LICENSE file for copyright and license information.
+
+Author:
+    Dhinesh Kumar Pitchai, MCCI Corporation   November 2022
+
+*/
+
+#ifndef _hostsim_Catena_BootloaderApi_h_
+# define _hostsim_Catena_BootloaderApi_h_
+
+#pragma once
+
+namespace McciCatena {
+
+class cBootloaderApi
+    {
+    };
+
+} // namespace McciCatena
+
+#endif /* _hostsim_Catena_BootloaderApi_h_ */
@@ -0,0 +1,62 @@
+/*
+
+Module: Catena_CommandStream.h
+
+Function:
+    Host simulation: the command processor.
+
+Copyright:
+    See accompanying LICENSE file for copyright and license information.
+
+Author:
+    Dhinesh Kumar Pitchai, MCCI Corporation   November 2022
+
+*/
+
+#ifndef _hostsim_Catena_CommandStream_h_
+# define _hostsim_Catena_CommandStream_h_
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace McciCatena {
+
+// just enough to declare command tables; the simulation has no console
+// input, so commands never run.
+class cCommandStream
+    {
+public:
+    enum class CommandStatus : int
+        {
+        kSuccess = 0,
+        kError = -1,
+        kInvalidParameter = -2,
+        kIoError = -3,
+        kReadError = -4,
+        kWriteError = -5,
+        kNotFound = -6,
+        };
+
+    typedef CommandStatus (CommandFn)(cCommandStream *pThis, void *pContext, int argc, char **argv);
+
+    struct cEntry
+        {
+        const char *pName;
+        CommandFn *pFn;
+        };
+
+    class cDispatch
+        {
+    public:
+        cDispatch(const cEntry *pEntries, size_t sizeEntries, const char *pFirstWord) {}
+        };
+
+    void printf(const char *pFmt, ...) __attribute__((__format__(__printf__, 2, 3)));
+    static CommandStatus getuint32(int argc, char **argv, int iArg, unsigned radix, std::uint32_t &result, std::uint32_t uDefault);
+    };
+
+} // namespace McciCatena
+
+#endif /* _hostsim_Catena_CommandStream_h_ */
@@ -0,0 +1,81 @@
+/*
+
+Module: Catena_Download.h
+
+Function:
+    Host simulation: firmware download to the SPI flash.
+
+Copyright:
+    See accompanying LICENSE file for copyright and license information.
+
+Author:
+    Dhinesh Kumar Pitchai, MCCI Corporation   November 2022
+
+*/
+
+#ifndef _hostsim_Catena_Download_h_
+# define _hostsim_Catena_Download_h_
+
+#pragma once
+
+#include <Catena_BootloaderApi.h>
+#include <Catena_Mx25v8035f.h>
+#include <cstddef>
+#include <cstdint>
+
+namespace McciCatena {
+
+template <typename TFn>
+struct cCallback
+    {
+    TFn *pfn = nullptr;
+    void *pUserData = nullptr;
+
+    void init(TFn *pFn, void *pUser)
+        {
+        this->pfn = pFn;
+        this->pUserData = pUser;
+        }
+    };
+
+// evStart() pulls the whole image through the request's callbacks, as
+// the real download does in the background, discards it, and reports
+// success; there's no flash to program or bootloader to run it.
+class cDownload
+    {
+public:
+    static constexpr size_t kTransferChunkBytes = 256;
+
+    enum class DownloadRq_t : std::uint8_t
+        {
+        GetUpdate,
+        GetFallback,
+        };
+
+    enum class Status_t : std::uint8_t
+        {
+        kSuccessful,
+        kError,
+        };
+
+    typedef int QueryAvailableData_t(void *pUserData);
+    typedef void PromptForData_t(void *pUserData);
+    typedef size_t ReadBytes_t(void *pUserData, std::uint8_t *pBuffer, size_t nBuffer);
+    typedef void Completion_t(void *pUserData, Status_t status);
+
+    struct Request_t
+        {
+        cCallback<QueryAvailableData_t> QueryAvailableData;
+        cCallback<PromptForData_t>      PromptForData;
+        cCallback<ReadBytes_t>          ReadBytes;
+        cCallback<Completion_t>         Completion;
+        DownloadRq_t                    rq;
+        };
+
+    void begin(Catena_Mx25v8035f &flash, cBootloaderApi &bootloaderApi) {}
+    bool evStart(Request_t &request);
+    };
+
+} // namespace McciCatena
+
+#endif /* _hostsim_Catena_Download_h_ */
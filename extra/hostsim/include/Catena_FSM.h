@@ -0,0 +1,93 @@
+/*
+
+Module: Catena_FSM.h
+
+Function:
+    Host simulation: the Catena finite state machine template.
+
+Copyright:
+    See accompanying LICENSE file for copyright and license information.
+
+Author:
+    Dhinesh Kumar Pitchai, MCCI Corporation   November 2022
+
+*/
+
+#ifndef _hostsim_Catena_FSM_h_
+# define _hostsim_Catena_FSM_h_
+
+#pragma once
+
+#include "../hostsim.h"
+
+namespace McciCatena {
+
+// The dispatch function is called with fEntry true the first time it
+// runs in a state, and returns the next state or stNoChange. eval()
+// runs it until it settles; an eval() from inside the dispatch function
+// (by way of poll(), or a completion) just asks for another pass. Each
+// state is reported to the energy ledger by the parent's getStateName().
+template <class TParent, class TState>
+class cFSM
+    {
+public:
+    typedef TState (TParent::*Dispatch_t)(TState currentState, bool fEntry);
+
+    void init(TParent &parent, Dispatch_t pDispatch)
+        {
+        this->m_pParent = &parent;
+        this->m_pDispatch = pDispatch;
+        this->m_state = TState::stInitial;
+        this->m_fEntry = true;
+        HostSim::setEnergyState(TParent::getStateName(this->m_state));
+        this->eval();
+        }
+
+    void eval()
+        {
+        if (this->m_pParent == nullptr)
+            return;
+
+        if (this->m_fBusy)
+            {
+            this->m_fAgain = true;
+            return;
+            }
+
+        this->m_fBusy = true;
+        do  {
+            this->m_fAgain = false;
+            for (;;)
+                {
+                auto const fEntry = this->m_fEntry;
+                auto const newState = (this->m_pParent->*this->m_pDispatch)(this->m_state, fEntry);
+
+                this->m_fEntry = false;
+                if (newState == TState::stNoChange)
+                    break;
+
+                this->m_state = newState;
+                this->m_fEntry = true;
+                HostSim::setEnergyState(TParent::getStateName(newState));
+                }
+            } while (this->m_fAgain);
+        this->m_fBusy = false;
+        }
+
+    TState getState() const
+        {
+        return this->m_state;
+        }
+
+private:
+    TParent                         *m_pParent = nullptr;
+    Dispatch_t                      m_pDispatch = nullptr;
+    TState                          m_state = TState::stInitial;
+    bool                            m_fEntry = true;
+    bool                            m_fBusy = false;
+    bool                            m_fAgain = false;
+    };
+
+} // namespace McciCatena
+
+#endif /* _hostsim_Catena_FSM_h_ */
@@ -0,0 +1,69 @@
+/*
+
+Module: Catena_Fram.h
+
+Function:
+    Host simulation: the FRAM.
+
+Copyright:
+    See accompanying LICENSE file for copyright and license information.
+
+Author:
+    Dhinesh Kumar Pitchai, MCCI Corporation   November 2022
+
+*/
+
+#ifndef _hostsim_Catena_Fram_h_
+# define _hostsim_Catena_Fram_h_
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace McciCatena {
+
+class cFramStorage
+    {
+public:
+    typedef std::uint32_t Offset;
+
+    enum StandardKeys : std::uint8_t
+        {
+        kHeader = 0, kSysEUI, kPlatformGuid, kDevEUI, kAppEUI, kDevAddr,
+        kJoin, kLoRaClass, kNwkSKey, kAppSKey, kFCntDown, kFCntUp, kNetID,
+        kAppKey, kBootCount, kOperatingFlags, kPlatformFlags,
+        kLmicSessionState, kMAX,
+        };
+    };
+
+// 32 KiB of memory that, like FRAM, keeps its contents through deep
+// sleep. The platform's keyed fields aren't simulated; getField() finds
+// nothing.
+class cFram
+    {
+public:
+    static constexpr size_t kSize = 32 * 1024;
+
+    virtual ~cFram() {}
+    virtual bool read(cFramStorage::Offset uOffset, std::uint8_t *pBuffer, size_t nBuffer);
+    virtual bool write(cFramStorage::Offset uOffset, const std::uint8_t *pBuffer, size_t nBuffer);
+
+    template <typename T>
+    bool getField(cFramStorage::StandardKeys key, T &value)
+        {
+        return false;
+        }
+    template <typename T>
+    bool saveField(cFramStorage::StandardKeys key, const T &value)
+        {
+        return false;
+        }
+
+private:
+    std::uint8_t                    m_data[kSize] {};
+    };
+
+} // namespace McciCatena
+
+#endif /* _hostsim_Catena_Fram_h_ */
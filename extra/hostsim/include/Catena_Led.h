@@ -0,0 +1,55 @@
+/*
+
+Module: Catena_Led.h
+
+Function:
+    Host simulation: the status LED.
+
+Copyright:
+    See accompanying LICENSE file for copyright and license information.
+
+Author:
+    Dhinesh Kumar Pitchai, MCCI Corporation   November 2022
+
+*/
+
+#ifndef _hostsim_Catena_Led_h_
+# define _hostsim_Catena_Led_h_
+
+#pragma once
+
+#include <Catena_PollableInterface.h>
+#include <cstdint>
+
+namespace McciCatena {
+
+enum class LedPattern : std::uint32_t
+    {
+    NotProvisioned, Joining, Joined, Sending, WarmingUp, Measuring,
+    Settling, Sleeping, FastFlash, TwoShort, Off, On,
+    };
+
+// remembers the pattern; nothing blinks.
+class StatusLed : public cPollableObject
+    {
+public:
+    StatusLed(int pin) {}
+    bool begin()
+        {
+        return true;
+        }
+    LedPattern Set(LedPattern pattern)
+        {
+        auto const old = this->m_pattern;
+        this->m_pattern = pattern;
+        return old;
+        }
+    void poll() override {}
+
+private:
+    LedPattern                      m_pattern = LedPattern::Off;
+    };
+
+} // namespace McciCatena
+
+#endif /* _hostsim_Catena_Led_h_ */
@@ -0,0 +1,62 @@
+/*
+
+Module: Catena_Log.h
+
+Function:
+    Host simulation: the Catena debug log.
+
+Copyright:
+    See accompanying LICENSE file for copyright and license information.
+
+Author:
+    Dhinesh Kumar Pitchai, MCCI Corporation   November 2022
+
+*/
+
+#ifndef _hostsim_Catena_Log_h_
+# define _hostsim_Catena_Log_h_
+
+#pragma once
+
+#include <cstdint>
+
+namespace McciCatena {
+
+class cLog
+    {
+public:
+    enum DebugFlags : std::uint32_t
+        {
+        kAlways = 0,
+        kError = 1 << 0,
+        kWarning = 1 << 1,
+        kTrace = 1 << 2,
+        kInfo = 1 << 3,
+        kBug = 1u << 31,
+        };
+
+    bool isEnabled(DebugFlags flags) const
+        {
+        return flags == kAlways || (this->m_flags & flags) != 0;
+        }
+    DebugFlags getFlags() const
+        {
+        return this->m_flags;
+        }
+    DebugFlags setFlags(DebugFlags flags)
+        {
+        auto const old = this->m_flags;
+        this->m_flags = flags;
+        return old;
+        }
+    void printf(DebugFlags flags, const char *pFmt, ...) __attribute__((__format__(__printf__, 3, 4)));
+
+private:
+    DebugFlags                      m_flags = DebugFlags(kError | kBug);
+    };
+
+extern cLog gLog;
+
+} // namespace McciCatena
+
+#endif /* _hostsim_Catena_Log_h_ */
@@ -0,0 +1,40 @@
+/*
+
+Module: Catena_Mx25v8035f.h
+
+Function:
+    Host simulation: the SPI flash.
+
+Copyright:
+    See accompanying LICENSE file for copyright and license information.
+
+Author:
+    Dhinesh Kumar Pitchai, MCCI Corporation   November 2022
+
+*/
+
+#ifndef _hostsim_Catena_Mx25v8035f_h_
+# define _hostsim_Catena_Mx25v8035f_h_
+
+#pragma once
+
+#include <SPI.h>
+
+namespace McciCatena {
+
+// present, but never written: cDownload doesn't program anything here.
+class Catena_Mx25v8035f
+    {
+public:
+    bool begin(SPIClass *pSpi, int csPin)
+        {
+        return true;
+        }
+    void end() {}
+    void powerDown() {}
+    void powerUp() {}
+    };
+
+} // namespace McciCatena
+
+#endif /* _hostsim_Catena_Mx25v8035f_h_ */
@@ -0,0 +1,35 @@
+/*
+
+Module: Catena_PollableInterface.h
+
+Function:
+    Host simulation: objects polled by Catena::poll().
+
+Copyright:
+    See accompanying LICENSE file for copyright and license information.
+
+Author:
+    Dhinesh Kumar Pitchai, MCCI Corporation   November 2022
+
+*/
+
+#ifndef _hostsim_Catena_PollableInterface_h_
+# define _hostsim_Catena_PollableInterface_h_
+
+#pragma once
+
+namespace McciCatena {
+
+class cPollableObject
+    {
+public:
+    virtual ~cPollableObject() {}
+    virtual void poll() = 0;
+
+    // the list kept by Catena::registerObject().
+    cPollableObject                 *m_pNext = nullptr;
+    };
+
+} // namespace McciCatena
+
+#endif /* _hostsim_Catena_PollableInterface_h_ */
@@ -0,0 +1,77 @@
+/*
+
+Module: Catena_Timer.h
+
+Function:
+    Host simulation: the Catena millisecond timer.
+
+Copyright:
+    See accompanying LICENSE file for copyright and license information.
+
+Author:
+    Dhinesh Kumar Pitchai, MCCI Corporation   November 2022
+
+*/
+
+#ifndef _hostsim_Catena_Timer_h_
+# define _hostsim_Catena_Timer_h_
+
+#pragma once
+
+#include <Arduino.h>
+
+namespace McciCatena {
+
+// a periodic timer on millis(): it ticks every interval, and
+// isready() consumes the ticks that have gone by.
+class cTimer
+    {
+public:
+    bool begin(std::uint32_t nMillis)
+        {
+        this->m_interval = nMillis;
+        this->m_time = millis();
+        return true;
+        }
+    void end() {}
+    void setInterval(std::uint32_t nMillis)
+        {
+        this->m_interval = nMillis;
+        }
+    std::uint32_t getInterval() const
+        {
+        return this->m_interval;
+        }
+    // make the next tick due now.
+    void retrigger()
+        {
+        this->m_time = millis() - this->m_interval;
+        }
+    std::uint32_t peekTicks() const
+        {
+        return this->m_interval == 0 ? 0 : (millis() - this->m_time) / this->m_interval;
+        }
+    bool isready()
+        {
+        auto const nTicks = this->peekTicks();
+
+        if (nTicks == 0)
+            return false;
+
+        this->m_time += nTicks * this->m_interval;
+        return true;
+        }
+    std::uint32_t getRemaining() const
+        {
+        auto const elapsed = millis() - this->m_time;
+        return elapsed >= this->m_interval ? 0 : this->m_interval - elapsed;
+        }
+
+private:
+    std::uint32_t                   m_interval = 0;
+    std::uint32_t                   m_time = 0;
+    };
+
+} // namespace McciCatena
+
+#endif /* _hostsim_Catena_Timer_h_ */
@@ -0,0 +1,130 @@
+/*
+
+Module: Catena_TxBuffer.h
+
+Function:
+    Host simulation: the Catena uplink buffer.
+
+Copyright:
+    See accompanying LICENSE file for copyright and license information.
+
+Author:
+    Dhinesh Kumar Pitchai, MCCI Corporation   November 2022
+
+*/
+
+#ifndef _hostsim_Catena_TxBuffer_h_
+# define _hostsim_Catena_TxBuffer_h_
+
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+namespace McciCatena {
+
+class AbstractTxBufferBase_t
+    {
+public:
+    // 16-bit unsigned float: 4 bits of exponent, 12 of mantissa, for
+    // values in [0, 1).
+    static std::uint16_t f2uflt16(float f);
+    // the same with a sign bit and 11 bits of mantissa, for (-1, 1).
+    static std::uint16_t f2sflt16(float f);
+    };
+
+// big-endian, saturating, as in the platform library.
+template <size_t N = 32>
+class AbstractTxBuffer_t : public AbstractTxBufferBase_t
+    {
+public:
+    void begin()
+        {
+        this->m_p = this->m_buf;
+        }
+    void put(std::uint8_t c)
+        {
+        if (this->m_p < this->m_buf + N)
+            *this->m_p++ = c;
+        }
+    void put1u(std::int32_t v)
+        {
+        this->put(std::uint8_t(v < 0 ? 0 : v > 0xFF ? 0xFF : v));
+        }
+    void put2(std::uint32_t v)
+        {
+        if (v > 0xFFFF)
+            v = 0xFFFF;
+        this->put(std::uint8_t(v >> 8));
+        this->put(std::uint8_t(v));
+        }
+    void put2(std::int32_t v)
+        {
+        if (v < -0x8000)
+            v = -0x8000;
+        else if (v > 0x7FFF)
+            v = 0x7FFF;
+        this->put(std::uint8_t(std::uint32_t(v) >> 8));
+        this->put(std::uint8_t(v));
+        }
+    void put2u(std::int32_t v)
+        {
+        this->put2(std::uint32_t(v < 0 ? 0 : v));
+        }
+    void put2uf(float v)
+        {
+        this->put2u(std::int32_t(v < 0.0f ? 0.0f : v > 65535.0f ? 65535.0f : v + 0.5f));
+        }
+    void put2sf(float v)
+        {
+        this->put2(std::int32_t(std::lrintf(v)));
+        }
+    void put3(std::uint32_t v)
+        {
+        this->put(std::uint8_t(v >> 16));
+        this->put(std::uint8_t(v >> 8));
+        this->put(std::uint8_t(v));
+        }
+    void put4u(std::uint32_t v)
+        {
+        this->put(std::uint8_t(v >> 24));
+        this->put3(v);
+        }
+    void put4(std::int32_t v)
+        {
+        this->put4u(std::uint32_t(v));
+        }
+    void putV(float V)
+        {
+        this->put2(std::int32_t(V * 4096.0f + 0.5f));
+        }
+    void putBootCountLsb(std::uint32_t bootCount)
+        {
+        this->put(std::uint8_t(bootCount));
+        }
+    void putT(float T)
+        {
+        this->put2(std::int32_t(std::lrintf(T * 256.0f)));
+        }
+    std::uint8_t *getbase()
+        {
+        return this->m_buf;
+        }
+    size_t getn() const
+        {
+        return this->m_p - this->m_buf;
+        }
+    size_t getSize() const
+        {
+        return N;
+        }
+
+private:
+    std::uint8_t                    m_buf[N];
+    std::uint8_t                    *m_p = m_buf;
+    };
+
+} // namespace McciCatena
+
+#endif /* _hostsim_Catena_TxBuffer_h_ */
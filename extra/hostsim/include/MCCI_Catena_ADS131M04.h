@@ -0,0 +1,37 @@
+/*
+
+Module: MCCI_Catena_ADS131M04.h
+
+Function:
+    Host simulation: the ADS131M04 ADC on the gas cells.
+
+Copyright:
+    See accompanying LICENSE file for copyright and license information.
+
+Author:
+    Dhinesh Kumar Pitchai, MCCI Corporation   November 2022
+
+*/
+
+#ifndef _hostsim_MCCI_Catena_ADS131M04_h_
+# define _hostsim_MCCI_Catena_ADS131M04_h_
+
+#pragma once
+
+#include <SPI.h>
+#include <cstdint>
+
+namespace McciCatenaAds131m04 {
+
+// channels 0..3 are the CO, NO2, O3 and SO2 cells.
+class cADS131M04
+    {
+public:
+    bool begin(SPIClass *pSpi);
+    // one conversion: 1 ms.
+    float readVoltage(std::uint8_t channel);
+    };
+
+} // namespace McciCatenaAds131m04
+
+#endif /* _hostsim_MCCI_Catena_ADS131M04_h_ */
@@ -0,0 +1,60 @@
+/*
+
+Module: MCCI_Catena_IPS-7100.h
+
+Function:
+    Host simulation: the IPS-7100 particle sensor.
+
+Copyright:
+    See accompanying LICENSE file for copyright and license information.
+
+Author:
+    Dhinesh Kumar Pitchai, MCCI Corporation   November 2022
+
+*/
+
+#ifndef _hostsim_MCCI_Catena_IPS_7100_h_
+# define _hostsim_MCCI_Catena_IPS_7100_h_
+
+#pragma once
+
+#include <Wire.h>
+#include <cstdint>
+
+namespace McciCatenaIps7100 {
+
+class cIPS7100
+    {
+public:
+    static constexpr unsigned kBins = 7;
+
+    cIPS7100(TwoWire &wire) {}
+    bool begin();
+    void end() {}
+    // reads all the bins: 25 ms on the bus.
+    void updateData();
+
+    std::uint32_t getPC01Data() const { return this->m_count[0]; }
+    std::uint32_t getPC03Data() const { return this->m_count[1]; }
+    std::uint32_t getPC05Data() const { return this->m_count[2]; }
+    std::uint32_t getPC10Data() const { return this->m_count[3]; }
+    std::uint32_t getPC25Data() const { return this->m_count[4]; }
+    std::uint32_t getPC50Data() const { return this->m_count[5]; }
+    std::uint32_t getPC100Data() const { return this->m_count[6]; }
+
+    float getPM01Data() const { return this->m_mass[0]; }
+    float getPM03Data() const { return this->m_mass[1]; }
+    float getPM05Data() const { return this->m_mass[2]; }
+    float getPM10Data() const { return this->m_mass[3]; }
+    float getPM25Data() const { return this->m_mass[4]; }
+    float getPM50Data() const { return this->m_mass[5]; }
+    float getPM100Data() const { return this->m_mass[6]; }
+
+private:
+    std::uint32_t                   m_count[kBins] {};
+    float                           m_mass[kBins] {};
+    };
+
+} // namespace McciCatenaIps7100
+
+#endif /* _hostsim_MCCI_Catena_IPS_7100_h_ */
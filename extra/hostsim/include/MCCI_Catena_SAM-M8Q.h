@@ -0,0 +1,61 @@
+/*
+
+Module: MCCI_Catena_SAM-M8Q.h
+
+Function:
+    Host simulation: the SAM-M8Q GNSS receiver.
+
+Copyright:
+    See accompanying LICENSE file for copyright and license information.
+
+Author:
+    Dhinesh Kumar Pitchai, MCCI Corporation   November 2022
+
+*/
+
+#ifndef _hostsim_MCCI_Catena_SAM_M8Q_h_
+# define _hostsim_MCCI_Catena_SAM_M8Q_h_
+
+#pragma once
+
+#include <cstdint>
+
+#define UBX_CLASS_NAV       0x01
+#define UBX_NAV_PVT         0x07
+#define COM_PORT_I2C        0
+#define COM_TYPE_UBX        1
+
+#define SAM_M8Q_ID_GPS      0
+#define SAM_M8Q_ID_SBAS     1
+#define SAM_M8Q_ID_GALILEO  2
+#define SAM_M8Q_ID_BEIDOU   3
+#define SAM_M8Q_ID_IMES     4
+#define SAM_M8Q_ID_QZSS     5
+#define SAM_M8Q_ID_GLONASS  6
+
+// each query polls a UBX-NAV-PVT: 40 ms. After powerOff(), the receiver
+// answers nothing until the time is up.
+class SAM_M8Q
+    {
+public:
+    bool begin();
+    bool configureMessage(std::uint8_t msgClass, std::uint8_t msgId, std::uint8_t port, std::uint8_t rate);
+    bool enableGNSS(bool fEnable, int gnssId);
+    bool isGNSSenabled(int gnssId);
+    bool setI2COutput(std::uint8_t comType);
+    bool saveConfiguration();
+    float getLatitude();
+    float getLongitude();
+    std::uint32_t getUnixEpoch();
+    bool powerOff(std::uint32_t durationInMs);
+
+private:
+    bool isAwake();
+
+    std::uint32_t                   m_enabled = 1u << SAM_M8Q_ID_GPS;
+    bool                            m_fAsleep = false;
+    // device millis() when it wakes
+    std::uint32_t                   m_wakeMs = 0;
+    };
+
+#endif /* _hostsim_MCCI_Catena_SAM_M8Q_h_ */
@@ -0,0 +1,83 @@
+/*
+
+Module: MCCI_Catena_SCD30.h
+
+Function:
+    Host simulation: the SCD30 CO2 sensor.
+
+Copyright:
+    See accompanying LICENSE file for copyright and license information.
+
+Author:
+    Dhinesh Kumar Pitchai, MCCI Corporation   November 2022
+
+*/
+
+#ifndef _hostsim_MCCI_Catena_SCD30_h_
+# define _hostsim_MCCI_Catena_SCD30_h_
+
+#pragma once
+
+#include <Wire.h>
+#include <cstdint>
+
+namespace McciCatenaScd30 {
+
+// measures continuously every two seconds from begin() to end().
+class cSCD30
+    {
+public:
+    struct Info
+        {
+        std::uint16_t FirmwareVersion;
+        bool fASC_status;
+        std::uint16_t MeasurementInterval;
+        std::uint16_t ForcedRecalibrationValue;
+        std::int16_t TemperatureOffset;
+        std::int16_t AltitudeCompensation;
+        };
+
+    struct Measurements
+        {
+        float CO2ppm;
+        float Temperature;
+        float RelativeHumidity;
+        };
+
+    enum class Error : std::uint8_t
+        {
+        kOk,
+        kNotMeasuring,
+        kCrc,
+        };
+
+    cSCD30(TwoWire &wire) {}
+    bool begin();
+    void end();
+    Info getInfo() const;
+    Error getLastError() const
+        {
+        return this->m_lastError;
+        }
+    const char *getLastErrorName() const;
+    bool queryReady(bool &fError);
+    bool readMeasurement();
+    Measurements getMeasurement() const
+        {
+        return this->m_measurement;
+        }
+    // zero while a measurement is waiting to be read.
+    std::uint32_t getMsToNextMeasurement() const;
+
+private:
+    Measurements                    m_measurement {};
+    Error                           m_lastError = Error::kOk;
+    bool                            m_fRunning = false;
+    // device millis() of begin(), and the measurements read since
+    std::uint32_t                   m_startMs = 0;
+    std::uint32_t                   m_nRead = 0;
+    };
+
+} // namespace McciCatenaScd30
+
+#endif /* _hostsim_MCCI_Catena_SCD30_h_ */
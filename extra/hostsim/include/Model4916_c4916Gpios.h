@@ -0,0 +1,37 @@
+/*
+
+Module: Model4916_c4916Gpios.h
+
+Function:
+    Host simulation: the Model 4916 power and enable GPIOs.
+
+Copyright:
+    See accompanying LICENSE file for copyright and license information.
+
+Author:
+    Dhinesh Kumar Pitchai, MCCI Corporation   November 2022
+
+*/
+
+#ifndef _hostsim_Model4916_c4916Gpios_h_
+# define _hostsim_Model4916_c4916Gpios_h_
+
+#pragma once
+
+#include <Model4916_cPCA9574.h>
+
+namespace McciModel4916 {
+
+class c4916Gpios
+    {
+public:
+    c4916Gpios(cPCA9574 *pPca) {}
+    bool begin()
+        {
+        return true;
+        }
+    };
+
+} // namespace McciModel4916
+
+#endif /* _hostsim_Model4916_c4916Gpios_h_ */
@@ -0,0 +1,33 @@
+/*
+
+Module: Model4916_cPCA9574.h
+
+Function:
+    Host simulation: the PCA9574 GPIO expander.
+
+Copyright:
+    See accompanying LICENSE file for copyright and license information.
+
+Author:
+    Dhinesh Kumar Pitchai, MCCI Corporation   November 2022
+
+*/
+
+#ifndef _hostsim_Model4916_cPCA9574_h_
+# define _hostsim_Model4916_cPCA9574_h_
+
+#pragma once
+
+#include <Wire.h>
+
+namespace McciModel4916 {
+
+class cPCA9574
+    {
+public:
+    cPCA9574(TwoWire *pWire, int address) {}
+    };
+
+} // namespace McciModel4916
+
+#endif /* _hostsim_Model4916_cPCA9574_h_ */
@@ -0,0 +1,86 @@
+/*
+
+Module: SD.h
+
+Function:
+    Host simulation: the SD library, on an in-memory card.
+
+Copyright:
+    See accompanying LICENSE file for copyright and license information.
+
+Author:
+    Dhinesh Kumar Pitchai, MCCI Corporation   November 2022
+
+*/
+
+#ifndef _hostsim_SD_h_
+# define _hostsim_SD_h_
+
+#pragma once
+
+#include <Arduino.h>
+#include <SPI.h>
+#include <memory>
+
+#define O_READ      0x01
+#define O_WRITE     0x02
+#define O_RDWR      (O_READ | O_WRITE)
+#define O_APPEND    0x04
+#define O_CREAT     0x10
+#define O_TRUNC     0x40
+
+#define FILE_READ   O_READ
+#define FILE_WRITE  (O_READ | O_WRITE | O_CREAT | O_APPEND)
+
+#define SPI_FULL_SPEED      0
+#define SPI_HALF_SPEED      1
+#define SPI_QUARTER_SPEED   2
+
+// A File is a handle: copies share the open file, as in the SD library.
+// Operations take time on the virtual clock.
+class File : public Stream
+    {
+public:
+    struct Handle_t;
+
+    File() {}
+    explicit File(std::shared_ptr<Handle_t> pHandle)
+        : m_pHandle(pHandle)
+        {}
+
+    size_t write(std::uint8_t c) override;
+    size_t write(const std::uint8_t *pBuffer, size_t nBuffer) override;
+    using Print::write;
+    int available() override;
+    int read() override;
+    int read(void *pBuffer, std::uint16_t nBuffer);
+    int peek() override;
+    void flush() override;
+    bool seek(std::uint32_t pos);
+    std::uint32_t position();
+    std::uint32_t size();
+    void close();
+    operator bool();
+    char *name();
+    bool isDirectory();
+    File openNextFile(std::uint8_t mode = O_READ);
+    void rewindDirectory();
+
+private:
+    std::shared_ptr<Handle_t>       m_pHandle;
+    };
+
+// begin() fails when the simulation has no card inserted.
+class SDClass
+    {
+public:
+    bool begin(SPIClass &spi, std::uint32_t clock, std::uint8_t csPin);
+    bool end();
+    File open(const char *pPath, std::uint8_t mode = FILE_READ);
+    bool exists(const char *pPath);
+    bool mkdir(const char *pPath);
+    bool remove(const char *pPath);
+    bool rmdir(const char *pPath);
+    };
+
+#endif /* _hostsim_SD_h_ */
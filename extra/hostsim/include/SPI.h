@@ -0,0 +1,35 @@
+/*
+
+Module: SPI.h
+
+Function:
+    Host simulation: SPI ports.
+
+Copyright:
+    See accompanying LICENSE file for copyright and license information.
+
+Author:
+    Dhinesh Kumar Pitchai, MCCI Corporation   November 2022
+
+*/
+
+#ifndef _hostsim_SPI_h_
+# define _hostsim_SPI_h_
+
+#pragma once
+
+#include <Arduino.h>
+
+// nothing is on the bus: the devices are simulated a level up.
+class SPIClass
+    {
+public:
+    SPIClass() {}
+    SPIClass(int mosi, int miso, int sck) {}
+    void begin() {}
+    void end() {}
+    };
+
+extern SPIClass SPI;
+
+#endif /* _hostsim_SPI_h_ */
@@ -0,0 +1,33 @@
+/*
+
+Module: Wire.h
+
+Function:
+    Host simulation: the I2C port.
+
+Copyright:
+    See accompanying LICENSE file for copyright and license information.
+
+Author:
+    Dhinesh Kumar Pitchai, MCCI Corporation   November 2022
+
+*/
+
+#ifndef _hostsim_Wire_h_
+# define _hostsim_Wire_h_
+
+#pragma once
+
+#include <Arduino.h>
+
+// nothing is on the bus: the devices are simulated a level up.
+class TwoWire
+    {
+public:
+    void begin() {}
+    void end() {}
+    };
+
+extern TwoWire Wire;
+
+#endif /* _hostsim_Wire_h_ */
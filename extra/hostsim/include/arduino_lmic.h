@@ -0,0 +1,64 @@
+/*
+
+Module: arduino_lmic.h
+
+Function:
+    Host simulation: the LMIC calls the sketch makes.
+
+Copyright:
+    See accompanying LICENSE file for copyright and license information.
+
+Author:
+    Dhinesh Kumar Pitchai, MCCI Corporation   November 2022
+
+*/
+
+#ifndef _hostsim_arduino_lmic_h_
+# define _hostsim_arduino_lmic_h_
+
+#pragma once
+
+#include <cstdint>
+
+#define CFG_us915 1
+
+typedef std::int32_t ostime_t;
+typedef std::uint32_t lmic_gpstime_t;
+
+#define OSTICKS_PER_SEC 32768
+#define osticks2ms(os)  ((std::int32_t)(((std::int64_t)(os) * 1000) / OSTICKS_PER_SEC))
+#define ms2osticks(ms)  ((ostime_t)(((std::int64_t)(ms) * OSTICKS_PER_SEC) / 1000))
+
+#define MAX_CLOCK_ERROR 65536
+
+struct lmic_time_reference_t
+    {
+    ostime_t tLocal;
+    lmic_gpstime_t tNetwork;
+    };
+
+typedef void lmic_request_network_time_cb_t(void *pUserData, int flagSuccess);
+
+// the answer comes with the next uplink.
+void LMIC_requestNetworkTime(lmic_request_network_time_cb_t *pCallback, void *pUserData);
+int LMIC_getNetworkTimeReference(lmic_time_reference_t *pReference);
+void LMIC_setClockError(std::uint16_t error);
+ostime_t os_getTime();
+
+enum { RSSI_OFF = 64 };
+enum { DR_SF10 = 0, DR_SF9, DR_SF8, DR_SF7, DR_SF8C };
+
+// the fields the sketch reads; the radio model fills them in.
+struct lmic_t
+    {
+    std::int8_t rssi;
+    std::int8_t snr;
+    std::uint8_t datarate;
+    std::uint8_t txrxFlags;
+    std::uint8_t opmode;
+    std::int8_t txpow;
+    };
+
+extern lmic_t LMIC;
+
+#endif /* _hostsim_arduino_lmic_h_ */
@@ -0,0 +1,31 @@
+/*
+
+Module: bsec.h
+
+Function:
+    Host simulation: the BME680 library.
+
+Copyright:
+    See accompanying LICENSE file for copyright and license information.
+
+Author:
+    Dhinesh Kumar Pitchai, MCCI Corporation   November 2022
+
+*/
+
+#ifndef _hostsim_bsec_h_
+# define _hostsim_bsec_h_
+
+#pragma once
+
+#include <Wire.h>
+
+#define BME680_I2C_ADDR_SECONDARY 0x77
+
+class Bsec
+    {
+public:
+    void begin(int address, TwoWire &wire) {}
+    };
+
+#endif /* _hostsim_bsec_h_ */
@@ -0,0 +1,26 @@
+/*
+
+Module: mcciadk_baselib.h
+
+Function:
+    Host simulation: the MCCI ADK base library.
+
+Copyright:
+    See accompanying LICENSE file for copyright and license information.
+
+Author:
+    Dhinesh Kumar Pitchai, MCCI Corporation   November 2022
+
+*/
+
+#ifndef _hostsim_mcciadk_baselib_h_
+# define _hostsim_mcciadk_baselib_h_
+
+#pragma once
+
+#include <cstddef>
+
+extern "C" size_t McciAdkLib_Snprintf(char *pBuffer, size_t nBuffer, size_t iBuffer, const char *pFmt, ...)
+    __attribute__((__format__(__printf__, 4, 5)));
+
+#endif /* _hostsim_mcciadk_baselib_h_ */
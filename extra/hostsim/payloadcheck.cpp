@@ -0,0 +1,469 @@
+/*
+
+Module: payloadcheck.cpp
+
+Function:
+    Round-trip and robustness checks of the port 1 (format 0x27)
+    encoder and decoder on a host.
+
+Copyright:
+    See accompanying LICENSE file for copyright and license information.
+
+Author:
+    Dhinesh Kumar Pitchai, MCCI Corporation   November 2022
+
+Usage:
+    payloadcheck [--count {n}] [--seed {n}] [--vectors {file}]
+                 [--corpus {dir}]
+
+    Encodes random measurements, edge cases included, with the sketch's
+    cMeasurementLoop::fillTxBuffer() at each data rate, decodes them with
+    ../port1decoder.h, and checks each field against what was measured,
+    within the field's quantization. Then feeds mutated and random
+    messages to the decoder, which must reject any whose length doesn't
+    match its flags. --vectors writes messages and their decoding, as
+    JSON lines, for payloadcheck.js to check the JavaScript decoders
+    against; --corpus writes the messages as files, to seed port1fuzz.
+    See README.md.
+
+*/
+
+#include "hostsim.h"
+
+#include "../../Model4916-MultiGas-Sensor.h"
+#include "../../Model4916_cLogCategory.h"
+#include "../../Model4916_cMeasurementLoop.h"
+#include "../port1decoder.h"
+
+#include <arduino_lmic.h>
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace McciCatena;
+using namespace McciModel4916;
+
+/****************************************************************************\
+|
+|   Random measurements
+|
+\****************************************************************************/
+
+namespace {
+
+using Flags = cMeasurementLoop::Flags;
+using Measurement = cMeasurementLoop::Measurement;
+
+// uniform in [lo, hi].
+float uniform(float lo, float hi)
+    {
+    return lo + (hi - lo) * float(HostSim::random32() >> 8) / float(1u << 24);
+    }
+
+// mostly uniform in [lo, hi], and one time in eight one of the edges:
+// the ends of the encoding's range, and values past them.
+template <size_t nEdges>
+float pick(float lo, float hi, const float (&edges)[nEdges])
+    {
+    if (HostSim::random32() % 8 == 0)
+        return edges[HostSim::random32() % nEdges];
+    return uniform(lo, hi);
+    }
+
+// concentrations span decades; mostly log-uniform in [lo, hi].
+template <size_t nEdges>
+float pickLog(float lo, float hi, const float (&edges)[nEdges])
+    {
+    if (HostSim::random32() % 8 == 0)
+        return edges[HostSim::random32() % nEdges];
+    return std::exp(uniform(std::log(lo), std::log(hi)));
+    }
+
+void randomMeasurement(Measurement &m)
+    {
+    static const float kVbatEdges[] = { 0.0f, -0.5f, -8.5f, 1.0f / 8192, 7.9997f, 8.0f, 12.0f };
+    static const float kTEdges[] = { 0.0f, -128.0f, -140.0f, 127.99f, 128.0f, 200.0f, 1.0f / 512 };
+    static const float kRHEdges[] = { 0.0f, 100.0f, -1.0f, 101.0f, 0.0007f };
+    static const float kLatEdges[] = { 0.0f, -90.0f, 90.0f, 1e-7f };
+    static const float kLonEdges[] = { 0.0f, -180.0f, 180.0f, -1e-7f };
+    static const float kPmEdges[] = { 0.0f, -1.0f, 1e-6f, 65535.0f, 65536.0f, 1e6f };
+    static const float kCO2Edges[] = { 0.0f, -1.0f, 39999.0f, 40000.0f, 45000.0f, 0.3f };
+    static const float kCOEdges[] = { 0.0f, -5.0f, 999.0f, 1000.0f, 2000.0f, 0.02f };
+    static const float kNO2Edges[] = { 0.0f, -0.1f, 3.999f, 4.0f, 5.0f, 4e-8f };
+
+    std::memset(&m, 0, sizeof(m));
+
+    // bits past NO2 too, which the flags byte can't carry.
+    m.flags = Flags(HostSim::random32() & 0x3FF);
+    m.Vbat = pick(2.8f, 4.3f, kVbatEdges);
+    m.Vbus = uniform(0.0f, 5.0f);
+    m.BootCount = HostSim::random32();
+    m.env.TempC = pick(-40.0f, 85.0f, kTEdges);
+    m.env.Humidity = pick(0.0f, 100.0f, kRHEdges);
+    m.position.UnixTime = HostSim::random32();
+    m.position.Latitude = pick(-90.0f, 90.0f, kLatEdges);
+    m.position.Longitude = pick(-180.0f, 180.0f, kLonEdges);
+    for (unsigned i = 0; i < 7; ++i)
+        {
+        m.particle.Mass[i] = pickLog(0.01f, 5000.0f, kPmEdges);
+        m.particle.Count[i] = HostSim::random32();
+        }
+    m.co2ppm.CO2ppm = pickLog(300.0f, 10000.0f, kCO2Edges);
+    m.gases.CO = pickLog(0.05f, 500.0f, kCOEdges);
+    m.gases.NO2 = pickLog(0.001f, 3.9f, kNO2Edges);
+    m.gases.O3 = uniform(0.0f, 1.0f);
+    m.gases.SO2 = uniform(0.0f, 1.0f);
+    }
+
+/****************************************************************************\
+|
+|   Checking a round trip
+|
+\****************************************************************************/
+
+float clamp(float v, float lo, float hi)
+    {
+    return v < lo ? lo : v > hi ? hi : v;
+    }
+
+// a uflt16 of v / scale keeps 12 significant bits down to 2^-16 of
+// full scale, and anything smaller is sent as zero; it can't hold full scale.
+bool isUflt16Near(float decoded, float v, float scale)
+    {
+    float const expected = clamp(v, 0.0f, scale);
+    float const quantum = std::fmax(expected / 4096, scale / 65536);
+
+    return std::fabs(decoded - expected) <= quantum * 1.00001f;
+    }
+
+struct Result_t
+    {
+    unsigned                        nMessages;
+    unsigned                        nDropped;
+    unsigned                        nFailed;
+    };
+
+void fail(Result_t &result, const Measurement &m, const std::uint8_t *p, size_t n, const char *pWhat)
+    {
+    if (++result.nFailed <= 20)
+        {
+        std::fprintf(stderr, "mismatch: %s; flags %04x, message ", pWhat, unsigned(m.flags));
+        for (size_t i = 0; i < n; ++i)
+            std::fprintf(stderr, "%02x", p[i]);
+        std::fputc('\n', stderr);
+        }
+    }
+
+// the fields the encoder may leave out to fit the data rate, in order.
+const std::uint8_t kDropOrder[] = { Port1::kGPS, Port1::kPM, Port1::kNO2, Port1::kCO };
+
+void checkRoundTrip(Result_t &result, const Measurement &m, const std::uint8_t *p, size_t n)
+    {
+    Port1::Message_t d;
+    auto const wanted = std::uint8_t(m.flags);
+
+    ++result.nMessages;
+    if (n > gMeasurementLoop.getMaxUplinkBytes())
+        fail(result, m, p, n, "too long for the data rate");
+    if (! Port1::decode(p, n, d))
+        return fail(result, m, p, n, "doesn't decode");
+
+    // only the optional fields may be missing, and only the first ones
+    // in the order they're dropped.
+    std::uint8_t const dropped = wanted & ~d.flags;
+    if ((d.flags & ~wanted) != 0)
+        fail(result, m, p, n, "fields that weren't measured");
+    if (dropped != 0)
+        {
+        bool fKept = false;
+
+        ++result.nDropped;
+        for (auto const field : kDropOrder)
+            {
+            if ((dropped & field) != 0 && fKept)
+                fail(result, m, p, n, "fields dropped out of order");
+            if ((wanted & field) != 0 && (dropped & field) == 0)
+                fKept = true;
+            }
+        if ((dropped & ~(Port1::kGPS | Port1::kPM | Port1::kNO2 | Port1::kCO)) != 0)
+            fail(result, m, p, n, "a required field dropped");
+        }
+
+    if ((d.flags & Port1::kVbat) != 0 &&
+        ! (std::fabs(d.vBat - clamp(m.Vbat, -8.0f, 32767.0f / 4096)) <= 1.0f / 4096))
+        fail(result, m, p, n, "vbat");
+
+    if ((d.flags & Port1::kBoot) != 0 && d.bootCountLsb != std::uint8_t(m.BootCount))
+        fail(result, m, p, n, "boot count");
+
+    // RH is scaled in float before it's rounded, which can add a
+    // hundredth of a step.
+    if ((d.flags & Port1::kTH) != 0 &&
+        (! (std::fabs(d.tempC - clamp(m.env.TempC, -128.0f, 32767.0f / 256)) <= 0.5f / 256) ||
+         ! (std::fabs(d.humidity - clamp(m.env.Humidity, 0.0f, 100.0f)) <= 0.51f * 100 / 65535)))
+        fail(result, m, p, n, "t/rh");
+
+    if ((d.flags & Port1::kGPS) != 0 &&
+        (d.time != m.position.UnixTime ||
+         ! (std::fabs(d.latitude - m.position.Latitude) <= 0.50001e-7) ||
+         ! (std::fabs(d.longitude - m.position.Longitude) <= 0.50001e-7)))
+        fail(result, m, p, n, "gps");
+
+    if ((d.flags & Port1::kPM) != 0)
+        {
+        for (unsigned i = 0; i < 7; ++i)
+            {
+            if (! isUflt16Near(d.mass[i], m.particle.Mass[i], 65536.0f))
+                fail(result, m, p, n, "pm");
+            }
+        }
+
+    if ((d.flags & Port1::kCO2) != 0 && ! isUflt16Near(d.co2ppm, m.co2ppm.CO2ppm, 40000.0f))
+        fail(result, m, p, n, "co2");
+    if ((d.flags & Port1::kCO) != 0 && ! isUflt16Near(d.coPpm, m.gases.CO, 1000.0f))
+        fail(result, m, p, n, "co");
+    if ((d.flags & Port1::kNO2) != 0 && ! isUflt16Near(d.no2Ppm, m.gases.NO2, 4.0f))
+        fail(result, m, p, n, "no2");
+    }
+
+/****************************************************************************\
+|
+|   Checking the decoder
+|
+\****************************************************************************/
+
+// the decoder takes exactly the messages of the right length, and
+// nothing it returns is outside what the encoding can hold.
+void checkDecoder(Result_t &result, const std::uint8_t *p, size_t n)
+    {
+    Port1::Message_t d;
+    bool const fValid = n >= 2 && p[0] == Port1::kFormat && n == Port1::getMessageSize(p[1]);
+    Measurement m;
+
+    m.flags = Flags(n >= 2 ? p[1] : 0);
+    ++result.nMessages;
+    if (Port1::decode(p, n, d) != fValid)
+        return fail(result, m, p, n, fValid ? "valid message rejected" : "invalid message accepted");
+    if (! fValid)
+        return;
+
+    bool fInRange = d.vBat >= -8.0f && d.vBat < 8.0f &&
+                    d.tempC >= -128.0f && d.tempC < 128.0f &&
+                    d.humidity >= 0.0f && d.humidity <= 100.0f &&
+                    std::fabs(d.latitude) <= 214.7483648 && std::fabs(d.longitude) <= 214.7483648 &&
+                    d.co2ppm >= 0.0f && d.co2ppm < 40000.0f &&
+                    d.coPpm >= 0.0f && d.coPpm < 1000.0f &&
+                    d.no2Ppm >= 0.0f && d.no2Ppm < 4.0f;
+    for (auto const mass : d.mass)
+        fInRange = fInRange && mass >= 0.0f && mass < 65536.0f;
+    if (! fInRange)
+        fail(result, m, p, n, "decoded value out of range");
+    }
+
+// flip bits, cut or extend valid messages, or make up random ones.
+size_t mutate(std::uint8_t *p, size_t n, size_t nMax)
+    {
+    switch (HostSim::random32() % 4)
+        {
+    case 0:
+        for (unsigned i = 1 + HostSim::random32() % 3; i != 0; --i)
+            p[HostSim::random32() % n] ^= std::uint8_t(1 << (HostSim::random32() % 8));
+        return n;
+    case 1:
+        return HostSim::random32() % n;
+    case 2:
+        while (n < nMax && HostSim::random32() % 2 == 0)
+            p[n++] = std::uint8_t(HostSim::random32());
+        return n;
+    default:
+        n = HostSim::random32() % nMax;
+        for (size_t i = 0; i < n; ++i)
+            p[i] = std::uint8_t(HostSim::random32());
+        if (n != 0 && HostSim::random32() % 2 == 0)
+            p[0] = Port1::kFormat;
+        return n;
+        }
+    }
+
+/****************************************************************************\
+|
+|   Vectors
+|
+\****************************************************************************/
+
+void putHex(std::FILE *pFile, const std::uint8_t *p, size_t n)
+    {
+    for (size_t i = 0; i < n; ++i)
+        std::fprintf(pFile, "%02x", p[i]);
+    }
+
+// one JSON line: the message, and the reference decoding, or "error"
+// if it must be rejected.
+void writeVector(std::FILE *pFile, const std::uint8_t *p, size_t n)
+    {
+    Port1::Message_t d;
+
+    std::fputs("{\"hex\":\"", pFile);
+    putHex(pFile, p, n);
+    std::fputc('"', pFile);
+    if (! Port1::decode(p, n, d))
+        {
+        std::fputs(",\"error\":true}\n", pFile);
+        return;
+        }
+
+    std::fprintf(pFile, ",\"flags\":%u", d.flags);
+    if (d.flags & Port1::kVbat)
+        std::fprintf(pFile, ",\"vBat\":%.9g", d.vBat);
+    if (d.flags & Port1::kBoot)
+        std::fprintf(pFile, ",\"boot\":%u", d.bootCountLsb);
+    if (d.flags & Port1::kTH)
+        std::fprintf(pFile, ",\"tempC\":%.9g,\"rh\":%.9g", d.tempC, d.humidity);
+    if (d.flags & Port1::kGPS)
+        std::fprintf(pFile, ",\"time\":%lu,\"lat\":%.17g,\"lon\":%.17g", (unsigned long) d.time, d.latitude, d.longitude);
+    if (d.flags & Port1::kPM)
+        {
+        for (unsigned i = 0; i < 7; ++i)
+            std::fprintf(pFile, "%s%.9g", i == 0 ? ",\"pm\":[" : ",", d.mass[i]);
+        std::fputc(']', pFile);
+        }
+    if (d.flags & Port1::kCO2)
+        std::fprintf(pFile, ",\"co2ppm\":%.9g", d.co2ppm);
+    if (d.flags & Port1::kCO)
+        std::fprintf(pFile, ",\"coPpm\":%.9g", d.coPpm);
+    if (d.flags & Port1::kNO2)
+        std::fprintf(pFile, ",\"no2Ppm\":%.9g", d.no2Ppm);
+    std::fputs("}\n", pFile);
+    }
+
+bool writeCorpusFile(const std::string &dir, unsigned i, const std::uint8_t *p, size_t n)
+    {
+    char name[32];
+
+    std::snprintf(name, sizeof(name), "/%06u", i);
+    auto const pFile = std::fopen((dir + name).c_str(), "wb");
+    if (pFile == nullptr)
+        {
+        std::perror((dir + name).c_str());
+        return false;
+        }
+    std::fwrite(p, 1, n, pFile);
+    return std::fclose(pFile) == 0;
+    }
+
+const char * const kUsage =
+    "usage: payloadcheck [options]\n"
+    "  --count {n}         measurements to encode at each data rate (20000)\n"
+    "  --seed {n}          seed for the random measurements and messages\n"
+    "  --vectors {file}    write messages and their decoding, as JSON lines\n"
+    "  --corpus {dir}      write the encoded messages as files, for port1fuzz\n";
+
+} // namespace
+
+/****************************************************************************\
+|
+|   main
+|
+\****************************************************************************/
+
+int main(int argc, char **argv)
+    {
+    unsigned nCount = 20000;
+    std::uint32_t seed = 1;
+    const char *pVectors = nullptr;
+    const char *pCorpus = nullptr;
+
+    for (int i = 1; i < argc; ++i)
+        {
+        if (std::strcmp(argv[i], "--count") == 0 && i + 1 < argc)
+            nCount = unsigned(std::strtoul(argv[++i], nullptr, 0));
+        else if (std::strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+            seed = std::uint32_t(std::strtoul(argv[++i], nullptr, 0));
+        else if (std::strcmp(argv[i], "--vectors") == 0 && i + 1 < argc)
+            pVectors = argv[++i];
+        else if (std::strcmp(argv[i], "--corpus") == 0 && i + 1 < argc)
+            pCorpus = argv[++i];
+        else
+            {
+            std::fputs(kUsage, stderr);
+            return 2;
+            }
+        }
+
+    std::FILE *pVectorFile = nullptr;
+    if (pVectors != nullptr && (pVectorFile = std::fopen(pVectors, "w")) == nullptr)
+        {
+        std::perror(pVectors);
+        return 1;
+        }
+
+    // bring the loop up as the sketch does, with the console and the
+    // logs out of the way.
+    HostSim::gOptions.fEcho = false;
+    for (unsigned i = 0; i < cLogCategory::kCategories; ++i)
+        cLogCategory::getCategory(i)->setLevel(cLogCategory::kWarning);
+
+    gCatena.begin();
+    gMeasurementLoop.begin();
+    HostSim::setSeed(seed);
+
+    Result_t roundTrip {};
+    Result_t decoder {};
+    std::vector<std::vector<std::uint8_t>> messages;
+    cMeasurementLoop::TxBuffer_t b;
+    Measurement m;
+
+    for (std::uint8_t dr = 0; dr <= 4; ++dr)
+        {
+        LMIC.datarate = dr;
+        for (unsigned i = 0; i < nCount; ++i)
+            {
+            randomMeasurement(m);
+            gMeasurementLoop.fillTxBuffer(b, m);
+            checkRoundTrip(roundTrip, m, b.getbase(), b.getn());
+            if (i < 64)
+                messages.emplace_back(b.getbase(), b.getbase() + b.getn());
+            }
+        }
+
+    for (unsigned i = 0; i < messages.size(); ++i)
+        {
+        auto const &message = messages[i];
+
+        if (pVectorFile != nullptr)
+            writeVector(pVectorFile, message.data(), message.size());
+        if (pCorpus != nullptr && ! writeCorpusFile(pCorpus, i, message.data(), message.size()))
+            return 1;
+        }
+
+    // one mutant of a valid message each time.
+    std::uint8_t buffer[2 * SdLogFormat::kMaxRaw];
+    for (unsigned i = 0; i < 5 * nCount; ++i)
+        {
+        auto const &message = messages[i % messages.size()];
+
+        std::memcpy(buffer, message.data(), message.size());
+        auto const n = mutate(buffer, message.size(), sizeof(buffer));
+        checkDecoder(decoder, buffer, n);
+        if (pVectorFile != nullptr && i < 256)
+            writeVector(pVectorFile, buffer, n);
+        }
+
+    if (pVectorFile != nullptr && std::fclose(pVectorFile) != 0)
+        {
+        std::perror(pVectors);
+        return 1;
+        }
+
+    std::printf(
+        "round trip: %u messages, %u with fields dropped for the data rate, %u mismatches\n",
+        roundTrip.nMessages, roundTrip.nDropped, roundTrip.nFailed
+        );
+    std::printf("decoder:    %u messages, %u mismatches\n", decoder.nMessages, decoder.nFailed);
+
+    return roundTrip.nFailed == 0 && decoder.nFailed == 0 ? 0 : 1;
+    }
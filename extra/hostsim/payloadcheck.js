@@ -0,0 +1,145 @@
+/*
+
+Module: payloadcheck.js
+
+Function:
+    Check the port 1 JavaScript decoders against the C++ decoder.
+
+Copyright:
+    See accompanying LICENSE file for copyright and license information.
+
+Author:
+    Dhinesh Kumar Pitchai, MCCI Corporation   November 2022
+
+Usage:
+    payloadcheck --vectors vectors.jsonl
+    node payloadcheck.js vectors.jsonl
+
+    Runs each message written by payloadcheck through the TTN console and
+    Node-RED decoders in ../, and compares their fields with the ones
+    ../port1decoder.h decoded. A message the C++ decoder rejects must
+    come back with an error and no fields (or, from Node-RED, as null).
+    Exits with status 1 on any difference.
+
+*/
+
+"use strict";
+
+var fs = require("fs");
+var path = require("path");
+
+var extraDir = path.join(__dirname, "..");
+
+function loadTtn() {
+    var src = fs.readFileSync(path.join(extraDir, "catena-message-0x27-port-1-decoder-ttn.js"), "utf8");
+    var Decoder = new Function(src + "\nreturn Decoder;")();
+
+    return function (bytes) {
+        return Decoder(bytes, 1);
+    };
+}
+
+// the Node-RED script is the body of a function node, with msg and node.
+function loadNodeRed() {
+    var src = fs.readFileSync(path.join(extraDir, "catena-message-0x27-port-1-decoder-nodered.js"), "utf8");
+    var fn = new Function("msg", "node", src);
+    var node = { error: function () {} };
+
+    return function (bytes) {
+        return fn({ payload: Buffer.from(bytes), port: 1 }, node).payload;
+    };
+}
+
+var PM_NAMES = ["0.1", "0.3", "0.5", "1.0", "2.5", "5.0", "10"];
+
+// the C++ decoder works in float; allow for its rounding.
+function isNear(a, b) {
+    return typeof a === "number" && Math.abs(a - b) <= 1e-6 * Math.abs(b) + 1e-9;
+}
+
+// the differences between one decoding and the reference, as strings.
+function compare(got, want) {
+    var errors = [];
+    var fields = ["vBat", "boot", "tempC", "rh", "time", "lat", "lon", "co2ppm", "coPpm", "no2Ppm"];
+
+    // Node-RED's decoder returns null for other formats.
+    if (want.error && got === null)
+        return errors;
+    if (got === null || typeof got !== "object")
+        return ["no result"];
+
+    if (want.error) {
+        if (!got.error)
+            errors.push("accepted");
+        if (Object.keys(got).length !== 1)
+            errors.push("fields with an error");
+        return errors;
+    }
+
+    if (got.error)
+        errors.push("error " + got.error);
+
+    fields.forEach(function (field) {
+        if (!(field in want)) {
+            if (field in got)
+                errors.push(field + " not sent");
+        } else if (!isNear(got[field], want[field])) {
+            errors.push(field + " " + got[field] + ", want " + want[field]);
+        }
+    });
+
+    if (!("pm" in want)) {
+        if ("pm" in got)
+            errors.push("pm not sent");
+    } else if (typeof got.pm !== "object") {
+        errors.push("pm missing");
+    } else {
+        PM_NAMES.forEach(function (name, i) {
+            if (!isNear(got.pm[name], want.pm[i]))
+                errors.push("pm" + name + " " + got.pm[name] + ", want " + want.pm[i]);
+        });
+    }
+
+    // dewpoint is only in the JavaScript.
+    if (("tempC" in want) !== ("tDewC" in got))
+        errors.push("tDewC");
+
+    return errors;
+}
+
+function main(argv) {
+    if (argv.length !== 1) {
+        process.stderr.write("usage: node payloadcheck.js {vectors.jsonl}\n");
+        return 2;
+    }
+
+    var decoders = { ttn: loadTtn(), nodered: loadNodeRed() };
+    var lines = fs.readFileSync(argv[0], "utf8").split("\n");
+    var nVectors = 0;
+    var nFailed = 0;
+
+    lines.forEach(function (line) {
+        if (line === "")
+            return;
+
+        var want = JSON.parse(line);
+        var bytes = want.hex.match(/../g) || [];
+
+        bytes = bytes.map(function (hex) { return parseInt(hex, 16); });
+        ++nVectors;
+
+        Object.keys(decoders).forEach(function (name) {
+            var errors = compare(decoders[name](bytes), want);
+
+            if (errors.length !== 0) {
+                if (++nFailed <= 20)
+                    console.log(name + " " + want.hex + ": " + errors.join("; "));
+            }
+        });
+    });
+
+    console.log(nVectors + " vectors, " + nFailed + " mismatches");
+    return nFailed === 0 ? 0 : 1;
+}
+
+process.exitCode = main(process.argv.slice(2));
@@ -0,0 +1,49 @@
+#!/usr/bin/env python3
+#
+# Module: mkfwman.py
+#
+# Function:
+#     Write the manifest for a Model4916 firmware image on an SD card.
+#
+# Copyright:
+#     See accompanying LICENSE file for copyright and license information.
+#
+# Author:
+#     Dhinesh Kumar Pitchai, MCCI Corporation   November 2022
+#
+# Usage:
+#     python3 mkfwman.py update.bin [fallback.bin...]
+#
+#     Writes update.man beside update.bin: the size of the image in
+#     decimal and its CRC-32 (as used by zip) in hex. Copy both files to
+#     the root of the card. The device reads the image once to check it
+#     against the manifest before it erases anything, and won't program
+#     an image that doesn't match, or one without a manifest. (Patches
+#     from mkpatch carry their own sizes and CRCs, and need none.)
+#
+
+import os
+import sys
+import zlib
+
+
+def main():
+    if len(sys.argv) < 2:
+        print("usage: %s image.bin..." % sys.argv[0], file=sys.stderr)
+        return 2
+
+    for name in sys.argv[1:]:
+        with open(name, "rb") as f:
+            data = f.read()
+
+        manifest = os.path.splitext(name)[0] + ".man"
+        with open(manifest, "w", newline="\n") as f:
+            f.write("%d %08x\n" % (len(data), zlib.crc32(data)))
+
+        print("%s: %d bytes, crc %08x" % (manifest, len(data), zlib.crc32(data)))
+
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,306 @@
+/*
+
+Module: mkpatch.cpp
+
+Function:
+    Make a Model4916 firmware delta patch.
+
+Copyright:
+    See accompanying LICENSE file for copyright and license information.
+
+Author:
+    Dhinesh Kumar Pitchai, MCCI Corporation   November 2022
+
+Build:
+    c++ -std=c++11 -O2 -o mkpatch mkpatch.cpp ../Model4916_cDeltaPatch.cpp
+
+Usage:
+    mkpatch old.bin new.bin update.pat
+
+    old.bin must be the image the device is running, exactly as built;
+    new.bin is the image to go to. The patch is applied here to check it
+    before it's written, and its size is reported. Copy update.pat to
+    the root of the SD card; the device rebuilds new.bin from its own
+    flash and the patch, checks it, and programs it like update.bin.
+
+*/
+
+#include "../Model4916_cDeltaPatch.h"
+#include "../Model4916_crc.h"
+
+#include <cstdio>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+using namespace McciModel4916;
+
+namespace {
+
+// matches shorter than this are sent as literals.
+constexpr size_t kMinMatch = 8;
+// old positions remembered per hash; bounds the search time.
+constexpr size_t kMaxCandidates = 32;
+
+bool readFile(const char *pName, std::vector<std::uint8_t> &data)
+    {
+    std::FILE *pFile = std::fopen(pName, "rb");
+    if (pFile == nullptr)
+        {
+        std::perror(pName);
+        return false;
+        }
+
+    std::uint8_t buffer[4096];
+    size_t n;
+    while ((n = std::fread(buffer, 1, sizeof(buffer), pFile)) > 0)
+        data.insert(data.end(), buffer, buffer + n);
+
+    std::fclose(pFile);
+    return true;
+    }
+
+std::uint64_t key(const std::uint8_t *p)
+    {
+    std::uint64_t k;
+    std::memcpy(&k, p, sizeof(k));
+    return k;
+    }
+
+void putVarint(std::vector<std::uint8_t> &out, std::uint32_t v)
+    {
+    while (v >= 0x80)
+        {
+        out.push_back(std::uint8_t(v | 0x80));
+        v >>= 7;
+        }
+    out.push_back(std::uint8_t(v));
+    }
+
+class cPatchWriter
+    {
+public:
+    explicit cPatchWriter(std::vector<std::uint8_t> &out)
+        : m_out(out)
+        {}
+
+    void literal(std::uint8_t b)
+        {
+        this->m_literal.push_back(b);
+        }
+
+    void copy(std::uint32_t pos, std::uint32_t length)
+        {
+        this->flushLiteral();
+
+        std::int32_t const delta = std::int32_t(pos - this->m_oldPos);
+        this->m_out.push_back(DeltaPatchFormat::kOpCopy);
+        putVarint(this->m_out, length);
+        putVarint(this->m_out, (std::uint32_t(delta) << 1) ^ std::uint32_t(delta >> 31));
+        this->m_oldPos = pos + length;
+        ++this->m_nCopies;
+        }
+
+    void end()
+        {
+        this->flushLiteral();
+        this->m_out.push_back(DeltaPatchFormat::kOpEnd);
+        }
+
+    unsigned m_nCopies = 0;
+    unsigned m_nLiterals = 0;
+    size_t m_nLiteralBytes = 0;
+
+private:
+    void flushLiteral()
+        {
+        if (this->m_literal.empty())
+            return;
+
+        this->m_out.push_back(DeltaPatchFormat::kOpLiteral);
+        putVarint(this->m_out, std::uint32_t(this->m_literal.size()));
+        this->m_out.insert(this->m_out.end(), this->m_literal.begin(), this->m_literal.end());
+        ++this->m_nLiterals;
+        this->m_nLiteralBytes += this->m_literal.size();
+        this->m_literal.clear();
+        }
+
+    std::vector<std::uint8_t> &m_out;
+    std::vector<std::uint8_t> m_literal;
+    std::uint32_t m_oldPos = 0;
+    };
+
+size_t matchLength(
+    const std::vector<std::uint8_t> &oldImage,
+    size_t oldPos,
+    const std::vector<std::uint8_t> &newImage,
+    size_t newPos
+    )
+    {
+    size_t n = 0;
+    while (oldPos + n < oldImage.size() &&
+           newPos + n < newImage.size() &&
+           oldImage[oldPos + n] == newImage[newPos + n])
+        ++n;
+    return n;
+    }
+
+// greedy: at each position of the new image, take the longest match in
+// the old image, trying first where the last copy left off.
+void makePatch(
+    const std::vector<std::uint8_t> &oldImage,
+    const std::vector<std::uint8_t> &newImage,
+    cPatchWriter &writer
+    )
+    {
+    std::unordered_map<std::uint64_t, std::vector<std::uint32_t>> index;
+
+    for (size_t i = 0; i + kMinMatch <= oldImage.size(); ++i)
+        {
+        auto &v = index[key(&oldImage[i])];
+        if (v.size() < kMaxCandidates)
+            v.push_back(std::uint32_t(i));
+        }
+
+    size_t expected = 0;
+    size_t i = 0;
+    while (i < newImage.size())
+        {
+        size_t bestPos = 0;
+        size_t bestLength = matchLength(oldImage, expected, newImage, i);
+        if (bestLength > 0)
+            bestPos = expected;
+
+        if (bestLength < 64 && i + kMinMatch <= newImage.size())
+            {
+            auto const it = index.find(key(&newImage[i]));
+            if (it != index.end())
+                {
+                for (auto pos : it->second)
+                    {
+                    size_t const length = matchLength(oldImage, pos, newImage, i);
+                    if (length > bestLength)
+                        {
+                        bestLength = length;
+                        bestPos = pos;
+                        }
+                    }
+                }
+            }
+
+        if (bestLength >= kMinMatch)
+            {
+            writer.copy(std::uint32_t(bestPos), std::uint32_t(bestLength));
+            i += bestLength;
+            expected = bestPos + bestLength;
+            }
+        else
+            {
+            writer.literal(newImage[i]);
+            ++i;
+            ++expected;
+            }
+        }
+
+    writer.end();
+    }
+
+struct PatchSource
+    {
+    const std::vector<std::uint8_t> *pPatch;
+    size_t pos;
+    };
+
+size_t readPatch(void *pUserData, std::uint8_t *pBuffer, size_t nBuffer)
+    {
+    auto const pSource = static_cast<PatchSource *>(pUserData);
+    size_t n = pSource->pPatch->size() - pSource->pos;
+
+    if (n > nBuffer)
+        n = nBuffer;
+    std::memcpy(pBuffer, pSource->pPatch->data() + pSource->pos, n);
+    pSource->pos += n;
+    return n;
+    }
+
+// apply the patch the way the device does, and compare.
+bool checkPatch(
+    const std::vector<std::uint8_t> &oldImage,
+    const std::vector<std::uint8_t> &newImage,
+    const std::vector<std::uint8_t> &patch
+    )
+    {
+    cDeltaPatch applier;
+    PatchSource source { &patch, 0 };
+    std::vector<std::uint8_t> result;
+    std::uint8_t buffer[256];
+
+    if (! applier.begin(readPatch, &source, oldImage.data(), oldImage.size()))
+        return false;
+
+    for (;;)
+        {
+        size_t const n = applier.read(buffer, sizeof(buffer));
+        if (n == 0)
+            break;
+        result.insert(result.end(), buffer, buffer + n);
+        }
+
+    return applier.isComplete() && result == newImage;
+    }
+
+} // namespace
+
+int main(int argc, char **argv)
+    {
+    if (argc != 4)
+        {
+        std::fprintf(stderr, "usage: %s old.bin new.bin update.pat\n", argv[0]);
+        return 2;
+        }
+
+    std::vector<std::uint8_t> oldImage, newImage;
+    if (! readFile(argv[1], oldImage) || ! readFile(argv[2], newImage))
+        return 1;
+
+    std::vector<std::uint8_t> patch(sizeof(DeltaPatchFormat::Header_t));
+    DeltaPatchFormat::Header_t header {};
+
+    std::memcpy(header.magic, DeltaPatchFormat::kMagic, sizeof(header.magic));
+    header.oldSize = std::uint32_t(oldImage.size());
+    header.oldCrc = crc32_ieee(oldImage.data(), oldImage.size());
+    header.newSize = std::uint32_t(newImage.size());
+    header.newCrc = crc32_ieee(newImage.data(), newImage.size());
+    header.crc = crc32_ieee(&header, offsetof(DeltaPatchFormat::Header_t, crc));
+    std::memcpy(patch.data(), &header, sizeof(header));
+
+    cPatchWriter writer(patch);
+    makePatch(oldImage, newImage, writer);
+
+    if (! checkPatch(oldImage, newImage, patch))
+        {
+        std::fprintf(stderr, "%s: patch doesn't reproduce %s\n", argv[3], argv[2]);
+        return 1;
+        }
+
+    std::FILE *pOut = std::fopen(argv[3], "wb");
+    if (pOut == nullptr ||
+        std::fwrite(patch.data(), 1, patch.size(), pOut) != patch.size() ||
+        std::fclose(pOut) != 0)
+        {
+        std::perror(argv[3]);
+        return 1;
+        }
+
+    std::printf(
+        "%s: %zu bytes (%.1f%% of %zu); %u copies, %u literals (%zu bytes)\n",
+        argv[3],
+        patch.size(),
+        100.0 * patch.size() / (newImage.empty() ? 1 : newImage.size()),
+        newImage.size(),
+        writer.m_nCopies,
+        writer.m_nLiterals,
+        writer.m_nLiteralBytes
+        );
+    return 0;
+    }
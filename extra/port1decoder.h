@@ -0,0 +1,171 @@
+/*
+
+Module: port1decoder.h
+
+Function:
+    Decode Model4916 port 1 (format 0x27) uplinks on a host.
+
+Copyright:
+    See accompanying LICENSE file for copyright and license information.
+
+Author:
+    Dhinesh Kumar Pitchai, MCCI Corporation   November 2022
+
+Notes:
+    Header-only, C++11, so any host tool can use it. It follows what
+    cMeasurementLoop::fillTxBuffer() sends, which is the reference for
+    catena-message-0x27-port-1-format.md and the JavaScript decoders.
+
+*/
+
+#ifndef _port1decoder_h_
+# define _port1decoder_h_
+
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+namespace McciModel4916 {
+namespace Port1 {
+
+constexpr std::uint8_t kFormat = 0x27;
+
+// bits of the flags byte, as cMeasurementLoop::Flags.
+enum Flags : std::uint8_t
+    {
+    kVbat   = 1 << 0,
+    kBoot   = 1 << 1,
+    kTH     = 1 << 2,
+    kGPS    = 1 << 3,
+    kPM     = 1 << 4,
+    kCO2    = 1 << 5,
+    kCO     = 1 << 6,
+    kNO2    = 1 << 7,
+    };
+
+// bytes of each field, in the order of the bits.
+constexpr std::uint8_t kFieldBytes[8] = { 2, 1, 4, 12, 14, 2, 2, 2 };
+
+// bytes in a message with the given flags.
+inline size_t getMessageSize(std::uint8_t flags)
+    {
+    size_t n = 2;
+
+    for (unsigned i = 0; i < 8; ++i)
+        {
+        if (flags & (1u << i))
+            n += kFieldBytes[i];
+        }
+    return n;
+    }
+
+struct Message_t
+    {
+    // the flags byte as sent
+    std::uint8_t                flags;
+    float                       vBat;
+    // the boot count, modulo 256
+    std::uint8_t                bootCountLsb;
+    float                       tempC;
+    float                       humidity;
+    // seconds since the Unix epoch, and degrees
+    std::uint32_t               time;
+    double                      latitude;
+    double                      longitude;
+    // PM0.1, PM0.3, PM0.5, PM1.0, PM2.5, PM5.0, PM10 (ug/m3)
+    float                       mass[7];
+    float                       co2ppm;
+    float                       coPpm;
+    float                       no2Ppm;
+    };
+
+// uflt16: 4 bits of exponent b, 12 of fraction f; f / 4096 * 2^(b - 15).
+inline float uflt16ToFloat(std::uint16_t v)
+    {
+    return std::ldexp(float(v & 0xFFF) / 4096.0f, int(v >> 12) - 15);
+    }
+
+inline std::uint16_t getU16(const std::uint8_t *p)
+    {
+    return std::uint16_t((p[0] << 8) | p[1]);
+    }
+
+inline std::int16_t getI16(const std::uint8_t *p)
+    {
+    return std::int16_t(getU16(p));
+    }
+
+inline std::uint32_t getU32(const std::uint8_t *p)
+    {
+    return (std::uint32_t(getU16(p)) << 16) | getU16(p + 2);
+    }
+
+inline std::int32_t getI32(const std::uint8_t *p)
+    {
+    return std::int32_t(getU32(p));
+    }
+
+// decode a message. Returns false if it isn't format 0x27, or its
+// length isn't what its flags say.
+inline bool decode(const std::uint8_t *p, size_t n, Message_t &m)
+    {
+    if (n < 2 || p[0] != kFormat || n != getMessageSize(p[1]))
+        return false;
+
+    m = Message_t();
+    m.flags = p[1];
+    p += 2;
+
+    if (m.flags & kVbat)
+        {
+        m.vBat = getI16(p) / 4096.0f;
+        p += 2;
+        }
+    if (m.flags & kBoot)
+        {
+        m.bootCountLsb = p[0];
+        p += 1;
+        }
+    if (m.flags & kTH)
+        {
+        m.tempC = getI16(p) / 256.0f;
+        m.humidity = getU16(p + 2) * 100.0f / 65535.0f;
+        p += 4;
+        }
+    if (m.flags & kGPS)
+        {
+        m.time = getU32(p);
+        m.latitude = getI32(p + 4) / 1e7;
+        m.longitude = getI32(p + 8) / 1e7;
+        p += 12;
+        }
+    if (m.flags & kPM)
+        {
+        for (unsigned i = 0; i < 7; ++i, p += 2)
+            m.mass[i] = uflt16ToFloat(getU16(p)) * 65536.0f;
+        }
+    if (m.flags & kCO2)
+        {
+        m.co2ppm = uflt16ToFloat(getU16(p)) * 40000.0f;
+        p += 2;
+        }
+    if (m.flags & kCO)
+        {
+        m.coPpm = uflt16ToFloat(getU16(p)) * 1000.0f;
+        p += 2;
+        }
+    if (m.flags & kNO2)
+        {
+        m.no2Ppm = uflt16ToFloat(getU16(p)) * 4.0f;
+        p += 2;
+        }
+
+    return true;
+    }
+
+} // namespace Port1
+} // namespace McciModel4916
+
+#endif /* _port1decoder_h_ */
@@ -0,0 +1,112 @@
+/*
+
+Module: port1fuzz.cpp
+
+Function:
+    libFuzzer target for the port 1 (format 0x27) decoder.
+
+Copyright:
+    See accompanying LICENSE file for copyright and license information.
+
+Author:
+    Dhinesh Kumar Pitchai, MCCI Corporation   November 2022
+
+Build:
+    clang++ -std=c++11 -g -O1 -fsanitize=fuzzer,address,undefined \
+        -o port1fuzz port1fuzz.cpp
+
+    Without libFuzzer (for example with g++), add -DPORT1FUZZ_MAIN to
+    get a main() that runs the inputs named on the command line, so a
+    corpus or a crash can be replayed.
+
+Usage:
+    port1fuzz [libFuzzer options] [corpus dir...]
+
+    hostsim/payloadcheck --corpus {dir} writes messages from the sketch's
+    encoder, to start from. The decoder must take exactly the messages
+    whose length matches their flags, and nothing it returns may be
+    outside what the encoding can hold; anything else aborts.
+
+*/
+
+#include "port1decoder.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+using namespace McciModel4916;
+
+namespace {
+
+void check(bool fOk, const char *pWhat)
+    {
+    if (! fOk)
+        {
+        std::fprintf(stderr, "port1fuzz: %s\n", pWhat);
+        std::abort();
+        }
+    }
+
+bool isIn(float v, float lo, float hi)
+    {
+    return v >= lo && v < hi;
+    }
+
+} // namespace
+
+extern "C" int LLVMFuzzerTestOneInput(const std::uint8_t *pData, size_t nData)
+    {
+    Port1::Message_t m;
+    bool const fValid = nData >= 2 &&
+                        pData[0] == Port1::kFormat &&
+                        nData == Port1::getMessageSize(pData[1]);
+
+    // copy, so the sanitizer sees a read past the end.
+    std::vector<std::uint8_t> const message(pData, pData + nData);
+    bool const fDecoded = Port1::decode(message.data(), message.size(), m);
+
+    check(fDecoded == fValid, fValid ? "valid message rejected" : "invalid message accepted");
+    if (! fDecoded)
+        return 0;
+
+    check(m.flags == pData[1], "flags");
+    check(isIn(m.vBat, -8.0f, 8.0f), "vBat");
+    check(isIn(m.tempC, -128.0f, 128.0f), "tempC");
+    check(isIn(m.humidity, 0.0f, 100.001f), "humidity");
+    check(std::fabs(m.latitude) <= 214.7483648 && std::fabs(m.longitude) <= 214.7483648, "position");
+    for (auto const mass : m.mass)
+        check(isIn(mass, 0.0f, 65536.0f), "mass");
+    check(isIn(m.co2ppm, 0.0f, 40000.0f), "co2ppm");
+    check(isIn(m.coPpm, 0.0f, 1000.0f), "coPpm");
+    check(isIn(m.no2Ppm, 0.0f, 4.0f), "no2Ppm");
+
+    return 0;
+    }
+
+#ifdef PORT1FUZZ_MAIN
+int main(int argc, char **argv)
+    {
+    for (int i = 1; i < argc; ++i)
+        {
+        auto const pFile = std::fopen(argv[i], "rb");
+        std::vector<std::uint8_t> data;
+        int c;
+
+        if (pFile == nullptr)
+            {
+            std::perror(argv[i]);
+            return 1;
+            }
+        while ((c = std::fgetc(pFile)) != EOF)
+            data.push_back(std::uint8_t(c));
+        std::fclose(pFile);
+
+        LLVMFuzzerTestOneInput(data.data(), data.size());
+        }
+    std::printf("%d inputs\n", argc - 1);
+    return 0;
+    }
+#endif /* PORT1FUZZ_MAIN */
@@ -0,0 +1,159 @@
+#!/usr/bin/env python3
+#
+# Module: sdexport.py
+#
+# Function:
+#     Receive a file from the Model4916 SD card over the USB console.
+#
+# Copyright:
+#     See accompanying LICENSE file for copyright and license information.
+#
+# Author:
+#     Dhinesh Kumar Pitchai, MCCI Corporation   November 2022
+#
+# Usage:
+#     python3 sdexport.py -p /dev/ttyACM0 Data/23111400.REC [-o 23111400.REC]
+#
+#     Requires pyserial. Blocks with a bad CRC, and gaps, are asked for
+#     again from the first missing offset; --resume continues a partial
+#     local copy. See catena-sd-export-protocol.md.
+#
+
+import argparse
+import base64
+import binascii
+import os
+import sys
+import time
+import zlib
+
+import serial
+
+
+class ExportError(Exception):
+    def __init__(self, message, offset):
+        super().__init__(message)
+        self.offset = offset
+
+
+def request(port, name, offset, length):
+    port.reset_input_buffer()
+    port.write(("export %s %d %d\n" % (name, offset, length)).encode("ascii"))
+
+
+def receive(port, name, out, start, offset, end, timeout):
+    """Receive from offset up to end (None for end of file); return the
+    offset reached and the size of the file. Raises ExportError if the
+    transfer has to be restarted."""
+    request(port, name, offset, 0 if end is None else end - offset)
+
+    crc = 0
+    size = None
+    deadline = time.monotonic() + timeout
+
+    while True:
+        line = port.readline()
+        if not line:
+            if time.monotonic() > deadline:
+                raise ExportError("timeout at %d" % offset, offset)
+            continue
+
+        # the console echo, prompts and log messages are not frames.
+        fields = line.decode("ascii", "replace").strip().split(" ")
+        if not fields[0].startswith("@"):
+            continue
+
+        deadline = time.monotonic() + timeout
+        tag = fields[0]
+
+        if tag == "@S" and len(fields) == 5:
+            size = int(fields[2])
+            if int(fields[3]) != offset:
+                raise ExportError("device started at %s, not %d" % (fields[3], offset), offset)
+            end = offset + int(fields[4])
+            if offset == end:
+                return offset, size
+
+        elif tag == "@D" and len(fields) == 4 and size is not None:
+            at = int(fields[1])
+            if at != offset:
+                raise ExportError("expected block at %d, got %d" % (offset, at), offset)
+            try:
+                data = base64.b64decode(fields[3], validate=True)
+            except binascii.Error:
+                raise ExportError("bad block at %d" % offset, offset)
+            if zlib.crc32(data) != int(fields[2], 16):
+                raise ExportError("bad CRC at %d" % offset, offset)
+
+            out.seek(offset - start)
+            out.write(data)
+            crc = zlib.crc32(data, crc)
+            offset += len(data)
+
+        elif tag == "@E" and len(fields) == 3 and size is not None:
+            if int(fields[1]) != offset or int(fields[2], 16) != crc:
+                raise ExportError("range CRC mismatch, ending at %s" % fields[1], offset)
+            return offset, size
+
+        elif tag == "@X":
+            raise ExportError("device stopped: %s" % " ".join(fields[1:]), offset)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Receive a file from the Model4916 SD card.")
+    parser.add_argument("name", help="file on the card, e.g. Data/23111400.REC")
+    parser.add_argument("-p", "--port", required=True, help="serial port of the device")
+    parser.add_argument("-b", "--baud", type=int, default=115200)
+    parser.add_argument("-o", "--output", help="local file (default: last part of name)")
+    parser.add_argument("--offset", type=int, default=0, help="first byte to fetch")
+    parser.add_argument("--length", type=int, default=0, help="bytes to fetch; 0 for all")
+    parser.add_argument("--resume", action="store_true", help="continue a partial local file")
+    parser.add_argument("--retries", type=int, default=5, help="retries without progress")
+    parser.add_argument("--timeout", type=float, default=5.0, help="seconds without a frame")
+    args = parser.parse_args()
+
+    outname = args.output or args.name.replace("\\", "/").split("/")[-1]
+    start = args.offset
+    offset = start
+    if args.resume and os.path.exists(outname):
+        offset += os.path.getsize(outname)
+    end = start + args.length if args.length else None
+
+    port = serial.Serial(args.port, args.baud, timeout=0.5)
+    mode = "r+b" if args.resume and os.path.exists(outname) else "wb"
+    tries = 0
+    began = time.monotonic()
+
+    with open(outname, mode) as out:
+        while True:
+            try:
+                offset, size = receive(port, args.name, out, start, offset, end, args.timeout)
+                break
+            except ExportError as e:
+                port.write(b"export stop\n")
+                # blocks are only kept once their CRC matched, so ask
+                # again from the last good offset.
+                if e.offset > offset:
+                    tries = 0
+                offset = e.offset
+                tries += 1
+                print("%s: %s; retrying from %d" % (args.name, e, offset), file=sys.stderr)
+                if tries > args.retries:
+                    print("%s: giving up" % args.name, file=sys.stderr)
+                    return 1
+                time.sleep(0.5)
+
+        out.truncate(offset - start)
+
+    elapsed = time.monotonic() - began
+    nBytes = offset - start
+    print(
+        "%s: %d bytes of %d in %.1f s (%.0f bytes/s)"
+        % (outname, nBytes, size, elapsed, nBytes / elapsed if elapsed > 0 else 0),
+        file=sys.stderr,
+    )
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,1015 @@
+/*
+
+Module: sdingest.cpp
+
+Function:
+    Read the CSV logs from many Model4916 SD cards into columns per
+    device.
+
+Copyright:
+    See accompanying LICENSE file for copyright and license information.
+
+Author:
+    Dhinesh Kumar Pitchai, MCCI Corporation   November 2022
+
+Build:
+    c++ -std=c++11 -O2 -pthread -o sdingest sdingest.cpp
+
+Usage:
+    sdingest [-j {threads}] [--scale] -o {outdir} {file or dir}...
+
+    Directories are searched for *.CSV (and Data/DeviceStart*.dat,
+    from older firmware, whose rows have fewer columns under the same
+    heading); files named on the command line are read whatever their
+    names. Each file is mapped, cut into pieces at row boundaries, and
+    the pieces are parsed on -j threads (default: one per core). The
+    raw uplink in each row is decoded and checked against the row's
+    values. The rows of each device are written to {outdir}/{DevEUI}/,
+    one file per column, in the order of the files and rows; see
+    catena-sd-ingest-format.md. --scale times the parsing on 1, 2, 4
+    ... threads first, to show how it scales.
+
+*/
+
+#include "../Model4916_SdLogFormat.h"
+#include "port1decoder.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace McciModel4916;
+
+namespace {
+
+/****************************************************************************\
+|
+|   Manifest constants & typedefs.
+|
+\****************************************************************************/
+
+// the same columns as cMeasurementLoop::kSdCsvHeader
+const char kHeader[] =
+    "Timestamp,DevEUI,Raw,Uplink Port,Vbat,Vsystem,BootCount,Latitude,Longitude,"
+    "T,RH,CO2,TVOC,IAQ,PC0.1,PC0.3,PC0.5,PC1.0,PC2.5,PC5.0,PC10,"
+    "PM0.1,PM0.3,PM0.5,PM1.0,PM2.5,PM5.0,PM10,CO,NO2,O3,SO2";
+
+enum CsvField : unsigned
+    {
+    kTimestamp, kDevEUI, kRaw, kPort, kVbat, kVsystem, kBootCount,
+    kLatitude, kLongitude, kT, kRH, kCO2, kTVOC, kIAQ,
+    kPC, kPM = kPC + 7, kGas = kPM + 7,
+    kFields = kGas + 4
+    };
+
+// Where each CsvField is in a row, by layout; rows are told apart by
+// their number of fields. Rows from older firmware (DeviceStart*.dat)
+// have no Uplink Port or Vsystem, a different order, and a trailing
+// comma; all were port 1 uplinks. Those uplinks had flags for fields
+// they didn't carry, so they aren't checked.
+constexpr std::uint8_t kAbsent = 0xFF;
+
+struct Layout_t
+    {
+    unsigned                        nFields;
+    bool                            fCheck;
+    std::uint8_t                    column[kFields];
+    };
+
+const Layout_t kLayouts[] =
+    {
+    // the current layout, in CsvField order
+        {
+        kFields, true,
+            {
+            0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13,
+            14, 15, 16, 17, 18, 19, 20,
+            21, 22, 23, 24, 25, 26, 27,
+            28, 29, 30, 31,
+            },
+        },
+    // Timestamp, DevEUI, Raw, Vbat, BootCount, T, RH, Latitude, Longitude,
+    // PC x 7, PM x 7, CO2, CO, NO2, O3, SO2, TVOC, IAQ, and an empty field.
+        {
+        31, false,
+            {
+            0, 1, 2, kAbsent, 3, kAbsent, 4, 7, 8, 5, 6, 23, 28, 29,
+            9, 10, 11, 12, 13, 14, 15,
+            16, 17, 18, 19, 20, 21, 22,
+            24, 25, 26, 27,
+            },
+        },
+    };
+
+// pieces of a file parsed by one thread; device logs are at most 1 MiB.
+constexpr size_t kChunkBytes = 1024 * 1024;
+
+// a missing integer.
+constexpr std::uint32_t kNone = 0xFFFFFFFF;
+
+// Check bits: the row's values that don't match its uplink.
+enum Check : std::uint8_t
+    {
+    kCheckVbat      = 1 << 0,
+    kCheckBoot      = 1 << 1,
+    kCheckTH        = 1 << 2,
+    kCheckCO2       = 1 << 3,
+    kCheckGPS       = 1 << 4,
+    kCheckPM        = 1 << 5,
+    // CO or NO2
+    kCheckGas       = 1 << 6,
+    // a port 1 uplink that doesn't decode
+    kCheckPayload   = 1 << 7,
+    };
+
+// the rows of one device, by column; missing floats are NaN.
+struct Columns_t
+    {
+    std::vector<std::uint32_t>      time;
+    std::vector<std::uint8_t>       port;
+    std::vector<float>              vBat;
+    std::vector<std::uint32_t>      bootCount;
+    std::vector<float>              latitude;
+    std::vector<float>              longitude;
+    std::vector<float>              tempC;
+    std::vector<float>              humidity;
+    std::vector<float>              co2ppm;
+    std::vector<std::uint32_t>      count[7];
+    std::vector<float>              mass[7];
+    std::vector<float>              gases[4];
+    std::vector<std::uint8_t>       check;
+
+    size_t size() const
+        {
+        return this->time.size();
+        }
+
+    template <typename T>
+    static void append(std::vector<T> &to, const std::vector<T> &from)
+        {
+        to.insert(to.end(), from.begin(), from.end());
+        }
+
+    void append(const Columns_t &other)
+        {
+        append(this->time, other.time);
+        append(this->port, other.port);
+        append(this->vBat, other.vBat);
+        append(this->bootCount, other.bootCount);
+        append(this->latitude, other.latitude);
+        append(this->longitude, other.longitude);
+        append(this->tempC, other.tempC);
+        append(this->humidity, other.humidity);
+        append(this->co2ppm, other.co2ppm);
+        for (unsigned i = 0; i < 7; ++i)
+            {
+            append(this->count[i], other.count[i]);
+            append(this->mass[i], other.mass[i]);
+            }
+        for (unsigned i = 0; i < 4; ++i)
+            append(this->gases[i], other.gases[i]);
+        append(this->check, other.check);
+        }
+    };
+
+struct Counts_t
+    {
+    std::uint64_t                   nRows;
+    std::uint64_t                   nBadRows;
+    std::uint64_t                   nChecked;
+    std::uint64_t                   nMismatched;
+    // by Check bit
+    std::uint64_t                   nCheck[8];
+
+    void add(const Counts_t &other)
+        {
+        this->nRows += other.nRows;
+        this->nBadRows += other.nBadRows;
+        this->nChecked += other.nChecked;
+        this->nMismatched += other.nMismatched;
+        for (unsigned i = 0; i < 8; ++i)
+            this->nCheck[i] += other.nCheck[i];
+        }
+    };
+
+// a mapped input file.
+struct File_t
+    {
+    std::string                     name;
+    const char                      *pBase;
+    size_t                          nBytes;
+    bool                            fBadHeader;
+    };
+
+// a piece of a file, starting and ending at a row boundary; and what
+// came of it.
+struct Job_t
+    {
+    File_t                          *pFile;
+    size_t                          begin;
+    size_t                          end;
+    std::map<std::uint64_t, Columns_t> devices;
+    Counts_t                        counts;
+    // the device of the last row: usually the same one
+    std::uint64_t                   lastKey;
+    Columns_t                       *pLast;
+    };
+
+/****************************************************************************\
+|
+|   The CSV kernel
+|
+\****************************************************************************/
+
+// the device writes integers, and floats with two places ("12.34",
+// "-0.05"); anything else, such as "nan" or "ovf", is left to strtod.
+float parseFloat(const char *p, const char *pEnd)
+    {
+    if (p == pEnd)
+        return std::numeric_limits<float>::quiet_NaN();
+
+    const char * const pStart = p;
+    bool const fNegative = *p == '-';
+    std::uint64_t mantissa = 0;
+    unsigned nPlaces = 0;
+
+    if (fNegative)
+        ++p;
+    while (p < pEnd && unsigned(*p - '0') < 10 && mantissa < 100000000000ull)
+        mantissa = mantissa * 10 + unsigned(*p++ - '0');
+    if (p < pEnd && *p == '.')
+        {
+        ++p;
+        while (p < pEnd && unsigned(*p - '0') < 10 && nPlaces < 6)
+            {
+            mantissa = mantissa * 10 + unsigned(*p++ - '0');
+            ++nPlaces;
+            }
+        }
+
+    if (p != pEnd)
+        {
+        char buf[32];
+        size_t const n = std::min(size_t(pEnd - pStart), sizeof(buf) - 1);
+
+        std::memcpy(buf, pStart, n);
+        buf[n] = '\0';
+        if (std::strcmp(buf, "ovf") == 0)
+            return std::numeric_limits<float>::infinity();
+        return float(std::strtod(buf, nullptr));
+        }
+
+    static const double kScale[7] = { 1.0, 1e-1, 1e-2, 1e-3, 1e-4, 1e-5, 1e-6 };
+    double const v = double(mantissa) * kScale[nPlaces];
+    return float(fNegative ? -v : v);
+    }
+
+bool parseUnsigned(const char *p, const char *pEnd, std::uint32_t &v)
+    {
+    std::uint64_t r = 0;
+
+    if (p == pEnd || pEnd - p > 10)
+        return false;
+    for (; p < pEnd; ++p)
+        {
+        if (unsigned(*p - '0') >= 10)
+            return false;
+        r = r * 10 + unsigned(*p - '0');
+        }
+    if (r > 0xFFFFFFFFu)
+        return false;
+    v = std::uint32_t(r);
+    return true;
+    }
+
+int hexDigit(char c)
+    {
+    if (unsigned(c - '0') < 10)
+        return c - '0';
+    c |= 0x20;
+    if (unsigned(c - 'a') < 6)
+        return c - 'a' + 10;
+    return -1;
+    }
+
+bool parseHex(const char *p, const char *pEnd, std::uint8_t *pBuffer, size_t nBuffer, size_t &n)
+    {
+    if ((pEnd - p) % 2 != 0 || size_t(pEnd - p) / 2 > nBuffer)
+        return false;
+
+    for (n = 0; p < pEnd; p += 2)
+        {
+        int const hi = hexDigit(p[0]);
+        int const lo = hexDigit(p[1]);
+
+        if (hi < 0 || lo < 0)
+            return false;
+        pBuffer[n++] = std::uint8_t((hi << 4) | lo);
+        }
+    return true;
+    }
+
+// a 16-digit DevEUI as a key; 0 if there isn't one.
+bool parseDevEUI(const char *p, const char *pEnd, std::uint64_t &key)
+    {
+    std::uint8_t eui[8];
+    size_t n;
+
+    key = 0;
+    if (p == pEnd)
+        return true;
+    if (! parseHex(p, pEnd, eui, sizeof(eui), n) || n != sizeof(eui))
+        return false;
+    for (unsigned i = 0; i < sizeof(eui); ++i)
+        key = (key << 8) | eui[i];
+    return true;
+    }
+
+/****************************************************************************\
+|
+|   Checking the uplink
+|
+\****************************************************************************/
+
+// the row's values are printed to 0.01; the uplink's are quantized.
+bool isNear(float row, float sent, float quantum)
+    {
+    return std::fabs(row - sent) <= quantum / 2 + 0.005f + std::fabs(sent) * 1e-6f;
+    }
+
+// a uflt16 of sent / scale: 12 significant bits, and anything under
+// 2^-16 of full scale is sent as zero.
+float getUflt16Quantum(float sent, float scale)
+    {
+    return std::fmax(sent / 2048, scale / 32768);
+    }
+
+// check row i of c against its uplink.
+std::uint8_t checkUplink(
+    const std::uint8_t *pRaw,
+    size_t nRaw,
+    const Columns_t &c,
+    size_t i
+    )
+    {
+    Port1::Message_t m;
+    std::uint8_t result = 0;
+
+    if (! Port1::decode(pRaw, nRaw, m))
+        return kCheckPayload;
+
+    float const vBat = c.vBat[i];
+    std::uint32_t const bootCount = c.bootCount[i];
+    float const tempC = c.tempC[i];
+    float const humidity = c.humidity[i];
+    float const co2ppm = c.co2ppm[i];
+
+    // a field must be in both or neither.
+    if ((m.flags & Port1::kVbat) != 0
+            ? std::isnan(vBat) || (m.vBat < 7.99f && ! isNear(vBat, m.vBat, 1.0f / 4096))
+            : ! std::isnan(vBat))
+        result |= kCheckVbat;
+
+    if ((m.flags & Port1::kBoot) != 0
+            ? bootCount == kNone || std::uint8_t(bootCount) != m.bootCountLsb
+            : bootCount != kNone)
+        result |= kCheckBoot;
+
+    if ((m.flags & Port1::kTH) != 0
+            ? std::isnan(tempC) || std::isnan(humidity) ||
+              (std::fabs(m.tempC) < 127.9f && ! isNear(tempC, m.tempC, 1.0f / 256)) ||
+              ! isNear(humidity, m.humidity, 100.0f / 65535)
+            : ! std::isnan(tempC) || ! std::isnan(humidity))
+        result |= kCheckTH;
+
+    if ((m.flags & Port1::kCO2) != 0
+            ? std::isnan(co2ppm) || (m.co2ppm < 39990.0f && ! isNear(co2ppm, m.co2ppm, getUflt16Quantum(m.co2ppm, 40000.0f)))
+            : ! std::isnan(co2ppm))
+        result |= kCheckCO2;
+
+    // the device leaves these out when the message wouldn't fit the data
+    // rate, so they need only be in the row if they're in the uplink.
+    if ((m.flags & Port1::kGPS) != 0 &&
+        (m.time != c.time[i] ||
+         std::isnan(c.latitude[i]) || ! isNear(c.latitude[i], float(m.latitude), 1e-7f) ||
+         std::isnan(c.longitude[i]) || ! isNear(c.longitude[i], float(m.longitude), 1e-7f)))
+        result |= kCheckGPS;
+
+    if ((m.flags & Port1::kPM) != 0)
+        {
+        for (unsigned j = 0; j < 7; ++j)
+            {
+            if (std::isnan(c.mass[j][i]) ||
+                (m.mass[j] < 65500.0f && ! isNear(c.mass[j][i], m.mass[j], getUflt16Quantum(m.mass[j], 65536.0f))))
+                result |= kCheckPM;
+            }
+        }
+
+    if (((m.flags & Port1::kCO) != 0 &&
+         (std::isnan(c.gases[0][i]) ||
+          (m.coPpm < 999.7f && ! isNear(c.gases[0][i], m.coPpm, getUflt16Quantum(m.coPpm, 1000.0f))))) ||
+        ((m.flags & Port1::kNO2) != 0 &&
+         (std::isnan(c.gases[1][i]) ||
+          (m.no2Ppm < 3.999f && ! isNear(c.gases[1][i], m.no2Ppm, getUflt16Quantum(m.no2Ppm, 4.0f))))))
+        result |= kCheckGas;
+
+    return result;
+    }
+
+/****************************************************************************\
+|
+|   Parsing a piece of a file
+|
+\****************************************************************************/
+
+void parseRow(Job_t &job, const Layout_t &layout, const char *(&field)[kFields + 1])
+    {
+    static const char kEmpty[] = "";
+    auto &counts = job.counts;
+    std::uint64_t key;
+    std::uint32_t time = 0;
+    std::uint32_t port = 1;
+    std::uint32_t bootCount = kNone;
+    std::uint8_t raw[SdLogFormat::kMaxRaw];
+    size_t nRaw = 0;
+
+    // field[j] is the start of row field j, and field[j + 1] - 1 its
+    // end; quotes are stripped here. A column the layout hasn't got is
+    // empty.
+    auto const begin = [&field, &layout](unsigned i) -> const char *
+        {
+        unsigned const j = layout.column[i];
+
+        if (j == kAbsent)
+            return kEmpty;
+        return field[j] + (field[j] != field[j + 1] - 1 && *field[j] == '"');
+        };
+    auto const end = [&field, &layout](unsigned i) -> const char *
+        {
+        unsigned const j = layout.column[i];
+
+        if (j == kAbsent)
+            return kEmpty;
+        const char *p = field[j + 1] - 1;
+        return p - 1 > field[j] && p[-1] == '"' ? p - 1 : p;
+        };
+
+    if ((begin(kTimestamp) != end(kTimestamp) &&
+            ! parseUnsigned(begin(kTimestamp), end(kTimestamp), time)) ||
+        ! parseDevEUI(begin(kDevEUI), end(kDevEUI), key) ||
+        ! parseHex(begin(kRaw), end(kRaw), raw, sizeof(raw), nRaw) ||
+        (layout.column[kPort] != kAbsent &&
+            (! parseUnsigned(begin(kPort), end(kPort), port) || port > 255)) ||
+        (begin(kBootCount) != end(kBootCount) &&
+            ! parseUnsigned(begin(kBootCount), end(kBootCount), bootCount)))
+        {
+        ++counts.nBadRows;
+        return;
+        }
+
+    if (job.pLast == nullptr || key != job.lastKey)
+        {
+        job.lastKey = key;
+        job.pLast = &job.devices[key];
+        }
+
+    auto &c = *job.pLast;
+    auto const getFloat = [&begin, &end](unsigned i)
+        {
+        return parseFloat(begin(i), end(i));
+        };
+
+    c.time.push_back(time);
+    c.port.push_back(std::uint8_t(port));
+    c.vBat.push_back(getFloat(kVbat));
+    c.bootCount.push_back(bootCount);
+    c.latitude.push_back(getFloat(kLatitude));
+    c.longitude.push_back(getFloat(kLongitude));
+    c.tempC.push_back(getFloat(kT));
+    c.humidity.push_back(getFloat(kRH));
+    c.co2ppm.push_back(getFloat(kCO2));
+    for (unsigned i = 0; i < 7; ++i)
+        {
+        std::uint32_t count = kNone;
+
+        if (begin(kPC + i) != end(kPC + i))
+            (void) parseUnsigned(begin(kPC + i), end(kPC + i), count);
+        c.count[i].push_back(count);
+        c.mass[i].push_back(getFloat(kPM + i));
+        }
+    for (unsigned i = 0; i < 4; ++i)
+        c.gases[i].push_back(getFloat(kGas + i));
+
+    std::uint8_t check = 0;
+    if (layout.fCheck && port == 1 && nRaw != 0)
+        {
+        check = checkUplink(raw, nRaw, c, c.size() - 1);
+        ++counts.nChecked;
+        if (check != 0)
+            ++counts.nMismatched;
+        for (unsigned i = 0; i < 8; ++i)
+            if (check & (1 << i))
+                ++counts.nCheck[i];
+        }
+    c.check.push_back(check);
+    ++counts.nRows;
+    }
+
+void parseJob(Job_t &job)
+    {
+    const char *p = job.pFile->pBase + job.begin;
+    const char * const pEnd = job.pFile->pBase + job.end;
+    // field[i] is where field i starts; field[kFields] is one past the
+    // end of the row, as if there were another field.
+    const char *field[kFields + 1];
+
+    job.devices.clear();
+    job.counts = Counts_t();
+    job.pLast = nullptr;
+
+    while (p < pEnd)
+        {
+        const char *pEol = static_cast<const char *>(std::memchr(p, '\n', pEnd - p));
+        if (pEol == nullptr)
+            pEol = pEnd;
+
+        const char *pRowEnd = pEol;
+        if (pRowEnd > p && pRowEnd[-1] == '\r')
+            --pRowEnd;
+
+        // the heading line, and blank lines.
+        if (pRowEnd == p || (*p == 'T' && size_t(pRowEnd - p) == sizeof(kHeader) - 1 &&
+                             std::memcmp(p, kHeader, sizeof(kHeader) - 1) == 0))
+            {
+            p = pEol + 1;
+            continue;
+            }
+
+        // split at commas; the device never puts one inside quotes.
+        unsigned nFields = 0;
+        field[nFields++] = p;
+        for (const char *q = p; q < pRowEnd && nFields <= kFields; ++q)
+            if (*q == ',')
+                field[nFields++] = q + 1;
+
+        const Layout_t *pLayout = nullptr;
+        for (auto const &layout : kLayouts)
+            if (layout.nFields == nFields)
+                pLayout = &layout;
+
+        if (pLayout != nullptr)
+            {
+            field[nFields] = pRowEnd + 1;
+            parseRow(job, *pLayout, field);
+            }
+        else
+            ++job.counts.nBadRows;
+
+        p = pEol + 1;
+        }
+    }
+
+// parse every job on nThreads threads; each takes the next job.
+void parseAll(std::vector<Job_t> &jobs, unsigned nThreads)
+    {
+    std::atomic<size_t> next(0);
+    auto const worker = [&jobs, &next]()
+        {
+        for (size_t i; (i = next++) < jobs.size();)
+            parseJob(jobs[i]);
+        };
+    std::vector<std::thread> threads;
+
+    for (unsigned i = 1; i < nThreads; ++i)
+        threads.emplace_back(worker);
+    worker();
+    for (auto &t : threads)
+        t.join();
+    }
+
+/****************************************************************************\
+|
+|   Input files
+|
+\****************************************************************************/
+
+bool hasLogSuffix(const char *pName)
+    {
+    size_t const n = std::strlen(pName);
+
+    if (n < 4 || pName[n - 4] != '.')
+        return false;
+
+    char ext[4];
+    for (unsigned i = 0; i < 3; ++i)
+        ext[i] = char(pName[n - 3 + i] & ~0x20);
+    ext[3] = '\0';
+    return std::strcmp(ext, "CSV") == 0 || std::strcmp(ext, "DAT") == 0;
+    }
+
+void findFiles(const std::string &path, bool fNamed, std::vector<std::string> &names)
+    {
+    struct stat st;
+
+    if (::stat(path.c_str(), &st) != 0)
+        {
+        std::perror(path.c_str());
+        return;
+        }
+
+    if (! S_ISDIR(st.st_mode))
+        {
+        if (fNamed || hasLogSuffix(path.c_str()))
+            names.push_back(path);
+        return;
+        }
+
+    DIR * const pDir = ::opendir(path.c_str());
+    if (pDir == nullptr)
+        {
+        std::perror(path.c_str());
+        return;
+        }
+
+    std::vector<std::string> entries;
+    while (auto const pEntry = ::readdir(pDir))
+        {
+        if (pEntry->d_name[0] != '.')
+            entries.push_back(path + "/" + pEntry->d_name);
+        }
+    ::closedir(pDir);
+
+    // file names sort by date, so rows come out in time order.
+    std::sort(entries.begin(), entries.end());
+    for (auto const &entry : entries)
+        findFiles(entry, false, names);
+    }
+
+bool mapFile(File_t &file)
+    {
+    int const fd = ::open(file.name.c_str(), O_RDONLY);
+    struct stat st;
+
+    file.pBase = nullptr;
+    file.nBytes = 0;
+    file.fBadHeader = false;
+    if (fd < 0 || ::fstat(fd, &st) != 0)
+        {
+        std::perror(file.name.c_str());
+        if (fd >= 0)
+            ::close(fd);
+        return false;
+        }
+
+    file.nBytes = size_t(st.st_size);
+    if (file.nBytes != 0)
+        {
+        void * const p = ::mmap(nullptr, file.nBytes, PROT_READ, MAP_PRIVATE, fd, 0);
+
+        if (p == MAP_FAILED)
+            {
+            std::perror(file.name.c_str());
+            ::close(fd);
+            return false;
+            }
+        ::madvise(p, file.nBytes, MADV_SEQUENTIAL);
+        file.pBase = static_cast<const char *>(p);
+        }
+    ::close(fd);
+
+    // a file with some other heading has other columns.
+    if (file.nBytes != 0 && file.pBase[0] == 'T')
+        {
+        size_t const n = sizeof(kHeader) - 1;
+
+        file.fBadHeader = file.nBytes < n || std::memcmp(file.pBase, kHeader, n) != 0 ||
+                          (file.nBytes > n && file.pBase[n] != '\r' && file.pBase[n] != '\n');
+        }
+
+    return true;
+    }
+
+// cut a file into pieces of about kChunkBytes, each ending at a newline.
+void addJobs(File_t &file, std::vector<Job_t> &jobs)
+    {
+    size_t begin = 0;
+
+    while (begin < file.nBytes)
+        {
+        size_t end = begin + kChunkBytes;
+
+        if (end >= file.nBytes)
+            end = file.nBytes;
+        else
+            {
+            auto const pEol = static_cast<const char *>(
+                std::memchr(file.pBase + end, '\n', file.nBytes - end)
+                );
+            end = pEol == nullptr ? file.nBytes : size_t(pEol - file.pBase) + 1;
+            }
+
+        jobs.push_back(Job_t());
+        jobs.back().pFile = &file;
+        jobs.back().begin = begin;
+        jobs.back().end = end;
+        begin = end;
+        }
+    }
+
+/****************************************************************************\
+|
+|   Output
+|
+\****************************************************************************/
+
+template <typename T>
+bool writeColumn(const std::string &dir, const char *pName, const char *pType, const std::vector<T> &v)
+    {
+    std::string const path = dir + "/" + pName + "." + pType;
+    std::FILE * const pFile = std::fopen(path.c_str(), "wb");
+
+    if (pFile == nullptr)
+        {
+        std::perror(path.c_str());
+        return false;
+        }
+
+    bool const fResult = std::fwrite(v.data(), sizeof(T), v.size(), pFile) == v.size();
+    if (std::fclose(pFile) != 0 || ! fResult)
+        {
+        std::fprintf(stderr, "%s: write failed\n", path.c_str());
+        return false;
+        }
+    return true;
+    }
+
+bool makeDirectory(const std::string &path)
+    {
+    if (::mkdir(path.c_str(), 0777) != 0 && errno != EEXIST)
+        {
+        std::perror(path.c_str());
+        return false;
+        }
+    return true;
+    }
+
+std::string getDeviceName(std::uint64_t key)
+    {
+    char buf[24];
+
+    if (key == 0)
+        return "unknown";
+    std::snprintf(buf, sizeof(buf), "%016llX", (unsigned long long) key);
+    return buf;
+    }
+
+bool writeDevice(const std::string &dir, const Columns_t &c)
+    {
+    static const char * const kCountNames[7] = { "pc0_1", "pc0_3", "pc0_5", "pc1_0", "pc2_5", "pc5_0", "pc10" };
+    static const char * const kMassNames[7] = { "pm0_1", "pm0_3", "pm0_5", "pm1_0", "pm2_5", "pm5_0", "pm10" };
+    static const char * const kGasNames[4] = { "co", "no2", "o3", "so2" };
+    bool fResult = makeDirectory(dir);
+
+    fResult = fResult && writeColumn(dir, "time", "u32", c.time);
+    fResult = fResult && writeColumn(dir, "port", "u8", c.port);
+    fResult = fResult && writeColumn(dir, "vbat", "f32", c.vBat);
+    fResult = fResult && writeColumn(dir, "boot", "u32", c.bootCount);
+    fResult = fResult && writeColumn(dir, "lat", "f32", c.latitude);
+    fResult = fResult && writeColumn(dir, "lon", "f32", c.longitude);
+    fResult = fResult && writeColumn(dir, "t", "f32", c.tempC);
+    fResult = fResult && writeColumn(dir, "rh", "f32", c.humidity);
+    fResult = fResult && writeColumn(dir, "co2", "f32", c.co2ppm);
+    for (unsigned i = 0; i < 7; ++i)
+        {
+        fResult = fResult && writeColumn(dir, kCountNames[i], "u32", c.count[i]);
+        fResult = fResult && writeColumn(dir, kMassNames[i], "f32", c.mass[i]);
+        }
+    for (unsigned i = 0; i < 4; ++i)
+        fResult = fResult && writeColumn(dir, kGasNames[i], "f32", c.gases[i]);
+    fResult = fResult && writeColumn(dir, "check", "u8", c.check);
+
+    return fResult;
+    }
+
+/****************************************************************************\
+|
+|   main
+|
+\****************************************************************************/
+
+const char kUsage[] =
+    "usage: sdingest [-j {threads}] [--scale] -o {outdir} {file or dir}...\n";
+
+double getSeconds()
+    {
+    return std::chrono::duration<double>(
+                std::chrono::steady_clock::now().time_since_epoch()
+                ).count();
+    }
+
+} // namespace
+
+int main(int argc, char **argv)
+    {
+    unsigned nThreads = std::thread::hardware_concurrency();
+    bool fScale = false;
+    const char *pOut = nullptr;
+    std::vector<std::string> names;
+    int iArg;
+
+    for (iArg = 1; iArg < argc && argv[iArg][0] == '-'; ++iArg)
+        {
+        if (std::strcmp(argv[iArg], "-j") == 0 && iArg + 1 < argc)
+            nThreads = unsigned(std::strtoul(argv[++iArg], nullptr, 0));
+        else if (std::strcmp(argv[iArg], "-o") == 0 && iArg + 1 < argc)
+            pOut = argv[++iArg];
+        else if (std::strcmp(argv[iArg], "--scale") == 0)
+            fScale = true;
+        else
+            break;
+        }
+
+    if (pOut == nullptr || iArg >= argc || argv[iArg][0] == '-')
+        {
+        std::fputs(kUsage, stderr);
+        return 2;
+        }
+    if (nThreads == 0)
+        nThreads = 1;
+
+    for (; iArg < argc; ++iArg)
+        findFiles(argv[iArg], true, names);
+
+    // map everything, and cut it into jobs.
+    std::vector<File_t> files(names.size());
+    std::vector<Job_t> jobs;
+    std::uint64_t nBytes = 0;
+    int status = 0;
+
+    for (size_t i = 0; i < names.size(); ++i)
+        {
+        auto &file = files[i];
+
+        file.name = names[i];
+        if (! mapFile(file))
+            {
+            status = 1;
+            continue;
+            }
+        if (file.fBadHeader)
+            {
+            std::fprintf(stderr, "%s: different columns, skipped\n", file.name.c_str());
+            status = 1;
+            continue;
+            }
+        nBytes += file.nBytes;
+        addJobs(file, jobs);
+        }
+
+    if (jobs.empty())
+        {
+        std::fprintf(stderr, "sdingest: nothing to read\n");
+        return 1;
+        }
+
+    // rows per second on 1, 2, 4 ... threads.
+    if (fScale)
+        {
+        double base = 0.0;
+
+        std::printf("%-8s %12s %10s %8s\n", "threads", "rows/s", "MB/s", "speedup");
+        for (unsigned n = 1; ; n = n * 2 < nThreads ? n * 2 : nThreads)
+            {
+            double const tStart = getSeconds();
+            parseAll(jobs, n);
+            double const sec = getSeconds() - tStart;
+
+            std::uint64_t nRows = 0;
+            for (auto const &job : jobs)
+                nRows += job.counts.nRows + job.counts.nBadRows;
+            if (n == 1)
+                base = sec;
+
+            std::printf(
+                "%-8u %12.0f %10.1f %7.2fx\n",
+                n, nRows / sec, nBytes / sec / 1e6, base / sec
+                );
+            if (n == nThreads)
+                break;
+            }
+        std::printf("\n");
+        }
+
+    double const tParse = getSeconds();
+    parseAll(jobs, nThreads);
+    double const parseSec = getSeconds() - tParse;
+
+    // gather each device's rows in file order, whichever thread read them.
+    double const tWrite = getSeconds();
+    std::map<std::uint64_t, Columns_t> devices;
+    Counts_t counts = Counts_t();
+
+    for (auto &job : jobs)
+        {
+        counts.add(job.counts);
+        for (auto const &device : job.devices)
+            devices[device.first].append(device.second);
+        job.devices.clear();
+        }
+
+    if (! makeDirectory(pOut))
+        return 1;
+
+    std::string const indexPath = std::string(pOut) + "/index.csv";
+    std::FILE * const pIndex = std::fopen(indexPath.c_str(), "w");
+    if (pIndex == nullptr)
+        {
+        std::perror(indexPath.c_str());
+        return 1;
+        }
+
+    std::fprintf(pIndex, "DevEUI,Rows,First,Last,Mismatched\n");
+    for (auto const &device : devices)
+        {
+        auto const &c = device.second;
+        std::string const name = getDeviceName(device.first);
+        std::uint32_t first = 0, last = 0;
+        std::uint64_t nMismatched = 0;
+
+        for (size_t i = 0; i < c.size(); ++i)
+            {
+            if (c.time[i] != 0)
+                {
+                if (first == 0 || c.time[i] < first)
+                    first = c.time[i];
+                if (c.time[i] > last)
+                    last = c.time[i];
+                }
+            nMismatched += c.check[i] != 0;
+            }
+
+        std::fprintf(
+            pIndex, "%s,%lu,%lu,%lu,%llu\n",
+            name.c_str(), (unsigned long) c.size(),
+            (unsigned long) first, (unsigned long) last,
+            (unsigned long long) nMismatched
+            );
+        if (! writeDevice(std::string(pOut) + "/" + name, c))
+            status = 1;
+        }
+
+    if (std::fclose(pIndex) != 0)
+        status = 1;
+    double const writeSec = getSeconds() - tWrite;
+
+    for (auto &file : files)
+        {
+        if (file.pBase != nullptr)
+            ::munmap(const_cast<char *>(file.pBase), file.nBytes);
+        }
+
+    std::printf("%-10s %lu (%.1f MB)\n", "files", (unsigned long) files.size(), nBytes / 1e6);
+    std::printf(
+        "%-10s %llu, %llu malformed\n", "rows",
+        (unsigned long long) counts.nRows, (unsigned long long) counts.nBadRows
+        );
+    std::printf("%-10s %lu\n", "devices", (unsigned long) devices.size());
+    std::printf(
+        "%-10s %llu checked, %llu mismatched (vbat %llu, boot %llu, t/rh %llu, co2 %llu, gps %llu, pm %llu, gas %llu), %llu undecodable\n",
+        "uplinks",
+        (unsigned long long) counts.nChecked,
+        (unsigned long long) counts.nMismatched,
+        (unsigned long long) counts.nCheck[0],
+        (unsigned long long) counts.nCheck[1],
+        (unsigned long long) counts.nCheck[2],
+        (unsigned long long) counts.nCheck[3],
+        (unsigned long long) counts.nCheck[4],
+        (unsigned long long) counts.nCheck[5],
+        (unsigned long long) counts.nCheck[6],
+        (unsigned long long) counts.nCheck[7]
+        );
+    std::printf(
+        "%-10s %.3f s on %u threads: %.0f rows/s, %.1f MB/s\n",
+        "parse", parseSec, nThreads,
+        (counts.nRows + counts.nBadRows) / parseSec, nBytes / parseSec / 1e6
+        );
+    std::printf("%-10s %.3f s\n", "write", writeSec);
+
+    return status;
+    }
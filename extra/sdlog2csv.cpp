@@ -0,0 +1,325 @@
+/*
+
+Module: sdlog2csv.cpp
+
+Function:
+    Convert Model4916 binary SD logs to CSV.
+
+Copyright:
+    See accompanying LICENSE file for copyright and license information.
+
+Author:
+    Dhinesh Kumar Pitchai, MCCI Corporation   November 2022
+
+Build:
+    c++ -std=c++11 -O2 -o sdlog2csv sdlog2csv.cpp
+
+Usage:
+    sdlog2csv [-n] file.rec... > data.csv
+
+    The output has the same columns as the CSV logs written by the
+    device; -n omits the heading line. Records with a bad CRC are
+    skipped and counted on stderr.
+
+*/
+
+#include "../Model4916_SdLogFormat.h"
+#include "../Model4916_crc.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+using namespace McciModel4916;
+
+namespace {
+
+// the same columns as kHeader in Model4916_cMeasurementLoop_SDcard.cpp
+const char kHeader[] =
+    "Timestamp,DevEUI,Raw,Uplink Port,Vbat,Vsystem,BootCount,Latitude,Longitude,"
+    "T,RH,CO2,TVOC,IAQ,PC0.1,PC0.3,PC0.5,PC1.0,PC2.5,PC5.0,PC10,"
+    "PM0.1,PM0.3,PM0.5,PM1.0,PM2.5,PM5.0,PM10,CO,NO2,O3,SO2";
+
+// cMeasurementFormat::Flags
+enum Flags : std::uint16_t
+    {
+    kVbat   = 1 << 0,
+    kBoot   = 1 << 1,
+    kTH     = 1 << 2,
+    kGPS    = 1 << 3,
+    kPM     = 1 << 4,
+    kCO2    = 1 << 5,
+    kCO     = 1 << 6,
+    kNO2    = 1 << 7,
+    kO3     = 1 << 8,
+    kSO2    = 1 << 9,
+    };
+
+// append a float the way Arduino's Print::print(float) does: two
+// digits after the point, rounded half up, no exponent.
+void printFloat(std::string &s, double number)
+    {
+    char buf[24];
+
+    if (std::isnan(number))
+        {
+        s += "nan";
+        return;
+        }
+    if (std::isinf(number))
+        {
+        s += "inf";
+        return;
+        }
+    if (number > 4294967040.0 || number < -4294967040.0)
+        {
+        s += "ovf";
+        return;
+        }
+
+    if (number < 0.0)
+        {
+        s += '-';
+        number = -number;
+        }
+
+    number += 0.005;
+
+    unsigned long intPart = (unsigned long)number;
+    double remainder = number - (double)intPart;
+    std::snprintf(buf, sizeof(buf), "%lu.", intPart);
+    s += buf;
+
+    for (int i = 0; i < 2; ++i)
+        {
+        remainder *= 10.0;
+        unsigned digit = unsigned(remainder);
+        s += char('0' + digit);
+        remainder -= digit;
+        }
+    }
+
+void printUnsigned(std::string &s, unsigned long v)
+    {
+    char buf[16];
+    std::snprintf(buf, sizeof(buf), "%lu", v);
+    s += buf;
+    }
+
+void printHex(std::string &s, const std::uint8_t *p, size_t n)
+    {
+    char buf[4];
+
+    s += '"';
+    for (size_t i = 0; i < n; ++i)
+        {
+        std::snprintf(buf, sizeof(buf), "%02x", p[i]);
+        s += buf;
+        }
+    s += '"';
+    }
+
+bool isZero(const std::uint8_t *p, size_t n)
+    {
+    for (size_t i = 0; i < n; ++i)
+        if (p[i] != 0)
+            return false;
+    return true;
+    }
+
+// one row, in the same order and with the same rules as the device.
+void formatRecord(
+    std::string &s,
+    const SdLogFormat::FileHeader_t &header,
+    const SdLogFormat::Record_t &r
+    )
+    {
+    s.clear();
+
+    if (r.time != 0)
+        printUnsigned(s, r.time);
+    s += ',';
+
+    if (! isZero(header.devEUI, sizeof(header.devEUI)))
+        printHex(s, header.devEUI, sizeof(header.devEUI));
+    s += ',';
+
+    printHex(s, r.raw, r.nRaw < sizeof(r.raw) ? r.nRaw : sizeof(r.raw));
+    s += ',';
+
+    printUnsigned(s, r.port);
+    s += ',';
+
+    if (r.flags & kVbat)
+        printFloat(s, r.vBat);
+    s += ',';
+
+    // Vsystem isn't measured.
+    s += ',';
+
+    if (r.flags & kBoot)
+        printUnsigned(s, r.bootCount);
+    s += ',';
+
+    if (r.flags & kGPS)
+        {
+        printFloat(s, r.latitude);
+        s += ',';
+        printFloat(s, r.longitude);
+        s += ',';
+        }
+    else
+        s += ",,";
+
+    if (r.flags & kTH)
+        {
+        printFloat(s, r.tempC);
+        s += ',';
+        printFloat(s, r.humidity);
+        s += ',';
+        }
+    else
+        s += ",,";
+
+    if (r.flags & kCO2)
+        printFloat(s, r.co2ppm);
+    s += ',';
+
+    // TVOC and IAQ aren't measured.
+    s += ",,";
+
+    if (r.flags & kPM)
+        {
+        for (unsigned i = 0; i < 7; ++i)
+            {
+            printUnsigned(s, r.count[i]);
+            s += ',';
+            }
+        for (unsigned i = 0; i < 7; ++i)
+            {
+            printFloat(s, r.mass[i]);
+            s += ',';
+            }
+        }
+    else
+        s += ",,,,,,,,,,,,,,";
+
+    static const std::uint16_t kGasFlags[4] = { kCO, kNO2, kO3, kSO2 };
+    for (unsigned i = 0; i < 4; ++i)
+        {
+        if (r.flags & kGasFlags[i])
+            printFloat(s, r.gases[i]);
+        if (i < 3)
+            s += ',';
+        }
+
+    s += "\r\n";
+    }
+
+bool convertFile(const char *pName, std::FILE *pOut)
+    {
+    std::FILE *pIn = std::fopen(pName, "rb");
+    if (pIn == nullptr)
+        {
+        std::perror(pName);
+        return false;
+        }
+
+    std::uint8_t sector[SdLogFormat::kSectorSize];
+    SdLogFormat::FileHeader_t header;
+
+    if (std::fread(sector, sizeof(sector), 1, pIn) != 1)
+        {
+        std::fprintf(stderr, "%s: too short\n", pName);
+        std::fclose(pIn);
+        return false;
+        }
+
+    std::memcpy(&header, sector, sizeof(header));
+    if (std::memcmp(header.magic, SdLogFormat::kFileMagic, sizeof(header.magic)) != 0 ||
+        header.crc != crc32_ieee(&header, offsetof(SdLogFormat::FileHeader_t, crc)))
+        {
+        std::fprintf(stderr, "%s: not a binary log\n", pName);
+        std::fclose(pIn);
+        return false;
+        }
+    if (header.schemaVersion == 0 ||
+        header.schemaVersion > SdLogFormat::kSchemaVersion ||
+        header.recordSize != SdLogFormat::kRecordSize ||
+        header.recordsPerSector != SdLogFormat::kRecordsPerSector)
+        {
+        std::fprintf(stderr, "%s: unsupported schema %u\n", pName, header.schemaVersion);
+        std::fclose(pIn);
+        return false;
+        }
+
+    unsigned long nRecords = 0;
+    unsigned long nBad = 0;
+    std::string line;
+
+    while (std::fread(sector, 1, sizeof(sector), pIn) >= SdLogFormat::kRecordSize)
+        {
+        for (unsigned i = 0; i < SdLogFormat::kRecordsPerSector; ++i)
+            {
+            SdLogFormat::Record_t record;
+
+            std::memcpy(&record, sector + i * SdLogFormat::kRecordSize, sizeof(record));
+
+            // space that hasn't been written yet
+            if (isZero((const std::uint8_t *)&record, sizeof(record)))
+                continue;
+
+            if (record.crc != crc32_ieee(&record, offsetof(SdLogFormat::Record_t, crc)))
+                {
+                ++nBad;
+                continue;
+                }
+
+            formatRecord(line, header, record);
+            std::fwrite(line.data(), 1, line.size(), pOut);
+            ++nRecords;
+            }
+
+        std::memset(sector, 0, sizeof(sector));
+        }
+
+    std::fclose(pIn);
+
+    if (nBad != 0)
+        std::fprintf(stderr, "%s: %lu records, %lu skipped (bad CRC)\n", pName, nRecords, nBad);
+
+    return true;
+    }
+
+} // namespace
+
+int main(int argc, char **argv)
+    {
+    bool fHeader = true;
+    int iArg = 1;
+    int status = 0;
+
+    if (iArg < argc && std::strcmp(argv[iArg], "-n") == 0)
+        {
+        fHeader = false;
+        ++iArg;
+        }
+
+    if (iArg >= argc)
+        {
+        std::fprintf(stderr, "usage: %s [-n] file.rec...\n", argv[0]);
+        return 2;
+        }
+
+    if (fHeader)
+        std::fprintf(stdout, "%s\r\n", kHeader);
+
+    for (; iArg < argc; ++iArg)
+        {
+        if (! convertFile(argv[iArg], stdout))
+            status = 1;
+        }
+
+    return status;
+    }